@@ -45,6 +45,9 @@ benchmarks = [
     {'name': 'allocbench/small.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'allocbench/small-recursive.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'allocbench/small-reuse.R', 'warmup_rep': 0, 'bench_rep': 1},
+    {'name': 'allocbench/small-moribund.R', 'warmup_rep': 0, 'bench_rep': 1},
+    {'name': 'allocbench/small-raw.R', 'warmup_rep': 0, 'bench_rep': 1},
+    {'name': 'allocbench/small-raw-threads.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'allocbench/medium.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'allocbench/medium-recursive.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'allocbench/medium-reuse.R', 'warmup_rep': 0, 'bench_rep': 1},
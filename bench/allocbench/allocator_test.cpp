@@ -22,7 +22,12 @@
  */
 
 #define COMPILING_RHO
+#include <thread>
+#include <vector>
+
 #include "rho/IntVector.hpp"
+#include "rho/GCNodeAllocator.hpp"
+#include "rho/ListVector.hpp"
 #include "rho/GCStackRoot.hpp"
 #include "rho/MemoryBank.hpp"
 //#include "rho/BlockPool.hpp"
@@ -180,3 +185,58 @@ SEXP alloc_lookup_intvec(int* num, int* lookups, int* size) {
     return nullptr;
 }
 
+
+// Repeatedly fill a list with fresh scalars and then drop it.  The scalars
+// are typically still on the moribund list when the list (and hence they)
+// are deleted, which used to take time proportional to the length of the
+// moribund list for each scalar.
+extern "C"
+SEXP alloc_moribund_scalar(int* num, int* each) {
+    alloc_various_intvec();
+    for (int i = 0; i < ((*num + *each - 1) / *each); ++i) {
+        GCStackRoot<ListVector> list(ListVector::create(*each));
+        for (int j = 0; j < *each; ++j) {
+            (*list)[j] = ScalarInteger(j);
+        }
+    }
+    return nullptr;
+}
+
+// Allocate and free num blocks of the given size directly from the
+// GCNodeAllocator, keeping up to each blocks live at a time.
+static void alloc_free_raw(int num, size_t each, int size) {
+    std::vector<void*> allocations;
+    allocations.reserve(each);
+    for (int i = 0; i < num; ++i) {
+        if (allocations.size() == each) {
+            for (void* allocation : allocations) {
+                GCNodeAllocator::free(allocation);
+            }
+            allocations.clear();
+        }
+        allocations.push_back(GCNodeAllocator::allocate(size));
+    }
+    for (void* allocation : allocations) {
+        GCNodeAllocator::free(allocation);
+    }
+}
+
+// Run alloc_free_raw() on each of several threads at once.  With one thread
+// this measures the allocator's single-threaded fast path; with more it
+// measures the scaling of the per-thread caches.  Only the allocator itself
+// is thread-safe, so this bypasses GCNode construction.
+extern "C"
+SEXP alloc_raw_threads(int* num, int* each, int* size, int* threads) {
+    if (*threads == 1) {
+        alloc_free_raw(*num, *each, *size);
+        return nullptr;
+    }
+    std::vector<std::thread> workers;
+    for (int i = 0; i < *threads; ++i) {
+        workers.emplace_back(alloc_free_raw, *num, *each, *size);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return nullptr;
+}
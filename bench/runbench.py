@@ -49,6 +49,12 @@ benchmarks = [
     {'name': 'benchmarks/scalar/gcd/gcd_rec.R', 'warmup_rep': 2000, 'bench_rep': 5000},
     {'name': 'benchmarks/scalar/prime/prime.R', 'warmup_rep': 2, 'bench_rep': 3},
     {'name': 'benchmarks/scalar/ForLoopAdd/ForLoopAdd.R', 'warmup_rep': 2, 'bench_rep': 3},
+    # for() loop versions of the scalar benchmarks, for comparing the JIT's
+    # compiled loops against the interpreter.
+    {'name': 'jitbench/fib-for.R', 'warmup_rep': 2, 'bench_rep': 5},
+    {'name': 'jitbench/prime-for.R', 'warmup_rep': 2, 'bench_rep': 3},
+    {'name': 'jitbench/for-sum.R', 'warmup_rep': 2, 'bench_rep': 5},
+    {'name': 'jitbench/for-list.R', 'warmup_rep': 2, 'bench_rep': 5},
     {'name': 'benchmarks/shootout/nbody/nbody.R', 'warmup_rep': 0, 'bench_rep': 1},
     {'name': 'benchmarks/shootout/fannkuch-redux/fannkuch-redux.R', 'warmup_rep': 0, 'bench_rep': 1},
     # Skip shootout/spectral-norm because it takes too long.
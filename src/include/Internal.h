@@ -200,6 +200,7 @@ SEXP do_formals(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObj
 SEXP do_function(SEXP, SEXP, SEXP, SEXP);  // Special
 SEXP do_gc(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* verbose_, rho::RObject* reset_);
 SEXP do_gcinfo(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* verbose_);
+SEXP do_gcstats(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* reset_);
 SEXP do_gctime(rho::Expression* call, const rho::BuiltInFunction* op, int num_args, ...);
 SEXP do_gctorture(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* on_);
 SEXP do_gctorture2(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* step_, rho::RObject* wait_, rho::RObject* inhibit_release_);
@@ -246,6 +247,8 @@ SEXP do_isna(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject
 SEXP do_isnan(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* x_);
 SEXP do_isunsorted(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* x_, rho::RObject* strictly_);
 SEXP do_isvector(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* x_, rho::RObject* mode_);
+SEXP do_jitinfo(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* f_);
+SEXP do_jitstats(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* reset_);
 SEXP do_lapack(SEXP, SEXP, SEXP, SEXP);
 SEXP do_lapply(SEXP, SEXP, SEXP, SEXP);  // Special
 SEXP do_lazyLoadDBfetch(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* key_, rho::RObject* file_, rho::RObject* compressed_, rho::RObject* hook_);
@@ -364,7 +367,7 @@ rho::ArgumentArrayFn do_seq_along;
 SEXP do_seq_len(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* length);
 SEXP do_serialize(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* object, rho::RObject* connection, rho::RObject* type, rho::RObject* version, rho::RObject* hook);
 SEXP do_unserialize(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* object, rho::RObject* connection);
-SEXP do_serializeToConn(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* object_, rho::RObject* con_, rho::RObject* ascii_, rho::RObject* version_, rho::RObject* refhook_);
+SEXP do_serializeToConn(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* object_, rho::RObject* con_, rho::RObject* ascii_, rho::RObject* xdr_, rho::RObject* version_, rho::RObject* refhook_);
 SEXP do_set(SEXP, SEXP, SEXP, SEXP);  // Special
 SEXP do_setS4Object(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* object_, rho::RObject* flag_, rho::RObject* complete_);
 SEXP do_setFileTime(rho::Expression* call, const rho::BuiltInFunction* op, rho::RObject* path_, rho::RObject* time_);
@@ -212,6 +212,35 @@ public:
    */
   void applyToAllAllocations(std::function<void(void*)> fun) const;
 
+  /** @brief Calls the argument function on the allocation (if any) whose
+   * representative entry is the given bucket.
+   *
+   * Calling this for every bucket index from 0 to numBuckets() - 1 is
+   * equivalent to calling applyToAllAllocations().  Different buckets can
+   * be handled by different threads, so long as no allocations are added
+   * or freed meanwhile.
+   */
+  void applyToBucket(unsigned index, std::function<void(void*)> fun) const;
+
+  /** @brief The number of buckets in the hashtable. */
+  unsigned numBuckets() const {
+    return m_num_buckets;
+  }
+
+  /** @brief The number of buckets holding an entry. */
+  unsigned numUsedBuckets() const;
+
+  /** @brief Iterates over the allocations in the table without visiting
+   * their blocks.
+   *
+   * @param superblock_fun called for each medium-object superblock.
+   * @param large_fun called with the 2-log of the size of each large
+   * allocation.
+   */
+  void applyToEntries(
+      std::function<void(const AllocatorSuperblock*)> superblock_fun,
+      std::function<void(unsigned)> large_fun) const;
+
   /** @breif Erases all hashtable entries for an allocation.
    *
    * @param size_log2 the 2-log of the allocation size. Determines how many
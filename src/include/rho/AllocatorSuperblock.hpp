@@ -48,6 +48,16 @@ namespace rho {
  * of blocks that fit in the superblock, then the superblock is taken out of
  * the pool of superblocks with available nodes. Superblock nodes that are
  * freed are linked up in freelists according to size class.
+ *
+ * Small-object superblocks are owned by the thread cache of a single thread
+ * (see GCNodeAllocator), which bumps m_next_untouched without locking.
+ * Blocks may be freed by other threads meanwhile, so the free bitset is
+ * updated atomically.
+ *
+ * The memory of an empty superblock can be returned to the operating system
+ * with release().  A released small-object superblock keeps its header,
+ * with all blocks marked free, until newSuperblockFromArena() reuses it
+ * (possibly for another size class).
  */
 class AllocatorSuperblock {
 public:
@@ -74,33 +84,63 @@ public:
    */
   static void allocateArena();
 
-  /**
-   * Allocate a small block (bytes >= 32 && bytes <= 256).
-   * Returns nullptr if there is no more space left for this object
-   * size in the small object arena.
-   */
-  static void* allocateBlock(size_t block_size);
-
   /**
    * Allocates the next untouched block in this superblock.
    * The superblock must have an untouched block when calling this function.
    */
   void* allocateNextUntouched();
 
+  /** Returns true if some blocks in this superblock have never been used. */
+  bool hasUntouchedBlocks() const {
+    return m_next_untouched < numBlocks();
+  }
+
+  /** Returns true if this superblock has been released. */
+  bool isReleased() const {
+    return m_next_untouched == s_released;
+  }
+
+  /**
+   * Return the memory of an empty superblock to the operating system.  None
+   * of its blocks may be allocated, or linked in any freelist.  A medium
+   * object superblock is deleted.
+   *
+   * @return the number of bytes returned.
+   */
+  static std::size_t release(AllocatorSuperblock* superblock);
+
+  /** @brief The number of released superblocks in the small object arena. */
+  static unsigned numReleasedArenaSuperblocks();
+
   /** Allocate a medium or large object. */
   static void* allocateLarge(unsigned size_log2);
 
   /** @brief Apply function to all current allocations. */
   static void applyToArenaAllocations(std::function<void(void*)> fun);
 
+  /** @brief The number of superblocks carved out of the small object arena. */
+  static unsigned numArenaSuperblocks();
+
+  /**
+   * Returns the superblock with the given index in the small object arena.
+   * The index must be less than numArenaSuperblocks().
+   */
+  static const AllocatorSuperblock* arenaSuperblock(unsigned index);
+
   /** @brief Apply function to all current blocks in this superblock. */
   void applyToBlocks(std::function<void(void*)> fun) const;
 
+  /** @brief The number of blocks currently allocated in this superblock. */
+  unsigned numAllocatedBlocks() const;
+
   /**
    * Free a pointer inside a given superblock. The block MUST be in the given
    * superblock.
+   *
+   * @return the block, converted to a free list node.  The caller is
+   * responsible for adding it to a freelist.
    */
-  void freeBlock(void* pointer);
+  FreeListNode* freeBlock(void* pointer);
 
   /**
    * Tests the bitset if a block index is allocated.
@@ -188,6 +228,9 @@ private:
   static constexpr unsigned s_max_bitset_entries =
       (s_superblock_header_size - 128) / 8;
 
+  /** Value of m_next_untouched marking a released superblock. */
+  static constexpr std::uint32_t s_released = UINT32_MAX;
+
   // These are the superblock header members (1152 bytes total):
   std::uint32_t m_size_class;
   std::uint32_t m_next_untouched;
@@ -219,6 +262,11 @@ private:
     return GCNodeAllocator::bytesFromSizeClass(m_size_class);
   }
 
+  /** @return the number of blocks that fit in this superblock. */
+  unsigned numBlocks() const {
+    return (superblockSize() - s_superblock_header_size) / blockSize();
+  }
+
   /**
    * @return size in bytes of this superblock. Determined by m_size_class.
    */
@@ -0,0 +1,118 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file ArithmeticFusion.hpp
+ * @brief Class rho::ArithmeticFusion.
+ */
+
+#ifndef RHO_ARITHMETICFUSION_HPP
+#define RHO_ARITHMETICFUSION_HPP
+
+#include <cstddef>
+
+namespace rho {
+    class BuiltInFunction;
+    class Environment;
+    class Expression;
+    class FunctionBase;
+    class RObject;
+
+    /** @brief Evaluation of nested arithmetic in a single pass.
+     *
+     * Evaluating an expression such as <tt>a * b + c - d</tt> in the
+     * ordinary way allocates a full-length vector for each
+     * intermediate result.  When fusion is enabled, such an expression
+     * is instead evaluated by first evaluating its leaves, in the same
+     * order as ordinary evaluation would, and then computing the
+     * result a block of elements at a time, so that intermediate
+     * results never leave the cache and only the final result is
+     * allocated.
+     *
+     * An operation is fused only if the function called is the base
+     * primitive for <tt>+</tt>, <tt>-</tt>, <tt>*</tt>, <tt>/</tt> or
+     * <tt>^</tt> (the last only with an exponent of 2), it is called
+     * with two unnamed arguments, and each operand is either a fused
+     * operation or a double vector without attributes.  One operand
+     * may be a scalar; otherwise the operands must have the same
+     * length, which must be at least min_length.  Other operations
+     * are evaluated as usual, with any fused operands materialized
+     * first.  Before any other call among the operands is evaluated,
+     * the fused operations to its left are computed, in case the
+     * call modifies one of their leaves in place.  So the result is
+     * always identical to that of ordinary evaluation.
+     */
+    class ArithmeticFusion {
+    public:
+	/** @brief Shortest vector whose arithmetic is fused.
+	 */
+	static const std::size_t min_length = 4096;
+
+	/** @brief Is fusion enabled?
+	 */
+	static bool isEnabled()
+	{
+	    return s_enabled;
+	}
+
+	/** @brief Enable or disable fusion.
+	 *
+	 * @param on True iff subsequent evaluations should fuse
+	 *          arithmetic.
+	 */
+	static void setEnabled(bool on)
+	{
+	    s_enabled = on;
+	}
+
+	/** @brief Might a call be worth fusing?
+	 *
+	 * @param call A call about to be evaluated.
+	 *
+	 * @param func The function that \a call will invoke.
+	 *
+	 * @return true if \a call is a fusable arithmetic operation and
+	 * at least one of its arguments is itself a call.
+	 */
+	static bool canFuse(const Expression* call, const FunctionBase* func);
+
+	/** @brief Evaluate a call with fusion.
+	 *
+	 * @param call A call for which canFuse() returned true.
+	 *
+	 * @param func The function that \a call invokes.
+	 *
+	 * @param env The environment in which to evaluate \a call.
+	 *
+	 * @return The value of \a call.
+	 */
+	static RObject* evaluate(const Expression* call,
+				 const BuiltInFunction* func,
+				 Environment* env);
+    private:
+	static bool s_enabled;
+
+	ArithmeticFusion() = delete;
+    };
+}  // namespace rho
+
+#endif  // RHO_ARITHMETICFUSION_HPP
@@ -30,8 +30,10 @@
 #ifndef BINARYFUNCTION_HPP
 #define BINARYFUNCTION_HPP 1
 
+#include "rho/ParallelFor.hpp"
 #include "rho/UnaryFunction.hpp"
 #include "rho/VectorBase.hpp"
+#include "rho/VectorKernels.hpp"
 #include "rho/errors.hpp"
 
 namespace rho {
@@ -265,6 +267,73 @@ namespace rho {
 	    return result;
 	}
 
+	/** @brief Apply a vectorized kernel to a pair of vectors.
+	 *
+	 * This handles the common cases of applyBinaryOperator(), where
+	 * the operands have the same length or one of them has length
+	 * one, using one of the loops in namespace Kernels.  Other cases,
+	 * including those where the result has fewer than two elements,
+	 * are left to the caller, which will normally fall back on
+	 * applyBinaryOperator().
+	 *
+	 * Long vectors are split into ranges that are processed on
+	 * several threads, as described for ParallelFor, so \a kernel
+	 * may be called more than once and concurrently.
+	 *
+	 * @tparam OutputType Class of vector returned by the function.
+	 *
+	 * @param kernel Function object called as <tt>kernel(operands,
+	 *          out, lhs, rhs, n)</tt>, where \a operands is a
+	 *          Kernels::Operands, \a out points to \a n elements
+	 *          of a newly created result, and \a lhs and \a rhs point
+	 *          to the corresponding elements of the operands.
+	 *
+	 * @param attribute_copier As for applyBinaryOperator().
+	 *
+	 * @param lhs Non-null pointer to the first operand.
+	 *
+	 * @param rhs Non-null pointer to the second operand.
+	 *
+	 * @return Pointer to the result, or a null pointer if the
+	 * operands are not suitable for a kernel.
+	 */
+	template<typename OutputType, typename Kernel,
+		 typename AttributeCopier, typename LhsType, typename RhsType>
+	OutputType* applyBinaryKernel(Kernel kernel,
+				      AttributeCopier attribute_copier,
+				      const LhsType* lhs, const RhsType* rhs)
+	{
+	    size_t lhs_size = lhs->size();
+	    size_t rhs_size = rhs->size();
+	    Kernels::Operands operands;
+	    if (lhs_size == rhs_size)
+		operands = Kernels::VECTOR_VECTOR;
+	    else if (lhs_size == 1)
+		operands = Kernels::SCALAR_VECTOR;
+	    else if (rhs_size == 1)
+		operands = Kernels::VECTOR_SCALAR;
+	    else
+		return nullptr;
+	    size_t size = std::max(lhs_size, rhs_size);
+	    if (size < 2)
+		return nullptr;
+
+	    OutputType* result = OutputType::create(size);
+	    auto out = result->begin();
+	    auto lhs_data = lhs->begin();
+	    auto rhs_data = rhs->begin();
+	    ParallelFor::run(
+		size, ParallelFor::numRanges(size),
+		[&](unsigned int, size_t begin, size_t end) {
+		    kernel(operands, out + begin,
+			   lhs_data + (lhs_size == 1 ? 0 : begin),
+			   rhs_data + (rhs_size == 1 ? 0 : begin),
+			   end - begin);
+		});
+	    attribute_copier.copyAttributes(result, lhs, rhs);
+	    return result;
+	}
+
     }  // namespace VectorOps
 }  // namespace rho
 	
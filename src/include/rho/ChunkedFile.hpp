@@ -0,0 +1,300 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file ChunkedFile.hpp
+ * @brief Class rho::ChunkedFile and its nested classes.
+ */
+
+#ifndef RHO_CHUNKEDFILE_HPP
+#define RHO_CHUNKEDFILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace rho {
+    /** @brief Compressed files made of independently compressed chunks.
+     *
+     * A chunked file holds a byte stream, such as the output of
+     * R_Serialize(), cut into chunks of a fixed size that are each
+     * compressed separately with zlib.  Chunks can therefore be
+     * compressed and decompressed on several threads at once, and any
+     * part of the stream can be read without decompressing what comes
+     * before it.
+     *
+     * The file starts with a header of ChunkedFile::header_size bytes:
+     * the magic number, a codec byte (1 for zlib), two reserved bytes and
+     * the chunk size as a 32-bit integer.  The compressed chunks follow,
+     * then an index with, for each chunk, its offset in the file as a
+     * 64-bit integer and its compressed and uncompressed lengths as
+     * 32-bit integers.  The file ends with a trailer of
+     * ChunkedFile::trailer_size bytes: the offset of the index and the
+     * number of chunks as 64-bit integers, followed by an end marker.
+     * All integers are little-endian.
+     *
+     * The threads used only ever see byte buffers, so R objects are
+     * never touched other than on the interpreter's thread.
+     */
+    class ChunkedFile {
+    public:
+	class Job;
+	class WorkerPool;
+
+	/** @brief Number of bytes in the magic number.
+	 */
+	static const std::size_t magic_size = 5;
+
+	/** @brief Number of bytes in the file header.
+	 */
+	static const std::size_t header_size = 12;
+
+	/** @brief Number of bytes in the file trailer.
+	 */
+	static const std::size_t trailer_size = 24;
+
+	/** @brief Default number of uncompressed bytes in each chunk.
+	 */
+	static const std::size_t default_chunk_size = 1 << 20;
+
+	/** @brief Does a file start with the chunked file magic number?
+	 *
+	 * @param header The first bytes of the file.
+	 *
+	 * @param length The number of bytes in \a header.
+	 *
+	 * @return true iff \a header starts with the magic number.
+	 */
+	static bool hasMagic(const void* header, std::size_t length);
+
+	/** @brief Number of threads used per file.
+	 *
+	 * @return The number of threads that each Writer and Reader
+	 * uses to compress or decompress chunks.
+	 */
+	static unsigned int numThreads()
+	{
+	    return s_num_threads;
+	}
+
+	/** @brief Set the number of threads used per file.
+	 *
+	 * @param num_threads The number of threads that subsequently
+	 *          created Writer and Reader objects use.  0 means that
+	 *          chunks are compressed and decompressed on the calling
+	 *          thread.
+	 */
+	static void setNumThreads(unsigned int num_threads)
+	{
+	    s_num_threads = num_threads;
+	}
+
+	/** @brief Write a chunked file.
+	 *
+	 * Data is buffered until a chunk is full, when the chunk is
+	 * handed to a worker thread to compress.  Compressed chunks are
+	 * written in order as they become available.  At most two chunks
+	 * per thread are in progress at once, which bounds the memory
+	 * used.
+	 */
+	class Writer {
+	public:
+	    /** @brief Constructor.
+	     *
+	     * Writes the file header.
+	     *
+	     * @param fp File opened for binary writing, positioned at
+	     *          its start.  The Writer does not close it.
+	     *
+	     * @param level zlib compression level, from 0 to 9.
+	     *
+	     * @param chunk_size Number of uncompressed bytes per chunk.
+	     */
+	    Writer(std::FILE* fp, int level,
+		   std::size_t chunk_size = default_chunk_size);
+
+	    ~Writer();
+
+	    /** @brief Has an error occurred?
+	     *
+	     * @return true iff writing to the file or compressing a chunk
+	     * has failed.  Once this happens nothing more is written.
+	     */
+	    bool failed() const
+	    {
+		return m_failed;
+	    }
+
+	    /** @brief Write the index and trailer.
+	     *
+	     * Compresses and writes any data still buffered, and waits
+	     * for all chunks to be written.  Nothing may be written after
+	     * this.
+	     *
+	     * @return false iff an error has occurred.
+	     */
+	    bool finish();
+
+	    /** @brief Number of uncompressed bytes written so far.
+	     */
+	    std::uint64_t position() const
+	    {
+		return m_position;
+	    }
+
+	    /** @brief Append bytes to the uncompressed stream.
+	     *
+	     * @param data Pointer to the bytes to append.
+	     *
+	     * @param length Number of bytes to append.
+	     *
+	     * @return false iff an error has occurred.
+	     */
+	    bool write(const void* data, std::size_t length);
+	private:
+	    std::FILE* m_fp;
+	    int m_level;
+	    std::size_t m_chunk_size;
+	    std::uint64_t m_position;
+	    std::uint64_t m_file_offset;
+	    bool m_failed;
+	    bool m_finished;
+	    std::vector<unsigned char> m_pending;
+	    std::deque<std::shared_ptr<Job>> m_in_progress;
+	    std::vector<unsigned char> m_index;
+	    std::unique_ptr<WorkerPool> m_pool;
+
+	    Writer(const Writer&) = delete;
+	    Writer& operator=(const Writer&) = delete;
+
+	    void submitPending();
+	    void writeOldest();
+	    bool writeBytes(const void* data, std::size_t length);
+	};
+
+	/** @brief Read a chunked file.
+	 *
+	 * The index is read when the Reader is created.  Reading proceeds
+	 * through the chunks in order, decompressing the next few chunks
+	 * on worker threads while the current one is consumed.  seek()
+	 * moves straight to the chunk that holds the requested position.
+	 */
+	class Reader {
+	public:
+	    /** @brief Constructor.
+	     *
+	     * Reads and checks the header, trailer and index.
+	     *
+	     * @param fp File opened for binary reading.  The Reader does
+	     *          not close it.
+	     */
+	    explicit Reader(std::FILE* fp);
+
+	    ~Reader();
+
+	    /** @brief Has an error occurred?
+	     *
+	     * @return true iff the file is not a valid chunked file, or
+	     * reading or decompressing a chunk has failed.
+	     */
+	    bool failed() const
+	    {
+		return m_failed;
+	    }
+
+	    /** @brief Current position in the uncompressed stream.
+	     */
+	    std::uint64_t position() const
+	    {
+		return m_position;
+	    }
+
+	    /** @brief Read bytes from the uncompressed stream.
+	     *
+	     * @param buffer Where to put the bytes read.
+	     *
+	     * @param length Maximum number of bytes to read.
+	     *
+	     * @return The number of bytes read, which is less than \a
+	     * length only at the end of the stream or on error.
+	     */
+	    std::size_t read(void* buffer, std::size_t length);
+
+	    /** @brief Move to a position in the uncompressed stream.
+	     *
+	     * @param position The new position.  This may be beyond the
+	     *          end of the stream, in which case subsequent reads
+	     *          return nothing.
+	     */
+	    void seek(std::uint64_t position)
+	    {
+		m_position = position;
+	    }
+
+	    /** @brief Number of bytes in the uncompressed stream.
+	     */
+	    std::uint64_t size() const
+	    {
+		return m_chunk_starts.back();
+	    }
+	private:
+	    struct Chunk {
+		std::uint64_t offset;
+		std::uint32_t compressed_size;
+		std::uint32_t size;
+	    };
+
+	    std::FILE* m_fp;
+	    std::size_t m_chunk_size;
+	    std::vector<Chunk> m_chunks;
+	    // m_chunk_starts[i] is the position in the uncompressed stream
+	    // of chunk i.  There is an extra element holding the size of
+	    // the stream.
+	    std::vector<std::uint64_t> m_chunk_starts;
+	    std::uint64_t m_position;
+	    bool m_failed;
+	    // Chunk whose contents are in m_current, or m_chunks.size() if
+	    // none.
+	    std::size_t m_current_chunk;
+	    std::vector<unsigned char> m_current;
+	    // Chunks that have been handed to the worker threads.
+	    std::map<std::size_t, std::shared_ptr<Job>> m_read_ahead;
+	    std::unique_ptr<WorkerPool> m_pool;
+
+	    Reader(const Reader&) = delete;
+	    Reader& operator=(const Reader&) = delete;
+
+	    bool load(std::size_t chunk);
+	    bool readIndex();
+	    std::shared_ptr<Job> submit(std::size_t chunk);
+	};
+    private:
+	static unsigned int s_num_threads;
+
+	ChunkedFile() = delete;
+    };
+}  // namespace rho
+
+#endif  // RHO_CHUNKEDFILE_HPP
@@ -31,6 +31,7 @@
 #ifndef RCLOSURE_H
 #define RCLOSURE_H
 
+#include <vector>
 #include "rho/FunctionBase.hpp"
 #include "rho/ArgMatcher.hpp"
 #include "rho/Environment.hpp"
@@ -74,7 +75,7 @@ namespace rho {
 	 */
 	Closure(const Closure& pattern)
 	    : FunctionBase(pattern), m_debug(false),
-              m_num_invokes(0),
+              m_num_invokes(0), m_num_back_edges(0),
 	      m_matcher(pattern.m_matcher), m_body(pattern.m_body),
 	      m_environment(pattern.m_environment)
 	{}
@@ -220,6 +221,60 @@ namespace rho {
 	void visitReferents(const_visitor* v) const override;
 
         void compile() const;
+
+#ifdef ENABLE_LLVM_JIT
+	/** @brief Continue a loop in compiled code.
+	 *
+	 * This implements on-stack replacement.  The interpreter calls
+	 * it between iterations of a while() or repeat() loop that has
+	 * run for a long time in a call to this Closure.  The loop is
+	 * compiled on first use, and the compiled code is kept for
+	 * later calls.  The compiled code then runs the rest of the
+	 * loop.
+	 *
+	 * The Frame of a running call is never replaced, because
+	 * callers may hold pointers to its bindings.  So if the Frame
+	 * of \a env has no layout, the loop stays in the interpreter,
+	 * and later calls to this Closure are given Frames with a
+	 * layout instead.
+	 *
+	 * @param loop The loop being evaluated.
+	 *
+	 * @param env The working environment of the call to this
+	 *          Closure in which \a loop is being evaluated.
+	 *
+	 * @return true if the rest of the loop was run in compiled
+	 * code.  false if the loop couldn't be compiled for \a env,
+	 * in which case the interpreter should carry on.
+	 */
+	bool continueLoopInCompiledCode(const Expression* loop,
+					Environment* env) const;
+
+	/** @brief Counter of iterations of compiled loops.
+	 *
+	 * Baseline compiled code increments this on each iteration of
+	 * its loops, so that closures that spend their time in loops
+	 * get recompiled with more optimization.
+	 *
+	 * @return Pointer to the counter.
+	 */
+	unsigned int* backEdgeCounter() const
+	{
+	    return &m_num_back_edges;
+	}
+
+	/** @brief Compiled code for the body.
+	 *
+	 * @return The code that calls of this closure currently run,
+	 * or null if it hasn't been compiled or the machine code
+	 * isn't ready yet.
+	 */
+	const JIT::CompiledExpression* compiledBody() const
+	{
+	    const JIT::CompiledExpression* body = m_compiled_body;
+	    return (body && body->isReady()) ? body : nullptr;
+	}
+#endif
     protected:
 	// Virtual function of GCNode:
 	void detachReferents() override;
@@ -269,8 +324,25 @@ namespace rho {
 
 	bool m_debug;
         mutable int m_num_invokes;
+	mutable unsigned int m_num_back_edges;
 #ifdef ENABLE_LLVM_JIT
         mutable GCEdge<JIT::CompiledExpression> m_compiled_body;
+	// Code being compiled at a higher tier to replace m_compiled_body
+	// once it is ready.  It stays here if it fails, so that the
+	// closure isn't recompiled again.
+	mutable GCEdge<JIT::CompiledExpression> m_recompiled_body;
+	// Loops compiled for on-stack replacement, with the loop
+	// expressions and frame layouts they were compiled for.  The code
+	// is null if compilation failed.
+	struct CompiledLoop {
+	    GCEdge<const RObject> loop;
+	    GCEdge<const FrameDescriptor> frame_descriptor;
+	    GCEdge<JIT::CompiledExpression> code;
+	};
+	mutable std::vector<CompiledLoop> m_compiled_loops;
+	// Layout of the frames of calls made after a loop has run long
+	// enough to be compiled, while the body has no compiled code.
+	mutable GCEdge<const FrameDescriptor> m_loop_frame_descriptor;
 #else
         GCEdge<> m_compiled_body;  // unused.
 #endif
@@ -282,6 +354,16 @@ namespace rho {
 	// If a JIT compiled version of this closure exists, invalidate it.
 	void invalidateCompiledCode();
 
+#ifdef ENABLE_LLVM_JIT
+	// Start compiling or recompiling the body if it has been used
+	// enough, and install recompiled code that has become ready.
+	void updateCompiledCode() const;
+
+	// Returns true if the compiled body can be run in env, giving
+	// env's frame the layout that the code expects if necessary.
+	bool useCompiledCode(Environment* env) const;
+#endif
+
 	// Declared private to ensure that Closure objects are
 	// created only using 'new':
 	~Closure();
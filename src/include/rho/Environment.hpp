@@ -309,6 +309,54 @@ namespace rho {
 	    return m_frame;
 	}
 
+	/** @brief Move the Environment's bindings into another Frame.
+	 *
+	 * The JIT compiler uses this to give the working environment
+	 * of a Closure call that is running in the interpreter the
+	 * Frame layout that compiled code expects.  The bindings are
+	 * copied as by Frame::importBindings(), and the copies then
+	 * replace the existing Frame.
+	 *
+	 * @param frame Pointer to an empty Frame.
+	 *
+	 * @return false, leaving the Environment unchanged, if the
+	 * existing Frame can't safely be replaced, because it is
+	 * locked or on the search path.
+	 *
+	 * @note Callers must ensure that nothing retains pointers to
+	 * Bindings in the existing Frame.
+	 */
+	bool replaceFrame(Frame* frame);
+
+	/** @brief Generation count of the search path cache.
+	 *
+	 * The count changes whenever a Symbol is flushed from the
+	 * search path cache, and whenever an Environment's enclosing
+	 * environment is changed.  So a Binding found by searching
+	 * through Frames that are either locked or on the search
+	 * path (see Frame::isOnSearchPath()) is still the one that
+	 * the search would find for as long as the count is
+	 * unchanged.
+	 *
+	 * @return The current generation count.
+	 */
+	static unsigned int searchPathGeneration()
+	{
+	    return s_search_path_generation;
+	}
+
+	/** @brief Advance the generation count of the search path
+	 * cache.
+	 *
+	 * This discards the results held by caches keyed on
+	 * searchPathGeneration(), for example when a namespace is
+	 * unloaded.
+	 */
+	static void advanceSearchPathGeneration()
+	{
+	    ++s_search_path_generation;
+	}
+
 	/** @brief Global environment.
 	 *
 	 * @return Pointer to the global environment.
@@ -493,6 +541,7 @@ namespace rho {
         class Cache;
 	static Cache* searchPathCache();
         static Cache* createSearchPathCache();
+	static unsigned int s_search_path_generation;
 
 	// Predefined environments:
 	static Environment* createBaseEnvironment();
@@ -35,6 +35,7 @@
 #include "rho/ArgMatcher.hpp"
 #include "rho/FunctionBase.hpp"
 #include "rho/PairList.hpp"
+#include "rho/TypeFeedback.hpp"
 
 namespace rho {
     class ArgList;
@@ -90,12 +91,48 @@ namespace rho {
             return car();
         }
 
+	/** @brief Look up the function that this Expression calls.
+	 *
+	 * @param env The environment in which the Expression is to be
+	 *          evaluated.
+	 *
+	 * @return The function found, evaluating the head of the
+	 * Expression if it is not a Symbol.  An error is raised if
+	 * there is no such function.
+	 */
+        FunctionBase* getFunction(Environment* env) const;
+
         const PairList* getArgs() const {
             return tail();
         }
 
 	void check1arg(const char* formal) const;
 
+	/** @brief Record the operands of a binary builtin call.
+	 *
+	 * Called by the arithmetic and comparison builtins so that the
+	 * JIT compiler can specialize this call site for the operand
+	 * types seen.  The default implementation does nothing.
+	 *
+	 * @param lhs The first operand.
+	 *
+	 * @param rhs The second operand.
+	 */
+	virtual void recordOperandTypes(const RObject* lhs,
+					const RObject* rhs) const
+	{}
+
+	/** @brief Operand types seen at this call site.
+	 *
+	 * @return Pointer to the TypeFeedback recorded by
+	 * recordOperandTypes(), or null if this expression does not
+	 * record any.
+	 */
+	virtual const TypeFeedback* typeFeedback() const
+	{
+	    return nullptr;
+	}
+
 	/** @brief The name by which this type is known in R.
 	 *
 	 * @return the name by which this type is known in R.
@@ -148,8 +185,6 @@ namespace rho {
 	// allocated only using 'new':
 	~Expression() {}
 
-        FunctionBase* getFunction(Environment* env) const;
-
         RObject* invokeClosureImpl(const Closure* func,
                                    Environment* calling_env,
                                    const ArgList& arglist,
@@ -239,6 +274,18 @@ namespace rho {
 	CachingExpression(const Expression& pattern) : Expression(pattern)
 	{}
 
+	// Virtual functions of Expression:
+	void recordOperandTypes(const RObject* lhs,
+				const RObject* rhs) const override
+	{
+	    m_type_feedback.record(lhs, rhs);
+	}
+
+	const TypeFeedback* typeFeedback() const override
+	{
+	    return &m_type_feedback;
+	}
+
 	// Virtual functions of RObject:
 	CachingExpression* clone() const override;
 
@@ -247,10 +294,10 @@ namespace rho {
     protected:
 	void detachReferents() override;
     private:
-	// Object used for recording details from previous evaluations of
+	// Objects used for recording details from previous evaluations of
 	// this expression, for the purpose of optimizing future evaluations.
-	// In the future, this will likely include type recording as well.
         mutable GCEdge<const ArgMatchCache> m_cached_matching_info;
+	mutable TypeFeedback m_type_feedback;
 
 	void matchArgsIntoEnvironment(const Closure* func,
 				      Environment* calling_env,
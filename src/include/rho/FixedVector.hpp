@@ -43,6 +43,8 @@ namespace rho {
      *
      * Having said that, the template \e does implement decreaseSizeInPlace(),
      * primarily to service CR code's occasional use of SETLENGTH().
+     * Furthermore a vector may be created with spare capacity, into
+     * which it can subsequently be extended by VectorBase::enlarge().
      *
      * rho implements all of CR's built-in vector types using this
      * template.
@@ -67,6 +69,21 @@ namespace rho {
 	 */
 	static FixedVector* create(size_type sz);
 
+	/** @brief Create a vector with spare capacity.
+	 *
+	 * As create(size_type), except that space is reserved for
+	 * the vector to grow to \a capacity elements without being
+	 * reallocated.
+	 *
+	 * @param sz Number of elements required.  Zero is
+	 *          permissible.
+	 *
+	 * @param capacity Number of elements for which space is
+	 *          reserved.  Must be at least \a sz .
+	 */
+	static FixedVector* createWithCapacity(size_type sz,
+					       size_type capacity);
+
 	/** @brief Create a vector from a range.
 	 * 
 	 * @tparam An iterator type, at least a forward iterator.
@@ -172,6 +189,28 @@ namespace rho {
 	    return begin() + size();
 	}
 
+	/** @brief Number of elements the vector can hold without
+	 *         being reallocated.
+	 *
+	 * @return The capacity of the vector, which is never less
+	 * than its size().
+	 */
+	size_type capacity() const
+	{
+	    return m_capacity;
+	}
+
+	/** @brief Extend the vector into its spare capacity.
+	 *
+	 * The extra elements are set to <tt>NA<T>()</tt>, and the
+	 * attributes of the vector are adjusted as by
+	 * VectorBase::resizeAttributes().
+	 *
+	 * @param new_size New size required.  Must be at least the
+	 *          current size and no more than capacity().
+	 */
+	void increaseSizeInPlace(size_type new_size);
+
 	/** @brief Name by which this type is known in R.
 	 *
 	 * @return the name by which this type is known in R.
@@ -203,7 +242,7 @@ namespace rho {
 
 	    // GCNode::~GCNode doesn't know about the string storage space in
 	    // this object, so account for it here.
-	    size_t bytes = (size()) * sizeof(T);
+	    size_t bytes = m_capacity * sizeof(T);
             if (bytes != 0) {
                 MemoryBank::adjustFreedSize(sizeof(FixedVector), sizeof(FixedVector) + bytes);
             }
@@ -213,6 +252,7 @@ namespace rho {
 	void detachReferents() override;
     private:
 	T* m_data;  // pointer to the vector's data block.
+	size_type m_capacity;  // number of elements allocated.
 
 	alignas(T) char m_first_element_storage[sizeof(T)];
 
@@ -222,10 +262,13 @@ namespace rho {
 	 *
 	 * @param sz Number of elements required.  Zero is
 	 *          permissible.
+	 *
+	 * @param capacity Number of elements allocated, at least \a sz .
 	 */
-	FixedVector(size_type sz)
+	FixedVector(size_type sz, size_type capacity)
 	    : VectorBase(ST, sz),
-	      m_data(reinterpret_cast<T*>(m_first_element_storage))
+	      m_data(reinterpret_cast<T*>(m_first_element_storage)),
+	      m_capacity(capacity)
 	{
 	    constructElementsIfNeeded();
 	}
@@ -291,7 +334,8 @@ template <typename T, SEXPTYPE ST>
 rho::FixedVector<T, ST>::FixedVector(
     const FixedVector<T, ST>& pattern)
     : VectorBase(pattern),
-      m_data(reinterpret_cast<T*>(m_first_element_storage))
+      m_data(reinterpret_cast<T*>(m_first_element_storage)),
+      m_capacity(pattern.size())
 {
     constructElementsIfNeeded();
 
@@ -328,7 +372,16 @@ rho::FixedVector<T, ST>*
 rho::FixedVector<T, ST>::create(size_type sz)
 {
     void* storage = allocate(sz);
-    return new(storage) FixedVector(sz);
+    return new(storage) FixedVector(sz, sz);
+}
+
+template <typename T, SEXPTYPE ST>
+rho::FixedVector<T, ST>*
+rho::FixedVector<T, ST>::createWithCapacity(size_type sz,
+					    size_type capacity)
+{
+    void* storage = allocate(capacity);
+    return new(storage) FixedVector(sz, capacity);
 }
 
 template <typename T, SEXPTYPE ST>
@@ -373,13 +426,30 @@ void rho::FixedVector<T, ST>::decreaseSizeInPlace(size_type new_size)
     if (new_size > size()) {
 	Rf_error("Increasing vector length in place not allowed.");
     }
-    size_t bytes = (size() - new_size) * sizeof(T);
+    // Any spare capacity is given up along with the discarded
+    // elements.
+    size_t bytes = (m_capacity - new_size) * sizeof(T);
     MemoryBank::adjustBytesAllocated(-bytes);
+    m_capacity = new_size;
 
     destructElementsIfNeeded(begin() + new_size, end());
     adjustSize(new_size);
 }
 
+template <typename T, SEXPTYPE ST>
+void rho::FixedVector<T, ST>::increaseSizeInPlace(size_type new_size)
+{
+    if (new_size < size() || new_size > m_capacity) {
+	Rf_error("Vector cannot be extended in place to this size.");
+    }
+    iterator from = end();
+    iterator to = begin() + new_size;
+    constructElementsIfNeeded(from, to);
+    for (iterator p = from; p != to; ++p)
+	*p = ElementTraits::duplicate_element(NA<T>());
+    adjustSize(new_size);
+}
+
 template <typename T, SEXPTYPE ST>
 const char* rho::FixedVector<T, ST>::typeName() const
 {
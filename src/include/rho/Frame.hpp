@@ -772,6 +772,31 @@ namespace rho {
 	    return m_locked;
 	}
 
+	/** @brief Is the Frame monitored by the search path cache?
+	 *
+	 * @return true iff the Frame belongs to an Environment on the
+	 * search path, in which case
+	 * Environment::searchPathGeneration() changes whenever a
+	 * Symbol becomes bound or unbound in the Frame.
+	 */
+	bool isOnSearchPath() const
+	{
+	    return m_cache_count > 0;
+	}
+
+	/** @brief Report Symbols becoming bound or unbound.
+	 *
+	 * After this is called, Environment::searchPathGeneration()
+	 * changes whenever a Symbol becomes bound or unbound in this
+	 * Frame, as it does for Frames on the search path.  This is
+	 * used for the Frames of S3 methods tables, so that cached
+	 * method lookups see methods being registered.
+	 */
+	void reportStatusChanges()
+	{
+	    m_reports_status_changes = true;
+	}
+
 	/** @brief Lock this Frame.
 	 *
 	 * Locking a Frame prevents the addition or removal of
@@ -972,6 +997,7 @@ namespace rho {
 	bool m_no_special_symbols      : 1;
 	mutable bool m_read_monitored  : 1;
 	mutable bool m_write_monitored : 1;
+	bool m_reports_status_changes  : 1;
 
         // The default arguments that were added by the argument matching.
         std::vector<PromiseData> m_default_arglist;
@@ -1010,7 +1036,7 @@ namespace rho {
 	 */
 	void statusChanged(const Symbol* sym)
 	{
-	    if (m_cache_count > 0)
+	    if (m_cache_count > 0 || m_reports_status_changes)
 		flush(sym);
 	}
 
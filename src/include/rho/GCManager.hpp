@@ -27,7 +27,6 @@
 /** @file GCManager.hpp
  * @brief Class rho::GCManager.
  *
- * @todo Reinstate garbage collection timing.
  * @todo Update DEBUG_GC_SUMMARY etc.
  */
 
@@ -35,7 +34,9 @@
 #define GCMANAGER_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include "rho/MemoryBank.hpp"
 
 namespace rho {
@@ -92,6 +93,12 @@ namespace rho {
 	 *
 	 * It is currently an error to initiate a garbage collection when
 	 * a GCEdge is under construction.
+	 *
+	 * @param force_full_collection If true, always runs a full
+	 *          mark-sweep collection.  Otherwise a cycle
+	 *          collection is only run if the collection threshold
+	 *          has been reached, and may be restricted to the young
+	 *          generation (see setFullCollectionInterval()).
 	 */
 	static void gc(bool force_full_collection = true);
 
@@ -164,6 +171,254 @@ namespace rho {
 	 */
 	static void setGCThreshold(size_t initial_threshold);
 
+	/** @brief Set the frequency of full mark-sweep collections.
+	 *
+	 * When the collection threshold is reached, gc() normally
+	 * runs a young-generation collection (see GCNode::gcYoung()),
+	 * which only examines nodes created since the previous cycle
+	 * collection.  Garbage cycles involving older nodes are only
+	 * reclaimed by a full mark-sweep collection.
+	 *
+	 * @param interval Every <tt>interval</tt>-th threshold-triggered
+	 *          collection is a full mark-sweep collection.  A
+	 *          value of 1 (or 0) disables young-generation
+	 *          collections.
+	 */
+	static void setFullCollectionInterval(unsigned int interval)
+	{
+	    s_full_gc_interval = interval;
+	}
+
+	/** @brief Frequency of full mark-sweep collections.
+	 *
+	 * @return The interval set by setFullCollectionInterval().
+	 */
+	static unsigned int fullCollectionInterval()
+	{
+	    return s_full_gc_interval;
+	}
+
+	/** @brief Result of a cycle collection, as seen by a
+	 * ThresholdPolicy.
+	 */
+	struct CollectionOutcome {
+	    size_t bytes_before;  // Bytes allocated when the collection began.
+	    size_t bytes_after;   // Bytes still allocated when it finished.
+	    size_t threshold;     // Threshold in force during the collection.
+	    size_t min_threshold; // Floor set by setGCThreshold().
+	    double pause_seconds;
+	    bool full;  // True for mark-sweep, false for young-generation.
+	};
+
+	/** @brief Policy choosing the collection threshold.
+	 *
+	 * A threshold policy is called after every cycle collection
+	 * with its outcome, and returns the new collection
+	 * threshold.  It must not itself give rise to a garbage
+	 * collection.  Any state that a policy carries from one
+	 * collection to the next is kept in the policy object, and
+	 * so is discarded when another policy is installed.
+	 */
+	class ThresholdPolicy {
+	public:
+	    virtual ~ThresholdPolicy() {}
+
+	    virtual size_t operator()(const CollectionOutcome& outcome) = 0;
+	};
+
+	/** @brief Default threshold policy.
+	 *
+	 * Sets the threshold to heapOverhead() above the number of
+	 * bytes surviving the collection, but never lowers it by more
+	 * than 20% at a time.
+	 */
+	class FixedGrowthPolicy : public ThresholdPolicy {
+	public:
+	    size_t operator()(const CollectionOutcome& outcome) override;
+	};
+
+	/** @brief Threshold policy adapting to survival rate and
+	 * pause times.
+	 *
+	 * The headroom above the surviving bytes is heapOverhead() times
+	 * the surviving bytes, increased (up to threefold) when most
+	 * of the bytes survive, so that a steadily growing heap does
+	 * not provoke back-to-back collections.  Unlike
+	 * FixedGrowthPolicy, the threshold falls at once when the
+	 * heap shrinks.
+	 *
+	 * If a target pause has been set, the headroom is also
+	 * scaled down while young-generation collections, whose
+	 * duration grows with the headroom, exceed the target, and
+	 * allowed to recover when they are within it.  The duration
+	 * of full collections depends on the surviving heap rather
+	 * than the threshold, so they do not affect this scaling.
+	 */
+	class AdaptivePolicy : public ThresholdPolicy {
+	public:
+	    AdaptivePolicy()
+		: m_pause_scale(1.0)
+	    {}
+
+	    size_t operator()(const CollectionOutcome& outcome) override;
+	private:
+	    // Factor applied to the headroom to meet the target pause.
+	    double m_pause_scale;
+	};
+
+	/** @brief Set the collection threshold policy.
+	 *
+	 * @param policy Pointer to the policy to use from now on, or
+	 *          a null pointer to revert to a FixedGrowthPolicy.
+	 *          GCManager takes ownership of the policy, and
+	 *          deletes the policy previously in use.
+	 */
+	static void setThresholdPolicy(ThresholdPolicy* policy = nullptr)
+	{
+	    s_threshold_policy.reset(policy);
+	}
+
+	/** @brief Set the pause time targeted by AdaptivePolicy.
+	 *
+	 * @param seconds Target duration of young-generation
+	 *          collections.  Zero (or a negative value) means no
+	 *          target.
+	 */
+	static void setTargetPause(double seconds)
+	{
+	    s_target_pause = (seconds > 0 ? seconds : 0);
+	}
+
+	/** @brief The pause time targeted by AdaptivePolicy.
+	 *
+	 * @return The target set by setTargetPause(), or zero if none.
+	 */
+	static double targetPause()
+	{
+	    return s_target_pause;
+	}
+
+	/** @brief Set the heap overhead allowed by the threshold
+	 * policies.
+	 *
+	 * @param ratio The collection threshold is set at least
+	 *          this fraction above the number of bytes surviving a
+	 *          collection.  Must be positive.
+	 */
+	static void setHeapOverhead(double ratio)
+	{
+	    s_heap_overhead = ratio;
+	}
+
+	/** @brief The heap overhead set by setHeapOverhead().
+	 */
+	static double heapOverhead()
+	{
+	    return s_heap_overhead;
+	}
+
+	/** @brief Set how soon empty memory is returned to the
+	 * operating system.
+	 *
+	 * Cycle collections periodically call
+	 * GCNodeAllocator::releaseEmptySuperblocks(), which releases
+	 * allocator superblocks that have stayed empty for this
+	 * long.
+	 *
+	 * @param seconds The delay.  A negative value stops memory
+	 *          being released.
+	 */
+	static void setMemoryReleaseDelay(double seconds)
+	{
+	    s_release_delay = seconds;
+	}
+
+	/** @brief The delay set by setMemoryReleaseDelay().
+	 */
+	static double memoryReleaseDelay()
+	{
+	    return s_release_delay;
+	}
+
+	/** @brief Kinds of garbage collection distinguished by
+	 * pauseStatistics().
+	 */
+	enum CollectionKind {
+	    GCLITE,      ///< Processing of the moribund list.
+	    YOUNG,       ///< Young-generation cycle collection.
+	    MARK_SWEEP,  ///< Full mark-sweep collection.
+	    NUM_COLLECTION_KINDS
+	};
+
+	/** @brief Pause times of one kind of garbage collection.
+	 */
+	struct PauseStatistics {
+	    /** @brief Number of buckets in the pause time histogram.
+	     */
+	    static const unsigned int s_num_buckets = 16;
+
+	    /** @brief Upper limit of a histogram bucket.
+	     *
+	     * @param bucket Index of a histogram bucket other than
+	     *          the last, which has no upper limit.
+	     *
+	     * @return The upper limit in seconds of the pause times
+	     * counted in  bucket.  The limits double from 10
+	     * microseconds for the first bucket.
+	     */
+	    static double bucketLimit(unsigned int bucket)
+	    {
+		return 1e-5*double(1 << bucket);
+	    }
+
+	    std::uint64_t count;  // Number of collections.
+	    double total_seconds;
+	    double max_seconds;
+	    std::uint64_t histogram[s_num_buckets];
+	};
+
+	/** @brief Pause times since the start of the session (or the
+	 * last call to resetStatistics()).
+	 *
+	 * Pauses are timed by wall-clock time, whether or not
+	 * gc.time() is enabled.
+	 *
+	 * @param kind Kind of collection to report on.
+	 *
+	 * @return Statistics for  kind.
+	 */
+	static const PauseStatistics& pauseStatistics(CollectionKind kind)
+	{
+	    return s_pause_stats[kind];
+	}
+
+	/** @brief Reset the pause time statistics.
+	 */
+	static void resetStatistics();
+
+	/** @brief Set the number of threads used by mark-sweep
+	 * collection.
+	 *
+	 * @param num_threads The maximum number of threads that
+	 *          GCNode::gc() may use to mark and sweep.  A value of
+	 *          1 (or 0) makes mark-sweep collection
+	 *          single-threaded.  Values other than 1 have no effect
+	 *          unless rho was built with OpenMP support.
+	 */
+	static void setMarkSweepThreads(unsigned int num_threads)
+	{
+	    s_mark_sweep_threads = (num_threads ? num_threads : 1);
+	}
+
+	/** @brief Number of threads used by mark-sweep collection.
+	 *
+	 * @return The number set by setMarkSweepThreads().
+	 */
+	static unsigned int markSweepThreads()
+	{
+	    return s_mark_sweep_threads;
+	}
+
 	/** @brief Set/unset monitors on mark-sweep garbage collection.
 	 *
 	 * @param pre_gc If not a null pointer, this function will be
@@ -222,6 +477,22 @@ namespace rho {
 	// gclite() reaches this level.
 	static size_t s_threshold;
 
+	// Every s_full_gc_interval-th threshold-triggered collection is a
+	// full mark-sweep collection; the others are young-generation
+	// collections.
+	static unsigned int s_full_gc_interval;
+	static unsigned int s_young_gcs_since_full;
+
+	static unsigned int s_mark_sweep_threads;
+
+	// Null while the default FixedGrowthPolicy is in use.
+	static std::unique_ptr<ThresholdPolicy> s_threshold_policy;
+	static double s_target_pause;  // In seconds, or 0 for none.
+	static double s_heap_overhead;
+	static double s_release_delay;  // In seconds, or negative.
+
+	static PauseStatistics s_pause_stats[NUM_COLLECTION_KINDS];
+
 	static bool s_gc_is_running;
 	static bool s_gc_pending;
 
@@ -62,6 +62,17 @@
  *
  * A backup mark-sweep garbage collection is used to handle reference cycles
  * and objects whose reference counts have saturated. 
+ *
+ * Since most cycles become garbage shortly after they are created, the
+ * cycle collector is generational.  Nodes created since the last cycle
+ * collection make up the young generation, and a young-generation
+ * collection only considers those nodes.  Rather than using a write barrier
+ * to track references from old nodes to young ones, it uses the reference
+ * counts: any young node whose count exceeds the number of references to it
+ * from other young nodes must be referenced from outside the young
+ * generation, and is treated as a root.  Nodes that survive a cycle
+ * collection are promoted to the old generation, which is only examined by
+ * the full mark-sweep collection.
  * TODO(kmillar): implement cycle breaking for unevaluated default promises.
  * TODO(kmillar): implement cycle breaking for closures.
  */
@@ -128,7 +139,9 @@ namespace rho {
             : m_refcount_flags(s_mark | s_moribund_mask)
 	{
 	    ++s_num_nodes;
+	    ++s_num_nodes_created;
 	    s_moribund->push_back(this);
+	    s_young->push_back(this);
 	}
 
 	/** @brief Allocate memory.
@@ -206,6 +219,25 @@ namespace rho {
 	 */
 	static void gc(bool markSweep);
 
+	/** @brief Initiate a young-generation cycle collection.
+	 *
+	 * Collects reference cycles (and nodes with saturated
+	 * reference counts) among the nodes created since the last
+	 * cycle collection.  Nodes referred to from outside the young
+	 * generation are treated as reachable, so this is typically
+	 * much faster than gc(true), but cannot collect garbage that
+	 * involves older nodes.  The surviving young nodes are
+	 * promoted to the old generation.
+	 */
+	static void gcYoung();
+
+	/** @brief Number of nodes in the young generation.
+	 *
+	 * @return an upper bound on the number of nodes created since
+	 * the last cycle collection.
+	 */
+	static size_t numYoungNodes() {return s_young->size();}
+
 	/** @brief Number of GCNode objects in existence.
 	 *
 	 * @return the number of GCNode objects currently in
@@ -213,6 +245,28 @@ namespace rho {
 	 */
 	static size_t numNodes() {return s_num_nodes;}
 
+	/** @brief Number of GCNode objects created so far.
+	 *
+	 * @return the number of GCNode objects created in this
+	 * session.  Nodes created and deleted since then number
+	 * numNodesCreated() - numNodes(); of these,
+	 * numNodesCollectedAsCycles() were deleted by cycle
+	 * collection, and the rest when their reference counts fell
+	 * to zero.
+	 */
+	static size_t numNodesCreated() {return s_num_nodes_created;}
+
+	/** @brief Number of GCNode objects deleted by cycle
+	 * collection.
+	 *
+	 * @return the number of nodes deleted so far by young-generation
+	 * and mark-sweep collections.
+	 */
+	static size_t numNodesCollectedAsCycles()
+	{
+	    return s_num_nodes_collected_as_cycles;
+	}
+
 	/** @brief Conduct a visitor to the nodes referred to by this
 	 * one.
 	 *
@@ -288,10 +342,28 @@ namespace rho {
 	    unsigned int m_marks_applied;
 	};
 
+	/** Visitors used by youngGC(). */
+	class YoungRefCounter;
+	class YoungMarker;
+
+	/** Visitor used by each thread of parallelMark(). */
+	class ParallelMarker;
+
 	static std::vector<const GCNode*>* s_moribund;  // Vector of
 	  // pointers to nodes whose reference count has fallen to
-	  // zero (but may subsequently have increased again).
+	  // zero (but may subsequently have increased again).  As
+	  // with s_young, nodes are not necessarily removed when they
+	  // are deleted.
+	static std::vector<const GCNode*>* s_young;  // Addresses of
+	  // nodes created since the last cycle collection.  Nodes
+	  // are not removed when they are deleted, so this may also
+	  // contain addresses that are no longer allocated, or that
+	  // have been reused by a later node; see compactYoungList().
+	static size_t s_young_compaction_threshold;  // gclite()
+	  // compacts s_young when it grows beyond this size.
 	static unsigned int s_num_nodes;  // Number of nodes in existence
+	static size_t s_num_nodes_created;
+	static size_t s_num_nodes_collected_as_cycles;
 
 	// Flag that is set if the on_stack bits are known to be up to date.
 	// If this true, then objects can be deleted immediately when
@@ -325,6 +397,13 @@ namespace rho {
 
 	static void gcliteImpl();
 
+	/** @brief Run a garbage collector with all roots protected.
+	 *
+	 * @param collector The collection to run: one of gclite(),
+	 *          markSweepGC() or youngGC().
+	 */
+	static void collect(void (*collector)());
+
 	struct CreateAMinimallyInitializedGCNode;
 	GCNode(CreateAMinimallyInitializedGCNode*);
 	GCNode(const GCNode&) = delete;
@@ -332,6 +411,21 @@ namespace rho {
 
 	static void markSweepGC();
 
+	/** @brief Young-generation cycle collection.
+	 *
+	 * Implements gcYoung() using trial deletion (see the memory
+	 * management overview at the top of this file).
+	 */
+	static void youngGC();
+
+	/** @brief Remove stale and duplicate entries from s_young.
+	 *
+	 * Afterwards s_young contains exactly the currently allocated
+	 * nodes created since the last cycle collection, in ascending
+	 * order of address.
+	 */
+	static void compactYoungList();
+
 	/** @brief Lightweight garbage collection.
 	 *
 	 * This function deletes nodes whose reference counts are
@@ -391,14 +485,16 @@ namespace rho {
 
 
 	// Helper function for the destructor, handling the case where
-	// the node is still under construction.  This should happen
-	// only in the case where a derived class constructor has
-	// thrown an exception.
-#ifdef __GNUC__
-	__attribute__((cold))
-#endif
+	// the node is still on the moribund list.  This takes constant
+	// time: the list entry is normally left in place to be skipped
+	// by gclite().
 	void destruct_aux();
 
+	// Returns true if an entry on the moribund list refers to a
+	// node that still exists (though not necessarily the node that
+	// the entry was created for).
+	static bool isLiveMoribundEntry(const GCNode* node);
+
 	// Increment the reference count.  Overflow is handled by the
 	// stickiness of the MSB.
 	static void incRefCount(const GCNode* node)
@@ -423,6 +519,15 @@ namespace rho {
 	    return (m_refcount_flags & s_mark_mask) == s_mark;
 	}
 
+	/** @brief Atomically mark this node.
+	 *
+	 * @return true if this call marked the node, false if it was
+	 * already marked.  Only the mark bit is altered, so this may
+	 * safely race with calls on the same node from other marking
+	 * threads.
+	 */
+	bool tryMark() const;
+
 	/** @brief Mark this node as moribund or delete if the stack bit is correct.
          */
 	void makeMoribund() const HOT_FUNCTION;
@@ -433,6 +538,17 @@ namespace rho {
 	 */
 	static void mark();
 
+	/** @brief Mark everything reachable from the roots using
+	 * several threads.
+	 *
+	 * Each thread works through its own stack of marked nodes
+	 * whose referents have yet to be visited, sharing surplus
+	 * nodes with (and stealing them from) the other threads.
+	 *
+	 * @param num_threads The maximum number of threads to use.
+	 */
+	static void parallelMark(unsigned int num_threads);
+
 	/** @brief Carry out the sweep phase of garbage collection.
 	 */
 	static void sweep();
@@ -31,6 +31,7 @@
 
 #include <cstdint>
 #include <functional>
+#include <vector>
 
 #include "rho/AddressSanitizer.hpp"
 
@@ -85,6 +86,16 @@ private:
  * This allocator should only be used to allocate GCNode objects, otherwise
  * the garbage collector to be tricked into treating non-GCNodes as GCNodes
  * during the Sweep phase of garbage collection.
+ *
+ * allocate() and free() may be called from several threads at once.  Each
+ * thread has a cache of small blocks, from which small allocations are
+ * made without locking: first from the cached freelist, then from the
+ * untouched blocks of a superblock owned by the thread.  The cache is
+ * refilled in batches from the shared freelists, and returns blocks to them
+ * in batches when it grows too long.  Medium and large allocations, and the
+ * shared freelists, are protected by a mutex.  The remaining operations
+ * (pointer lookup and iteration) must not overlap with allocation or
+ * freeing in other threads.
  */
 class GCNodeAllocator {
 public:
@@ -99,12 +110,58 @@ public:
   /** @brief Apply function to all current allocations. */
   static void applyToAllAllocations(std::function<void(void*)> f);
 
+  /** @brief Apply function to all current allocations using several threads.
+   *
+   * The superblocks and large allocations are shared out between up to
+   * num_threads threads (just one unless rho was built with OpenMP support).
+   * The second argument passed to the function is the index, counting from
+   * zero, of the calling thread.  The function must be safe to call
+   * concurrently, and must not allocate or free anything.
+   */
+  static void applyToAllAllocationsInParallel(
+      std::function<void(void*, unsigned)> f, unsigned num_threads);
+
   /** @brief Free a previously allocated object. */
   static void free(void* p);
 
+  /** @brief Return the calling thread's cached small blocks to the shared
+   * freelists.
+   *
+   * This is done automatically when a thread exits.
+   */
+  static void releaseThreadCache();
+
   /** @brief Must be called before any allocations can be made. */
   static void initialize();
 
+  /** @brief Return the memory of superblocks that have stayed empty to the
+   * operating system.
+   *
+   * A superblock is empty when all its blocks are in the shared freelists
+   * (this includes the calling thread's cached blocks, which are returned
+   * to the shared freelists first).  It is released if it was already
+   * empty when this function was called at least delay seconds earlier,
+   * which avoids giving back memory that is about to be needed again.
+   * Small-object superblocks remain in the arena, but their pages are
+   * discarded; medium-object superblocks are deleted.
+   *
+   * This must not overlap with allocation or freeing in other threads.
+   * Nothing is released in address sanitizer builds.
+   *
+   * @param delay time in seconds that a superblock must stay empty.
+   *
+   * @return the number of bytes released.
+   */
+  static std::size_t releaseEmptySuperblocks(double delay);
+
+  /** @brief Total bytes released by releaseEmptySuperblocks(). */
+  static std::size_t bytesReleased() {
+    return s_bytes_released;
+  }
+
+  /** @brief The number of small-object superblocks currently released. */
+  static unsigned numReleasedSuperblocks();
+
   /** @brief Find heap allocation start pointer.
    *
    * This function finds the corresponding allocation for an internal or
@@ -121,6 +178,42 @@ public:
   /** @brief Print allocator state summary for debugging. */
   static void printSummary();
 
+  /** @brief Usage of the allocator by one size class. */
+  struct SizeClassStatistics {
+    /** Size in bytes of each allocation. */
+    std::size_t block_size;
+
+    /** Number of superblocks (zero for large allocations). */
+    std::size_t superblocks;
+
+    /**
+     * Number of blocks in the superblocks, allocated or not, or for large
+     * allocations the number of allocations.
+     */
+    std::size_t blocks;
+
+    /** Number of blocks currently allocated. */
+    std::size_t allocated_blocks;
+  };
+
+  /** @brief Statistics for each size class in use.
+   *
+   * This scans all superblocks and the allocation table, so it must not
+   * overlap with allocation or freeing in other threads.
+   *
+   * @return statistics for each size class with at least one superblock or
+   * large allocation, in increasing order of block size.
+   */
+  static std::vector<SizeClassStatistics> sizeClassStatistics();
+
+  /** @brief Usage of the hashtable for medium and large allocations.
+   *
+   * @param num_buckets set to the number of buckets in the table.
+   * @param used_buckets set to the number of buckets holding an entry.
+   */
+  static void allocationTableUsage(unsigned* num_buckets,
+      unsigned* used_buckets);
+
 private:
   friend class AllocatorSuperblock;
   friend class AllocationTable;
@@ -154,12 +247,65 @@ private:
   /** Free list heads, indexed by size class. */
   static FreeListNode* s_freelists[s_num_freelists];
 
+  /**
+   * Number of small blocks moved between a thread cache and the shared
+   * freelists at a time.
+   */
+  static constexpr unsigned s_thread_cache_batch_size = 64;
+
+  /** @brief Small blocks cached by one thread. */
+  struct ThreadCache {
+    /** Free list heads, indexed by small size class. */
+    FreeListNode* m_freelists[s_num_small_pools];
+
+    /** Lengths of the cached freelists. */
+    unsigned m_freelist_lengths[s_num_small_pools];
+
+    /**
+     * Superblocks owned by this thread, indexed by small size class.  Each
+     * has untouched blocks left: a superblock is dropped from the cache
+     * when it runs out, after which it can be released.
+     */
+    AllocatorSuperblock* m_superblocks[s_num_small_pools];
+  };
+
+  /** The calling thread's cache. */
+  static thread_local ThreadCache s_thread_cache;
+
+  /**
+   * Allocate a block of a small size class from the calling thread's cache.
+   * Returns nullptr if the small object arena is exhausted.
+   */
+  static void* allocateSmall(unsigned size_class);
+
+  /**
+   * Refill the calling thread's cache for a small size class from the
+   * shared freelists or, if those are empty, with a new superblock.  Returns
+   * false if neither is possible.  The caller must hold the allocator lock.
+   */
+  static bool refillThreadCache(unsigned size_class);
+
+  /** Add a freed small block to the calling thread's cache. */
+  static void addToThreadCache(FreeListNode* free_node, unsigned size_class);
+
+  /**
+   * Move all but the first keep nodes of the calling thread's cached
+   * freelist for a size class to the shared one.  The caller must hold the
+   * allocator lock.
+   */
+  static void flushThreadCache(unsigned size_class, unsigned keep);
+
   /**
    * Pointers to superblocks with untouched blocks, indexed by size class.
+   * Only the medium size classes are used: small-object superblocks are
+   * owned by thread caches.
    */
   static AllocatorSuperblock* s_superblocks[
       s_num_small_pools + s_num_medium_pools];
 
+  /** Bytes released by releaseEmptySuperblocks() so far. */
+  static std::size_t s_bytes_released;
+
   /** Smallest known heap address. */
   static uintptr_t s_heap_start;
 
@@ -0,0 +1,151 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file IntegerSequence.hpp
+ * @brief Class rho::IntegerSequence.
+ */
+
+#ifndef RHO_INTEGERSEQUENCE_HPP
+#define RHO_INTEGERSEQUENCE_HPP
+
+#include <cstddef>
+
+#include "rho/GCStackRoot.hpp"
+#include "rho/IntVector.hpp"
+
+namespace rho {
+    class Environment;
+    class RObject;
+
+    /** @brief Compact representation of an integer sequence.
+     *
+     * An IntegerSequence stands for the integer vector
+     * <tt>from, from + step, ...</tt> of a given size, where \a step
+     * is 1 or -1, without storing its elements.  It is used by code
+     * that iterates over the value of <tt>from:to</tt>,
+     * <tt>seq_len(n)</tt> or <tt>seq_along(x)</tt> to avoid
+     * allocating that value: see evaluate().
+     */
+    class IntegerSequence {
+    public:
+	/** @brief Default constructor.
+	 *
+	 * Constructs an empty sequence.
+	 */
+	IntegerSequence()
+	    : m_from(1), m_step(1), m_size(0)
+	{}
+
+	/** @brief Constructor.
+	 *
+	 * @param from First element of the sequence.
+	 *
+	 * @param size Number of elements in the sequence.  All the
+	 *          elements must be representable as non-NA ints.
+	 *
+	 * @param step 1 for an increasing sequence, or -1 for a
+	 *          decreasing sequence.
+	 */
+	IntegerSequence(int from, std::size_t size, int step = 1)
+	    : m_from(from), m_step(step), m_size(size)
+	{}
+
+	/** @brief Element access.
+	 *
+	 * @param index Index of the required element (counting from
+	 *          zero).  No bounds checking is applied.
+	 *
+	 * @return The element at position \a index.
+	 */
+	int operator[](std::size_t index) const
+	{
+	    return m_from + m_step*int(index);
+	}
+
+	/** @brief First element.
+	 *
+	 * @return The first element of the sequence.  Meaningless if
+	 * the sequence is empty.
+	 */
+	int from() const
+	{
+	    return m_from;
+	}
+
+	/** @brief Last element.
+	 *
+	 * @return The last element of the sequence.  Meaningless if
+	 * the sequence is empty.
+	 */
+	int to() const
+	{
+	    return (*this)[m_size - 1];
+	}
+
+	/** @brief Number of elements.
+	 */
+	std::size_t size() const
+	{
+	    return m_size;
+	}
+
+	/** @brief Allocate the sequence as a vector.
+	 *
+	 * @return Pointer to a newly created IntVector with the same
+	 * elements as this sequence.
+	 */
+	IntVector* materialize() const;
+
+	/** @brief Evaluate an expression that may yield an integer
+	 * sequence.
+	 *
+	 * If \a expr is a call to the base function <tt>:</tt>,
+	 * <tt>seq_len</tt> or <tt>seq_along</tt> whose value would be
+	 * an integer vector, its arguments are evaluated and the
+	 * resulting sequence is described in \a *sequence without
+	 * being allocated.  Otherwise \a expr is evaluated as usual.
+	 *
+	 * @param expr The expression to be evaluated.
+	 *
+	 * @param env The environment in which to evaluate \a expr.
+	 *
+	 * @param sequence Non-null pointer to an IntegerSequence, which
+	 *          is set if the function returns true.
+	 *
+	 * @param value Non-null pointer to a GCStackRoot, which is set
+	 *          to the value of \a expr if the function returns
+	 *          false.
+	 *
+	 * @return true iff the value of \a expr is \a *sequence.
+	 */
+	static bool evaluate(RObject* expr, Environment* env,
+			     IntegerSequence* sequence,
+			     GCStackRoot<>* value);
+    private:
+	int m_from;
+	int m_step;
+	std::size_t m_size;
+    };
+}  // namespace rho
+
+#endif  // RHO_INTEGERSEQUENCE_HPP
@@ -0,0 +1,140 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file ParallelFor.hpp
+ * @brief Class rho::ParallelFor.
+ */
+
+#ifndef RHO_PARALLELFOR_HPP
+#define RHO_PARALLELFOR_HPP
+
+#include <cstddef>
+
+namespace rho {
+    /** @brief Elementwise loops over long vectors on several threads.
+     *
+     * A loop over the elements of a vector with at least threshold()
+     * elements is divided into contiguous ranges, one per thread, which
+     * are processed at once by the OpenMP thread pool that the garbage
+     * collector also uses.  Shorter loops run on the calling thread, as
+     * do all loops if rho was built without OpenMP, or in a child
+     * process forked after the parent started its threads.
+     *
+     * The body of a loop runs on threads other than the interpreter's,
+     * so it must not allocate or modify R objects, raise R errors or
+     * warnings, or throw.  Anything that calls for a warning should be
+     * recorded for each range and reported once the loop has finished.
+     */
+    class ParallelFor {
+    public:
+	/** @brief Default for threshold().
+	 */
+	static const std::size_t default_threshold = 100000;
+
+	/** @brief Maximum number of threads used by a loop.
+	 */
+	static unsigned int numThreads()
+	{
+	    return s_num_threads;
+	}
+
+	/** @brief Set the maximum number of threads used by a loop.
+	 *
+	 * @param num_threads The new maximum.  0 is treated as 1, which
+	 *          runs every loop on the calling thread.
+	 */
+	static void setNumThreads(unsigned int num_threads)
+	{
+	    s_num_threads = (num_threads ? num_threads : 1);
+	}
+
+	/** @brief Smallest loop that is split across threads.
+	 */
+	static std::size_t threshold()
+	{
+	    return s_threshold;
+	}
+
+	/** @brief Set the smallest loop that is split across threads.
+	 *
+	 * @param num_elements Number of elements below which loops run
+	 *          on the calling thread.
+	 */
+	static void setThreshold(std::size_t num_elements)
+	{
+	    s_threshold = num_elements;
+	}
+
+	/** @brief Number of ranges that a loop is split into.
+	 *
+	 * @param n Number of elements in the loop.
+	 *
+	 * @return The number of ranges that run() should use for a loop
+	 * over \a n elements.  This is 1 if the loop should run on the
+	 * calling thread.
+	 */
+	static unsigned int numRanges(std::size_t n);
+
+	/** @brief Run a loop.
+	 *
+	 * @param n Number of elements in the loop.
+	 *
+	 * @param num_ranges Number of ranges to split the loop into,
+	 *          normally the value of numRanges(n).
+	 *
+	 * @param body Function object called as <tt>body(range, begin,
+	 *          end)</tt> for each range, where \a range numbers the
+	 *          ranges from 0 and the range covers elements \a begin
+	 *          up to but not including \a end.  If \a num_ranges is
+	 *          1, it is called once with the whole loop on the
+	 *          calling thread.
+	 */
+	template<typename Body>
+	static void run(std::size_t n, unsigned int num_ranges, Body body)
+	{
+	    if (num_ranges <= 1) {
+		body(0, 0, n);
+		return;
+	    }
+	    runRanges(n, num_ranges,
+		      [](void* data, unsigned int range,
+			 std::size_t begin, std::size_t end) {
+			  (*static_cast<Body*>(data))(range, begin, end);
+		      },
+		      &body);
+	}
+    private:
+	typedef void (*RangeFunction)(void* data, unsigned int range,
+				      std::size_t begin, std::size_t end);
+
+	static unsigned int s_num_threads;
+	static std::size_t s_threshold;
+
+	ParallelFor() = delete;
+
+	static void runRanges(std::size_t n, unsigned int num_ranges,
+			      RangeFunction body, void* data);
+    };
+}  // namespace rho
+
+#endif  // RHO_PARALLELFOR_HPP
@@ -29,6 +29,8 @@
 #ifndef S3LAUNCHER_HPP
 #define S3LAUNCHER_HPP 1
 
+#include <vector>
+
 #include "rho/GCNode.hpp"
 
 #include "rho/StringVector.hpp"
@@ -270,6 +272,18 @@ namespace rho {
 	    m_call_env = call_env;
 	    m_table_env = table_env;
 	}
+
+	// create() records the methods it finds in a dispatch cache,
+	// keyed by the generic, group and classes (see S3Launcher.cpp).
+	// If the cache holds a method that is still valid, this sets
+	// the fields from m_function onwards and returns true.
+	bool findCachedMethod(bool allow_default);
+
+	// Add the method found by create() to the dispatch cache, if
+	// the lookup can be cached.  symbols are the names that
+	// create() looked up, in order, ending with m_symbol.
+	void cacheMethod(const std::vector<Symbol*>& symbols,
+			 bool allow_default);
     };
 }
 
@@ -32,6 +32,7 @@
 #define SUBSCRIPTING_HPP 1
 
 #include "rho/GCStackRoot.hpp"
+#include "rho/IntegerSequence.hpp"
 #include "rho/IntVector.hpp"
 #include "rho/ListVector.hpp"
 #include "rho/PairList.hpp"
@@ -370,6 +371,26 @@ namespace rho {
 	    indices.initialize(subscripts, v->size(), v->names());
 	    return vectorSubset(v, indices);
 	}
+
+	/** @brief Extract a range of elements of an R vector object.
+	 *
+	 * This has the same effect as vectorSubset() with the
+	 * materialized  range as subscripts, but doesn't allocate
+	 * the subscripts.
+	 *
+	 * @tparam V A type inheriting from VectorBase.
+	 *
+	 * @param v Non-null pointer to a \a V object.
+	 *
+	 * @param range Indices (counting from 1) of the elements to be
+	 *          extracted, all of which must lie between 1 and the
+	 *          size of \a v.
+	 *
+	 * @return Pointer to a newly created object of type \a V ,
+	 * containing the designated elements of \a v .
+	 */
+	template <class V>
+	static V* vectorSubset(const V* v, const IntegerSequence& range);
     private:
 	/** @brief Canonical representation of a vector of indices.
 	 *
@@ -746,6 +767,21 @@ namespace rho {
 					const VectorBase* source,
 					const Indices& indices);
 
+	/** @brief Set the attributes on a range of a vector.
+	 *
+	 * As setVectorAttributes() above, but for a subset formed by
+	 * vectorSubset() from an IntegerSequence.
+	 */
+	static void setVectorAttributes(VectorBase* subset,
+					const VectorBase* source,
+					const IntegerSequence& range);
+
+	// Implementation of both the above.
+	template <class I>
+	static void copyVectorAttributes(VectorBase* subset,
+					 const VectorBase* source,
+					 const I& indices);
+
 	/** @brief Assign to selected elements of an R vector object.
 	 *
 	 * @tparam VL A type inheriting from VectorBase.
@@ -761,7 +797,8 @@ namespace rho {
 	 *            point to a modified copy of \a lhs.  (Copying
 	 *            will occur if \a lhs aliases either \a rhs or
 	 *            the first element of \a indices_pr , or if the
-	 *            return vector needs to be larger than \a lhs .)
+	 *            return vector needs to be larger than the
+	 *            capacity of \a lhs : see VectorBase::enlarge().)
 	 *
 	 * @param indices Reference to an Indices object designating
 	 *          the elements of \a lhs to be assigned to.  It is
@@ -1006,7 +1043,7 @@ namespace rho {
 	GCStackRoot<VL> ans(lhs);
 	std::size_t minsize = indices.minimumLHSSize();
 	if (minsize > lhs->size())
-	    ans = VectorBase::resize(lhs, minsize);
+	    ans = VectorBase::enlarge(lhs, minsize);
 	// If necessary, make a copy to be sure we don't modify rhs or
 	// indices.  (FIXME: ideally this should be a shallow copy for
 	// HandleVectors.)
@@ -1059,6 +1096,18 @@ namespace rho {
 	setVectorAttributes(ans, v, indices);
 	return ans;
     }
+
+    template <class V>
+    V* Subscripting::vectorSubset(const V* v, const IntegerSequence& range)
+    {
+	std::size_t ni = range.size();
+	GCStackRoot<V> ans(V::create(ni));
+	V* vnc = const_cast<V*>(v);
+	for (std::size_t i = 0; i < ni; ++i)
+	    (*ans)[i] = ElementTraits::duplicate_element((*vnc)[range[i] - 1]);
+	setVectorAttributes(ans, v, range);
+	return ans;
+    }
 }  // namespace rho;
 
 #endif  // SUBSCRIPTING_HPP
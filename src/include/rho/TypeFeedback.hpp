@@ -0,0 +1,137 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file TypeFeedback.hpp
+ * @brief Class rho::TypeFeedback.
+ */
+
+#ifndef RHO_TYPEFEEDBACK_HPP
+#define RHO_TYPEFEEDBACK_HPP
+
+#include <cstdint>
+
+namespace rho {
+    class RObject;
+
+    /** @brief Operand types seen at a call site.
+     *
+     * A TypeFeedback object is attached to each CachingExpression, and
+     * records the kinds of operand that the interpreter has passed to
+     * the binary arithmetic and comparison builtins when evaluating that
+     * expression.  The JIT compiler uses this to decide whether it is
+     * worth emitting code specialized for scalar operands.
+     */
+    class TypeFeedback {
+    public:
+	/** @brief Kinds of operand.
+	 *
+	 * The values are bits, so that the set of kinds seen can be
+	 * held as a mask.  A scalar here is a vector of length one
+	 * with no attributes.
+	 */
+	enum Kind : unsigned char {
+	    NONE = 0,
+	    SCALAR_LOGICAL = 1,
+	    SCALAR_INTEGER = 2,
+	    SCALAR_REAL = 4,
+	    OTHER = 8
+	};
+
+	TypeFeedback()
+	    : m_lhs_kinds(NONE), m_rhs_kinds(NONE), m_num_samples(0)
+	{}
+
+	/** @brief Classify an operand.
+	 *
+	 * @param value The operand, which may be null.
+	 *
+	 * @return The Kind of \a value.
+	 */
+	static Kind classify(const RObject* value);
+
+	/** @brief Record the operands of one call.
+	 *
+	 * @param lhs The first operand.
+	 *
+	 * @param rhs The second operand.
+	 */
+	void record(const RObject* lhs, const RObject* rhs)
+	{
+	    m_lhs_kinds |= classify(lhs);
+	    m_rhs_kinds |= classify(rhs);
+	    if (m_num_samples != UINT16_MAX)
+		++m_num_samples;
+	}
+
+	/** @brief Kinds seen as the first operand.
+	 *
+	 * @return A mask of Kind values.
+	 */
+	unsigned lhsKinds() const
+	{
+	    return m_lhs_kinds;
+	}
+
+	/** @brief Kinds seen as the second operand.
+	 *
+	 * @return A mask of Kind values.
+	 */
+	unsigned rhsKinds() const
+	{
+	    return m_rhs_kinds;
+	}
+
+	/** @brief Number of calls recorded.
+	 *
+	 * The count saturates at UINT16_MAX.
+	 */
+	unsigned numSamples() const
+	{
+	    return m_num_samples;
+	}
+
+	/** @brief Does a mask hold exactly one Kind?
+	 *
+	 * @param kinds A mask of Kind values.
+	 *
+	 * @return true iff \a kinds has exactly one bit set.
+	 */
+	static bool isMonomorphic(unsigned kinds)
+	{
+	    return kinds != NONE && (kinds & (kinds - 1)) == 0;
+	}
+
+	/** @brief Forget all recorded operands.
+	 */
+	void reset()
+	{
+	    *this = TypeFeedback();
+	}
+    private:
+	unsigned char m_lhs_kinds;
+	unsigned char m_rhs_kinds;
+	uint16_t m_num_samples;
+    };
+}  // namespace rho
+
+#endif  // RHO_TYPEFEEDBACK_HPP
@@ -31,7 +31,10 @@
 #define UNARYFUNCTION_HPP 1
 
 #include <algorithm>
+#include <functional>
+#include <vector>
 #include "rho/FixedVector.hpp"
+#include "rho/ParallelFor.hpp"
 #include "rho/errors.hpp"
 
 namespace rho {
@@ -135,6 +138,54 @@ namespace rho {
 	    attribute_copier.copyAttributes(result, input);
 	    return result;
 	}
+
+	/** @brief Apply a unary function to a vector using several
+	 *  threads.
+	 *
+	 * As applyUnaryOperator(), except that long vectors are split
+	 * into ranges that are processed on several threads, as
+	 * described for ParallelFor.  Each range is processed by its
+	 * own copy of \a op, so \a op may note conditions such as the
+	 * need for a warning, but must not otherwise use the
+	 * interpreter.
+	 *
+	 * @param op Function object to apply to each element.  Its
+	 *          class must provide <tt>void merge(const Op&)</tt>,
+	 *          which is called on \a op with each copy once all the
+	 *          ranges have been processed.
+	 *
+	 * @param attribute_copier As for applyUnaryOperator().
+	 *
+	 * @param input Non-null pointer to the operand.
+	 */
+	template<typename Op, typename AttributeCopier,
+		 typename InputType,
+		 typename OutputType = VectorOpReturnType<Op, InputType>>
+	OutputType* applyUnaryOperatorInParallel(Op& op,
+						 AttributeCopier attribute_copier,
+						 const InputType* input)
+	{
+	    size_t size = input->size();
+	    unsigned int num_ranges = ParallelFor::numRanges(size);
+	    if (num_ranges <= 1) {
+		return applyUnaryOperator(std::ref(op), attribute_copier,
+					  input);
+	    }
+	    OutputType* result = OutputType::create(size);
+	    std::vector<Op> range_ops(num_ranges, op);
+	    auto in = input->begin();
+	    auto out = result->begin();
+	    ParallelFor::run(size, num_ranges,
+			     [&](unsigned int range, size_t begin, size_t end) {
+				 std::transform(in + begin, in + end,
+						out + begin,
+						std::ref(range_ops[range]));
+			     });
+	    for (const Op& range_op : range_ops)
+		op.merge(range_op);
+	    attribute_copier.copyAttributes(result, input);
+	    return result;
+	}
     }  // namespace VectorOps
 }  // namespace rho
 
@@ -148,6 +148,31 @@ namespace rho {
 	template <class V>
 	static V* resize(const V* pattern, size_type new_size);
 
+	/** @brief Extend an R vector, in place if possible.
+	 *
+	 * This has the same effect as resize() with a \a new_size
+	 * greater than the size of \a vector , except that if \a
+	 * vector has sufficient spare capacity it is extended in
+	 * place.  Otherwise the vector created is given spare
+	 * capacity in proportion to its size, so that extending a
+	 * vector repeatedly by a few elements at a time takes
+	 * amortized constant time per element.
+	 *
+	 * @tparam V A type inheriting from VectorBase.
+	 *
+	 * @param vector Non-null pointer to the vector to be
+	 *          extended.  Because \a vector may be modified, it
+	 *          must not be shared.
+	 *
+	 * @param new_size Required size, which must be greater than
+	 *          the size of \a vector .
+	 *
+	 * @return Pointer to the extended vector, which is either \a
+	 * vector itself or a newly created vector.
+	 */
+	template <class V>
+	static V* enlarge(V* vector, size_type new_size);
+
 	/** @brief Adjust attributes for a resized vector.
 	 *
 	 * When a vector is resized (either by VectorBase::resize() or
@@ -318,6 +343,26 @@ namespace rho {
 	ans->setS4Object(pattern->isS4Object());
 	return ans;
     }
+
+    template <class V>
+    V* VectorBase::enlarge(V* vector, size_type new_size)
+    {
+	if (new_size <= vector->capacity()) {
+	    vector->increaseSizeInPlace(new_size);
+	    return vector;
+	}
+	// Grow by half as much again, but by at least a few elements.
+	size_type capacity = new_size + std::max(new_size/2, size_type(4));
+	if (capacity < new_size)
+	    capacity = new_size;  // overflow
+	// The elements needn't be duplicated, as vector isn't shared.
+	GCStackRoot<V> ans(V::createWithCapacity(vector->size(), capacity));
+	std::copy(vector->begin(), vector->end(), ans->begin());
+	ans->increaseSizeInPlace(new_size);
+	ans->setAttributes(resizeAttributes(vector->attributes(), new_size));
+	ans->setS4Object(vector->isS4Object());
+	return ans;
+    }
 }  // namespace rho
 
 extern "C" {
@@ -0,0 +1,180 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file VectorKernels.hpp
+ *
+ * @brief Vectorized loops for common binary operations on R vectors.
+ */
+
+#ifndef RHO_VECTORKERNELS_HPP
+#define RHO_VECTORKERNELS_HPP 1
+
+#include <cstddef>
+
+namespace rho {
+    namespace VectorOps {
+	/** @brief Loops over raw element data for common binary operations.
+	 *
+	 * Each kernel computes the same values, including NAs, as the
+	 * element-by-element functions used with applyBinaryOperator(),
+	 * but does so without branching on the element values, so that
+	 * the compiler can use SIMD instructions.  Where the platform
+	 * supports it, each kernel is compiled several times for
+	 * different instruction sets (AVX-512, AVX2 and the baseline),
+	 * and the best version for the CPU in use is chosen when the
+	 * program is loaded.
+	 *
+	 * The output array must not overlap either input array.
+	 * Normally these functions are used via applyBinaryKernel().
+	 */
+	namespace Kernels {
+	    /** @brief Shape of the operands of a kernel.
+	     *
+	     * Kernels do not handle general recycling: either both
+	     * operands have \a n elements, or one of them has a single
+	     * element which is combined with every element of the other.
+	     */
+	    enum Operands {
+		VECTOR_VECTOR,  /**< Both operands have n elements. */
+		SCALAR_VECTOR,  /**< The first operand has one element. */
+		VECTOR_SCALAR   /**< The second operand has one element. */
+	    };
+
+	    /** @brief Arithmetic operations with a kernel.
+	     *
+	     * SQUARE ignores the second operand, and is used for
+	     * <tt>x^2</tt>.
+	     */
+	    enum ArithmeticOp {PLUS, MINUS, TIMES, DIVIDE, SQUARE};
+
+	    /** @brief Comparison operations with a kernel.
+	     */
+	    enum ComparisonOp {EQ, NE, LT, GT, LE, GE};
+
+	    /** @brief Logical operations with a kernel.
+	     */
+	    enum LogicalOp {AND, OR};
+
+	    /** @brief Arithmetic on real vectors.
+	     *
+	     * @param op The operation to apply.  All are supported.
+	     *
+	     * @param operands Shape of the operands.
+	     *
+	     * @param out Array of \a n elements to receive the result.
+	     *
+	     * @param lhs The first operand.
+	     *
+	     * @param rhs The second operand.
+	     *
+	     * @param n Number of elements in the result.
+	     */
+	    void realArithmetic(ArithmeticOp op, Operands operands,
+				double* out, const double* lhs,
+				const double* rhs, std::size_t n);
+
+	    /** @brief Arithmetic on integer vectors.
+	     *
+	     * A result that is NA, or that does not fit in an int, is
+	     * NA_INTEGER.
+	     *
+	     * @param op The operation to apply: PLUS, MINUS or TIMES.
+	     *
+	     * @param operands Shape of the operands.
+	     *
+	     * @param out Array of \a n elements to receive the result.
+	     *
+	     * @param lhs The first operand.
+	     *
+	     * @param rhs The second operand.
+	     *
+	     * @param n Number of elements in the result.
+	     *
+	     * @return true iff any result overflowed.
+	     */
+	    bool integerArithmetic(ArithmeticOp op, Operands operands,
+				   int* out, const int* lhs, const int* rhs,
+				   std::size_t n);
+
+	    /** @brief Division of integer vectors.
+	     *
+	     * Parameters are as for integerArithmetic(), but the result
+	     * is real, and NA_REAL if either operand is NA.
+	     */
+	    void integerDivide(Operands operands, double* out,
+			       const int* lhs, const int* rhs, std::size_t n);
+
+	    /** @brief Comparison of real vectors.
+	     *
+	     * The result is NA_LOGICAL if either operand is NA or NaN.
+	     *
+	     * @param op The comparison to make.
+	     *
+	     * @param operands Shape of the operands.
+	     *
+	     * @param out Array of \a n elements to receive the result.
+	     *
+	     * @param lhs The first operand.
+	     *
+	     * @param rhs The second operand.
+	     *
+	     * @param n Number of elements in the result.
+	     */
+	    void realComparison(ComparisonOp op, Operands operands,
+				int* out, const double* lhs,
+				const double* rhs, std::size_t n);
+
+	    /** @brief Comparison of integer vectors.
+	     *
+	     * Parameters are as for realComparison().
+	     */
+	    void integerComparison(ComparisonOp op, Operands operands,
+				   int* out, const int* lhs, const int* rhs,
+				   std::size_t n);
+
+	    /** @brief Elementwise <tt>&</tt> and <tt>|</tt> of logical
+	     * vectors.
+	     *
+	     * Any nonzero value other than NA_LOGICAL counts as TRUE.
+	     * The result follows R's three-valued logic, as
+	     * Logical::operator&&() and Logical::operator||() do.
+	     *
+	     * @param op The operation to apply.
+	     *
+	     * @param operands Shape of the operands.
+	     *
+	     * @param out Array of \a n elements to receive the result.
+	     *
+	     * @param lhs The first operand.
+	     *
+	     * @param rhs The second operand.
+	     *
+	     * @param n Number of elements in the result.
+	     */
+	    void logical(LogicalOp op, Operands operands, int* out,
+			 const int* lhs, const int* rhs, std::size_t n);
+	}  // namespace Kernels
+    }  // namespace VectorOps
+}  // namespace rho
+
+#endif  // RHO_VECTORKERNELS_HPP
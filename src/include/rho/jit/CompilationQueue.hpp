@@ -0,0 +1,196 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#ifndef RHO_JIT_COMPILATION_QUEUE_HPP
+#define RHO_JIT_COMPILATION_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "rho/jit/OptimizationOptions.hpp"
+
+namespace llvm {
+
+class ExecutionEngine;
+class Module;
+}
+
+namespace rho {
+namespace JIT {
+
+class MCJITMemoryManager;
+
+/*
+ * The second half of compiling an expression: optimizing the IR that the
+ * Compiler has generated and turning it into machine code.
+ *
+ * Generating the IR reads interpreter data structures, so it has to be done
+ * on the interpreter thread.  Once it is complete, the module is handed to a
+ * CompilationJob, which only touches LLVM objects, and so can be run on the
+ * compilation thread while the interpreter carries on.
+ */
+class CompilationJob {
+public:
+    CompilationJob(std::unique_ptr<llvm::Module> module,
+		   std::unique_ptr<MCJITMemoryManager> memory_manager,
+		   const std::string& function_name,
+		   CompilationTier tier);
+    ~CompilationJob();
+
+    // Generates the machine code.  The caller must hold
+    // CompilationQueue::llvmMutex().
+    void run();
+
+    // Marks a job that will never be run as finished, without any code.
+    void abandon();
+
+    // True once run() has completed, on whichever thread it ran, or the
+    // job has been abandoned.
+    bool isFinished() const {
+	return m_finished.load(std::memory_order_acquire);
+    }
+
+    // The results, which are only valid once the job is finished.  The
+    // address is zero if compilation failed.
+    uint64_t functionAddress() const { return m_function_address; }
+    std::shared_ptr<llvm::ExecutionEngine> takeEngine();
+
+    // The number of bytes of machine code and of data generated.
+    uint64_t codeSize() const { return m_code_size; }
+    uint64_t dataSize() const { return m_data_size; }
+
+    std::chrono::steady_clock::time_point submitTime() const {
+	return m_submit_time;
+    }
+
+    CompilationTier tier() const { return m_tier; }
+
+    // True if the machine code was loaded from the ObjectCache.
+    bool loadedFromCache() const { return m_loaded_from_cache; }
+
+private:
+
+    std::unique_ptr<llvm::Module> m_module;
+    std::unique_ptr<MCJITMemoryManager> m_memory_manager;
+    std::string m_function_name;
+    CompilationTier m_tier;
+    // Shared with other jobs' modules.
+    std::shared_ptr<llvm::ExecutionEngine> m_engine;
+    uint64_t m_function_address;
+    uint64_t m_code_size;
+    uint64_t m_data_size;
+    bool m_loaded_from_cache;
+    std::atomic<bool> m_finished;
+    std::chrono::steady_clock::time_point m_submit_time;
+
+    CompilationJob(const CompilationJob&) = delete;
+    CompilationJob& operator=(const CompilationJob&) = delete;
+};
+
+/*
+ * Runs CompilationJobs on a dedicated thread, so that compiling a closure
+ * doesn't stall the interpreter.
+ *
+ * All of the JIT's modules share one LLVMContext, which isn't thread safe.
+ * Anything that creates, modifies or destroys LLVM objects must hold
+ * llvmMutex().  The interpreter thread only ever try_lock()s it before
+ * generating IR, and when it is busy postpones the compilation, so it never
+ * waits for the compilation thread.
+ */
+class CompilationQueue {
+public:
+    struct Statistics {
+	uint64_t num_background;     // Jobs run on the compilation thread.
+	uint64_t num_synchronous;    // Jobs run on the interpreter thread.
+	uint64_t num_optimized;      // Jobs at CompilationTier::OPTIMIZED.
+	uint64_t num_cached;         // Jobs loaded from the ObjectCache.
+	uint64_t num_failed;
+	uint64_t total_code_size;    // Bytes of machine code generated.
+	uint64_t total_data_size;
+	unsigned int num_engines;    // ExecutionEngines now in existence.
+	unsigned int queue_length;   // Jobs currently waiting or running.
+	unsigned int max_queue_length;
+	double total_latency;        // Seconds from submission to completion.
+	double max_latency;
+	double total_compile_time;   // Seconds spent generating machine code.
+	double max_compile_time;
+    };
+
+    // Compiles a job, in the background if possible.  The job is run on the
+    // calling thread instead if the maximum queue depth is zero or the queue
+    // is full.  The caller must hold llvmMutex().
+    static void submit(const std::shared_ptr<CompilationJob>& job);
+
+    // Compiles a job on the calling thread.  The caller must hold
+    // llvmMutex().
+    static void runNow(const std::shared_ptr<CompilationJob>& job);
+
+    // Stops the compilation thread, waiting for the job it is running to
+    // finish.  Jobs that are still waiting are abandoned, so their code is
+    // never ready.  This is called at exit.  A later submit() starts a new
+    // thread.  The caller must not hold llvmMutex().
+    static void shutdown();
+
+    static std::recursive_mutex& llvmMutex();
+
+    // Drops a CompiledExpression's references to LLVM objects, destroying
+    // them if nothing else uses them.  (The engine is shared with other
+    // functions.)  This may be called without holding llvmMutex(), for
+    // example by the garbage collector.  If the mutex is in use, the
+    // references are kept until destroyReleased() is next called, which
+    // happens after each background job and before the interpreter
+    // generates IR.
+    static void release(std::shared_ptr<llvm::ExecutionEngine> engine,
+			std::shared_ptr<CompilationJob> job);
+
+    // The caller must hold llvmMutex().
+    static void destroyReleased();
+
+    // The maximum number of jobs that may be waiting for, or running on,
+    // the compilation thread.  Zero disables background compilation.
+    static unsigned int maxDepth() { return s_max_depth; }
+    static void setMaxDepth(unsigned int depth) { s_max_depth = depth; }
+
+    // The directory where the ObjectCache keeps machine code, or empty if
+    // code isn't cached.
+    static std::string cacheDirectory();
+    static void setCacheDirectory(const std::string& directory);
+
+    static Statistics statistics();
+    static void resetStatistics();
+
+private:
+    static unsigned int s_max_depth;
+
+    CompilationQueue() = delete;
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_COMPILATION_QUEUE_HPP
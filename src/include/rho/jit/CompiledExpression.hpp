@@ -24,13 +24,16 @@
 #ifndef RHO_JIT_COMPILED_EXPRESSION_HPP
 #define RHO_JIT_COMPILED_EXPRESSION_HPP
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "rho/ArgList.hpp"
 #include "rho/GCEdge.hpp"
 #include "rho/GCNode.hpp"
 #include "rho/GCStackRoot.hpp"
 #include "rho/FrameDescriptor.hpp"
+#include "rho/jit/OptimizationOptions.hpp"
 
 namespace llvm {
 
@@ -42,15 +45,32 @@ namespace rho {
 class Closure;
 class CompilerContext;
 class Environment;
+class Expression;
 class Frame;
 class RObject;
 
 namespace JIT {
 
+class CompilationJob;
+class FunctionLookupCache;
+
 class CompiledExpression : public GCNode {
 public:
     ~CompiledExpression();
 
+    // Machine code for function bodies may be generated on the compilation
+    // thread, so it isn't necessarily available as soon as the
+    // CompiledExpression has been created.  This returns true once it is,
+    // installing the code the first time it is called after compilation has
+    // finished.  evalInEnvironment() may only be called if this is true.
+    bool isReady() const
+    {
+	return m_function || installCompiledCode();
+    }
+
+    // True if the machine code couldn't be generated.
+    bool failed() const;
+
     RObject* evalInEnvironment(Environment* env) const
     {
 	GCStackRoot<const GCNode> protect(this);
@@ -61,25 +81,118 @@ public:
 
     bool hasMatchingFrameLayout(const Environment* env) const;
 
-    static CompiledExpression* compileFunctionBody(const Closure* function);
+    CompilationTier tier() const { return m_tier; }
+
+    const FrameDescriptor* frameDescriptor() const {
+	return m_frame_descriptor;
+    }
+
+    // The number of bytes of machine code and data generated for the
+    // expression, once it is ready.
+    uint64_t codeSize() const { return m_code_size; }
+    uint64_t dataSize() const { return m_data_size; }
+
+    // True if the machine code was loaded from the ObjectCache.
+    bool loadedFromCache() const { return m_loaded_from_cache; }
+
+    // Generates IR for the body of a closure, and queues it for compilation
+    // to machine code.  Returns null if the compiler is already in use by
+    // the compilation thread, in which case the caller should try again
+    // later.  When recompiling a function at a higher tier, pass the frame
+    // descriptor of the existing code so that the new code can use the same
+    // frames.
+    static CompiledExpression* compileFunctionBody(
+	const Closure* function,
+	CompilationTier tier = CompilationTier::BASELINE,
+	const FrameDescriptor* frame_descriptor = nullptr);
+
+    // Compiles a while() or repeat() loop in the body of a closure, so that
+    // a call that started the loop in the interpreter can run the rest of it
+    // in compiled code.  The code evaluates the loop from the start of an
+    // iteration, and runs in frames with the layout given by
+    // frame_descriptor, or a new layout if that is null.  The loop is
+    // compiled immediately, and is ready on return.  Returns null if the
+    // compiler is already in use by the compilation thread.
+    static CompiledExpression* compileLoop(
+	const Closure* function, const Expression* loop,
+	const FrameDescriptor* frame_descriptor);
+
+    // When closures and loops get compiled.  Zero disables the step.
+    //
+    // The number of calls after which a closure is compiled.
+    static unsigned int compileThreshold() { return s_compile_threshold; }
+    static void setCompileThreshold(unsigned int calls) {
+	s_compile_threshold = calls;
+    }
+
+    // The number of calls, or iterations of loops in its compiled code,
+    // after which a closure is recompiled at CompilationTier::OPTIMIZED.
+    static unsigned int optimizeThreshold() { return s_optimize_threshold; }
+    static void setOptimizeThreshold(unsigned int calls) {
+	s_optimize_threshold = calls;
+    }
+    static unsigned int optimizeBackEdgeThreshold() {
+	return s_optimize_back_edge_threshold;
+    }
+    static void setOptimizeBackEdgeThreshold(unsigned int back_edges) {
+	s_optimize_back_edge_threshold = back_edges;
+    }
+
+    // The number of iterations of a while() or repeat() loop in the
+    // interpreter after which the rest of the loop is run in compiled code.
+    static unsigned int loopThreshold() { return s_loop_threshold; }
+    static void setLoopThreshold(unsigned int back_edges) {
+	s_loop_threshold = back_edges;
+    }
+
+    // How calls of closures whose compiled code was ready were run.
+    struct CallStatistics {
+	uint64_t num_compiled;         // Calls that ran compiled code.
+	uint64_t num_frames_replaced;  // Of those, calls whose frame had to
+				       // be given the code's layout first.
+	uint64_t num_interpreted;      // Calls whose frame couldn't be used.
+    };
+    static CallStatistics& callStatistics() { return s_call_statistics; }
 
     void detachReferents() override;
     void visitReferents(const_visitor* v) const override;
 
 private:
-    CompiledExpression(const Closure* closure);
+    CompiledExpression(const Closure* closure, const RObject* code,
+		       const FrameDescriptor* frame_descriptor,
+		       bool is_loop_entry, CompilationTier tier);
 
-    // The compiled function itself.
+    static unsigned int s_compile_threshold;
+    static unsigned int s_optimize_threshold;
+    static unsigned int s_optimize_back_edge_threshold;
+    static unsigned int s_loop_threshold;
+    static CallStatistics s_call_statistics;
+
+    CompilationTier m_tier;
+
+    // The compiled function itself, or null until it is ready.
     typedef RObject* (*CompiledExpressionPointer)(Environment* env);
-    CompiledExpressionPointer m_function;
+    mutable CompiledExpressionPointer m_function;
+
+    // The compilation that will produce m_function and m_engine.  Only set
+    // until its results have been installed.
+    mutable std::shared_ptr<CompilationJob> m_job;
 
     // The interpreter requires the frame descriptor to work with the frames
     // that the compiled code generates.
-    GCEdge<FrameDescriptor> m_frame_descriptor;
+    GCEdge<const FrameDescriptor> m_frame_descriptor;
+
+    // The inline caches that the compiled code uses to look up functions.
+    std::vector<std::unique_ptr<FunctionLookupCache>> m_function_lookup_caches;
+
+    // The engine holding the machine code, which is shared by many
+    // functions.
+    mutable std::shared_ptr<llvm::ExecutionEngine> m_engine;
+    mutable uint64_t m_code_size;
+    mutable uint64_t m_data_size;
+    mutable bool m_loaded_from_cache;
 
-    // TODO(kmillar): we ought to have a single engine that is shared by many
-    //   functions.
-    std::unique_ptr<llvm::ExecutionEngine> m_engine;
+    bool installCompiledCode() const;
 
     CompiledExpression(const CompiledExpression&) = delete;
     CompiledExpression& operator=(const CompiledExpression&) = delete;
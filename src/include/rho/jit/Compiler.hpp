@@ -24,6 +24,8 @@
 #ifndef RHO_JIT_COMPILER_HPP
 #define RHO_JIT_COMPILER_HPP
 
+#include <functional>
+#include <vector>
 #include "rho/jit/CompilerContext.hpp"
 #include "rho/jit/llvm.hpp"
 namespace rho {
@@ -90,11 +92,63 @@ private:
     llvm::Value* emitInlinedBegin(const Expression* expression);
     llvm::Value* emitInlinedReturn(const Expression* expression);
     llvm::Value* emitInlinedIf(const Expression* expression);
+    llvm::Value* emitInlinedFor(const Expression* expression);
     llvm::Value* emitInlinedWhile(const Expression* expression);
     llvm::Value* emitInlinedRepeat(const Expression* expression);
     llvm::Value* emitInlinedBreak(const Expression* expression);
     llvm::Value* emitInlinedNext(const Expression* expression);
 
+    // Loop variables that are held unboxed in a register instead of in the
+    // frame.  The frame isn't updated until the loop exits, so the values
+    // must be spilled to the frame before running any code that might read
+    // it.
+    struct UnboxedVariable {
+	const Symbol* symbol;
+	int location;
+	llvm::Value* value;  // An i32.
+    };
+    std::vector<UnboxedVariable> m_unboxed_variables;
+
+    const UnboxedVariable* findUnboxedVariable(const RObject* expression) const;
+    void emitSpillUnboxedVariables();
+
+    // Arithmetic and comparison operators, specialized for the operand
+    // types that the interpreter has recorded at the call site.
+    template<unsigned opcode>
+    llvm::Value* emitInlinedArithmetic(const Expression* expression);
+    template<unsigned opcode>
+    llvm::Value* emitInlinedComparison(const Expression* expression);
+    llvm::Value* emitSpecializedBinaryOp(const Expression* expression,
+					 bool is_comparison, unsigned opcode);
+    llvm::Value* emitRealBinaryOp(bool is_comparison, unsigned opcode,
+				  llvm::Value* lhs, llvm::Value* rhs,
+				  llvm::BasicBlock* deoptimize);
+    llvm::Value* emitIntegerBinaryOp(bool is_comparison, unsigned opcode,
+				     llvm::Value* lhs, llvm::Value* rhs,
+				     llvm::BasicBlock* deoptimize);
+    llvm::Value* emitUnboxOperand(llvm::Value* value,
+				  const UnboxedVariable* variable,
+				  unsigned kind);
+    llvm::Value* emitIntegerToReal(llvm::Value* value,
+				   llvm::BasicBlock* deoptimize);
+    void emitDeoptimizeIf(llvm::Value* condition,
+			  llvm::BasicBlock* deoptimize);
+
+    // for() loops.
+    void emitIndexedLoop(llvm::Value* length, const RObject* body,
+			 llvm::BasicBlock* continue_block,
+			 const std::function<void(llvm::Value*)>& bind_variable);
+    void emitBoxedForLoop(const Symbol* symbol, int location,
+			  llvm::Value* sequence, llvm::Value* length,
+			  const RObject* body);
+    void emitUnboxedForLoop(const Expression* expression,
+			    const Symbol* symbol, int location,
+			    llvm::Value* sequence, llvm::Value* length,
+			    const RObject* body);
+    static bool isIntegerSequenceExpression(const RObject* expression);
+    static bool keepsLoopVariableLocal(const RObject* code,
+				       const Symbol* variable);
+
     typedef llvm::Value* (Compiler::*EmitBuiltinFn)(const Expression*);
     static const std::vector<std::pair<FunctionBase*, EmitBuiltinFn>>&
 	getInlineableBuiltins();
@@ -118,6 +172,7 @@ private:
 	llvm::Function* function);
 
     llvm::Constant* emitConstantPointer(const void* value, llvm::Type* type);
+    llvm::Value* emitEntryBlockAlloca(llvm::Type* type, const char* name);
 
     void emitSetVisibility(bool visible);
 
@@ -130,6 +185,7 @@ private:
 				   llvm::PHINode* merge_point,
 				   llvm::BasicBlock* insert_before = nullptr);
     llvm::Value* createBackEdge(llvm::BasicBlock* destination);
+    void emitCountBackEdge();
 };
 
 template <class T>
@@ -24,11 +24,15 @@
 #ifndef RHO_JIT_COMPILER_CONTEXT_HPP
 #define RHO_JIT_COMPILER_CONTEXT_HPP
 
+#include <memory>
 #include <stack>
 #include <typeinfo>
+#include <vector>
 
 #include "rho/Frame.hpp"
 #include "rho/GCRoot.hpp"
+#include "rho/jit/FunctionLookupCache.hpp"
+#include "rho/jit/OptimizationOptions.hpp"
 
 namespace llvm {
     class BasicBlock;
@@ -50,7 +54,6 @@ namespace JIT {
 
 class Compiler;
 class MCJITMemoryManager;
-struct OptimizationOptions;
 
 class CompilerContext {
 public:
@@ -58,7 +61,14 @@ public:
 		    llvm::Value* environment,
 		    // The function to emit code into.
 		    llvm::Function* function,
-		    MCJITMemoryManager* memory_manager);
+		    MCJITMemoryManager* memory_manager,
+		    // If non-null, the layout of the frames that the code
+		    // will run in.  Otherwise a new layout is created.
+		    const FrameDescriptor* frame_descriptor = nullptr,
+		    // True if compiling a loop to be entered from the
+		    // interpreter, rather than a whole function body.
+		    bool is_loop_entry = false,
+		    CompilationTier tier = CompilationTier::BASELINE);
 
     ~CompilerContext();
 
@@ -83,6 +93,19 @@ public:
 	return m_environment;
     }
 
+    // If true, the code is a loop that is entered part way through a call
+    // that started in the interpreter.  Returning from the compiled code
+    // only ends the loop, so 'return' must be left to the interpreter.
+    bool isLoopEntry() {
+	return m_is_loop_entry;
+    }
+
+    // Baseline code counts the iterations of its loops, so that hot
+    // closures can be recompiled with more optimization.
+    CompilationTier getTier() {
+	return m_tier;
+    }
+
     // The environment that encloses the closure's local environment.
     const Environment* getEnclosingEnvironment();
 
@@ -115,13 +138,18 @@ public:
 
     // These variables are read-write and publicly accessible for use by the
     // compiler.
-    GCRoot<FrameDescriptor> m_frame_descriptor;
+    GCRoot<const FrameDescriptor> m_frame_descriptor;
+    // The inline caches used by the code's function lookups, which the
+    // CompiledExpression takes ownership of.
+    std::vector<std::unique_ptr<FunctionLookupCache>> m_function_lookup_caches;
 
 private:
     const Closure* m_closure;
     llvm::Value* m_environment;
     llvm::Function* m_function;
     MCJITMemoryManager* m_memory_manager;
+    bool m_is_loop_entry;
+    CompilationTier m_tier;
 
     std::stack<llvm::BasicBlock*> m_break_destinations;
     std::stack<llvm::BasicBlock*> m_next_destinations;
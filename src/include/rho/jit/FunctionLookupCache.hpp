@@ -0,0 +1,110 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#ifndef RHO_JIT_FUNCTION_LOOKUP_CACHE_HPP
+#define RHO_JIT_FUNCTION_LOOKUP_CACHE_HPP
+
+#include "rho/Environment.hpp"
+#include "rho/Frame.hpp"
+#include "rho/FunctionBase.hpp"
+#include "rho/GCEdge.hpp"
+#include "rho/Promise.hpp"
+
+namespace rho {
+
+class Symbol;
+
+namespace JIT {
+
+// An inline cache for the lookup of a function at one call site in compiled
+// code.
+//
+// The cache remembers the Binding that the last lookup found in the
+// environments enclosing the closure's local environment.  That Binding
+// remains the right one for as long as the enclosing environment is the
+// same, the local frame doesn't bind the symbol and
+// Environment::searchPathGeneration() is unchanged, provided that every
+// Frame the search passed through was either locked or on the search path.
+// Lookups that went through other frames aren't cached.
+//
+// The code for a closure body always runs with the same enclosing
+// environment, so the cache only holds one entry.
+class FunctionLookupCache {
+public:
+    FunctionLookupCache() : m_binding(nullptr), m_generation(0) {}
+
+    // Returns the function that symbol refers to when called from env, or
+    // null if there is none.  The result is the same as
+    // findFunction(symbol, env).
+    FunctionBase* lookup(const Symbol* symbol, Environment* env)
+    {
+	if (m_binding && env->enclosingEnvironment() == m_enclosing
+	    && m_generation == Environment::searchPathGeneration()
+	    && !env->frame()->binding(symbol)) {
+	    FunctionBase* function = cachedFunction();
+	    if (function)
+		return function;
+	}
+	return update(symbol, env);
+    }
+
+    // Does a full lookup, and caches the result if it can be.
+    FunctionBase* update(const Symbol* symbol, Environment* env);
+
+    void clear();
+
+    void detachReferents();
+    void visitReferents(GCNode::const_visitor* v) const;
+
+private:
+    GCEdge<const Environment> m_enclosing;
+    // The frame holding m_binding, which keeps the binding alive.
+    GCEdge<const Frame> m_frame;
+    const Frame::Binding* m_binding;
+    unsigned int m_generation;
+
+    // The function bound by m_binding, if it is still bound to one.
+    FunctionBase* cachedFunction() const
+    {
+	if (m_binding->isActive())
+	    return nullptr;
+	RObject* value = m_binding->rawValue();
+	if (value && value->sexptype() == PROMSXP) {
+	    Promise* promise = static_cast<Promise*>(value);
+	    if (!promise->evaluated())
+		return nullptr;
+	    value = promise->force();
+	}
+	return FunctionBase::isA(value) ? static_cast<FunctionBase*>(value)
+	    : nullptr;
+    }
+
+    FunctionLookupCache(const FunctionLookupCache&) = delete;
+    FunctionLookupCache& operator=(const FunctionLookupCache&) = delete;
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_FUNCTION_LOOKUP_CACHE_HPP
@@ -39,14 +39,49 @@ namespace JIT {
  * Memory manager that additionally knows the locations of:
  * - All Symbol objects.
  * - All builtin function objects.
- * - Any objects that have been added with 'addGlobal()'.
+ * - Any objects that have been added with 'addGlobal()' or
+ *   'getConstant()'.
+ *
+ * Generated code refers to these objects through named external globals
+ * rather than by their addresses, so the same object code can be reused
+ * in another process (see ObjectCache).  The names only depend on the
+ * order in which the compiler asks for them.
  */
 class MCJITMemoryManager : public llvm::SectionMemoryManager {
 public:
-    explicit MCJITMemoryManager(llvm::Module* module);
+    // The module is the one that globals are added to.  A memory manager
+    // that is only used by an ExecutionEngine doesn't need one.
+    explicit MCJITMemoryManager(llvm::Module* module = nullptr);
 
     uint64_t getSymbolAddress(const std::string& name) override;
 
+    uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment,
+				 unsigned section_id,
+				 llvm::StringRef section_name) override;
+    uint8_t* allocateDataSection(uintptr_t size, unsigned alignment,
+				 unsigned section_id,
+				 llvm::StringRef section_name,
+				 bool is_read_only) override;
+
+    // The number of bytes of code and data allocated so far.
+    uint64_t codeSize() const { return m_code_size; }
+    uint64_t dataSize() const { return m_data_size; }
+
+    // Several modules may be loaded into one ExecutionEngine, which
+    // resolves their globals through a single memory manager.  This appends
+    // '.suffix' to the names of the globals that are specific to this
+    // module, so that they are distinct from those of other modules.
+    void renameModuleGlobals(const std::string& suffix);
+
+    // Makes the globals of another module's memory manager known to this
+    // one.
+    void addGlobalsFrom(const MCJITMemoryManager& other);
+
+    // Forgets the globals added by addGlobalsFrom(), once the modules that
+    // refer to them have been finalized.  Symbols and builtins can still
+    // be looked up by name.
+    void clearGlobals();
+
     template<class T>
     llvm::GlobalVariable* addGlobal(T* object,
 				    bool isConstant,
@@ -59,10 +94,21 @@ public:
 
     llvm::GlobalVariable* getSymbol(const Symbol* symbol);
     llvm::GlobalVariable* getBuiltIn(const BuiltInFunction* function);
+
+    // Returns a global of opaque type located at 'address', which must
+    // not be null.  Each address gets a single constant, as LLVM assumes
+    // that distinct globals don't have the same address.
+    llvm::GlobalVariable* getConstant(const void* address);
 private:
     llvm::Module* m_module;
     std::unordered_map<std::string,
 		       std::pair<void*, llvm::GlobalVariable*>> m_mappings;
+    std::unordered_map<const void*, llvm::GlobalVariable*> m_constants;
+    int m_num_names;
+    uint64_t m_code_size;
+    uint64_t m_data_size;
+
+    std::string addCounter(const std::string& prefix);
 
     llvm::GlobalVariable* addGlobal(llvm::Type* type, void* address,
 				    bool is_constant, std::string name);
@@ -0,0 +1,102 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#ifndef RHO_JIT_OBJECT_CACHE_HPP
+#define RHO_JIT_OBJECT_CACHE_HPP
+
+#include "rho/jit/llvm.hpp"
+#include "rho/jit/OptimizationOptions.hpp"
+
+#include <memory>
+#include <string>
+
+namespace rho {
+namespace JIT {
+
+/*
+ * Keeps the machine code that MCJIT generates for a module in a file, so
+ * that later processes can load it instead of compiling the module again.
+ *
+ * The file is named after a hash of the module's IR, together with the
+ * compilation tier, the target, and the versions of LLVM and of the runtime
+ * module.  The IR captures everything the compiler took from the closure:
+ * the body and formals, the frame layout and the type feedback.  Objects
+ * in the interpreter are referred to by name and resolved by the
+ * MCJITMemoryManager when the code is loaded, so the code is valid in any
+ * process that generates the same IR.
+ *
+ * Each CompilationJob uses its own ObjectCache.  Errors reading or writing
+ * the files are ignored, and the code is simply compiled.  So are files
+ * that don't hold the complete object code for their key.
+ */
+class ObjectCache : public llvm::ObjectCache {
+public:
+    // Looks up the module in the cache in 'directory'.  This must be called
+    // before the module is optimized.  The caller must hold
+    // CompilationQueue::llvmMutex().
+    static std::unique_ptr<ObjectCache> create(const llvm::Module* module,
+					       CompilationTier tier,
+					       const std::string& directory);
+
+    // True if the cache holds code for the module, which getObject() will
+    // return.
+    bool hasObject() const { return bool(m_object); }
+
+    // The hash that identifies the module.
+    const std::string& key() const { return m_key; }
+
+    // The hash that identifies the module's code at the given tier in a
+    // build of rho whose runtime module has the hash 'runtime_hash'.
+    static std::string key(const llvm::Module* module, CompilationTier tier,
+			   const std::string& runtime_hash);
+
+#if (LLVM_VERSION >= 306)
+    void notifyObjectCompiled(const llvm::Module* module,
+			      llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer>
+    getObject(const llvm::Module* module) override;
+#else
+    void notifyObjectCompiled(const llvm::Module* module,
+			      const llvm::MemoryBuffer* object) override;
+    llvm::MemoryBuffer* getObject(const llvm::Module* module) override;
+#endif
+
+private:
+    std::string m_key;
+    std::string m_filename;
+    std::unique_ptr<llvm::MemoryBuffer> m_object;
+
+    ObjectCache(const std::string& key, const std::string& filename,
+		std::unique_ptr<llvm::MemoryBuffer> object);
+
+    void writeObject(llvm::StringRef object);
+
+    ObjectCache(const ObjectCache&) = delete;
+    ObjectCache& operator=(const ObjectCache&) = delete;
+};
+
+} // namespace JIT
+} // namespace rho
+
+#endif // RHO_JIT_OBJECT_CACHE_HPP
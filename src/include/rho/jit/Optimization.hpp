@@ -75,6 +75,12 @@ class RemoveRedundantCallsToSetVisibility : public llvm::BasicBlockPass {
   static char pass_id;  // LLVM uses the address of this variable as the ID.
 };
 
+// Runs LLVM's standard -O2 pipeline, including inlining, GVN, LICM and
+// the loop and SLP vectorizers, over a module.  This is used for the
+// optimized tier of compilation.  Runtime::linkInRuntimeModule() should be
+// called first so that there are runtime functions to inline.
+void optimizeModule(llvm::Module* module, llvm::TargetMachine* target);
+
 }  // namespace JIT
 }  // namespace rho
 
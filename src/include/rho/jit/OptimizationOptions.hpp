@@ -27,6 +27,13 @@
 namespace rho {
 namespace JIT {
 
+// Closures are first compiled quickly, with minimal optimization.  Those
+// that stay hot are then recompiled with LLVM's full optimization pipeline.
+enum class CompilationTier {
+    BASELINE,
+    OPTIMIZED
+};
+
 struct OptimizationOptions {
     OptimizationOptions()
 	: AssumeSaneControlFlowOperators(true),
@@ -52,7 +59,7 @@ struct OptimizationOptions {
 
     // TODO(kmillar): add optimization options here.
 
-    // TODO(kmillar): add LLVM optimization options.
+    // The LLVM optimization level is chosen by the CompilationTier.
 };
 
 }  // namespace JIT
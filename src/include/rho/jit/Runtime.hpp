@@ -38,6 +38,7 @@ class Value;
 
 namespace rho {
 
+class BuiltInFunction;
 class Environment;
 class RObject;
 class Symbol;
@@ -80,10 +81,15 @@ llvm::Function* getDeclaration(const std::string& name, Compiler* compiler);
 // returns NOT_A_RUNTIME_FUNCTION if function isn't a runtime function.
 FunctionId getFunctionId(llvm::Function* function);
 
+// The file that the runtime module is loaded from.
+std::string getRuntimeModuleFilename();
+
 // Return a module that has been setup to work with the runtime.
 std::unique_ptr<llvm::Module> createModule(llvm::LLVMContext& context);
 
 // Links any needed runtime functions and definitions into the module.
+// This gives the runtime functions that the module calls their bodies, so
+// that the optimizer can inline them.
 void linkInRuntimeModule(llvm::Module* module);
 
 // Returns the LLVM type that the runtime uses for the given class name.
@@ -114,11 +120,39 @@ llvm::Value* emitAssignSymbolInCompiledFrame(llvm::Value* symbol,
 llvm::Value* emitLookupFunction(llvm::Value* symbol, llvm::Value* environment,
 				Compiler* compiler);
 
+// Like emitLookupFunction(), but first tries the FunctionLookupCache that
+// cache points to.
+llvm::Value* emitLookupFunctionCached(llvm::Value* symbol,
+				      llvm::Value* environment,
+				      llvm::Value* cache, Compiler* compiler);
+
 llvm::Value* emitCallFunction(llvm::Value* function_base,
 			      llvm::Value* pairlist_args, llvm::Value* call,
 			      llvm::Value* environment,
 			      Compiler* compiler);
 
+// Call a binary builtin with operands that have already been evaluated.
+llvm::Value* emitApplyBinaryBuiltIn(const BuiltInFunction* function,
+				    llvm::Value* lhs, llvm::Value* rhs,
+				    const Expression* call,
+				    llvm::Value* environment,
+				    Compiler* compiler);
+
+// for() loops.
+llvm::Value* emitForLoopSequence(llvm::Value* sequence, const Expression* call,
+				 Compiler* compiler);
+llvm::Value* emitForLoopLength(llvm::Value* sequence, Compiler* compiler);
+llvm::Value* emitForLoopElement(llvm::Value* sequence, llvm::Value* index,
+				Compiler* compiler);
+llvm::Value* emitIsIntegerVector(llvm::Value* sequence, Compiler* compiler);
+llvm::Value* emitIntegerElement(llvm::Value* sequence, llvm::Value* index,
+				Compiler* compiler);
+// Run the whole loop in the interpreter.
+llvm::Value* emitForLoopOverSequence(const Expression* call,
+				     llvm::Value* sequence,
+				     llvm::Value* environment,
+				     Compiler* compiler);
+
 llvm::Value* emitBreak(llvm::Value* environment, Compiler* compiler);
 llvm::Value* emitNext(llvm::Value* environment, Compiler* compiler);
 
@@ -134,6 +168,12 @@ void emitMaybeCheckForUserInterrupt(Compiler* compiler);
 
 void emitIncrementNamed(llvm::Value* value, Compiler* compiler);
 
+// Protects a value from garbage collection until the protection stack is
+// restored to the returned size.  If an exception escapes first, the
+// enclosing ProtectStack::Scope restores it.
+llvm::Value* emitProtect(llvm::Value* value, Compiler* compiler);
+void emitRestoreProtectStack(llvm::Value* size, Compiler* compiler);
+
 // Exception handling code.
 // These functions currently don't have FunctionIds assigned.
 llvm::Type* exceptionInfoType(Compiler* compiler);
@@ -153,6 +193,16 @@ llvm::Value* emitGetReturnExceptionValue(llvm::Value* return_exception,
 // Utility functions.
 llvm::Value* emitIsAFunction(llvm::Value* robject, Compiler* compiler);
 
+// Scalar values.
+// emitScalarKind returns the TypeFeedback::Kind of the value as an i32.
+// The unboxing functions may only be applied to values of the matching kind.
+llvm::Value* emitScalarKind(llvm::Value* robject, Compiler* compiler);
+llvm::Value* emitScalarRealValue(llvm::Value* robject, Compiler* compiler);
+llvm::Value* emitScalarIntegerValue(llvm::Value* robject, Compiler* compiler);
+llvm::Value* emitBoxReal(llvm::Value* value, Compiler* compiler);
+llvm::Value* emitBoxInteger(llvm::Value* value, Compiler* compiler);
+llvm::Value* emitBoxLogical(llvm::Value* value, Compiler* compiler);
+
 // Error handling.
 void emitError(const char* error_msg, llvm::ArrayRef<llvm::Value*> args,
 	       Compiler* compiler);
@@ -24,8 +24,16 @@
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
 
 #include "llvm/Pass.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#if (LLVM_VERSION >= 307)
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/LegacyPassManager.h"
+#else
+#include "llvm/PassManager.h"
+#endif
 
 #include "llvm/Transforms/Utils/Cloning.h"
 
@@ -33,10 +41,14 @@
 
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/TargetSelect.h"
 
+#include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 
 #if (LLVM_VERSION >= 305)
@@ -56,6 +68,12 @@
 #include "llvm/Analysis/Verifier.h"
 #endif
 
+#if (LLVM_VERSION >= 305)
+#include "llvm/IR/DebugInfo.h"
+#else
+#include "llvm/DebugInfo.h"
+#endif
+
 #if (LLVM_VERSION < 306)
 namespace llvm {
 inline
@@ -178,22 +178,52 @@ void rho::AllocationTable::resize(unsigned new_alloctable_bits) {
 void rho::AllocationTable::applyToAllAllocations(
     std::function<void(void*)> fun) const {
   for (int i = 0; i < m_num_buckets; ++i) {
-    Allocation& bucket = m_buckets[i];
-    if (!bucket.isEmpty() && !bucket.isDeleted()) {
-      if (bucket.isFirst()) {
-        if (bucket.isSuperblock()) {
-          // This is a large superblock.
-          AllocatorSuperblock* superblock = bucket.asSuperblock();
-          superblock->applyToBlocks(fun);
-        } else {
+    applyToBucket(i, fun);
+  }
+}
+
+void rho::AllocationTable::applyToBucket(unsigned index,
+    std::function<void(void*)> fun) const {
+  Allocation& bucket = m_buckets[index];
+  if (!bucket.isEmpty() && !bucket.isDeleted()) {
+    if (bucket.isFirst()) {
+      if (bucket.isSuperblock()) {
+        // This is a large superblock.
+        AllocatorSuperblock* superblock = bucket.asSuperblock();
+        superblock->applyToBlocks(fun);
+      } else {
 #ifdef ALLOCATION_CHECK
-          // Extra consistency check.
-          if (!GCNodeAllocator::lookupPointer(bucket.asPointer())) {
-            allocerr("apply to all blocks iterating over non-alloc'd pointer");
-          }
-#endif
-          fun(bucket.asPointer());
+        // Extra consistency check.
+        if (!GCNodeAllocator::lookupPointer(bucket.asPointer())) {
+          allocerr("apply to all blocks iterating over non-alloc'd pointer");
         }
+#endif
+        fun(bucket.asPointer());
+      }
+    }
+  }
+}
+
+unsigned rho::AllocationTable::numUsedBuckets() const {
+  unsigned count = 0;
+  for (int i = 0; i < m_num_buckets; ++i) {
+    if (!m_buckets[i].isEmpty() && !m_buckets[i].isDeleted()) {
+      count += 1;
+    }
+  }
+  return count;
+}
+
+void rho::AllocationTable::applyToEntries(
+    std::function<void(const AllocatorSuperblock*)> superblock_fun,
+    std::function<void(unsigned)> large_fun) const {
+  for (int i = 0; i < m_num_buckets; ++i) {
+    Allocation& bucket = m_buckets[i];
+    if (!bucket.isEmpty() && !bucket.isDeleted() && bucket.isFirst()) {
+      if (bucket.isSuperblock()) {
+        superblock_fun(bucket.asSuperblock());
+      } else {
+        large_fun(bucket.sizeLog2());
       }
     }
   }
@@ -27,12 +27,15 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <vector>
 
 #include "rho/AddressSanitizer.hpp"
 #include "rho/AllocationTable.hpp"
@@ -43,6 +46,9 @@ namespace {
   uintptr_t arena_superblock_start = 0;
   uintptr_t arena_superblock_end = 0;
   uintptr_t arena_superblock_next = 0;
+
+  // Released superblocks in the arena, available for reuse.
+  std::vector<rho::AllocatorSuperblock*> released_superblocks;
 }
 
 void rho::AllocatorSuperblock::allocateArena() {
@@ -63,6 +69,17 @@ void rho::AllocatorSuperblock::allocateArena() {
 
 rho::AllocatorSuperblock* rho::AllocatorSuperblock::newSuperblockFromArena(
     unsigned block_size) {
+  unsigned superblock_size =
+      (s_small_superblock_size - s_superblock_header_size) / block_size;
+  unsigned bitset_entries = (superblock_size + 63) / 64;
+  if (!released_superblocks.empty()) {
+    // Reuse a released superblock.  Its blocks are still poisoned, and are
+    // paged back in as they are touched.
+    void* pointer = released_superblocks.back();
+    released_superblocks.pop_back();
+    return new (pointer)AllocatorSuperblock(
+        sizeClassFromBlockSize(block_size), bitset_entries);
+  }
   if (arena_superblock_next >= arena_superblock_end) {
     return nullptr;
   }
@@ -70,16 +87,48 @@ rho::AllocatorSuperblock* rho::AllocatorSuperblock::newSuperblockFromArena(
   // The whole arena is poisoned on allocation, now we just unpoison this
   // superblock header.
   ASAN_UNPOISON_MEMORY_REGION(pointer, s_superblock_header_size);
-  unsigned superblock_size =
-      (s_small_superblock_size - s_superblock_header_size) / block_size;
-  unsigned bitset_entries = (superblock_size + 63) / 64;
   AllocatorSuperblock* superblock =
       new (pointer)AllocatorSuperblock(
           sizeClassFromBlockSize(block_size), bitset_entries);
-  arena_superblock_next += s_small_superblock_size;
+  // Other threads may be reading this (to free blocks in older superblocks)
+  // without holding the allocator lock.
+  __atomic_store_n(&arena_superblock_next,
+      arena_superblock_next + s_small_superblock_size, __ATOMIC_RELEASE);
   return superblock;
 }
 
+std::size_t rho::AllocatorSuperblock::release(
+    AllocatorSuperblock* superblock) {
+  assert(superblock->numAllocatedBlocks() == 0);
+  if (superblock->m_size_class >= GCNodeAllocator::s_num_small_pools) {
+    GCNodeAllocator::s_alloctable->erase(
+        reinterpret_cast<uintptr_t>(superblock), s_large_superblock_size_log2);
+    delete[] reinterpret_cast<double*>(superblock);
+    return s_large_superblock_size;
+  }
+  // The header stays in place, so that the arena can still be scanned, and
+  // the pages holding only blocks are discarded.
+  uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = (superblock->firstBlockPointer() + page_size - 1)
+      & ~(page_size - 1);
+  uintptr_t end = superblock->endPointer();
+  std::size_t bytes = 0;
+  if (start < end
+      && madvise(reinterpret_cast<void*>(start), end - start,
+                 MADV_DONTNEED) == 0) {
+    bytes = end - start;
+  }
+  ASAN_POISON_MEMORY_REGION(reinterpret_cast<void*>(
+      superblock->firstBlockPointer()), end - superblock->firstBlockPointer());
+  superblock->m_next_untouched = s_released;
+  released_superblocks.push_back(superblock);
+  return bytes;
+}
+
+unsigned rho::AllocatorSuperblock::numReleasedArenaSuperblocks() {
+  return released_superblocks.size();
+}
+
 rho::AllocatorSuperblock* rho::AllocatorSuperblock::newLargeSuperblock(
     unsigned size_log2) {
   void* memory = new double[s_large_superblock_size / sizeof(double)];
@@ -99,7 +148,8 @@ rho::AllocatorSuperblock* rho::AllocatorSuperblock::newLargeSuperblock(
 
 rho::AllocatorSuperblock* rho::AllocatorSuperblock::arenaSuperblockFromPointer(
     uintptr_t candidate) {
-  if (candidate >= arena_superblock_start && candidate < arena_superblock_next) {
+  if (candidate >= arena_superblock_start
+      && candidate < __atomic_load_n(&arena_superblock_next, __ATOMIC_ACQUIRE)) {
     if ((candidate & (s_small_superblock_size - 1)) < s_superblock_header_size) {
       // The pointer points inside the superblock header.
       return nullptr;
@@ -132,44 +182,19 @@ void* rho::AllocatorSuperblock::lookupBlock(uintptr_t candidate) const {
   }
 }
 
-void* rho::AllocatorSuperblock::allocateBlock(size_t block_size) {
-  assert(block_size >= 32 && block_size <= 256
-      && "Only use allocateBlock() to allocate objects between "
-         "32 and 256 bytes.");
-  assert((block_size & 7) == 0
-      && "The size argument must be a multiple of 8 bytes");
-
-  unsigned size_class = sizeClassFromBlockSize(block_size);
-  AllocatorSuperblock* superblock;
-  if (GCNodeAllocator::s_superblocks[size_class]) {
-    superblock = GCNodeAllocator::s_superblocks[size_class];
-  } else {
-    superblock = newSuperblockFromArena(block_size);
-    if (!superblock) {
-      return nullptr;
-    }
-    GCNodeAllocator::s_superblocks[size_class] = superblock;
-  }
-  return superblock->allocateNextUntouched();
-}
-
 void* rho::AllocatorSuperblock::allocateNextUntouched() {
+  assert(hasUntouchedBlocks());
   unsigned block_size = blockSize();
-  unsigned num_blocks =
-      (superblockSize() - s_superblock_header_size) / block_size;
   uint32_t index = m_next_untouched;
   tagBlockAllocated(index);
   m_next_untouched += 1;
-  if (m_next_untouched == num_blocks) {
-    GCNodeAllocator::s_superblocks[m_size_class] = nullptr;
-  }
   void* result = reinterpret_cast<void*>(
       firstBlockPointer() + (index * block_size));
   ASAN_UNPOISON_MEMORY_REGION(result, block_size);
   return result;
 }
 
-void rho::AllocatorSuperblock::freeBlock(void* pointer) {
+rho::FreeListNode* rho::AllocatorSuperblock::freeBlock(void* pointer) {
   uintptr_t block = reinterpret_cast<uintptr_t>(pointer);
   uintptr_t first_block = firstBlockPointer();
   unsigned index = (block - first_block) / blockSize();
@@ -177,9 +202,8 @@ void rho::AllocatorSuperblock::freeBlock(void* pointer) {
   // Mark the block as not allocated.
   tagBlockUnallocated(index);
 
-  // Use the block as a free list node and prepend to the free list.
-  FreeListNode* free_node = new (pointer)FreeListNode(this, index);
-  GCNodeAllocator::addToFreelist(free_node, m_size_class);
+  // Use the block as a free list node.
+  return new (pointer)FreeListNode(this, index);
 }
 
 void* rho::AllocatorSuperblock::allocateLarge(unsigned size_log2) {
@@ -197,17 +221,25 @@ void* rho::AllocatorSuperblock::allocateLarge(unsigned size_log2) {
     superblock = newLargeSuperblock(size_log2);
     GCNodeAllocator::s_superblocks[size_class] = superblock;
   }
-  return superblock->allocateNextUntouched();
+  void* result = superblock->allocateNextUntouched();
+  if (!superblock->hasUntouchedBlocks()) {
+    GCNodeAllocator::s_superblocks[size_class] = nullptr;
+  }
+  return result;
 }
 
+// Blocks in the same bitset word can be allocated and freed concurrently by
+// different threads, so the bitset is updated with atomic operations.
 void rho::AllocatorSuperblock::tagBlockAllocated(unsigned block) {
   unsigned bitset = block / 64;
-  m_free[bitset] &= ~(uint64_t{1} << (block & 63));
+  __atomic_fetch_and(&m_free[bitset], ~(uint64_t{1} << (block & 63)),
+      __ATOMIC_RELAXED);
 }
 
 void rho::AllocatorSuperblock::tagBlockUnallocated(unsigned block) {
   unsigned bitset = block / 64;
-  m_free[bitset] |= uint64_t{1} << (block & 63);
+  __atomic_fetch_or(&m_free[bitset], uint64_t{1} << (block & 63),
+      __ATOMIC_RELAXED);
 }
 
 void rho::AllocatorSuperblock::applyToArenaAllocations(
@@ -221,6 +253,18 @@ void rho::AllocatorSuperblock::applyToArenaAllocations(
   }
 }
 
+unsigned rho::AllocatorSuperblock::numArenaSuperblocks() {
+  return (arena_superblock_next - arena_superblock_start)
+      / s_small_superblock_size;
+}
+
+const rho::AllocatorSuperblock* rho::AllocatorSuperblock::arenaSuperblock(
+    unsigned index) {
+  assert(index < numArenaSuperblocks());
+  return reinterpret_cast<const AllocatorSuperblock*>(
+      arena_superblock_start + uintptr_t{index} * s_small_superblock_size);
+}
+
 void rho::AllocatorSuperblock::applyToBlocks(std::function<void(void*)> fun)
     const {
   uintptr_t block = firstBlockPointer();
@@ -248,6 +292,16 @@ void rho::AllocatorSuperblock::applyToBlocks(std::function<void(void*)> fun)
   }
 }
 
+unsigned rho::AllocatorSuperblock::numAllocatedBlocks() const {
+  // Bits past the last block are always set, as if free.
+  unsigned bitset_entries = (numBlocks() + 63) / 64;
+  unsigned count = 0;
+  for (unsigned i = 0; i < bitset_entries; ++i) {
+    count += __builtin_popcountll(~m_free[i]);
+  }
+  return count;
+}
+
 void rho::AllocatorSuperblock::debugPrintSmallSuperblocks() {
   uintptr_t next_superblock = arena_superblock_start;
   while (next_superblock < arena_superblock_next) {
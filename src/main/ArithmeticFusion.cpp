@@ -0,0 +1,345 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file ArithmeticFusion.cpp
+ *
+ * Implementation of class rho::ArithmeticFusion.
+ */
+
+#include "rho/ArithmeticFusion.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "rho/ArgList.hpp"
+#include "rho/BuiltInFunction.hpp"
+#include "rho/Evaluator.hpp"
+#include "rho/Expression.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "rho/ParallelFor.hpp"
+#include "rho/RealVector.hpp"
+#include "rho/Symbol.hpp"
+#include "rho/VectorKernels.hpp"
+
+using namespace rho;
+using namespace rho::VectorOps::Kernels;
+
+bool ArithmeticFusion::s_enabled = false;
+
+namespace {
+    // Number of elements computed at a time.  Each intermediate result
+    // needs a buffer of this many doubles per thread.
+    const std::size_t block_size = 1024;
+
+    enum Operator {NOT_FUSABLE, ADD, SUBTRACT, MULTIPLY, DIVIDE_BY, POWER};
+
+    Operator fusableOperator(const FunctionBase* func)
+    {
+	static const BuiltInFunction* plus
+	    = BuiltInFunction::obtainPrimitive("+");
+	static const BuiltInFunction* minus
+	    = BuiltInFunction::obtainPrimitive("-");
+	static const BuiltInFunction* times
+	    = BuiltInFunction::obtainPrimitive("*");
+	static const BuiltInFunction* divide
+	    = BuiltInFunction::obtainPrimitive("/");
+	static const BuiltInFunction* power
+	    = BuiltInFunction::obtainPrimitive("^");
+	if (func->traced())
+	    return NOT_FUSABLE;
+	if (func == plus)
+	    return ADD;
+	if (func == minus)
+	    return SUBTRACT;
+	if (func == times)
+	    return MULTIPLY;
+	if (func == divide)
+	    return DIVIDE_BY;
+	if (func == power)
+	    return POWER;
+	return NOT_FUSABLE;
+    }
+
+    // Returns the arithmetic operator applied by call, or NOT_FUSABLE
+    // if the call doesn't have exactly two plain arguments.
+    Operator fusableOperator(const Expression* call, const FunctionBase* func)
+    {
+	const PairList* args = call->getArgs();
+	if (!args || !args->tail() || args->tail()->tail())
+	    return NOT_FUSABLE;
+	for (const ConsCell& arg : *args) {
+	    if (arg.tag() || arg.car() == DotsSymbol)
+		return NOT_FUSABLE;
+	}
+	return fusableOperator(func);
+    }
+
+    // One side of an operation in a fused expression.  This is either
+    // the result of an earlier operation or a vector's data, which is
+    // recycled if it is a scalar.
+    struct Source {
+	int operation;
+	const double* data;
+	bool scalar;
+    };
+
+    struct Operation {
+	ArithmeticOp op;
+	Operands operands;
+	Source lhs;
+	Source rhs;
+	// Index of the first operation of the subexpression that this
+	// operation completes.  Its operations are contiguous.
+	std::size_t first;
+    };
+
+    // An evaluated operand: either a value or the (as yet uncomputed)
+    // result of an operation.
+    struct Operand {
+	RObject* value;
+	int operation;
+	R_xlen_t length;
+    };
+
+    class FusedEvaluator {
+    public:
+	explicit FusedEvaluator(Environment* env)
+	    : m_env(env)
+	{}
+
+	Operand evaluateCall(const Expression* call,
+			     const BuiltInFunction* func, Operator oper);
+	RObject* materialize(const Operand& operand);
+    private:
+	Environment* m_env;
+	std::vector<Operation> m_operations;
+	std::vector<GCRoot<>> m_values;  // Protects the leaves.
+	// Left operands of the enclosing calls whose right operands are
+	// being evaluated.
+	std::vector<Operand*> m_pending;
+
+	Operand evaluateArgument(RObject* arg);
+	void materializePending();
+	Operand valueOperand(RObject* value);
+	Operand fuse(ArithmeticOp op, const Operand& lhs, const Operand& rhs);
+	Source source(const Operand& operand) const;
+	static bool isFusable(const Operand& operand);
+    };
+}
+
+Operand FusedEvaluator::evaluateArgument(RObject* arg)
+{
+    if (arg && arg->sexptype() == LANGSXP) {
+	Expression* call = static_cast<Expression*>(arg);
+	FunctionBase* func = call->getFunction(m_env);
+	Operator oper = fusableOperator(call, func);
+	if (oper != NOT_FUSABLE)
+	    return evaluateCall(call, static_cast<BuiltInFunction*>(func),
+				oper);
+	// The call may have side effects, such as modifying a leaf in
+	// place, so compute the operations to its left first.
+	materializePending();
+	return valueOperand(call->evaluateFunctionCall(
+	    func, m_env, ArgList(call->getArgs(), ArgList::RAW)));
+    }
+    return valueOperand(Evaluator::evaluate(arg, m_env));
+}
+
+void FusedEvaluator::materializePending()
+{
+    for (Operand* operand : m_pending) {
+	if (operand->operation >= 0)
+	    *operand = valueOperand(materialize(*operand));
+    }
+}
+
+Operand FusedEvaluator::valueOperand(RObject* value)
+{
+    m_values.push_back(GCRoot<>(value));
+    if (value && value->sexptype() == REALSXP)
+	return Operand{value, -1, XLENGTH(value)};
+    return Operand{value, -1, 0};
+}
+
+bool FusedEvaluator::isFusable(const Operand& operand)
+{
+    if (operand.operation >= 0)
+	return true;
+    RObject* value = operand.value;
+    return value && value->sexptype() == REALSXP && !value->hasAttributes();
+}
+
+Operand FusedEvaluator::evaluateCall(const Expression* call,
+				     const BuiltInFunction* func,
+				     Operator oper)
+{
+    // Evaluate the arguments in order, as ordinary evaluation would.
+    std::size_t num_operations = m_operations.size();
+    const PairList* args = call->getArgs();
+    Operand lhs = evaluateArgument(args->car());
+    m_pending.push_back(&lhs);
+    Operand rhs = evaluateArgument(args->tail()->car());
+    m_pending.pop_back();
+
+    if (isFusable(lhs) && isFusable(rhs)) {
+	R_xlen_t length = std::max(lhs.length, rhs.length);
+	bool conformable = (lhs.length == rhs.length || lhs.length == 1
+			    || rhs.length == 1);
+	if (conformable
+	    && length >= R_xlen_t(ArithmeticFusion::min_length)) {
+	    switch (oper) {
+	    case ADD:
+		return fuse(PLUS, lhs, rhs);
+	    case SUBTRACT:
+		return fuse(MINUS, lhs, rhs);
+	    case MULTIPLY:
+		return fuse(TIMES, lhs, rhs);
+	    case DIVIDE_BY:
+		return fuse(DIVIDE, lhs, rhs);
+	    case POWER:
+		if (rhs.operation < 0 && rhs.length == 1
+		    && lhs.length == length
+		    && *SEXP_downcast<RealVector*>(rhs.value)->begin() == 2.0)
+		    return fuse(SQUARE, lhs, rhs);
+		break;
+	    default:
+		break;
+	    }
+	}
+    }
+
+    // Evaluate this operation as usual.  The operations of any fused
+    // operands are no longer needed once they have been materialized.
+    GCStackRoot<> lhs_value(materialize(lhs));
+    GCStackRoot<> rhs_value(materialize(rhs));
+    m_operations.resize(num_operations);
+    return valueOperand(call->evaluateFunctionCall(
+	func, m_env, ArgList({lhs_value, rhs_value}, ArgList::EVALUATED)));
+}
+
+Source FusedEvaluator::source(const Operand& operand) const
+{
+    if (operand.operation >= 0)
+	return Source{operand.operation, nullptr, false};
+    return Source{-1, SEXP_downcast<RealVector*>(operand.value)->begin(),
+	    operand.length == 1};
+}
+
+Operand FusedEvaluator::fuse(ArithmeticOp op, const Operand& lhs,
+			     const Operand& rhs)
+{
+    Operation operation;
+    operation.op = op;
+    operation.lhs = source(lhs);
+    operation.rhs = (op == SQUARE ? Source{-1, nullptr, false}
+		     : source(rhs));
+    if (operation.lhs.scalar)
+	operation.operands = SCALAR_VECTOR;
+    else if (operation.rhs.scalar)
+	operation.operands = VECTOR_SCALAR;
+    else
+	operation.operands = VECTOR_VECTOR;
+    operation.first = m_operations.size();
+    if (lhs.operation >= 0)
+	operation.first = m_operations[lhs.operation].first;
+    if (rhs.operation >= 0)
+	operation.first = std::min(operation.first,
+				   m_operations[rhs.operation].first);
+    m_operations.push_back(operation);
+    return Operand{nullptr, int(m_operations.size() - 1),
+	    std::max(lhs.length, rhs.length)};
+}
+
+RObject* FusedEvaluator::materialize(const Operand& operand)
+{
+    if (operand.operation < 0)
+	return operand.value;
+
+    std::size_t last = operand.operation;
+    std::size_t first = m_operations[last].first;
+    std::size_t n = operand.length;
+    RealVector* result = RealVector::create(n);
+    double* out = result->begin();
+
+    // Every operation but the last writes to a block-sized buffer.
+    std::size_t num_buffers = last - first;
+    unsigned int num_ranges = ParallelFor::numRanges(n);
+    std::vector<std::vector<double>> buffers(
+	num_ranges, std::vector<double>(num_buffers*block_size));
+
+    const Operation* operations = m_operations.data();
+    ParallelFor::run(n, num_ranges,
+		     [&](unsigned int range, std::size_t begin,
+			 std::size_t end) {
+	double* buffer = buffers[range].data();
+	auto data = [&](const Source& source, std::size_t offset) {
+	    if (source.operation >= 0)
+		return const_cast<const double*>(
+		    buffer + (source.operation - first)*block_size);
+	    if (source.data && !source.scalar)
+		return source.data + offset;
+	    return source.data;
+	};
+	for (std::size_t offset = begin; offset < end; offset += block_size) {
+	    std::size_t length = std::min(block_size, end - offset);
+	    for (std::size_t i = first; i <= last; ++i) {
+		const Operation& operation = operations[i];
+		double* dest = (i == last ? out + offset
+				: buffer + (i - first)*block_size);
+		realArithmetic(operation.op, operation.operands, dest,
+			       data(operation.lhs, offset),
+			       data(operation.rhs, offset), length);
+	    }
+	}
+    });
+    return result;
+}
+
+bool ArithmeticFusion::canFuse(const Expression* call,
+			       const FunctionBase* func)
+{
+    if (func->sexptype() != BUILTINSXP
+	|| fusableOperator(call, func) == NOT_FUSABLE)
+	return false;
+    for (const ConsCell& arg : *call->getArgs()) {
+	if (arg.car() && arg.car()->sexptype() == LANGSXP)
+	    return true;
+    }
+    return false;
+}
+
+RObject* ArithmeticFusion::evaluate(const Expression* call,
+				    const BuiltInFunction* func,
+				    Environment* env)
+{
+    FusedEvaluator evaluator(env);
+    Operand operand = evaluator.evaluateCall(call, func,
+					     fusableOperator(func));
+    if (operand.operation < 0)
+	return operand.value;
+    RObject* result = evaluator.materialize(operand);
+    Evaluator::enableResultPrinting(
+	func->printHandling() != BuiltInFunction::FORCE_OFF);
+    return result;
+}
@@ -0,0 +1,467 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file ChunkedFile.cpp
+ *
+ * @brief Implementation of class ChunkedFile and its nested classes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "rho/ChunkedFile.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <zlib.h>
+
+/* As in connections.cpp: use 64-bit file offsets where 'long' may be
+   too small. */
+#ifdef Win32
+# define f_seek fseeko64
+# define f_tell ftello64
+# define OFF_T off64_t
+#elif defined(HAVE_OFF_T) && defined(HAVE_FSEEKO)
+# define f_seek fseeko
+# define f_tell ftello
+# define OFF_T off_t
+#else
+# define f_seek fseek
+# define f_tell ftell
+# define OFF_T long
+#endif
+
+using namespace rho;
+
+namespace {
+    const unsigned char magic[ChunkedFile::magic_size]
+	= {'R', 'Z', 'C', '1', '\n'};
+    const unsigned char end_marker[8]
+	= {'R', 'Z', 'C', 'I', 'N', 'D', 'E', 'X'};
+    const unsigned char zlib_codec = 1;
+    const std::size_t index_entry_size = 16;
+
+    void putUInt(std::vector<unsigned char>* out, std::uint64_t value,
+		 unsigned int num_bytes)
+    {
+	for (unsigned int i = 0; i < num_bytes; ++i)
+	    out->push_back(static_cast<unsigned char>(value >> (8*i)));
+    }
+
+    std::uint64_t getUInt(const unsigned char* in, unsigned int num_bytes)
+    {
+	std::uint64_t value = 0;
+	for (unsigned int i = 0; i < num_bytes; ++i)
+	    value |= std::uint64_t(in[i]) << (8*i);
+	return value;
+    }
+
+    unsigned int defaultNumThreads()
+    {
+	unsigned int num_threads = std::thread::hardware_concurrency();
+	return num_threads ? num_threads : 1;
+    }
+}
+
+unsigned int ChunkedFile::s_num_threads = defaultNumThreads();
+
+bool ChunkedFile::hasMagic(const void* header, std::size_t length)
+{
+    return length >= magic_size && std::memcmp(header, magic, magic_size) == 0;
+}
+
+// ***** Class ChunkedFile::Job *****
+
+// Compression or decompression of one chunk.  A Job only touches its own
+// buffers, so it can be run on any thread.
+class ChunkedFile::Job {
+public:
+    enum Kind {COMPRESS, DECOMPRESS};
+
+    // 'size' is the number of uncompressed bytes in the chunk.
+    Job(Kind kind, int level, std::size_t size)
+	: m_kind(kind), m_level(level), m_size(size), m_done(false),
+	  m_ok(false)
+    {}
+
+    Kind m_kind;
+    int m_level;
+    std::size_t m_size;
+    std::vector<unsigned char> m_input;
+    std::vector<unsigned char> m_output;
+    // Set once the job has been run; guarded by the WorkerPool's mutex.
+    bool m_done;
+    bool m_ok;
+
+    void run();
+};
+
+void ChunkedFile::Job::run()
+{
+    if (m_kind == COMPRESS) {
+	uLongf length = compressBound(uLong(m_input.size()));
+	m_output.resize(length);
+	m_ok = (compress2(m_output.data(), &length, m_input.data(),
+			  uLong(m_input.size()), m_level) == Z_OK);
+	m_output.resize(length);
+    } else {
+	uLongf length = uLongf(m_size);
+	m_output.resize(m_size);
+	m_ok = (uncompress(m_output.data(), &length, m_input.data(),
+			   uLong(m_input.size())) == Z_OK
+		&& length == m_size);
+    }
+    std::vector<unsigned char>().swap(m_input);
+}
+
+// ***** Class ChunkedFile::WorkerPool *****
+
+// Threads that run Jobs in the order they are submitted.  With no threads,
+// Jobs are run as they are submitted.
+class ChunkedFile::WorkerPool {
+public:
+    explicit WorkerPool(unsigned int num_threads)
+	: m_stopping(false)
+    {
+	// If threads can't be created, make do with those that were.
+	try {
+	    for (unsigned int i = 0; i < num_threads; ++i)
+		m_threads.emplace_back(&WorkerPool::work, this);
+	} catch (const std::system_error&) {
+	}
+    }
+
+    ~WorkerPool()
+    {
+	{
+	    std::lock_guard<std::mutex> lock(m_mutex);
+	    m_stopping = true;
+	}
+	m_work_available.notify_all();
+	for (std::thread& thread : m_threads)
+	    thread.join();
+    }
+
+    std::size_t size() const
+    {
+	return m_threads.size();
+    }
+
+    void submit(std::shared_ptr<Job> job)
+    {
+	if (m_threads.empty()) {
+	    job->run();
+	    job->m_done = true;
+	    return;
+	}
+	{
+	    std::lock_guard<std::mutex> lock(m_mutex);
+	    m_pending.push_back(std::move(job));
+	}
+	m_work_available.notify_one();
+    }
+
+    void wait(const Job& job)
+    {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_job_done.wait(lock, [&job] { return job.m_done; });
+    }
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_work_available;
+    std::condition_variable m_job_done;
+    std::deque<std::shared_ptr<Job>> m_pending;
+    std::vector<std::thread> m_threads;
+    bool m_stopping;
+
+    void work();
+};
+
+void ChunkedFile::WorkerPool::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+	m_work_available.wait(lock, [this] {
+		return m_stopping || !m_pending.empty();
+	    });
+	if (m_stopping)
+	    return;
+	std::shared_ptr<Job> job = std::move(m_pending.front());
+	m_pending.pop_front();
+	lock.unlock();
+	job->run();
+	lock.lock();
+	job->m_done = true;
+	m_job_done.notify_all();
+    }
+}
+
+// ***** Class ChunkedFile::Writer *****
+
+ChunkedFile::Writer::Writer(std::FILE* fp, int level, std::size_t chunk_size)
+    : m_fp(fp), m_level(level), m_chunk_size(chunk_size), m_position(0),
+      m_file_offset(0), m_failed(false), m_finished(false),
+      m_pool(new WorkerPool(s_num_threads))
+{
+    m_pending.reserve(m_chunk_size);
+    std::vector<unsigned char> header(magic, magic + magic_size);
+    header.push_back(zlib_codec);
+    putUInt(&header, 0, 2);
+    putUInt(&header, m_chunk_size, 4);
+    writeBytes(header.data(), header.size());
+}
+
+ChunkedFile::Writer::~Writer()
+{
+}
+
+bool ChunkedFile::Writer::finish()
+{
+    if (m_finished)
+	return !m_failed;
+    m_finished = true;
+    if (!m_pending.empty())
+	submitPending();
+    while (!m_in_progress.empty())
+	writeOldest();
+    std::uint64_t index_offset = m_file_offset;
+    std::vector<unsigned char> trailer;
+    putUInt(&trailer, index_offset, 8);
+    putUInt(&trailer, m_index.size()/index_entry_size, 8);
+    trailer.insert(trailer.end(), end_marker, end_marker + sizeof(end_marker));
+    writeBytes(m_index.data(), m_index.size());
+    writeBytes(trailer.data(), trailer.size());
+    if (!m_failed && std::fflush(m_fp) != 0)
+	m_failed = true;
+    return !m_failed;
+}
+
+void ChunkedFile::Writer::submitPending()
+{
+    std::shared_ptr<Job> job
+	= std::make_shared<Job>(Job::COMPRESS, m_level, m_pending.size());
+    job->m_input.swap(m_pending);
+    m_pending.reserve(m_chunk_size);
+    m_pool->submit(job);
+    m_in_progress.push_back(std::move(job));
+    // Keep every thread busy, with one chunk queued behind each.
+    std::size_t max_in_progress = 2*std::max<std::size_t>(m_pool->size(), 1);
+    while (m_in_progress.size() > max_in_progress)
+	writeOldest();
+}
+
+bool ChunkedFile::Writer::write(const void* data, std::size_t length)
+{
+    if (m_failed || m_finished)
+	return false;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    while (length > 0) {
+	std::size_t n = std::min(length, m_chunk_size - m_pending.size());
+	m_pending.insert(m_pending.end(), p, p + n);
+	p += n;
+	length -= n;
+	m_position += n;
+	if (m_pending.size() == m_chunk_size)
+	    submitPending();
+    }
+    return !m_failed;
+}
+
+bool ChunkedFile::Writer::writeBytes(const void* data, std::size_t length)
+{
+    if (m_failed)
+	return false;
+    if (length != 0 && std::fwrite(data, 1, length, m_fp) != length) {
+	m_failed = true;
+	return false;
+    }
+    m_file_offset += length;
+    return true;
+}
+
+void ChunkedFile::Writer::writeOldest()
+{
+    std::shared_ptr<Job> job = std::move(m_in_progress.front());
+    m_in_progress.pop_front();
+    if (m_failed)
+	return;
+    m_pool->wait(*job);
+    if (!job->m_ok) {
+	m_failed = true;
+	return;
+    }
+    std::uint64_t offset = m_file_offset;
+    if (!writeBytes(job->m_output.data(), job->m_output.size()))
+	return;
+    putUInt(&m_index, offset, 8);
+    putUInt(&m_index, job->m_output.size(), 4);
+    putUInt(&m_index, job->m_size, 4);
+}
+
+// ***** Class ChunkedFile::Reader *****
+
+ChunkedFile::Reader::Reader(std::FILE* fp)
+    : m_fp(fp), m_chunk_size(0), m_chunk_starts(1, 0), m_position(0),
+      m_failed(false)
+{
+    m_failed = !readIndex();
+    m_current_chunk = m_chunks.size();
+    m_pool.reset(new WorkerPool(m_failed ? 0 : s_num_threads));
+}
+
+ChunkedFile::Reader::~Reader()
+{
+}
+
+bool ChunkedFile::Reader::load(std::size_t chunk)
+{
+    std::size_t read_ahead = m_pool->size();
+    // Forget chunks read ahead that are no longer wanted.  Any still
+    // being decompressed are freed when their thread finishes with them.
+    for (auto it = m_read_ahead.begin(); it != m_read_ahead.end(); ) {
+	if (it->first < chunk || it->first > chunk + read_ahead)
+	    it = m_read_ahead.erase(it);
+	else
+	    ++it;
+    }
+    std::shared_ptr<Job> job;
+    auto found = m_read_ahead.find(chunk);
+    if (found != m_read_ahead.end()) {
+	job = std::move(found->second);
+	m_read_ahead.erase(found);
+    } else
+	job = submit(chunk);
+    if (!job)
+	return false;
+    for (std::size_t next = chunk + 1;
+	 next <= chunk + read_ahead && next < m_chunks.size(); ++next) {
+	if (m_read_ahead.count(next) == 0) {
+	    std::shared_ptr<Job> ahead = submit(next);
+	    if (!ahead)
+		break;
+	    m_read_ahead[next] = std::move(ahead);
+	}
+    }
+    m_pool->wait(*job);
+    if (!job->m_ok)
+	return false;
+    m_current.swap(job->m_output);
+    m_current_chunk = chunk;
+    return true;
+}
+
+std::size_t ChunkedFile::Reader::read(void* buffer, std::size_t length)
+{
+    unsigned char* out = static_cast<unsigned char*>(buffer);
+    std::size_t num_read = 0;
+    while (num_read < length && !m_failed && m_position < size()) {
+	std::size_t chunk = m_current_chunk;
+	if (chunk == m_chunks.size() || m_position < m_chunk_starts[chunk]
+	    || m_position >= m_chunk_starts[chunk + 1]) {
+	    chunk = std::upper_bound(m_chunk_starts.begin(),
+				     m_chunk_starts.end(), m_position)
+		- m_chunk_starts.begin() - 1;
+	    if (!load(chunk)) {
+		m_failed = true;
+		break;
+	    }
+	}
+	std::size_t offset = std::size_t(m_position - m_chunk_starts[chunk]);
+	std::size_t n = std::min(length - num_read, m_current.size() - offset);
+	std::memcpy(out + num_read, m_current.data() + offset, n);
+	num_read += n;
+	m_position += n;
+    }
+    return num_read;
+}
+
+bool ChunkedFile::Reader::readIndex()
+{
+    if (f_seek(m_fp, 0, SEEK_END) != 0)
+	return false;
+    OFF_T file_size = f_tell(m_fp);
+    if (file_size < OFF_T(header_size + trailer_size))
+	return false;
+    unsigned char header[header_size];
+    if (f_seek(m_fp, 0, SEEK_SET) != 0
+	|| std::fread(header, 1, header_size, m_fp) != header_size
+	|| !hasMagic(header, header_size) || header[magic_size] != zlib_codec)
+	return false;
+    m_chunk_size = std::size_t(getUInt(header + 8, 4));
+    if (m_chunk_size == 0)
+	return false;
+
+    unsigned char trailer[trailer_size];
+    std::uint64_t index_end = std::uint64_t(file_size) - trailer_size;
+    if (f_seek(m_fp, OFF_T(index_end), SEEK_SET) != 0
+	|| std::fread(trailer, 1, trailer_size, m_fp) != trailer_size
+	|| std::memcmp(trailer + 16, end_marker, sizeof(end_marker)) != 0)
+	return false;
+    std::uint64_t index_offset = getUInt(trailer, 8);
+    std::uint64_t num_chunks = getUInt(trailer + 8, 8);
+    if (index_offset < header_size || index_offset > index_end
+	|| (index_end - index_offset) % index_entry_size != 0
+	|| (index_end - index_offset)/index_entry_size != num_chunks)
+	return false;
+
+    std::vector<unsigned char> index(std::size_t(index_end - index_offset));
+    if (f_seek(m_fp, OFF_T(index_offset), SEEK_SET) != 0
+	|| std::fread(index.data(), 1, index.size(), m_fp) != index.size())
+	return false;
+    m_chunks.reserve(num_chunks);
+    m_chunk_starts.reserve(num_chunks + 1);
+    for (const unsigned char* entry = index.data();
+	 entry != index.data() + index.size(); entry += index_entry_size) {
+	Chunk chunk;
+	chunk.offset = getUInt(entry, 8);
+	chunk.compressed_size = std::uint32_t(getUInt(entry + 8, 4));
+	chunk.size = std::uint32_t(getUInt(entry + 12, 4));
+	if (chunk.size == 0 || chunk.size > m_chunk_size
+	    || chunk.offset < header_size || chunk.offset > index_offset
+	    || chunk.compressed_size > index_offset - chunk.offset)
+	    return false;
+	m_chunks.push_back(chunk);
+	m_chunk_starts.push_back(m_chunk_starts.back() + chunk.size);
+    }
+    return true;
+}
+
+std::shared_ptr<ChunkedFile::Job>
+ChunkedFile::Reader::submit(std::size_t chunk)
+{
+    const Chunk& entry = m_chunks[chunk];
+    std::shared_ptr<Job> job
+	= std::make_shared<Job>(Job::DECOMPRESS, 0, entry.size);
+    job->m_input.resize(entry.compressed_size);
+    if (f_seek(m_fp, OFF_T(entry.offset), SEEK_SET) != 0
+	|| std::fread(job->m_input.data(), 1, job->m_input.size(), m_fp)
+	   != job->m_input.size())
+	return nullptr;
+    m_pool->submit(job);
+    return job;
+}
@@ -43,6 +43,7 @@
 #include "rho/ReturnBailout.hpp"
 #include "rho/ReturnException.hpp"
 #include "rho/errors.hpp"
+#include "rho/jit/CompilationException.hpp"
 #include "rho/jit/CompiledExpression.hpp"
 
 using namespace std;
@@ -67,7 +68,7 @@ bool Closure::s_debugging_enabled = true;
 
 Closure::Closure(const PairList* formal_args, RObject* body, Environment* env)
     : FunctionBase(CLOSXP), m_debug(false),
-      m_num_invokes(0)
+      m_num_invokes(0), m_num_back_edges(0)
 {
     m_matcher = new ArgMatcher(formal_args);
     m_body = body;
@@ -91,6 +92,11 @@ void Closure::detachReferents()
     m_body.detach();
     m_environment.detach();
     m_compiled_body.detach();
+#ifdef ENABLE_LLVM_JIT
+    m_recompiled_body.detach();
+    m_compiled_loops.clear();
+    m_loop_frame_descriptor.detach();
+#endif
     FunctionBase::detachReferents();
 }
 
@@ -103,17 +109,11 @@ RObject* Closure::execute(Environment* env) const
     try {
 	++m_num_invokes;
 #ifdef ENABLE_LLVM_JIT
-	if (m_compiled_body
-	    && m_compiled_body->hasMatchingFrameLayout(env)) {
+	updateCompiledCode();
+	if (useCompiledCode(env)) {
 	    PlainContext boctxt;
 	    ans = m_compiled_body->evalInEnvironment(env);
 	} else {
-	    if (!m_compiled_body && m_num_invokes == 100) {
-		// Compile the body, but stay in the interpreter because the
-		// frame hasn't been setup for a compiled function.
-		// TODO(kmillar): recompile functions as needed.
-		compile();
-	    }
 #endif
 	    BailoutContext boctxt;
 	    ans = Evaluator::evaluate(m_body, env);
@@ -139,17 +139,162 @@ RObject* Closure::execute(Environment* env) const
 void Closure::compile() const {
 #ifdef ENABLE_LLVM_JIT
     try {
-	m_compiled_body = JIT::CompiledExpression::compileFunctionBody(this);
+	// Use the layout of any frames already created for compiled loops,
+	// so that calls in them can run the compiled body.
+	m_compiled_body = JIT::CompiledExpression::compileFunctionBody(
+	    this, JIT::CompilationTier::BASELINE, m_loop_frame_descriptor);
+	if (!m_compiled_body) {
+	    // The compiler is busy with another function.  Try again on the
+	    // next call.
+	    --m_num_invokes;
+	}
     } catch (...) {
 	// Compilation failed.  Continue on with the interpreter.
     }
 #endif
 }
 
+#ifdef ENABLE_LLVM_JIT
+void Closure::updateCompiledCode() const
+{
+    using JIT::CompilationTier;
+    using JIT::CompiledExpression;
+
+    if (!m_compiled_body) {
+	if (unsigned(m_num_invokes) == CompiledExpression::compileThreshold()) {
+	    // Start compiling the body, but stay in the interpreter because
+	    // the frame hasn't been setup for a compiled function.  The
+	    // machine code is generated in the background, and used by the
+	    // first call after it is ready.
+	    compile();
+	}
+	return;
+    }
+    if (m_compiled_body->failed()) {
+	m_compiled_body = nullptr;
+	return;
+    }
+
+    if (m_recompiled_body) {
+	if (m_recompiled_body->isReady()) {
+	    m_compiled_body = m_recompiled_body;
+	    m_recompiled_body = nullptr;
+	}
+	return;
+    }
+    if (m_compiled_body->tier() != CompilationTier::BASELINE
+	|| !m_compiled_body->isReady())
+	return;
+    unsigned int call_threshold = CompiledExpression::optimizeThreshold();
+    unsigned int back_edge_threshold
+	= CompiledExpression::optimizeBackEdgeThreshold();
+    bool hot = (call_threshold != 0
+		&& unsigned(m_num_invokes) >= call_threshold)
+	|| (back_edge_threshold != 0
+	    && m_num_back_edges >= back_edge_threshold);
+    if (!hot)
+	return;
+    // The optimized code uses the same frame layout, so that calls that
+    // are already running aren't affected when it is installed.  If the
+    // compiler is busy this leaves m_recompiled_body null, so it is tried
+    // again on the next call.
+    try {
+	m_recompiled_body = CompiledExpression::compileFunctionBody(
+	    this, CompilationTier::OPTIMIZED,
+	    m_compiled_body->frameDescriptor());
+    } catch (...) {
+	// Compilation failed.  Keep using the baseline code, and don't
+	// try again until the closure has been used as much again.
+	m_num_invokes = 0;
+	m_num_back_edges = 0;
+    }
+}
+
+bool Closure::useCompiledCode(Environment* env) const
+{
+    if (!m_compiled_body || !m_compiled_body->isReady())
+	return false;
+    JIT::CompiledExpression::CallStatistics& stats
+	= JIT::CompiledExpression::callStatistics();
+    if (!m_compiled_body->hasMatchingFrameLayout(env)) {
+	// The frame was created before the code was compiled, or has the
+	// layout of some earlier code.  At the start of the call nothing
+	// else refers to the frame, so its bindings can be moved into one
+	// with the right layout.
+	Frame* frame = env->frame();
+	if (!frame || !env->replaceFrame(
+		m_compiled_body->createFrame(frame->promiseArgs()))) {
+	    ++stats.num_interpreted;
+	    return false;
+	}
+	++stats.num_frames_replaced;
+    }
+    ++stats.num_compiled;
+    return true;
+}
+
+bool Closure::continueLoopInCompiledCode(const Expression* loop,
+					 Environment* env) const
+{
+    Frame* frame = env->frame();
+    if (!frame)
+	return false;
+    const FrameDescriptor* frame_descriptor = frame->getDescriptor();
+    if (!frame_descriptor) {
+	// Interpreted calls have frames without a layout.  Moving the
+	// bindings into a frame with one would leave dangling any
+	// Frame::Binding pointers that callers hold, such as the one for
+	// *tmp* in applydefine().  Instead give later calls frames that
+	// the compiled loop can run in.
+	if (!m_compiled_body && !m_loop_frame_descriptor)
+	    m_loop_frame_descriptor = new FrameDescriptor(this);
+	return false;
+    }
+
+    // Find or compile the loop.  The same loop may have been compiled
+    // for frames with other layouts.
+    const CompiledLoop* compiled_loop = nullptr;
+    for (const CompiledLoop& entry : m_compiled_loops) {
+	if (entry.loop == loop && entry.frame_descriptor == frame_descriptor) {
+	    compiled_loop = &entry;
+	    break;
+	}
+    }
+    if (!compiled_loop) {
+	CompiledLoop entry;
+	entry.loop = loop;
+	entry.frame_descriptor = frame_descriptor;
+	try {
+	    entry.code = JIT::CompiledExpression::compileLoop(
+		this, loop, frame_descriptor);
+	    if (!entry.code) {
+		// The compiler is busy with another function.  Leave this
+		// loop in the interpreter without giving up on it.
+		return false;
+	    }
+	} catch (const JIT::CompilationException&) {
+	    // The loop uses constructs that the compiler can't handle.
+	    // Don't try again.
+	}
+	m_compiled_loops.push_back(entry);
+	compiled_loop = &m_compiled_loops.back();
+    }
+    const JIT::CompiledExpression* code = compiled_loop->code;
+    if (!code || !code->isReady())
+	return false;
+
+    PlainContext context;
+    code->evalInEnvironment(env);
+    return true;
+}
+#endif
+
 Environment* Closure::createExecutionEnv(const ArgList& arglist) const {
     Frame* frame =
 #ifdef ENABLE_LLVM_JIT
         m_compiled_body ? m_compiled_body->createFrame(arglist):
+        m_loop_frame_descriptor
+	? Frame::closureWorkingFrame(m_loop_frame_descriptor, arglist):
 #endif
         Frame::closureWorkingFrame(arglist);
     return new Environment(environment(), frame);
@@ -177,7 +322,13 @@ void Closure::setBody(RObject* body) {
 
 void Closure::invalidateCompiledCode() {
     m_num_invokes = 0;
+    m_num_back_edges = 0;
     m_compiled_body = nullptr;
+#ifdef ENABLE_LLVM_JIT
+    m_recompiled_body = nullptr;
+    m_compiled_loops.clear();
+    m_loop_frame_descriptor = nullptr;
+#endif
 }
 
 void Closure::visitReferents(const_visitor* v) const
@@ -196,6 +347,24 @@ void Closure::visitReferents(const_visitor* v) const
 	(*v)(environment);
     if (compiled_body)
 	(*v)(compiled_body);
+#ifdef ENABLE_LLVM_JIT
+    const GCNode* recompiled_body = m_recompiled_body;
+    if (recompiled_body)
+	(*v)(recompiled_body);
+    for (const CompiledLoop& entry : m_compiled_loops) {
+	const GCNode* loop = entry.loop;
+	const GCNode* code = entry.code;
+	const GCNode* frame_descriptor = entry.frame_descriptor;
+	(*v)(loop);
+	if (code)
+	    (*v)(code);
+	if (frame_descriptor)
+	    (*v)(frame_descriptor);
+    }
+    const GCNode* loop_frame_descriptor = m_loop_frame_descriptor;
+    if (loop_frame_descriptor)
+	(*v)(loop_frame_descriptor);
+#endif
 }
 
 void SET_FORMALS(SEXP closure, SEXP formals) {
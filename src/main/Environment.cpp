@@ -158,9 +158,12 @@ Frame::Binding* Environment::findBinding(const Symbol* symbol)
 
 // Environment::findPackage() is in envir.cpp
 
+unsigned int Environment::s_search_path_generation = 0;
+
 void Environment::flushFromSearchPathCache(const Symbol* sym)
 {
     Cache* search_path_cache = searchPathCache();
+    ++s_search_path_generation;
 
     if (sym)
 	search_path_cache->erase(sym);
@@ -247,6 +250,15 @@ void Environment::setOnSearchPath(bool status) {
     }
 }
 
+bool Environment::replaceFrame(Frame* frame)
+{
+    if (!m_frame || m_frame->isLocked() || m_on_search_path)
+	return false;
+    frame->importBindings(m_frame, true);
+    m_frame = frame;
+    return true;
+}
+
 // Environment::namespaceSpec() is in envir.cpp
 
 const char* Environment::package_s11n_aux(const StringVector* pkg_name)
@@ -268,6 +280,7 @@ unsigned int Environment::packGPBits() const
 void  Environment::setEnclosingEnvironment(Environment* new_enclos)
 {
     m_enclosing = new_enclos;
+    ++s_search_path_generation;
     // Recursively propagate participation in search list cache:
     if (m_on_search_path) {
 	Environment* env = m_enclosing;
@@ -295,6 +308,7 @@ Environment* Environment::attachToSearchPath(int pos, StringVector* name)
     // Insert the new environment after where.
     new_env->m_enclosing = where->m_enclosing;
     where->m_enclosing = new_env;
+    ++s_search_path_generation;
     new_env->setOnSearchPath(true);
 
     return new_env;
@@ -319,6 +333,7 @@ Environment* Environment::detachFromSearchPath(int pos) {
     // Detach the environment after where.
     where->m_enclosing = env_to_detach->m_enclosing;
     env_to_detach->m_enclosing = nullptr;
+    ++s_search_path_generation;
     env_to_detach->setOnSearchPath(false);
 
     return env_to_detach;
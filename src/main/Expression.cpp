@@ -37,6 +37,7 @@
 #include "localization.h"
 #include "rho/ArgList.hpp"
 #include "rho/ArgMatcher.hpp"
+#include "rho/ArithmeticFusion.hpp"
 #include "rho/BuiltInFunction.hpp"
 #include "rho/Closure.hpp"
 #include "rho/ClosureContext.hpp"
@@ -105,6 +106,11 @@ RObject* Expression::evaluate(Environment* env)
 {
     FunctionBase* function = getFunction(env);
 
+    if (ArithmeticFusion::isEnabled()
+	&& ArithmeticFusion::canFuse(this, function))
+	return ArithmeticFusion::evaluate(
+	    this, static_cast<BuiltInFunction*>(function), env);
+
     ArgList arglist(tail(), ArgList::RAW);
     return evaluateFunctionCall(function, env, arglist);
 }
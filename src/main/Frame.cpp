@@ -137,7 +137,8 @@ Frame::Frame(const ArgList& promised_args, size_t num_bindings,
 	     bool check_list_size)
     : m_descriptor(), m_bindings_size(0), m_used_bindings_size(0),
       m_cache_count(0), m_locked(false), m_no_special_symbols(true),
-      m_read_monitored(false), m_write_monitored(false), m_overflow(nullptr),
+      m_read_monitored(false), m_write_monitored(false),
+      m_reports_status_changes(false), m_overflow(nullptr),
       m_promised_args(promised_args)
 {
     m_promised_args_protect = m_promised_args.list();
@@ -166,7 +167,8 @@ Frame::Frame(const Frame& source)
     : m_descriptor(source.m_descriptor), m_bindings_size(source.m_bindings_size),
       m_used_bindings_size(0), m_cache_count(0), m_locked(source.m_locked),
       m_no_special_symbols(source.m_no_special_symbols),
-      m_read_monitored(false), m_write_monitored(false), m_overflow(nullptr),
+      m_read_monitored(false), m_write_monitored(false),
+      m_reports_status_changes(false), m_overflow(nullptr),
       m_promised_args(source.m_promised_args)
 {
     m_promised_args_protect = m_promised_args.list();
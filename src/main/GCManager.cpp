@@ -31,6 +31,8 @@
 
 #include "rho/GCManager.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdarg>
 #include <iomanip>
 #include <iostream>
@@ -38,6 +40,7 @@
 #include "Defn.h"
 #include "R_ext/Print.h"
 #include "rho/GCNode.hpp"
+#include "rho/GCNodeAllocator.hpp"
 #include "rho/WeakRef.hpp"
 
 using namespace rho;
@@ -47,6 +50,15 @@ unsigned int GCManager::s_inhibitor_count = 0;
 size_t GCManager::s_threshold = R_VSIZE;
 size_t GCManager::s_min_threshold = s_threshold;
 size_t GCManager::s_gclite_threshold = s_threshold;
+unsigned int GCManager::s_full_gc_interval = 8;
+unsigned int GCManager::s_young_gcs_since_full = 0;
+unsigned int GCManager::s_mark_sweep_threads = 1;
+std::unique_ptr<GCManager::ThresholdPolicy> GCManager::s_threshold_policy;
+double GCManager::s_target_pause = 0;
+double GCManager::s_heap_overhead = 0.2;
+double GCManager::s_release_delay = 10;
+GCManager::PauseStatistics
+GCManager::s_pause_stats[GCManager::NUM_COLLECTION_KINDS];
 bool GCManager::s_gc_is_running = false;
 bool GCManager::s_gc_pending = false;
 size_t GCManager::s_max_bytes = 0;
@@ -77,6 +89,32 @@ namespace {
 #endif /* DEBUG_GC */
 }
 
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    // Record a collection that started at the given time, and return
+    // its duration in seconds.
+    double recordPause(GCManager::PauseStatistics* stats,
+		       Clock::time_point start)
+    {
+	typedef GCManager::PauseStatistics Stats;
+	double seconds
+	    = std::chrono::duration<double>(Clock::now() - start).count();
+	++stats->count;
+	stats->total_seconds += seconds;
+	stats->max_seconds = std::max(stats->max_seconds, seconds);
+	unsigned int bucket = 0;
+	while (bucket + 1 < Stats::s_num_buckets
+	       && seconds >= Stats::bucketLimit(bucket))
+	    ++bucket;
+	++stats->histogram[bucket];
+	return seconds;
+    }
+
+    // When GCNodeAllocator::releaseEmptySuperblocks() was last called.
+    Clock::time_point last_release_scan;
+}
+
 void GCManager::gc(bool force_full_collection)
 {
     if (s_inhibitor_count > 0) {
@@ -96,24 +134,94 @@ void GCManager::gc(bool force_full_collection)
 
     if (s_pre_gc) (*s_pre_gc)();
 
+    Clock::time_point start = Clock::now();
     GCNode::gc(false);
+    recordPause(&s_pause_stats[GCLITE], start);
 
     if (force_full_collection || MemoryBank::bytesAllocated() > s_threshold) {
-	GCNode::gc(true);
-	s_threshold = std::max(size_t(0.8*double(s_threshold)),
-			       std::max(s_min_threshold,
-					size_t(1.2*MemoryBank::bytesAllocated())));
+	CollectionOutcome outcome;
+	outcome.bytes_before = MemoryBank::bytesAllocated();
+	outcome.threshold = s_threshold;
+	outcome.min_threshold = s_min_threshold;
+	outcome.full = (force_full_collection
+			|| s_young_gcs_since_full + 1 >= s_full_gc_interval);
+	start = Clock::now();
+	if (outcome.full) {
+	    GCNode::gc(true);
+	    s_young_gcs_since_full = 0;
+	    outcome.pause_seconds = recordPause(&s_pause_stats[MARK_SWEEP],
+						start);
+	} else {
+	    GCNode::gcYoung();
+	    ++s_young_gcs_since_full;
+	    outcome.pause_seconds = recordPause(&s_pause_stats[YOUNG], start);
+	}
+	outcome.bytes_after = MemoryBank::bytesAllocated();
+	size_t threshold = (s_threshold_policy
+			    ? (*s_threshold_policy)(outcome)
+			    : FixedGrowthPolicy()(outcome));
+	s_threshold = std::max(s_min_threshold, threshold);
+
+	// A superblock must be found empty by scans spanning the release
+	// delay before it is released, so scanning much more often would
+	// gain little.
+	Clock::time_point now = Clock::now();
+	if (s_release_delay >= 0
+	    && now - last_release_scan
+	       >= std::chrono::duration<double>(0.5*s_release_delay)) {
+	    GCNodeAllocator::releaseEmptySuperblocks(s_release_delay);
+	    last_release_scan = now;
+	}
     }
 
+    // A cycle collection can only be triggered from maybeGC() once
+    // the gclite threshold is reached, so keep that no higher than
+    // the collection threshold.
     s_gclite_threshold = std::max(size_t(0.8*double(s_gclite_threshold)),
 			       std::max(s_min_threshold,
 					size_t(1.2*MemoryBank::bytesAllocated())));
+    s_gclite_threshold = std::min(s_gclite_threshold, s_threshold);
 
     if (s_post_gc) (*s_post_gc)();
 
     s_gc_is_running = false;
 }
 
+size_t GCManager::FixedGrowthPolicy::operator()(
+    const CollectionOutcome& outcome)
+{
+    return std::max(size_t(0.8*double(outcome.threshold)),
+		    size_t((1.0 + s_heap_overhead)*double(outcome.bytes_after)));
+}
+
+size_t GCManager::AdaptivePolicy::operator()(
+    const CollectionOutcome& outcome)
+{
+    double survival = (outcome.bytes_before == 0 ? 0.0
+		       : double(outcome.bytes_after)/outcome.bytes_before);
+    // A collection that frees little was mostly wasted work, so leave
+    // more room before the next one.
+    double headroom = s_heap_overhead*double(outcome.bytes_after)
+	*(1.0 + 4.0*std::max(0.0, std::min(survival, 1.0) - 0.5));
+    if (s_target_pause > 0 && !outcome.full && outcome.pause_seconds > 0) {
+	// Move part way towards the scale that would have met the target,
+	// limiting the change per collection to damp out noise.
+	double ratio = std::max(0.5, std::min(2.0, s_target_pause
+					      /outcome.pause_seconds));
+	m_pause_scale = std::max(1.0/64, std::min(1.0, m_pause_scale*ratio));
+    } else if (s_target_pause == 0)
+	m_pause_scale = 1.0;
+    headroom *= m_pause_scale;
+    return std::max(outcome.min_threshold,
+		    outcome.bytes_after + size_t(headroom));
+}
+
+void GCManager::resetStatistics()
+{
+    std::fill(s_pause_stats, s_pause_stats + NUM_COLLECTION_KINDS,
+	      PauseStatistics());
+}
+
 void GCManager::resetMaxTallies()
 {
     s_max_bytes = MemoryBank::bytesAllocated();
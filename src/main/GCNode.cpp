@@ -32,13 +32,23 @@
 #include "rho/GCNode.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <atomic>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <utility>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "rho/GCManager.hpp"
 #include "rho/GCRoot.hpp"
 #include "rho/GCStackFrameBoundary.hpp"
@@ -52,7 +62,11 @@ using namespace std;
 using namespace rho;
 
 vector<const GCNode*>* GCNode::s_moribund = 0;
+vector<const GCNode*>* GCNode::s_young = 0;
+size_t GCNode::s_young_compaction_threshold = 1 << 16;
 unsigned int GCNode::s_num_nodes = 0;
+size_t GCNode::s_num_nodes_created = 0;
+size_t GCNode::s_num_nodes_collected_as_cycles = 0;
 bool GCNode::s_on_stack_bits_correct = false;
 
 // Used to update reference count bits of a GCNode. The array element at index
@@ -100,6 +114,12 @@ void GCNode::operator delete(void* pointer, size_t bytes) {
 bool GCNode::check() {
     // Check moribund list:
     for (const GCNode* node: *s_moribund) {
+
+        if (!isLiveMoribundEntry(node)) {
+            // A node deleted since it was added, or an address reused by a
+            // later node: see destruct_aux().
+            continue;
+        }
         if (!(node->m_refcount_flags & s_moribund_mask)) {
             cerr << "GCNode::check() : "
                 "Node on moribund list without moribund bit set.\n";
@@ -111,18 +131,30 @@ bool GCNode::check() {
 }
 
 void GCNode::destruct_aux() {
-    // Erase this node from the moribund list:
-    typedef std::vector<const GCNode*>::iterator Iter;
-    Iter it = std::find(s_moribund->begin(), s_moribund->end(), this);
-    if (it == s_moribund->end()) {
-        abort();  // Should never happen!
+    // Searching the moribund list for this node would take time proportional
+    // to the length of the list, so the entry is normally left in place, and
+    // skipped by gclite() once the node has gone.  The exception is the
+    // common case of a temporary that dies straight after being created.
+    if (!s_moribund->empty() && s_moribund->back() == this) {
+        s_moribund->pop_back();
     }
-    s_moribund->erase(it);
+}
+
+bool GCNode::isLiveMoribundEntry(const GCNode* node) {
+    return GCNodeAllocator::lookupPointer(const_cast<GCNode*>(node)) == node;
 }
     
 extern RObject* R_Srcref;
 
 void GCNode::gc(bool markSweep) {
+    collect(markSweep ? markSweepGC : gclite);
+}
+
+void GCNode::gcYoung() {
+    collect(youngGC);
+}
+
+void GCNode::collect(void (*collector)()) {
     if (GCManager::GCInhibitor::active()) {
         return;
     }
@@ -131,11 +163,7 @@ void GCNode::gc(bool markSweep) {
     ProtectStack::protectAll();
     incRefCount(R_Srcref);
 
-    if (markSweep) {
-        GCStackRootBase::withAllStackNodesProtected(markSweepGC);
-    } else {
-        GCStackRootBase::withAllStackNodesProtected(gclite);
-    }
+    GCStackRootBase::withAllStackNodesProtected(collector);
 
     decRefCount(R_Srcref);
 }
@@ -145,27 +173,236 @@ void GCNode::markSweepGC() {
     // any new stack roots.  To ensure correctness, this function must not call
     // any code that depends on normal operation of the garbage collector.
     s_on_stack_bits_correct = true;
+    unsigned int num_nodes = s_num_nodes;
 
     mark();
     sweep();
+    s_num_nodes_collected_as_cycles += num_nodes - s_num_nodes;
+
+    // All the survivors are now in the old generation.
+    s_young->clear();
+
+    s_on_stack_bits_correct = false;
+}
+
+namespace {
+    // Per-node bookkeeping for a young-generation collection.
+    struct YoungNodeState {
+	// Reference count less the number of references from other
+	// young nodes.  If this is non-zero, the node is referenced
+	// from outside the young generation.
+	int external_refs;
+	bool reachable;
+    };
+
+    // The young generation during youngGC(): the state of each node is
+    // held at the same index as its address in the sorted list of young
+    // nodes, so that a node can be looked up by binary search.  This is
+    // considerably cheaper to build than a hash table.
+    class YoungGeneration {
+    public:
+	explicit YoungGeneration(const vector<const GCNode*>* nodes)
+	    : m_nodes(nodes), m_states(nodes->size())
+	{}
+
+	size_t size() const
+	{
+	    return m_nodes->size();
+	}
+
+	const GCNode* node(size_t index) const
+	{
+	    return (*m_nodes)[index];
+	}
+
+	YoungNodeState& state(size_t index)
+	{
+	    return m_states[index];
+	}
+
+	// Returns null if node is not in the young generation.
+	YoungNodeState* find(const GCNode* node)
+	{
+	    if (m_nodes->empty() || node < m_nodes->front()
+		|| node > m_nodes->back())
+		return nullptr;
+	    vector<const GCNode*>::const_iterator it
+		= lower_bound(m_nodes->begin(), m_nodes->end(), node);
+	    if (*it != node)
+		return nullptr;
+	    return &m_states[it - m_nodes->begin()];
+	}
+    private:
+	const vector<const GCNode*>* m_nodes;
+	vector<YoungNodeState> m_states;
+    };
+}
+
+// Visitor which subtracts the references held by a young node from the
+// counts of its young referents.
+class GCNode::YoungRefCounter : public const_visitor {
+public:
+    YoungRefCounter(YoungGeneration* young)
+	: m_young(young)
+    {}
+
+    void operator()(const GCNode* node) override
+    {
+	YoungNodeState* state = m_young->find(node);
+	if (state) {
+	    --state->external_refs;
+	}
+    }
+private:
+    YoungGeneration* m_young;
+};
+
+// Visitor which flags young nodes as reachable and queues them so that
+// their own referents get visited.  Old nodes are ignored.
+class GCNode::YoungMarker : public const_visitor {
+public:
+    YoungMarker(YoungGeneration* young, vector<const GCNode*>* pending)
+	: m_young(young), m_pending(pending)
+    {}
+
+    void operator()(const GCNode* node) override
+    {
+	YoungNodeState* state = m_young->find(node);
+	if (state && !state->reachable) {
+	    state->reachable = true;
+	    m_pending->push_back(node);
+	}
+    }
+private:
+    YoungGeneration* m_young;
+    vector<const GCNode*>* m_pending;
+};
+
+void GCNode::youngGC() {
+    // As in markSweepGC(), new stack roots are ignored from here on.
+    s_on_stack_bits_correct = true;
+    unsigned int num_nodes = s_num_nodes;
+
+    compactYoungList();
+
+    // Saturated reference counts can't be trusted, so nodes with them are
+    // treated as roots, as are nodes referenced from the stack.
+    static const unsigned char saturated_refcount = s_refcount_mask >> 1;
+    YoungGeneration young(s_young);
+    for (size_t i = 0; i < young.size(); ++i) {
+        unsigned char ref_count = young.node(i)->getRefCount();
+        YoungNodeState& state = young.state(i);
+        state.external_refs = ref_count;
+        state.reachable = (ref_count == saturated_refcount
+                           || young.node(i)->isOnStackBitSet());
+    }
+
+    // Trial deletion: discount references from other young nodes.
+    {
+        YoungRefCounter counter(&young);
+        for (const GCNode* node : *s_young) {
+            node->visitReferents(&counter);
+        }
+    }
+
+    // Anything still referenced from outside the young generation is a
+    // root.  A negative count means that a node visits an edge that doesn't
+    // contribute to the reference count, so play safe with those too.
+    vector<const GCNode*> pending;
+    YoungMarker marker(&young, &pending);
+    for (size_t i = 0; i < young.size(); ++i) {
+        YoungNodeState& state = young.state(i);
+        if (state.external_refs != 0) {
+            state.reachable = true;
+        }
+        if (state.reachable) {
+            pending.push_back(young.node(i));
+        }
+    }
+    while (!pending.empty()) {
+        const GCNode* node = pending.back();
+        pending.pop_back();
+        node->visitReferents(&marker);
+    }
+
+    // Break up the unreachable cycles, as in sweep().  Detaching the
+    // referents of one node may cause others on the list to be deleted, so
+    // check that each node still exists before touching it.  (No allocation
+    // can happen here, so the address can't have been reused.)
+    for (size_t i = 0; i < young.size(); ++i) {
+        if (young.state(i).reachable) {
+            continue;
+        }
+        GCNode* node = const_cast<GCNode*>(young.node(i));
+        if (GCNodeAllocator::lookupPointer(node) != node) {
+            continue;
+        }
+        incRefCount(node);
+        node->detachReferents();
+        decRefCount(node);
+    }
+
+    s_num_nodes_collected_as_cycles += num_nodes - s_num_nodes;
+
+    // Promote the survivors to the old generation.
+    s_young->clear();
 
     s_on_stack_bits_correct = false;
 }
 
+void GCNode::compactYoungList() {
+    // Most young nodes are usually deleted by reference counting, so drop
+    // the stale entries before sorting what remains.
+    vector<const GCNode*>::iterator end
+        = remove_if(s_young->begin(), s_young->end(),
+                    [](const GCNode* node) {
+            void* pointer = const_cast<GCNode*>(node);
+            return GCNodeAllocator::lookupPointer(pointer) != node;
+        });
+    sort(s_young->begin(), end);
+    end = unique(s_young->begin(), end);
+    s_young->erase(end, s_young->end());
+    s_young_compaction_threshold
+        = std::max(size_t(1 << 16), 2 * s_young->size());
+}
+
+static double T_mor=0,T_cmp=0; static size_t N_ent=0,N_stale=0,N_del=0,N_cmp=0,N_cmpin=0;
+struct Rep{~Rep(){fprintf(stderr,"mor %g cmp %g ent %zu stale %zu del %zu ncmp %zu cmpin %zu\n",T_mor,T_cmp,N_ent,N_stale,N_del,N_cmp,N_cmpin);}} rep_;
 void GCNode::gclite() {
     s_on_stack_bits_correct = true;
+    auto t0=std::chrono::steady_clock::now();
 
     while (!s_moribund->empty()) {
         // Last in, first out, for cache efficiency:
         const GCNode* node = s_moribund->back();
         s_moribund->pop_back();
+        // Skip entries left behind by destruct_aux().  If the address has
+        // since been reused by another node, that node's flags decide: if
+        // it is moribund, processing it here just means that its own entry
+        // will be skipped later on.
+        ++N_ent;
+        if (!isLiveMoribundEntry(node)
+            || !(node->m_refcount_flags & s_moribund_mask)) {
+            continue;
+        }
         // Clear moribund bit.  Beware ~ promotes to unsigned int.
         node->m_refcount_flags &= static_cast<unsigned char>(~s_moribund_mask);
 
         if (node->maybeGarbage()) {
+            ++N_del;
             delete node;
         }
     }
+    auto t1=std::chrono::steady_clock::now();
+    T_mor+=std::chrono::duration<double>(t1-t0).count();
+
+    // Keep the young generation list from growing without bound between
+    // cycle collections.
+    if (s_young->size() > s_young_compaction_threshold) {
+        N_cmpin+=s_young->size(); ++N_cmp;
+        compactYoungList();
+    }
+    T_cmp+=std::chrono::duration<double>(std::chrono::steady_clock::now()-t1).count();
 
     s_on_stack_bits_correct = false;
 }
@@ -173,6 +410,7 @@ void GCNode::gclite() {
 void GCNode::initialize() {
     GCNodeAllocator::initialize();
     s_moribund = new vector<const GCNode*>();
+    s_young = new vector<const GCNode*>();
 }
 
 void GCNode::makeMoribund() const {
@@ -196,6 +434,12 @@ void GCNode::mark() {
     // alternation.  This avoids the need for the sweep phase to
     // iterate through the surviving nodes simply to remove marks.
     s_mark ^= s_mark_mask;
+    unsigned int num_threads = GCManager::markSweepThreads();
+    if (num_threads > 1) {
+        parallelMark(num_threads);
+        WeakRef::markThru();
+        return;
+    }
     GCNode::Marker marker;
     GCRootBase::visitRoots(&marker);
     GCStackRootBase::visitRoots(&marker);
@@ -206,28 +450,265 @@ void GCNode::mark() {
     }
 }
 
+bool GCNode::tryMark() const {
+    unsigned char flags = __atomic_load_n(&m_refcount_flags, __ATOMIC_RELAXED);
+    unsigned char marked;
+    do {
+        if ((flags & s_mark_mask) == s_mark) {
+            return false;
+        }
+        // Beware ~ promotes to unsigned int.
+        marked = (flags & static_cast<unsigned char>(~s_mark_mask)) | s_mark;
+    } while (!__atomic_compare_exchange_n(&m_refcount_flags, &flags, marked,
+                                          true, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+    return true;
+}
+
+namespace {
+    // Visitor which just records the nodes it is applied to.
+    class NodeCollector : public GCNode::const_visitor {
+    public:
+	void operator()(const GCNode* node) override
+	{
+	    m_nodes.push_back(node);
+	}
+
+	vector<const GCNode*> m_nodes;
+    };
+
+    // Marked nodes whose referents are yet to be visited, shared by one
+    // marking thread with the others.  The owning thread pushes and pops
+    // at the back; other threads steal from the front.
+    class GreyNodeDeque {
+    public:
+	GreyNodeDeque()
+	    : m_size(0)
+	{}
+
+	// May be stale by the time the caller looks at it.
+	bool empty() const
+	{
+	    return m_size == 0;
+	}
+
+	void push(vector<const GCNode*>::const_iterator first,
+		  vector<const GCNode*>::const_iterator last)
+	{
+	    lock_guard<mutex> lock(m_mutex);
+	    m_nodes.insert(m_nodes.end(), first, last);
+	    m_size = m_nodes.size();
+	}
+
+	// Move up to max_nodes nodes from the back onto *out.
+	bool pop(vector<const GCNode*>* out, size_t max_nodes)
+	{
+	    lock_guard<mutex> lock(m_mutex);
+	    size_t n = std::min(max_nodes, m_nodes.size());
+	    out->insert(out->end(), m_nodes.end() - n, m_nodes.end());
+	    m_nodes.erase(m_nodes.end() - n, m_nodes.end());
+	    m_size = m_nodes.size();
+	    return n != 0;
+	}
+
+	// Move half the nodes (rounded up) from the front onto *out.
+	bool steal(vector<const GCNode*>* out)
+	{
+	    lock_guard<mutex> lock(m_mutex);
+	    size_t n = (m_nodes.size() + 1)/2;
+	    out->insert(out->end(), m_nodes.begin(), m_nodes.begin() + n);
+	    m_nodes.erase(m_nodes.begin(), m_nodes.begin() + n);
+	    m_size = m_nodes.size();
+	    return n != 0;
+	}
+    private:
+	mutex m_mutex;
+	deque<const GCNode*> m_nodes;
+	atomic<size_t> m_size;
+    };
+}
+
+// Visitor which claims unmarked referents for the current thread, together
+// with the loop that drives it.
+class GCNode::ParallelMarker : public const_visitor {
+public:
+    ParallelMarker(vector<GreyNodeDeque>* deques, unsigned int index,
+		   unsigned int num_markers, atomic<unsigned int>* num_idle)
+	: m_deques(deques), m_index(index), m_num_markers(num_markers),
+	  m_num_idle(num_idle)
+    {}
+
+    void operator()(const GCNode* node) override
+    {
+	if (node->tryMark()) {
+	    m_grey.push_back(node);
+	}
+    }
+
+    // Returns once every node reachable from the deques has been marked.
+    void run();
+private:
+    // Surplus grey nodes are offered to other threads once a thread has
+    // more than this many.
+    static const size_t s_share_threshold = 256;
+
+    vector<GreyNodeDeque>* m_deques;
+    unsigned int m_index;
+    unsigned int m_num_markers;
+    atomic<unsigned int>* m_num_idle;
+    vector<const GCNode*> m_grey;
+
+    bool steal();
+    bool waitForWork();
+};
+
+void GCNode::ParallelMarker::run() {
+    GreyNodeDeque& own = (*m_deques)[m_index];
+    do {
+	while (!m_grey.empty()) {
+	    const GCNode* node = m_grey.back();
+	    m_grey.pop_back();
+	    node->visitReferents(this);
+	    if (m_grey.size() > s_share_threshold && own.empty()) {
+		// Share the oldest half, which is likely to lead to the
+		// most further work.
+		vector<const GCNode*>::iterator middle
+		    = m_grey.begin() + m_grey.size()/2;
+		own.push(m_grey.begin(), middle);
+		m_grey.erase(m_grey.begin(), middle);
+	    }
+	}
+    } while (own.pop(&m_grey, s_share_threshold) || steal() || waitForWork());
+}
+
+bool GCNode::ParallelMarker::steal() {
+    for (unsigned int i = 1; i < m_num_markers; ++i) {
+	GreyNodeDeque& victim = (*m_deques)[(m_index + i) % m_num_markers];
+	if (!victim.empty() && victim.steal(&m_grey)) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+// Marking is complete when every thread is idle at once: only a busy
+// thread can add nodes to a deque, and a thread only goes idle once its
+// own deque is empty.
+bool GCNode::ParallelMarker::waitForWork() {
+    ++*m_num_idle;
+    while (*m_num_idle != m_num_markers) {
+	for (unsigned int i = 0; i < m_num_markers; ++i) {
+	    if (!(*m_deques)[i].empty()) {
+		--*m_num_idle;
+		if (steal()) {
+		    return true;
+		}
+		++*m_num_idle;
+		break;
+	    }
+	}
+	this_thread::yield();
+    }
+    return false;
+}
+
+void GCNode::parallelMark(unsigned int num_threads) {
+    NodeCollector roots;
+    GCRootBase::visitRoots(&roots);
+    GCStackRootBase::visitRoots(&roots);
+    ProtectStack::visitRoots(&roots);
+    // Unlike mark(), treat R_Srcref as a root before WeakRef::markThru() is
+    // called, so that weak references keyed on nodes reachable only from it
+    // are handled correctly.
+    if (R_Srcref) {
+	roots(R_Srcref);
+    }
+
+    vector<GreyNodeDeque> deques(num_threads);
+    atomic<unsigned int> num_idle(0);
+    unsigned int num_markers = 1;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+    {
+	// OpenMP may provide fewer threads than were asked for.
+#ifdef _OPENMP
+#pragma omp single
+#endif
+	{
+#ifdef _OPENMP
+	    num_markers = omp_get_num_threads();
+#endif
+	    vector<vector<const GCNode*>> shares(num_markers);
+	    for (size_t i = 0; i < roots.m_nodes.size(); ++i) {
+		const GCNode* node = roots.m_nodes[i];
+		if (node->tryMark()) {
+		    shares[i % num_markers].push_back(node);
+		}
+	    }
+	    for (unsigned int i = 0; i < num_markers; ++i) {
+		deques[i].push(shares[i].begin(), shares[i].end());
+	    }
+	}
+#ifdef _OPENMP
+	unsigned int index = omp_get_thread_num();
+#else
+	unsigned int index = 0;
+#endif
+	ParallelMarker marker(&deques, index, num_markers, &num_idle);
+	marker.run();
+    }
+}
+
 void GCNode::sweep() {
     // Detach the referents of nodes that haven't been marked.
     // Once this is done, all of the nodes in the cycle will be unreferenced
     // and they will have been deleted unless their reference count is
     // saturated.
     vector<GCNode*> to_delete;
-    GCNodeAllocator::applyToAllAllocations([&](void* pointer) {
-        // The pointer is still allocated, so detach referents.
-        GCNode* node = static_cast<GCNode*>(pointer);
-        if (!node->isMarked()) {
-            int ref_count = node->getRefCount();
-            incRefCount(node);
-            if (node->getRefCount() == ref_count) {
-                // The reference count has saturated.
-                node->detachReferents();
-                to_delete.push_back(node);
-            } else {
-                node->detachReferents();
-                decRefCount(node);
+    auto detach = [&](GCNode* node) {
+        int ref_count = node->getRefCount();
+        incRefCount(node);
+        if (node->getRefCount() == ref_count) {
+            // The reference count has saturated.
+            node->detachReferents();
+            to_delete.push_back(node);
+        } else {
+            node->detachReferents();
+            decRefCount(node);
+        }
+    };
+    unsigned int num_threads = GCManager::markSweepThreads();
+    if (num_threads > 1) {
+        // Find the unmarked nodes in parallel.  Detaching referents can
+        // delete arbitrary nodes, so that is done on this thread
+        // afterwards, checking that each node still exists first.  (No
+        // allocation can happen here, so the address can't have been
+        // reused.)
+        vector<vector<GCNode*>> unmarked(num_threads);
+        GCNodeAllocator::applyToAllAllocationsInParallel(
+            [&](void* pointer, unsigned int thread) {
+                GCNode* node = static_cast<GCNode*>(pointer);
+                if (!node->isMarked()) {
+                    unmarked[thread].push_back(node);
+                }
+            }, num_threads);
+        for (const vector<GCNode*>& nodes : unmarked) {
+            for (GCNode* node : nodes) {
+                if (GCNodeAllocator::lookupPointer(node) == node) {
+                    detach(node);
+                }
             }
         }
-    });
+    } else {
+        GCNodeAllocator::applyToAllAllocations([&](void* pointer) {
+            // The pointer is still allocated, so detach referents.
+            GCNode* node = static_cast<GCNode*>(pointer);
+            if (!node->isMarked()) {
+                detach(node);
+            }
+        });
+    }
     // At this point, the only unmarked objects are GCNodes with saturated
     // reference counts.  Delete them.
     for (GCNode* node : to_delete) {
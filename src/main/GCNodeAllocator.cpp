@@ -27,16 +27,24 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
 #include <limits>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "rho/AddressSanitizer.hpp"
 #include "rho/AllocationTable.hpp"
 #include "rho/GCNodeAllocator.hpp"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef HAVE_ADDRESS_SANITIZER
 // Quarantine free lists are used to store freed objects for a while before
 // they can be reused. Allocations are poisoned while in the quarantine. This
@@ -53,6 +61,8 @@ rho::AllocationTable* rho::GCNodeAllocator::s_alloctable = nullptr;
 rho::AllocatorSuperblock* rho::GCNodeAllocator::s_superblocks[
     s_num_small_pools + s_num_medium_pools];
 
+std::size_t rho::GCNodeAllocator::s_bytes_released = 0;
+
 // Tracking heap bounds for fast rejection in pointer lookup.
 uintptr_t rho::GCNodeAllocator::s_heap_start = UINTPTR_MAX;
 uintptr_t rho::GCNodeAllocator::s_heap_end = 0;
@@ -60,11 +70,43 @@ uintptr_t rho::GCNodeAllocator::s_heap_end = 0;
 // Free lists head pointers.
 rho::FreeListNode* rho::GCNodeAllocator::s_freelists[s_num_freelists];
 
+// Per-thread small block caches.  These are zero-initialized, so no
+// locking or other setup is needed before a thread's first allocation.
+thread_local rho::GCNodeAllocator::ThreadCache
+rho::GCNodeAllocator::s_thread_cache;
+
+namespace {
+  // Protects everything in the allocator except the thread caches and the
+  // free bitsets of the superblocks (which are updated atomically).
+  std::mutex allocator_mutex;
+
+  // Returns a thread's cached blocks to the shared freelists when the
+  // thread exits.  It is activated when the thread first puts blocks in
+  // its cache, whether by a refill or by freeing a block.
+  struct ThreadCacheReleaser {
+    bool m_active;
+
+    ~ThreadCacheReleaser() {
+      if (m_active) {
+        rho::GCNodeAllocator::releaseThreadCache();
+      }
+    }
+  };
+
+  thread_local ThreadCacheReleaser thread_cache_releaser;
+
+  // Empty superblocks found by releaseEmptySuperblocks() that have not
+  // been released yet, with the time in seconds when they were first found
+  // to be empty.
+  std::unordered_map<rho::AllocatorSuperblock*, double> empty_superblocks;
+}
+
 #ifdef ALLOCATION_CHECK
 // Helper function for allocator consistency checking.
 // An additional allocation map is added which shadows the state of the
 // allocator. The extra allocation map is checked to verify each operation
-// on the allocator.
+// on the allocator.  The map is not locked, so this is only usable when a
+// single thread allocates.
 
 namespace {
   void add_to_allocation_map(void* allocation, std::size_t size);
@@ -197,15 +239,13 @@ void* rho::GCNodeAllocator::allocate(size_t bytes) {
       size_class = 4;
     }
     actual_bytes = size_class * 8;
-    result = removeFromFreelist(size_class);
-    if (!result) {
-      result = AllocatorSuperblock::allocateBlock(actual_bytes);
-      // If allocating in the small object arena fails, we continue
-      // on to using the medium block allocator. The allocation
-      // size will be increased to the minimum allocation size 64 bytes.
-    }
+    result = allocateSmall(size_class);
+    // If allocating in the small object arena fails, we continue
+    // on to using the medium block allocator. The allocation
+    // size will be increased to the minimum allocation size 64 bytes.
   }
   if (!result) {
+    std::lock_guard<std::mutex> lock(allocator_mutex);
     // Now we try to allocate in a large superblock or, if the size
     // exceeds the superblock threshold, use a separate allocation.
     // These allocations are rounded up to the next power of two size.
@@ -275,8 +315,16 @@ void rho::GCNodeAllocator::free(void* pointer) {
   AllocatorSuperblock* superblock =
       AllocatorSuperblock::arenaSuperblockFromPointer(pointer_uint);
   if (superblock) {
-    superblock->freeBlock(pointer);
+    FreeListNode* free_node = superblock->freeBlock(pointer);
+#ifdef HAVE_ADDRESS_SANITIZER
+    // Freed blocks must pass through the (shared) quarantine.
+    std::lock_guard<std::mutex> lock(allocator_mutex);
+    addToFreelist(free_node, superblock->m_size_class);
+#else
+    addToThreadCache(free_node, superblock->m_size_class);
+#endif
   } else {
+    std::lock_guard<std::mutex> lock(allocator_mutex);
     // Search for the allocation in the hashtable.  If the allocation is in a
     // superblock, the superblock is left as is but the superblock bitset is
     // updated to indicate that the block is free.
@@ -290,7 +338,7 @@ void rho::GCNodeAllocator::free(void* pointer) {
     }
     if (allocation->isSuperblock()) {
       AllocatorSuperblock* superblock = allocation->asSuperblock();
-      superblock->freeBlock(pointer);
+      addToFreelist(superblock->freeBlock(pointer), superblock->m_size_class);
       // Done. Don't erase hash entries for the superblock.
     } else if (allocation->asPointer() == pointer) {
       // Erase all entries in hashtable for the allocation.
@@ -303,6 +351,127 @@ void rho::GCNodeAllocator::free(void* pointer) {
   }
 }
 
+void rho::GCNodeAllocator::releaseThreadCache() {
+  ThreadCache& cache = s_thread_cache;
+  std::lock_guard<std::mutex> lock(allocator_mutex);
+  for (unsigned size_class = 0; size_class < s_num_small_pools; ++size_class) {
+    flushThreadCache(size_class, 0);
+    AllocatorSuperblock* superblock = cache.m_superblocks[size_class];
+    if (superblock) {
+      // Hand the untouched blocks over to the shared freelist.
+      while (superblock->hasUntouchedBlocks()) {
+        void* block = superblock->allocateNextUntouched();
+        addToFreelist(superblock->freeBlock(block), size_class);
+      }
+      cache.m_superblocks[size_class] = nullptr;
+    }
+  }
+}
+
+void* rho::GCNodeAllocator::allocateSmall(unsigned size_class) {
+  ThreadCache& cache = s_thread_cache;
+#ifdef HAVE_ADDRESS_SANITIZER
+  {
+    // Freed blocks are not cached, but go to the shared quarantine and
+    // from there to the shared freelists.
+    std::lock_guard<std::mutex> lock(allocator_mutex);
+    void* result = removeFromFreelist(size_class);
+    if (result) {
+      return result;
+    }
+  }
+#endif
+  while (true) {
+    FreeListNode* node = cache.m_freelists[size_class];
+    if (node) {
+      cache.m_freelists[size_class] = node->m_next;
+      cache.m_freelist_lengths[size_class] -= 1;
+      node->m_superblock->tagBlockAllocated(node->m_block);
+      return static_cast<void*>(node);
+    }
+    AllocatorSuperblock* superblock = cache.m_superblocks[size_class];
+    if (superblock) {
+      void* result = superblock->allocateNextUntouched();
+      if (!superblock->hasUntouchedBlocks()) {
+        cache.m_superblocks[size_class] = nullptr;
+      }
+      return result;
+    }
+    std::lock_guard<std::mutex> lock(allocator_mutex);
+    if (!refillThreadCache(size_class)) {
+      return nullptr;
+    }
+  }
+}
+
+bool rho::GCNodeAllocator::refillThreadCache(unsigned size_class) {
+  ThreadCache& cache = s_thread_cache;
+  thread_cache_releaser.m_active = true;
+#ifndef HAVE_ADDRESS_SANITIZER
+  // Take a batch of blocks from the shared freelist.  (With the address
+  // sanitizer, allocateSmall() has already found that list empty.)
+  FreeListNode* head = s_freelists[size_class];
+  if (head) {
+    FreeListNode* tail = head;
+    unsigned count = 1;
+    while (count < s_thread_cache_batch_size && tail->m_next) {
+      tail = tail->m_next;
+      count += 1;
+    }
+    s_freelists[size_class] = tail->m_next;
+    tail->m_next = cache.m_freelists[size_class];
+    cache.m_freelists[size_class] = head;
+    cache.m_freelist_lengths[size_class] += count;
+    return true;
+  }
+#endif
+  // Otherwise start a new superblock.
+  AllocatorSuperblock* superblock =
+      AllocatorSuperblock::newSuperblockFromArena(
+          bytesFromSizeClass(size_class));
+  if (!superblock) {
+    return false;
+  }
+  cache.m_superblocks[size_class] = superblock;
+  return true;
+}
+
+void rho::GCNodeAllocator::addToThreadCache(FreeListNode* free_node,
+    unsigned size_class) {
+  ThreadCache& cache = s_thread_cache;
+  thread_cache_releaser.m_active = true;
+  free_node->m_next = cache.m_freelists[size_class];
+  cache.m_freelists[size_class] = free_node;
+  cache.m_freelist_lengths[size_class] += 1;
+  if (cache.m_freelist_lengths[size_class] > 2 * s_thread_cache_batch_size) {
+    // Keep the most recently freed blocks, which are likely to be in cache.
+    std::lock_guard<std::mutex> lock(allocator_mutex);
+    flushThreadCache(size_class, s_thread_cache_batch_size);
+  }
+}
+
+void rho::GCNodeAllocator::flushThreadCache(unsigned size_class,
+    unsigned keep) {
+  ThreadCache& cache = s_thread_cache;
+  FreeListNode** link = &cache.m_freelists[size_class];
+  unsigned kept = 0;
+  while (kept < keep && *link) {
+    link = &(*link)->m_next;
+    kept += 1;
+  }
+  FreeListNode* head = *link;
+  if (head) {
+    FreeListNode* tail = head;
+    while (tail->m_next) {
+      tail = tail->m_next;
+    }
+    tail->m_next = s_freelists[size_class];
+    s_freelists[size_class] = head;
+    *link = nullptr;
+  }
+  cache.m_freelist_lengths[size_class] = kept;
+}
+
 void rho::GCNodeAllocator::applyToAllAllocations(
     std::function<void(void*)> fun) {
 #ifdef HAVE_ADDRESS_SANITIZER
@@ -317,6 +486,42 @@ void rho::GCNodeAllocator::applyToAllAllocations(
   s_alloctable->applyToAllAllocations(fun);
 }
 
+void rho::GCNodeAllocator::applyToAllAllocationsInParallel(
+    std::function<void(void*, unsigned)> fun, unsigned num_threads) {
+  int num_superblocks = AllocatorSuperblock::numArenaSuperblocks();
+  int num_buckets = s_alloctable->numBuckets();
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads)
+#endif
+  {
+#ifdef _OPENMP
+    unsigned thread = omp_get_thread_num();
+#else
+    unsigned thread = 0;
+#endif
+    std::function<void(void*)> thread_fun = [&](void* pointer) {
+#ifdef HAVE_ADDRESS_SANITIZER
+      pointer = offsetPointer(pointer, s_redzone_size);
+#endif
+      fun(pointer, thread);
+    };
+    // Superblocks are handed out in small batches, as the time taken
+    // to scan one varies a lot with its block size.
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 4) nowait
+#endif
+    for (int i = 0; i < num_superblocks; ++i) {
+      AllocatorSuperblock::arenaSuperblock(i)->applyToBlocks(thread_fun);
+    }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1024)
+#endif
+    for (int i = 0; i < num_buckets; ++i) {
+      s_alloctable->applyToBucket(i, thread_fun);
+    }
+  }
+}
+
 rho::GCNode* rho::GCNodeAllocator::lookupPointer(void* candidate) {
   uintptr_t candidate_uint = reinterpret_cast<uintptr_t>(candidate);
   void* result = AllocatorSuperblock::lookupAllocation(candidate_uint);
@@ -409,11 +614,121 @@ void rho::GCNodeAllocator::updateHeapBounds(void* pointer, size_t size) {
   }
 }
 
+std::size_t rho::GCNodeAllocator::releaseEmptySuperblocks(double delay) {
+#ifdef HAVE_ADDRESS_SANITIZER
+  // Free blocks are poisoned, and may be held in the quarantine.
+  return 0;
+#else
+  std::lock_guard<std::mutex> lock(allocator_mutex);
+  for (unsigned size_class = 0; size_class < s_num_small_pools; ++size_class) {
+    flushThreadCache(size_class, 0);
+  }
+
+  // Count the blocks of each superblock in the shared freelists.  If they
+  // all are, the superblock is empty and not owned by any thread cache.
+  static constexpr unsigned num_superblock_classes =
+      s_num_small_pools + s_num_medium_pools;
+  std::unordered_map<AllocatorSuperblock*, unsigned> listed;
+  for (unsigned size_class = 0; size_class < num_superblock_classes;
+       ++size_class) {
+    for (FreeListNode* node = s_freelists[size_class]; node;
+         node = node->m_next) {
+      listed[node->m_superblock] += 1;
+    }
+  }
+
+  double now = std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  std::unordered_map<AllocatorSuperblock*, double> still_empty;
+  std::unordered_set<AllocatorSuperblock*> to_release;
+  for (const auto& entry : listed) {
+    AllocatorSuperblock* superblock = entry.first;
+    if (superblock && entry.second == superblock->numBlocks()) {
+      auto previous = empty_superblocks.find(superblock);
+      double empty_since = (previous == empty_superblocks.end()
+                            ? now : previous->second);
+      if (now - empty_since >= delay) {
+        to_release.insert(superblock);
+      } else {
+        still_empty[superblock] = empty_since;
+      }
+    }
+  }
+  empty_superblocks.swap(still_empty);
+  if (to_release.empty()) {
+    return 0;
+  }
+
+  for (unsigned size_class = 0; size_class < num_superblock_classes;
+       ++size_class) {
+    FreeListNode** link = &s_freelists[size_class];
+    while (*link) {
+      if (to_release.count((*link)->m_superblock)) {
+        *link = (*link)->m_next;
+      } else {
+        link = &(*link)->m_next;
+      }
+    }
+  }
+  std::size_t bytes = 0;
+  for (AllocatorSuperblock* superblock : to_release) {
+    bytes += AllocatorSuperblock::release(superblock);
+  }
+  s_bytes_released += bytes;
+  return bytes;
+#endif // HAVE_ADDRESS_SANITIZER
+}
+
+unsigned rho::GCNodeAllocator::numReleasedSuperblocks() {
+  return AllocatorSuperblock::numReleasedArenaSuperblocks();
+}
+
 void rho::GCNodeAllocator::printSummary() {
   AllocatorSuperblock::debugPrintSmallSuperblocks();
   s_alloctable->printSummary();
 }
 
+std::vector<rho::GCNodeAllocator::SizeClassStatistics>
+rho::GCNodeAllocator::sizeClassStatistics() {
+  std::vector<SizeClassStatistics> by_class(s_num_freelists);
+  auto add_superblock = [&](const AllocatorSuperblock* superblock) {
+    if (superblock->isReleased()) {
+      return;
+    }
+    SizeClassStatistics& stats = by_class[superblock->m_size_class];
+    stats.superblocks += 1;
+    stats.blocks += superblock->numBlocks();
+    stats.allocated_blocks += superblock->numAllocatedBlocks();
+  };
+  unsigned num_superblocks = AllocatorSuperblock::numArenaSuperblocks();
+  for (unsigned i = 0; i < num_superblocks; ++i) {
+    add_superblock(AllocatorSuperblock::arenaSuperblock(i));
+  }
+  s_alloctable->applyToEntries(add_superblock, [&](unsigned size_log2) {
+    SizeClassStatistics& stats = by_class[s_num_small_pools + size_log2];
+    stats.block_size = std::size_t{1} << size_log2;
+    stats.blocks += 1;
+    stats.allocated_blocks += 1;
+  });
+
+  std::vector<SizeClassStatistics> result;
+  for (unsigned size_class = 0; size_class < s_num_freelists; ++size_class) {
+    if (by_class[size_class].blocks) {
+      if (by_class[size_class].superblocks) {
+        by_class[size_class].block_size = bytesFromSizeClass(size_class);
+      }
+      result.push_back(by_class[size_class]);
+    }
+  }
+  return result;
+}
+
+void rho::GCNodeAllocator::allocationTableUsage(unsigned* num_buckets,
+    unsigned* used_buckets) {
+  *num_buckets = s_alloctable->numBuckets();
+  *used_buckets = s_alloctable->numUsedBuckets();
+}
+
 #ifdef ALLOCATION_CHECK
 
 namespace {
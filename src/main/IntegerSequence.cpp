@@ -0,0 +1,216 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file IntegerSequence.cpp
+ *
+ * Implementation of class rho::IntegerSequence.
+ */
+
+#include "rho/IntegerSequence.hpp"
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+#include "rho/ArgList.hpp"
+#include "rho/BuiltInFunction.hpp"
+#include "rho/Evaluator.hpp"
+#include "rho/Expression.hpp"
+#include "rho/RealVector.hpp"
+#include "rho/Symbol.hpp"
+
+using namespace rho;
+
+namespace {
+    enum Generator {NONE, COLON, SEQ_LEN, SEQ_ALONG};
+
+    Generator sequenceGenerator(const Expression* call,
+				const FunctionBase* func)
+    {
+	static const BuiltInFunction* colon
+	    = BuiltInFunction::obtainPrimitive(":");
+	static const BuiltInFunction* seq_len
+	    = BuiltInFunction::obtainPrimitive("seq_len");
+	static const BuiltInFunction* seq_along
+	    = BuiltInFunction::obtainPrimitive("seq_along");
+	if (func->traced())
+	    return NONE;
+	Generator generator;
+	std::size_t num_args;
+	if (func == colon) {
+	    generator = COLON;
+	    num_args = 2;
+	} else if (func == seq_len) {
+	    generator = SEQ_LEN;
+	    num_args = 1;
+	} else if (func == seq_along) {
+	    generator = SEQ_ALONG;
+	    num_args = 1;
+	} else
+	    return NONE;
+	std::size_t n = 0;
+	for (const ConsCell& arg : *call->getArgs()) {
+	    if (arg.tag() || arg.car() == DotsSymbol)
+		return NONE;
+	    ++n;
+	}
+	return (n == num_args ? generator : NONE);
+    }
+
+    // Whether the call's function might be one of the sequence
+    // generators, which saves looking up the functions of other calls.
+    bool mayGenerateSequence(const Expression* call)
+    {
+	static const Symbol* colon = Symbol::obtain(":");
+	static const Symbol* seq_len = Symbol::obtain("seq_len");
+	static const Symbol* seq_along = Symbol::obtain("seq_along");
+	const RObject* head = call->car();
+	return head == colon || head == seq_len || head == seq_along;
+    }
+
+    // Obtains the value of a plain integer or real scalar that isn't NA.
+    bool scalarValue(const RObject* x, double* value)
+    {
+	if (!x || x->hasAttributes())
+	    return false;
+	if (x->sexptype() == INTSXP) {
+	    const IntVector* v = static_cast<const IntVector*>(x);
+	    if (v->size() != 1 || (*v)[0] == NA_INTEGER)
+		return false;
+	    *value = (*v)[0];
+	    return true;
+	}
+	if (x->sexptype() == REALSXP) {
+	    const RealVector* v = static_cast<const RealVector*>(x);
+	    if (v->size() != 1 || std::isnan((*v)[0]))
+		return false;
+	    *value = (*v)[0];
+	    return true;
+	}
+	return false;
+    }
+
+    // The conditions under which seq_colon() in seq.cpp yields an
+    // integer vector, further restricted to at most INT_MAX elements.
+    bool colonSequence(const RObject* from, const RObject* to,
+		       IntegerSequence* sequence)
+    {
+	double n1, n2;
+	if (!scalarValue(from, &n1) || !scalarValue(to, &n2))
+	    return false;
+	double r = std::fabs(n2 - n1);
+	if (r >= INT_MAX)
+	    return false;
+	std::size_t n = std::size_t(r + 1 + FLT_EPSILON);
+	if (n1 <= INT_MIN || n1 > INT_MAX || n1 != int(n1))
+	    return false;
+	double last = n1 + (n1 <= n2 ? double(n) - 1 : -(double(n) - 1));
+	if (last <= INT_MIN || last > INT_MAX)
+	    return false;
+	*sequence = IntegerSequence(int(n1), n, n1 <= n2 ? 1 : -1);
+	return true;
+    }
+
+    bool seqLenSequence(const RObject* length, IntegerSequence* sequence)
+    {
+	double dlen;
+	if (!scalarValue(length, &dlen) || dlen < 0 || dlen > INT_MAX)
+	    return false;
+	*sequence = IntegerSequence(1, std::size_t(dlen));
+	return true;
+    }
+
+    bool seqAlongSequence(const RObject* along, IntegerSequence* sequence)
+    {
+	if (!along) {
+	    *sequence = IntegerSequence();
+	    return true;
+	}
+	// Objects may have a length() method.
+	if (along->hasClass() || !Rf_isVector(const_cast<RObject*>(along)))
+	    return false;
+	std::size_t length = static_cast<const VectorBase*>(along)->size();
+	if (length > INT_MAX)
+	    return false;
+	*sequence = IntegerSequence(1, length);
+	return true;
+    }
+}
+
+IntVector* IntegerSequence::materialize() const
+{
+    IntVector* ans = IntVector::create(m_size);
+    for (std::size_t i = 0; i < m_size; ++i)
+	(*ans)[i] = (*this)[i];
+    return ans;
+}
+
+bool IntegerSequence::evaluate(RObject* expr, Environment* env,
+			       IntegerSequence* sequence,
+			       GCStackRoot<>* value)
+{
+    // Anything other than a sequence is evaluated as usual, so that
+    // Expression::evaluate() can fuse arithmetic, for example.
+    if (!expr || expr->sexptype() != LANGSXP
+	|| !mayGenerateSequence(static_cast<Expression*>(expr))) {
+	*value = Evaluator::evaluate(expr, env);
+	return false;
+    }
+    Expression* call = static_cast<Expression*>(expr);
+    FunctionBase* func = call->getFunction(env);
+    Generator generator = sequenceGenerator(call, func);
+    if (generator == NONE) {
+	*value = Evaluator::evaluate(expr, env);
+	return false;
+    }
+
+    const PairList* args = call->getArgs();
+    GCStackRoot<> arg1(Evaluator::evaluate(args->car(), env));
+    GCStackRoot<> arg2;
+    switch (generator) {
+    case COLON:
+	arg2 = Evaluator::evaluate(args->tail()->car(), env);
+	if (colonSequence(arg1, arg2, sequence))
+	    return true;
+	break;
+    case SEQ_LEN:
+	if (seqLenSequence(arg1, sequence))
+	    return true;
+	break;
+    case SEQ_ALONG:
+	if (seqAlongSequence(arg1, sequence))
+	    return true;
+	break;
+    default:
+	break;
+    }
+
+    // Let the builtin produce the value, or the error or warnings.
+    if (generator == COLON)
+	*value = call->evaluateFunctionCall(
+	    func, env, ArgList({arg1, arg2}, ArgList::EVALUATED));
+    else
+	*value = call->evaluateFunctionCall(
+	    func, env, ArgList({arg1}, ArgList::EVALUATED));
+    return false;
+}
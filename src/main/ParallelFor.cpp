@@ -0,0 +1,93 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file ParallelFor.cpp
+ *
+ * Implementation of class rho::ParallelFor.
+ */
+
+#include "rho/ParallelFor.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(_OPENMP) && !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+using namespace rho;
+
+namespace {
+    bool forked_child = false;
+
+#if defined(_OPENMP) && !defined(_WIN32)
+    // The OpenMP runtime may hang if a forked child, such as one
+    // created by parallel::mcparallel(), uses threads started by its
+    // parent, so loops in children run on the calling thread.
+    void noteForkedChild()
+    {
+	forked_child = true;
+    }
+#endif
+
+    unsigned int defaultNumThreads()
+    {
+#if defined(_OPENMP) && !defined(_WIN32)
+	pthread_atfork(nullptr, nullptr, noteForkedChild);
+#endif
+	unsigned int num_threads = std::thread::hardware_concurrency();
+	return num_threads ? num_threads : 1;
+    }
+}
+
+unsigned int ParallelFor::s_num_threads = defaultNumThreads();
+std::size_t ParallelFor::s_threshold = ParallelFor::default_threshold;
+
+unsigned int ParallelFor::numRanges(std::size_t n)
+{
+#ifdef _OPENMP
+    if (n < s_threshold || s_num_threads <= 1 || forked_child)
+	return 1;
+    return static_cast<unsigned int>(std::min<std::size_t>(s_num_threads, n));
+#else
+    (void)n;
+    return 1;
+#endif
+}
+
+void ParallelFor::runRanges(std::size_t n, unsigned int num_ranges,
+			    RangeFunction body, void* data)
+{
+    // Ranges differ in length by at most one element.
+    std::size_t length = n / num_ranges;
+    std::size_t remainder = n % num_ranges;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_ranges) schedule(static, 1)
+#endif
+    for (unsigned int range = 0; range < num_ranges; ++range) {
+	std::size_t begin = range*length + std::min<std::size_t>(range,
+								 remainder);
+	std::size_t end = begin + length + (range < remainder ? 1 : 0);
+	body(data, range, begin, end);
+    }
+}
@@ -323,6 +323,7 @@ protected:
     virtual ~PaddedPairList() {}
 
     void* m_unused_padding_1;
+    TypeFeedback m_unused_padding_2;
 };
 
 }  // anonymous namespace
@@ -365,6 +366,7 @@ void RObject::TransmuteLogicalToInt(RObject* x)
     LogicalVector* object = SEXP_downcast<LogicalVector*>(x);
 
     size_t length = object->size();
+    size_t capacity = object->capacity();
     size_t truelength = XTRUELENGTH(object);
 
     // Store any data values that fall within the memory range of the
@@ -393,7 +395,8 @@ void RObject::TransmuteLogicalToInt(RObject* x)
     // Replace the original LogicalVector an IntVector in the same memory
     // location.
     RObject::Transmute(object,
-		       [=](void* p) { return new(p) IntVector(length); });
+		       [=](void* p) {
+			   return new(p) IntVector(length, capacity); });
 
     // Restore the truelength and stored values.
     SET_TRUELENGTH(object, truelength);
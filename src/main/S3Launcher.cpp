@@ -29,12 +29,141 @@
 
 #include "rho/S3Launcher.hpp"
 
+#include <functional>
+
 #include "rho/Environment.hpp"
+#include "rho/Frame.hpp"
 #include "rho/FunctionBase.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/Promise.hpp"
+#include "rho/Symbol.hpp"
 
 using namespace std;
 using namespace rho;
 
+// The dispatch cache saves create() from pasting together method names
+// and searching for them on every dispatch.  Each entry records the names
+// that create() looked up for a generic, group and vector of classes, and
+// the Binding of the method it found.
+//
+// An entry is only made if every Frame in which the names were sought,
+// other than those of the Environments between the call environment and
+// the first 'stable' one, is locked or on the search path, and if none of
+// the names looked up before the method's is bound there.  The Frame of
+// the S3 methods table is made to report changes like a Frame on the search
+// path.  So while Environment::searchPathGeneration() is unchanged, the
+// method is still the one that create() would find, provided that the
+// Frames before the stable Environment don't bind any of the names.  The
+// hit path checks that directly, as those are usually the few small Frames
+// of the closures between the call and a namespace or the global
+// environment.
+//
+// Once the generation has moved on, every entry is stale, so the cache is
+// then cleared rather than left holding on to the Environments of the
+// entries, which may belong to namespaces since unloaded.
+
+namespace {
+    struct DispatchCacheEntry {
+	DispatchCacheEntry()
+	    : generation(0), table_binding(nullptr), binding(nullptr),
+	      index(0), using_group(false), allow_default(false)
+	{}
+
+	std::string generic;
+	std::string group;
+	GCRoot<Environment> stable_env;
+	GCRoot<Environment> table_env;
+	GCRoot<const StringVector> classes;
+	unsigned int generation;
+	// The names looked up, ending with the method's:
+	std::vector<Symbol*> symbols;
+	// The S3 methods table, and its Binding in table_env's Frame:
+	GCRoot<Environment> table;
+	const Frame::Binding* table_binding;
+	const Frame::Binding* binding;
+	size_t index;
+	bool using_group;
+	bool allow_default;
+    };
+
+    const size_t dispatch_cache_size = 256;
+
+    // The search path generation in which the cache was last cleared,
+    // and whether any entry has been made since then.
+    unsigned int dispatch_cache_generation = 0;
+    bool dispatch_cache_empty = true;
+
+    DispatchCacheEntry* dispatchCache()
+    {
+	static DispatchCacheEntry* cache
+	    = new DispatchCacheEntry[dispatch_cache_size];
+	unsigned int generation = Environment::searchPathGeneration();
+	if (generation != dispatch_cache_generation) {
+	    if (!dispatch_cache_empty) {
+		for (size_t i = 0; i < dispatch_cache_size; ++i)
+		    cache[i] = DispatchCacheEntry();
+		dispatch_cache_empty = true;
+	    }
+	    dispatch_cache_generation = generation;
+	}
+	return cache;
+    }
+
+    DispatchCacheEntry& dispatchCacheEntry(const std::string& generic,
+					   const std::string& group,
+					   const Environment* stable_env,
+					   const Environment* table_env,
+					   const StringVector* classes)
+    {
+	std::hash<std::string> hash_string;
+	std::hash<const void*> hash_pointer;
+	size_t hash = hash_string(generic) ^ (hash_string(group) * 31)
+	    ^ (hash_pointer(stable_env) * 37) ^ (hash_pointer(table_env) * 41);
+	for (const String* klass : *classes)
+	    hash = hash * 43 + hash_pointer(klass);
+	return dispatchCache()[hash % dispatch_cache_size];
+    }
+
+    bool isStable(const Frame* frame)
+    {
+	return frame->isLocked() || frame->isOnSearchPath();
+    }
+
+    // The first Environment, starting with env, whose Frame is stable.
+    Environment* stableEnvironment(Environment* env)
+    {
+	while (env && !isStable(env->frame()))
+	    env = env->enclosingEnvironment();
+	return env;
+    }
+
+    bool bindsAny(const Frame* frame, const std::vector<Symbol*>& symbols)
+    {
+	for (const Symbol* symbol : symbols) {
+	    if (frame->binding(symbol))
+		return true;
+	}
+	return false;
+    }
+
+    // The function bound by binding, or null if it isn't bound to one or
+    // to a forced Promise of one.
+    FunctionBase* boundFunction(const Frame::Binding* binding)
+    {
+	if (binding->isActive())
+	    return nullptr;
+	RObject* value = binding->rawValue();
+	if (value && value->sexptype() == PROMSXP) {
+	    Promise* promise = static_cast<Promise*>(value);
+	    if (!promise->evaluated())
+		return nullptr;
+	    value = promise->force();
+	}
+	return FunctionBase::isA(value) ? static_cast<FunctionBase*>(value)
+	    : nullptr;
+    }
+}
+
 void S3Launcher::addMethodBindings(Frame* frame) const
 {
     // .Class:
@@ -66,6 +195,71 @@ void S3Launcher::addMethodBindings(Frame* frame) const
     frame->bind(DotGenericDefEnvSymbol, m_table_env);
 }	
 
+void S3Launcher::cacheMethod(const std::vector<Symbol*>& symbols,
+			     bool allow_default)
+{
+    Environment* stable_env = stableEnvironment(m_call_env);
+    if (!stable_env)
+	return;
+    for (Environment* env = m_call_env; env != stable_env;
+	 env = env->enclosingEnvironment()) {
+	if (bindsAny(env->frame(), symbols))
+	    return;
+    }
+
+    // Each name was sought through all the stable Frames, except that the
+    // search for the method stopped where it was found.
+    std::vector<Symbol*> misses(symbols.begin(), symbols.end() - 1);
+    const Frame::Binding* binding = nullptr;
+    for (Environment* env = stable_env; env;
+	 env = env->enclosingEnvironment()) {
+	const Frame* frame = env->frame();
+	if (!isStable(frame) || bindsAny(frame, misses))
+	    return;
+	if (!binding)
+	    binding = frame->binding(m_symbol);
+    }
+
+    Environment* table = nullptr;
+    const Frame::Binding* table_binding = nullptr;
+    if (m_table_env) {
+	if (!isStable(m_table_env->frame()))
+	    return;
+	table_binding = m_table_env->frame()->binding(S3MethodsTableSymbol);
+	if (table_binding) {
+	    RObject* value = table_binding->rawValue();
+	    if (!value || value->sexptype() != ENVSXP)
+		return;
+	    table = static_cast<Environment*>(value);
+	    Frame* table_frame = table->frame();
+	    if (bindsAny(table_frame, misses))
+		return;
+	    if (!binding)
+		binding = table_frame->binding(m_symbol);
+	    table_frame->reportStatusChanges();
+	}
+    }
+    if (!binding || boundFunction(binding) != m_function)
+	return;
+
+    DispatchCacheEntry& entry = dispatchCacheEntry(
+	m_generic, m_group, stable_env, m_table_env, m_classes);
+    entry.generic = m_generic;
+    entry.group = m_group;
+    entry.stable_env = stable_env;
+    entry.table_env = m_table_env;
+    entry.classes = m_classes;
+    entry.generation = Environment::searchPathGeneration();
+    entry.symbols = symbols;
+    entry.table = table;
+    entry.table_binding = table_binding;
+    entry.binding = binding;
+    entry.index = m_index;
+    entry.using_group = m_using_group;
+    entry.allow_default = allow_default;
+    dispatch_cache_empty = false;
+}
+
 // Implementation of S3Launcher::create() is in objects.cpp
 
 void S3Launcher::detachReferents()
@@ -76,6 +270,43 @@ void S3Launcher::detachReferents()
     m_function.detach();
 }
 
+bool S3Launcher::findCachedMethod(bool allow_default)
+{
+    Environment* stable_env = stableEnvironment(m_call_env);
+    if (!stable_env)
+	return false;
+    const DispatchCacheEntry& entry = dispatchCacheEntry(
+	m_generic, m_group, stable_env, m_table_env, m_classes);
+    if (!entry.binding
+	|| entry.generation != Environment::searchPathGeneration()
+	|| entry.stable_env != stable_env || entry.table_env != m_table_env
+	|| entry.allow_default != allow_default
+	|| entry.classes->size() != m_classes->size()
+	|| entry.generic != m_generic || entry.group != m_group)
+	return false;
+    for (size_t i = 0; i < m_classes->size(); ++i) {
+	if ((*entry.classes)[i] != (*m_classes)[i])
+	    return false;
+    }
+    for (Environment* env = m_call_env; env != stable_env;
+	 env = env->enclosingEnvironment()) {
+	if (bindsAny(env->frame(), entry.symbols))
+	    return false;
+    }
+    if (entry.table_binding
+	&& entry.table_binding->rawValue() != entry.table)
+	return false;
+    FunctionBase* function = boundFunction(entry.binding);
+    if (!function)
+	return false;
+
+    m_function = function;
+    m_symbol = entry.symbols.back();
+    m_index = entry.index;
+    m_using_group = entry.using_group;
+    return true;
+}
+
 std::pair<FunctionBase*, bool>
 S3Launcher::findMethod(const Symbol* symbol, Environment* call_env,
 		       Environment* table_env)
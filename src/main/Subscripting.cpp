@@ -528,6 +528,21 @@ void Subscripting::setArrayAttributes(VectorBase* subset,
 void Subscripting::setVectorAttributes(VectorBase* subset,
 				       const VectorBase* source,
 				       const Indices& indices)
+{
+    copyVectorAttributes(subset, source, indices);
+}
+
+void Subscripting::setVectorAttributes(VectorBase* subset,
+				       const VectorBase* source,
+				       const IntegerSequence& range)
+{
+    copyVectorAttributes(subset, source, range);
+}
+
+template <class I>
+void Subscripting::copyVectorAttributes(VectorBase* subset,
+					const VectorBase* source,
+					const I& indices)
 {
     // Names:
     {
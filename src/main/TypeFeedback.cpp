@@ -0,0 +1,55 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file TypeFeedback.cpp
+ *
+ * @brief Implementation of class TypeFeedback.
+ */
+
+#include "rho/TypeFeedback.hpp"
+
+#include "rho/RObject.hpp"
+#include "rho/VectorBase.hpp"
+
+using namespace rho;
+
+TypeFeedback::Kind TypeFeedback::classify(const RObject* value)
+{
+    if (!value || value->hasAttributes())
+	return OTHER;
+    Kind kind;
+    switch (value->sexptype()) {
+    case LGLSXP:
+	kind = SCALAR_LOGICAL;
+	break;
+    case INTSXP:
+	kind = SCALAR_INTEGER;
+	break;
+    case REALSXP:
+	kind = SCALAR_REAL;
+	break;
+    default:
+	return OTHER;
+    }
+    return static_cast<const VectorBase*>(value)->size() == 1 ? kind : OTHER;
+}
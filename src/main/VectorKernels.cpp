@@ -0,0 +1,334 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file VectorKernels.cpp
+ *
+ * Implementation of the functions in namespace
+ * rho::VectorOps::Kernels.
+ */
+
+#include "rho/VectorKernels.hpp"
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+#include "R_ext/Arith.h"
+
+// The loops below are written so that each iteration is free of
+// branches, and are left to the compiler to vectorize rather than
+// written with intrinsics.  Where the toolchain can dispatch on the CPU
+// at load time (GNU ifuncs), each kernel is built for AVX-512, AVX2 and
+// the baseline instruction set.
+#if defined(__x86_64__) && defined(__GLIBC__)			\
+    && ((defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6) \
+	|| (defined(__clang__) && __clang_major__ >= 14))
+#define RHO_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+// The helpers must be inlined into each clone to benefit from it.
+#define RHO_KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define RHO_KERNEL
+#define RHO_KERNEL_INLINE inline
+#endif
+
+// At -O2 GCC only vectorizes loops whose trip count is known to suit
+// the vector width.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("tree-vectorize", "vect-cost-model=dynamic")
+#endif
+
+using namespace rho::VectorOps::Kernels;
+
+namespace {
+    // NA_INTEGER and NA_LOGICAL are both R_NaInt, which is set to INT_MIN
+    // at startup.  Using the constant lets the compiler keep it in a
+    // register.
+    const int na_int = INT_MIN;
+
+    template<typename Out, typename In, typename Op>
+    RHO_KERNEL_INLINE void apply(Operands operands, Out* __restrict__ out,
+				 const In* lhs, const In* rhs, std::size_t n,
+				 Op op)
+    {
+	switch (operands) {
+	case VECTOR_VECTOR:
+	    for (std::size_t i = 0; i < n; ++i)
+		out[i] = op(lhs[i], rhs[i]);
+	    break;
+	case SCALAR_VECTOR:
+	    {
+		const In lhs_value = *lhs;
+		for (std::size_t i = 0; i < n; ++i)
+		    out[i] = op(lhs_value, rhs[i]);
+	    }
+	    break;
+	case VECTOR_SCALAR:
+	    {
+		const In rhs_value = *rhs;
+		for (std::size_t i = 0; i < n; ++i)
+		    out[i] = op(lhs[i], rhs_value);
+	    }
+	    break;
+	}
+    }
+
+    // As apply(), but op also takes a flag that it sets to 1 when an
+    // element overflows.  The flag is kept in a local variable so that
+    // the compiler can treat it as a reduction.
+    template<typename Op>
+    RHO_KERNEL_INLINE bool applyChecked(Operands operands,
+					int* __restrict__ out,
+					const int* lhs, const int* rhs,
+					std::size_t n, Op op)
+    {
+	int overflow = 0;
+	switch (operands) {
+	case VECTOR_VECTOR:
+	    for (std::size_t i = 0; i < n; ++i)
+		out[i] = op(lhs[i], rhs[i], overflow);
+	    break;
+	case SCALAR_VECTOR:
+	    {
+		const int lhs_value = *lhs;
+		for (std::size_t i = 0; i < n; ++i)
+		    out[i] = op(lhs_value, rhs[i], overflow);
+	    }
+	    break;
+	case VECTOR_SCALAR:
+	    {
+		const int rhs_value = *rhs;
+		for (std::size_t i = 0; i < n; ++i)
+		    out[i] = op(lhs[i], rhs_value, overflow);
+	    }
+	    break;
+	}
+	return overflow != 0;
+    }
+
+    inline int isNA(int value)
+    {
+	return value == na_int;
+    }
+
+    // Overflow is detected from the signs of the operands and of the
+    // wrapped-around result.  An exact result of INT_MIN counts as an
+    // overflow too, since that value is NA.
+    inline int integerPlus(int lhs, int rhs, int& overflow)
+    {
+	int sum = static_cast<int>(static_cast<unsigned int>(lhs)
+				   + static_cast<unsigned int>(rhs));
+	int na = isNA(lhs) | isNA(rhs);
+	int over = (((lhs ^ sum) & (rhs ^ sum)) < 0) | isNA(sum);
+	overflow |= over & !na;
+	return (na | over) ? na_int : sum;
+    }
+
+    inline int integerMinus(int lhs, int rhs, int& overflow)
+    {
+	int difference = static_cast<int>(static_cast<unsigned int>(lhs)
+					  - static_cast<unsigned int>(rhs));
+	int na = isNA(lhs) | isNA(rhs);
+	int over = (((lhs ^ rhs) & (lhs ^ difference)) < 0)
+	    | isNA(difference);
+	overflow |= over & !na;
+	return (na | over) ? na_int : difference;
+    }
+
+    inline int integerTimes(int lhs, int rhs, int& overflow)
+    {
+	std::int64_t product = static_cast<std::int64_t>(lhs) * rhs;
+	int na = isNA(lhs) | isNA(rhs);
+	int over = (product > INT_MAX) | (product < -INT_MAX);
+	overflow |= over & !na;
+	return (na | over) ? na_int : static_cast<int>(product);
+    }
+
+    template<typename T>
+    inline int isNaOrNaN(T value);
+
+    template<>
+    inline int isNaOrNaN(int value)
+    {
+	return isNA(value);
+    }
+
+    template<>
+    inline int isNaOrNaN(double value)
+    {
+	return std::isnan(value);
+    }
+
+    template<typename T, typename Compare>
+    RHO_KERNEL_INLINE void compare(Operands operands, int* out,
+				   const T* lhs, const T* rhs, std::size_t n,
+				   Compare cmp)
+    {
+	apply(operands, out, lhs, rhs, n,
+	      [=](T l, T r) {
+		  int na = isNaOrNaN(l) | isNaOrNaN(r);
+		  return na ? na_int : static_cast<int>(cmp(l, r));
+	      });
+    }
+
+    template<typename T>
+    RHO_KERNEL_INLINE void compare(ComparisonOp op, Operands operands,
+				   int* out, const T* lhs, const T* rhs,
+				   std::size_t n)
+    {
+	switch (op) {
+	case EQ:
+	    compare(operands, out, lhs, rhs, n,
+		    [](T l, T r) { return l == r; });
+	    break;
+	case NE:
+	    compare(operands, out, lhs, rhs, n,
+		    [](T l, T r) { return l != r; });
+	    break;
+	case LT:
+	    compare(operands, out, lhs, rhs, n,
+		    [](T l, T r) { return l < r; });
+	    break;
+	case GT:
+	    compare(operands, out, lhs, rhs, n,
+		    [](T l, T r) { return l > r; });
+	    break;
+	case LE:
+	    compare(operands, out, lhs, rhs, n,
+		    [](T l, T r) { return l <= r; });
+	    break;
+	case GE:
+	    compare(operands, out, lhs, rhs, n,
+		    [](T l, T r) { return l >= r; });
+	    break;
+	}
+    }
+}  // anonymous namespace
+
+RHO_KERNEL
+void rho::VectorOps::Kernels::realArithmetic(ArithmeticOp op,
+					     Operands operands, double* out,
+					     const double* lhs,
+					     const double* rhs, std::size_t n)
+{
+    switch (op) {
+    case PLUS:
+	apply(operands, out, lhs, rhs, n,
+	      [](double l, double r) { return l + r; });
+	break;
+    case MINUS:
+	apply(operands, out, lhs, rhs, n,
+	      [](double l, double r) { return l - r; });
+	break;
+    case TIMES:
+	apply(operands, out, lhs, rhs, n,
+	      [](double l, double r) { return l * r; });
+	break;
+    case DIVIDE:
+	apply(operands, out, lhs, rhs, n,
+	      [](double l, double r) { return l / r; });
+	break;
+    case SQUARE:
+	// Only the first operand matters, so it is always treated as
+	// a vector.
+	apply(VECTOR_SCALAR, out, lhs, lhs, n,
+	      [](double l, double) { return l * l; });
+	break;
+    }
+}
+
+RHO_KERNEL
+bool rho::VectorOps::Kernels::integerArithmetic(ArithmeticOp op,
+						Operands operands, int* out,
+						const int* lhs, const int* rhs,
+						std::size_t n)
+{
+    switch (op) {
+    case PLUS:
+	return applyChecked(operands, out, lhs, rhs, n, integerPlus);
+    case MINUS:
+	return applyChecked(operands, out, lhs, rhs, n, integerMinus);
+    case TIMES:
+	return applyChecked(operands, out, lhs, rhs, n, integerTimes);
+    default:
+	break;
+    }
+    return false;
+}
+
+RHO_KERNEL
+void rho::VectorOps::Kernels::integerDivide(Operands operands, double* out,
+					    const int* lhs, const int* rhs,
+					    std::size_t n)
+{
+    const double na_real = NA_REAL;
+    apply(operands, out, lhs, rhs, n,
+	  [=](int l, int r) {
+	      int na = isNA(l) | isNA(r);
+	      double quotient = static_cast<double>(l) / static_cast<double>(r);
+	      return na ? na_real : quotient;
+	  });
+}
+
+RHO_KERNEL
+void rho::VectorOps::Kernels::realComparison(ComparisonOp op,
+					     Operands operands, int* out,
+					     const double* lhs,
+					     const double* rhs, std::size_t n)
+{
+    compare(op, operands, out, lhs, rhs, n);
+}
+
+RHO_KERNEL
+void rho::VectorOps::Kernels::integerComparison(ComparisonOp op,
+						Operands operands, int* out,
+						const int* lhs, const int* rhs,
+						std::size_t n)
+{
+    compare(op, operands, out, lhs, rhs, n);
+}
+
+RHO_KERNEL
+void rho::VectorOps::Kernels::logical(LogicalOp op, Operands operands,
+				      int* out, const int* lhs,
+				      const int* rhs, std::size_t n)
+{
+    switch (op) {
+    case AND:
+	apply(operands, out, lhs, rhs, n,
+	      [](int l, int r) {
+		  int either_false = (l == 0) | (r == 0);
+		  int either_na = isNA(l) | isNA(r);
+		  return either_false ? 0 : (either_na ? na_int : 1);
+	      });
+	break;
+    case OR:
+	apply(operands, out, lhs, rhs, n,
+	      [](int l, int r) {
+		  int either_true = ((l != 0) & !isNA(l))
+		      | ((r != 0) & !isNA(r));
+		  int either_na = isNA(l) | isNA(r);
+		  return either_true ? 1 : (either_na ? na_int : 0);
+	      });
+	break;
+    }
+}
@@ -35,6 +35,7 @@
 #include <config.h>
 #endif
 
+#include <atomic>
 #include <limits>
 
 #ifdef __OpenBSD__
@@ -66,6 +67,7 @@
 #include "rho/LogicalVector.hpp"
 #include "rho/GCStackRoot.hpp"
 #include "rho/IntVector.hpp"
+#include "rho/ParallelFor.hpp"
 #include "rho/RAllocStack.hpp"
 #include "rho/RealVector.hpp"
 #include "rho/UnaryFunction.hpp"
@@ -307,6 +309,9 @@ RObject* attribute_hidden do_arith(/*const*/ Expression* call,
 	return R_unary(call, op, arg);
     } else {
 	UNPACK_VA_ARGS(num_args, (lhs)(rhs));
+#ifdef ENABLE_LLVM_JIT
+	call->recordOperandTypes(lhs, rhs);
+#endif
 	return R_binary(call, op, lhs, rhs);
     }
 }
@@ -541,6 +546,51 @@ namespace {
 				   SEXP_downcast<IntVector*>(lhs),
 				   SEXP_downcast<IntVector*>(rhs));
     }
+
+    // Use a vectorized kernel for the common cases of integer_binary(),
+    // returning a null pointer if none applies.
+    VectorBase* integer_binary_kernel(ARITHOP_TYPE code, SEXP lhs, SEXP rhs,
+				      Rboolean* naflag)
+    {
+	if (TYPEOF(lhs) != INTSXP || TYPEOF(rhs) != INTSXP)
+	    return nullptr;
+	const IntVector* vl = SEXP_downcast<IntVector*>(lhs);
+	const IntVector* vr = SEXP_downcast<IntVector*>(rhs);
+
+	Kernels::ArithmeticOp op;
+	switch (code) {
+	case PLUSOP:
+	    op = Kernels::PLUS;
+	    break;
+	case MINUSOP:
+	    op = Kernels::MINUS;
+	    break;
+	case TIMESOP:
+	    op = Kernels::TIMES;
+	    break;
+	case DIVOP:
+	    return applyBinaryKernel<RealVector>(
+		[](Kernels::Operands operands, double* out,
+		   const int* l, const int* r, size_t n) {
+		    Kernels::integerDivide(operands, out, l, r, n);
+		},
+		BinaryArithmeticAttributeCopier(), vl, vr);
+	default:
+	    return nullptr;
+	}
+	// The kernel may run on several threads at once.
+	std::atomic<bool> overflow(false);
+	VectorBase* ans = applyBinaryKernel<IntVector>(
+	    [&](Kernels::Operands operands, int* out,
+		const int* l, const int* r, size_t n) {
+		if (Kernels::integerArithmetic(op, operands, out, l, r, n))
+		    overflow = true;
+	    },
+	    BinaryArithmeticAttributeCopier(), vl, vr);
+	if (overflow)
+	    *naflag = TRUE;
+	return ans;
+    }
 }  // anonymous namespace
 
 #define INTEGER_OVERFLOW_WARNING _("NAs produced by integer overflow")
@@ -548,7 +598,12 @@ namespace {
 static SEXP integer_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2, SEXP lcall)
 {
     Rboolean naflag = FALSE;
-    VectorBase* ans = nullptr;
+    VectorBase* ans = integer_binary_kernel(code, s1, s2, &naflag);
+    if (ans) {
+	if (naflag)
+	    warningcall(lcall, INTEGER_OVERFLOW_WARNING);
+	return ans;
+    }
 
     switch (code) {
     case PLUSOP:
@@ -629,8 +684,53 @@ static RealVector* apply_real_binary(Op op, SEXP lhs, SEXP rhs)
     }
 }
 
+// Use a vectorized kernel for the common cases of real_binary(),
+// returning a null pointer if none applies.
+static RealVector* real_binary_kernel(ARITHOP_TYPE code, SEXP s1, SEXP s2)
+{
+    using namespace VectorOps;
+
+    if (TYPEOF(s1) != REALSXP || TYPEOF(s2) != REALSXP)
+	return nullptr;
+    const RealVector* vl = SEXP_downcast<RealVector*>(s1);
+    const RealVector* vr = SEXP_downcast<RealVector*>(s2);
+
+    Kernels::ArithmeticOp op;
+    switch (code) {
+    case PLUSOP:
+	op = Kernels::PLUS;
+	break;
+    case MINUSOP:
+	op = Kernels::MINUS;
+	break;
+    case TIMESOP:
+	op = Kernels::TIMES;
+	break;
+    case DIVOP:
+	op = Kernels::DIVIDE;
+	break;
+    case POWOP:
+	// R_POW(x, 2.0) is x * x.  Other powers call pow().
+	if (vr->size() != 1 || (*vr)[0] != 2.0)
+	    return nullptr;
+	op = Kernels::SQUARE;
+	break;
+    default:
+	return nullptr;
+    }
+    return applyBinaryKernel<RealVector>(
+	[=](Kernels::Operands operands, double* out,
+	    const double* l, const double* r, size_t n) {
+	    Kernels::realArithmetic(op, operands, out, l, r, n);
+	},
+	BinaryArithmeticAttributeCopier(), vl, vr);
+}
+
 static SEXP real_binary(ARITHOP_TYPE code, SEXP s1, SEXP s2)
 {
+    if (RealVector* ans = real_binary_kernel(code, s1, s2))
+	return ans;
+
     switch (code) {
     case PLUSOP:
 	return apply_real_binary(
@@ -689,6 +789,11 @@ public:
 	return ans;
     }
 
+    void merge(const NaNWarner& other)
+    {
+	m_any_NaN = m_any_NaN || other.m_any_NaN;
+    }
+
     void warnings()
     {
 	if (m_any_NaN)
@@ -699,7 +804,10 @@ private:
     bool m_any_NaN;
 };
 
-static SEXP math1(SEXP sa, double (*f)(double), SEXP lcall)
+// If 'threaded' is true, long vectors are processed on several threads,
+// so f must not raise R warnings or errors.
+static SEXP math1(SEXP sa, double (*f)(double), SEXP lcall,
+		  bool threaded = false)
 {
     using namespace VectorOps;
     if (!isNumeric(sa))
@@ -708,9 +816,13 @@ static SEXP math1(SEXP sa, double (*f)(double), SEXP lcall)
     GCStackRoot<RealVector>
 	rv(static_cast<RealVector*>(coerceVector(sa, REALSXP)));
     NaNWarner op(f);
-    RealVector* result = applyUnaryOperator(std::ref(op),
-					    CopyAllAttributes(),
-					    rv.get());
+    RealVector* result;
+    if (threaded)
+	result = applyUnaryOperatorInParallel(op, CopyAllAttributes(),
+					      rv.get());
+    else
+	result = applyUnaryOperator(std::ref(op), CopyAllAttributes(),
+				    rv.get());
     op.warnings();
     return result;
 }
@@ -725,7 +837,10 @@ SEXP attribute_hidden do_math1(Expression* call, const BuiltInFunction* builtin,
 			     PairList::cons(x, nullptr), nullptr);
     }
 
-#define MATH1(FUN) math1(x, FUN, call);
+    /* The gamma functions can raise warnings, so they can't use
+       several threads. */
+#define MATH1(FUN) math1(x, FUN, call, true);
+#define SERIAL_MATH1(FUN) math1(x, FUN, call);
     switch (builtin->variant()) {
     case 1: return MATH1(floor);
     case 2: return MATH1(ceil);
@@ -750,11 +865,11 @@ SEXP attribute_hidden do_math1(Expression* call, const BuiltInFunction* builtin,
     case 34: return MATH1(asinh);
     case 35: return MATH1(atanh);
 
-    case 40: return MATH1(lgammafn);
-    case 41: return MATH1(gammafn);
+    case 40: return SERIAL_MATH1(lgammafn);
+    case 41: return SERIAL_MATH1(gammafn);
 
-    case 42: return MATH1(digamma);
-    case 43: return MATH1(trigamma);
+    case 42: return SERIAL_MATH1(digamma);
+    case 43: return SERIAL_MATH1(trigamma);
 	/* case 44: return MATH1(tetragamma);
 	   case 45: return MATH1(pentagamma);
 	   removed in 2.0.0
@@ -834,8 +949,10 @@ SEXP attribute_hidden do_abs(SEXP call, SEXP op, SEXP args, SEXP env)
 	if      (ISNA (a) || ISNA (b)) y = NA_REAL;	\
 	else if (ISNAN(a) || ISNAN(b)) y = R_NaN;
 
+// If 'threaded' is true, long vectors are processed on several threads,
+// so f must not raise R warnings or errors.
 static SEXP math2(SEXP sa, SEXP sb, double (*f)(double, double),
-		  SEXP lcall)
+		  SEXP lcall, bool threaded = false)
 {
     SEXP sy;
     R_xlen_t i, ia, ib, n, na, nb;
@@ -867,15 +984,38 @@ static SEXP math2(SEXP sa, SEXP sb, double (*f)(double, double),
 
     SETUP_Math2;
 
-    MOD_ITERATE2(n, na, nb, i, ia, ib, {
-	ai = a[ia];
-	bi = b[ib];
-	if_NA_Math2_set(y[i], ai, bi)
-	else {
-	    y[i] = f(ai, bi);
-	    if (ISNAN(y[i])) naflag = 1;
-	}
-    });
+    unsigned int num_ranges = threaded ? ParallelFor::numRanges(n) : 1;
+    if (num_ranges > 1) {
+	std::atomic<bool> any_nan(false);
+	ParallelFor::run(n, num_ranges,
+			 [&](unsigned int, size_t begin, size_t end) {
+	    R_xlen_t ia = begin % na, ib = begin % nb;
+	    bool range_nan = false;
+	    for (R_xlen_t i = begin; i < R_xlen_t(end); i++) {
+		double ai = a[ia], bi = b[ib];
+		if_NA_Math2_set(y[i], ai, bi)
+		else {
+		    y[i] = f(ai, bi);
+		    if (ISNAN(y[i])) range_nan = true;
+		}
+		if (++ia == na) ia = 0;
+		if (++ib == nb) ib = 0;
+	    }
+	    if (range_nan)
+		any_nan = true;
+	});
+	naflag = any_nan;
+    } else {
+	MOD_ITERATE2(n, na, nb, i, ia, ib, {
+	    ai = a[ia];
+	    bi = b[ib];
+	    if_NA_Math2_set(y[i], ai, bi)
+	    else {
+		y[i] = f(ai, bi);
+		if (ISNAN(y[i])) naflag = 1;
+	    }
+	});
+    }
 
 #define FINISH_Math2					\
     if(naflag) warning(R_MSG_NA);			\
@@ -941,6 +1081,8 @@ static SEXP math2B(SEXP sa, SEXP sb, double (*f)(double, double, double *),
 
 #define Math2(A, FUN)	  math2(x, y, FUN, call);
 #define Math2B(A, FUN)	  math2B(x, y, FUN, call);
+/* For functions that never raise warnings. */
+#define THREADED_Math2(A, FUN)	  math2(x, y, FUN, call, true);
 
 SEXP attribute_hidden do_math2(Expression* call,
 			       const BuiltInFunction* op,
@@ -953,9 +1095,9 @@ SEXP attribute_hidden do_math2(Expression* call,
     }
     switch (op->variant()) {
 
-    case  0: return Math2(args, atan2);
-    case 10001: return Math2(args, fround);// round(),  ../nmath/fround.c
-    case 10004: return Math2(args, fprec); // signif(), ../nmath/fprec.c
+    case  0: return THREADED_Math2(args, atan2);
+    case 10001: return THREADED_Math2(args, fround);// round(),  ../nmath/fround.c
+    case 10004: return THREADED_Math2(args, fprec); // signif(), ../nmath/fprec.c
 
     case  2: return Math2(args, lbeta);
     case  3: return Math2(args, beta);
@@ -1039,7 +1181,7 @@ SEXP attribute_hidden do_log1arg(/*const*/ Expression* call, const BuiltInFuncti
       return BuiltInFunction::callBuiltInWithCApi(complex_math2,
                                                   call2, op, arglist2, env);
     else
-	return math2(args[0], tmp, logbase, call);
+	return math2(args[0], tmp, logbase, call, true);
 }
 
 #ifdef M_E
@@ -1080,7 +1222,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    if (isComplex(x))
 		res = complex_math1(call, op, args, env);
 	    else
-		res = math1(x, R_log, call);
+		res = math1(x, R_log, call, true);
 	    UNPROTECT(1);
 	    return res;
 	}
@@ -1096,7 +1238,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    if (isComplex(x) || isComplex(y))
 		res = complex_math2(call, op, args, env);
 	    else
-		res = math2(x, y, logbase, call);
+		res = math2(x, y, logbase, call, true);
 	    UNPROTECT(1);
 	    return res;
 	}
@@ -1119,7 +1261,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    if (isComplex(CAR(args)))
 		res = complex_math1(call, op, args, env);
 	    else
-		res = math1(CAR(args), R_log, call);
+		res = math1(CAR(args), R_log, call, true);
 	}
 	UNPROTECT(1);
 	return res;
@@ -1149,7 +1291,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP rho)
 	    if (isComplex(x) || isComplex(base))
 		res = complex_math2(call, op, args, env);
 	    else
-		res = math2(x, base, logbase, call);
+		res = math2(x, base, logbase, call, true);
 	}
 	UNPROTECT(2);
 	return res;
@@ -2005,7 +2005,168 @@ newxzfile(const char *description, const char *mode, int type, int compress)
     return newconn;
 }
 
-/* op 0 is gzfile, 1 is bzfile, 2 is xv/lzma */
+/* Chunked files are cut into independently compressed chunks, which are
+   compressed and decompressed on several threads: see ChunkedFile.hpp */
+#include "rho/ChunkedFile.hpp"
+
+typedef struct chunkedfileconn {
+    FILE *fp;
+    int compress;
+    rho::ChunkedFile::Writer *writer;
+    rho::ChunkedFile::Reader *reader;
+} *Rchunkedfileconn;
+
+static Rboolean chunkedfile_open(Rconnection con)
+{
+    Rchunkedfileconn cf = RHO_S_CAST(Rchunkedfileconn, con->connprivate);
+
+    if(con->mode[0] == 'a') {
+	warning(_("chunked files cannot be opened for appending"));
+	return FALSE;
+    }
+    con->canwrite = RHOCONSTRUCT(Rboolean, (con->mode[0] == 'w'));
+    con->canread = RHOCONSTRUCT(Rboolean, !con->canwrite);
+    errno = 0; /* precaution */
+    cf->fp = R_fopen(R_ExpandFileName(con->description),
+		     con->canwrite ? "wb" : "rb");
+    if(!cf->fp) {
+	warning(_("cannot open compressed file '%s', probable reason '%s'"),
+		R_ExpandFileName(con->description), strerror(errno));
+	return FALSE;
+    }
+    if(con->canwrite) {
+	cf->writer = new rho::ChunkedFile::Writer(cf->fp, cf->compress);
+	cf->reader = nullptr;
+    } else {
+	cf->writer = nullptr;
+	cf->reader = new rho::ChunkedFile::Reader(cf->fp);
+	if(cf->reader->failed()) {
+	    delete cf->reader;
+	    cf->reader = nullptr;
+	    fclose(cf->fp);
+	    cf->fp = nullptr;
+	    warning(_("file '%s' is not a valid chunked file"),
+		    R_ExpandFileName(con->description));
+	    return FALSE;
+	}
+    }
+    con->isopen = TRUE;
+    con->text = strchr(con->mode, 'b') ? FALSE : TRUE;
+    set_iconv(con);
+    con->save = -1000;
+    return TRUE;
+}
+
+static void chunkedfile_close(Rconnection con)
+{
+    Rchunkedfileconn cf = RHO_S_CAST(Rchunkedfileconn, con->connprivate);
+    Rboolean ok = TRUE;
+
+    if(cf->writer) {
+	ok = RHOCONSTRUCT(Rboolean, cf->writer->finish());
+	delete cf->writer;
+	cf->writer = nullptr;
+    }
+    delete cf->reader;
+    cf->reader = nullptr;
+    if(cf->fp && fclose(cf->fp) != 0) ok = FALSE;
+    cf->fp = nullptr;
+    con->isopen = FALSE;
+    if(!ok)
+	error(_("error writing chunked file '%s'"),
+	      R_ExpandFileName(con->description));
+}
+
+static size_t chunkedfile_read(void *ptr, size_t size, size_t nitems,
+			       Rconnection con)
+{
+    Rchunkedfileconn cf = RHO_S_CAST(Rchunkedfileconn, con->connprivate);
+    size_t n = cf->reader->read(ptr, size*nitems);
+
+    if(cf->reader->failed())
+	warning(_("error reading chunked file '%s'"),
+		R_ExpandFileName(con->description));
+    return n/size;
+}
+
+static int chunkedfile_fgetc_internal(Rconnection con)
+{
+    unsigned char c;
+
+    return chunkedfile_read(&c, 1, 1, con) == 1 ? c : R_EOF;
+}
+
+static size_t chunkedfile_write(const void *ptr, size_t size, size_t nitems,
+				Rconnection con)
+{
+    Rchunkedfileconn cf = RHO_S_CAST(Rchunkedfileconn, con->connprivate);
+
+    return cf->writer->write(ptr, size*nitems) ? nitems : 0;
+}
+
+/* Seeking is only possible when reading, when the index is used to go
+   directly to the chunk holding the new position. */
+static double chunkedfile_seek(Rconnection con, double where, int origin,
+			       int rw)
+{
+    Rchunkedfileconn cf = RHO_S_CAST(Rchunkedfileconn, con->connprivate);
+    double pos = double(cf->writer ? cf->writer->position()
+			: cf->reader->position());
+
+    if (ISNA(where)) return pos;
+    if (cf->writer)
+	error(_("seeking is not supported when writing chunked files"));
+    switch(origin) {
+    case 2: where += pos; break;
+    case 3: where += double(cf->reader->size()); break;
+    default: break;
+    }
+    if (where < 0)
+	error(_("cannot seek to a negative position"));
+    cf->reader->seek(uint64_t(where));
+    return pos;
+}
+
+static Rconnection newchunkedfile(const char *description, const char *mode,
+				  int compress)
+{
+    Rconnection newconn;
+    newconn = static_cast<Rconnection>( malloc(sizeof(struct Rconn)));
+    if(!newconn) error(_("allocation of chunkedfile connection failed"));
+    newconn->connclass = static_cast<char *>( malloc(strlen("chunkedfile") + 1));
+    if(!newconn->connclass) {
+	free(newconn);
+	error(_("allocation of chunkedfile connection failed"));
+    }
+    strcpy(newconn->connclass, "chunkedfile");
+    newconn->description = static_cast<char *>( malloc(strlen(description) + 1));
+    if(!newconn->description) {
+	free(newconn->connclass); free(newconn);
+	error(_("allocation of chunkedfile connection failed"));
+    }
+    init_con(newconn, description, CE_NATIVE, mode);
+
+    newconn->canseek = TRUE;
+    newconn->open = &chunkedfile_open;
+    newconn->close = &chunkedfile_close;
+    newconn->vfprintf = &dummy_vfprintf;
+    newconn->fgetc_internal = &chunkedfile_fgetc_internal;
+    newconn->fgetc = &dummy_fgetc;
+    newconn->seek = &chunkedfile_seek;
+    newconn->fflush = &null_fflush;
+    newconn->read = &chunkedfile_read;
+    newconn->write = &chunkedfile_write;
+    newconn->connprivate = RHO_NO_CAST(void *) malloc(sizeof(struct chunkedfileconn));
+    if(!newconn->connprivate) {
+	free(newconn->description); free(newconn->connclass); free(newconn);
+	error(_("allocation of chunkedfile connection failed"));
+    }
+    memset(newconn->connprivate, 0, sizeof(struct chunkedfileconn));
+    static_cast<Rchunkedfileconn>(newconn->connprivate)->compress = compress;
+    return newconn;
+}
+
+/* op 0 is gzfile, 1 is bzfile, 2 is xv/lzma, 3 is chunked */
 SEXP attribute_hidden do_gzfile(/*const*/ Expression* call, const BuiltInFunction* op, RObject* description_, RObject* open_, RObject* encoding_, RObject* compression_)
 {
     SEXP sfile, sopen, ans, connclass, enc;
@@ -2028,7 +2189,7 @@ SEXP attribute_hidden do_gzfile(/*const*/ Expression* call, const BuiltInFunctio
     if(!isString(enc) || Rf_length(enc) != 1 ||
        strlen(CHAR(STRING_ELT(enc, 0))) > 100) /* ASCII */
 	error(_("invalid '%s' argument"), "encoding");
-    if(type < 2) {
+    if(type < 2 || type == 3) {
 	compress = asInteger(compression_);
 	if(compress == NA_LOGICAL || compress < 0 || compress > 9)
 	    error(_("invalid '%s' argument"), "compress");
@@ -2048,6 +2209,7 @@ SEXP attribute_hidden do_gzfile(/*const*/ Expression* call, const BuiltInFunctio
 	    memset(buf, 0, 7); res = fread(buf, 5, 1, fp); fclose(fp);
 	    if(res == 1) {
 		if(!strncmp(buf, "BZh", 3)) type = 1;
+		if(rho::ChunkedFile::hasMagic(buf, 5)) type = 3;
 		if((buf[0] == '\xFD') && !strncmp(buf+1, "7zXZ", 4)) type = 2;
 		if((buf[0] == '\xFF') && !strncmp(buf+1, "LZMA", 4)) {
 		    type = 2; subtype = 1;
@@ -2070,6 +2232,9 @@ SEXP attribute_hidden do_gzfile(/*const*/ Expression* call, const BuiltInFunctio
     case 2:
 	con = newxzfile(file, strlen(open) ? open : "rb", subtype, compress);
 	break;
+    case 3:
+	con = newchunkedfile(file, strlen(open) ? open : "rb", compress);
+	break;
     }
     ncon = NextConnection();
     Connections[ncon] = con;
@@ -2102,6 +2267,9 @@ SEXP attribute_hidden do_gzfile(/*const*/ Expression* call, const BuiltInFunctio
     case 2:
 	SET_STRING_ELT(connclass, 0, mkChar("xzfile"));
 	break;
+    case 3:
+	SET_STRING_ELT(connclass, 0, mkChar("chunkedfile"));
+	break;
     }
     SET_STRING_ELT(connclass, 1, mkChar("connection"));
     classgets(ans, connclass);
@@ -5577,8 +5745,19 @@ static inline unsigned int uiSwap (unsigned int x)
 }
 #endif
 
+/* The uncompressed length in the header of compressed data, which need
+   not be aligned. */
+static unsigned int compressedDataLength(const unsigned char *p)
+{
+    unsigned int len;
+    memcpy(&len, p, sizeof(len));
+    return uiSwap(len);
+}
+
 /* These are all hidden and used only in serialize.c,
-   so managing R_alloc stack is prudence. */
+   so managing R_alloc stack is prudence.  The decompressors work on
+   bytes rather than raw vectors, so that lazy-load databases can be
+   decompressed straight from the mapped file. */
 attribute_hidden
 SEXP R_compress1(SEXP in)
 {
@@ -5605,29 +5784,25 @@ SEXP R_compress1(SEXP in)
 }
 
 attribute_hidden
-SEXP R_decompress1(SEXP in, Rboolean *err)
+SEXP R_decompress1(const unsigned char *p, size_t inlen, Rboolean *err)
 {
-    const void *vmax = vmaxget();
-    uLong inlen, outlen;
+    uLong outlen;
     int res;
-    Bytef *buf;
-    unsigned char *p = RAW(in);
     SEXP ans;
 
-    if(TYPEOF(in) != RAWSXP)
-	error("R_decompress1 requires a raw vector");
-    inlen = LENGTH(in);
-    outlen = uLong( uiSwap(*(reinterpret_cast<unsigned int *>( p))));
-    buf = static_cast<Bytef *>( RHO_alloc(outlen, sizeof(Bytef)));
-    res = uncompress(buf, &outlen, static_cast<Bytef *>(p + 4), inlen - 4);
-    if(res != Z_OK) {
-	warning("internal error %d in R_decompress1", res);
+    if (inlen < 4) {
+	warning("truncated data in R_decompress1");
 	*err = TRUE;
 	return R_NilValue;
     }
+    outlen = uLong(compressedDataLength(p));
     ans = allocVector(RAWSXP, outlen);
-    memcpy(RAW(ans), buf, outlen);
-    vmaxset(vmax);
+    res = uncompress(RAW(ans), &outlen, p + 4, uLong(inlen - 4));
+    if(res != Z_OK || outlen != uLong(XLENGTH(ans))) {
+	warning("internal error %d in R_decompress1", res);
+	*err = TRUE;
+	return R_NilValue;
+    }
     return ans;
 }
 
@@ -5664,51 +5839,6 @@ SEXP R_compress2(SEXP in)
     return ans;
 }
 
-attribute_hidden
-SEXP R_decompress2(SEXP in, Rboolean *err)
-{
-    const void *vmax = vmaxget();
-    unsigned int inlen, outlen;
-    int res;
-    char *buf, *p = reinterpret_cast<char *>( RAW(in)), type;
-    SEXP ans;
-
-    if(TYPEOF(in) != RAWSXP)
-	error("R_decompress2 requires a raw vector");
-    inlen = LENGTH(in);
-    outlen = uiSwap(static_cast<unsigned int>(*p));
-    buf = R_alloc(outlen, sizeof(char));
-    type = p[4];
-    if (type == '2') {
-	res = BZ2_bzBuffToBuffDecompress(buf, &outlen, p + 5, inlen - 5, 0, 0);
-	if(res != BZ_OK) {
-	    warning("internal error %d in R_decompress2", res);
-	    *err = TRUE;
-	    return R_NilValue;
-	}
-    } else if (type == '1') {
-	uLong outl;
-	res = uncompress(reinterpret_cast<unsigned char *>( buf), &outl,
-			 reinterpret_cast<Bytef *>((p + 5)), inlen - 5);
-	if(res != Z_OK) {
-	    warning("internal error %d in R_decompress1");
-	    *err = TRUE;
-	    return R_NilValue;
-	}
-    } else if (type == '0') {
-	buf = p + 5;
-    } else {
-	warning("unknown type in R_decompress2");
-	*err = TRUE;
-	return R_NilValue;
-    }
-    ans = allocVector(RAWSXP, outlen);
-    memcpy(RAW(ans), buf, outlen);
-    vmaxset(vmax);
-    return ans;
-}
-
-
 SEXP attribute_hidden do_sockselect(/*const*/ Expression* call, const BuiltInFunction* op, RObject* socklist_, RObject* write_, RObject* timeout_)
 {
     Rboolean immediate = FALSE;
@@ -5813,72 +5943,89 @@ SEXP R_compress3(SEXP in)
     return ans;
 }
 
-attribute_hidden
-SEXP R_decompress3(SEXP in, Rboolean *err)
+/* Decompresses data written by R_compress1, R_compress2 or, if
+   allow_lzma is true, R_compress3. */
+static SEXP decompressTyped(const unsigned char *p, size_t inlen,
+			    Rboolean *err, bool allow_lzma, const char *caller)
 {
-    const void *vmax = vmaxget();
-    unsigned int inlen, outlen;
-    unsigned char *buf, *p = RAW(in), type = p[4];
+    unsigned int outlen;
+    unsigned char type;
     SEXP ans;
 
-    if(TYPEOF(in) != RAWSXP)
-	error("R_decompress3 requires a raw vector");
-    inlen = LENGTH(in);
-    outlen = RHO_NO_CAST(unsigned int) uiSwap(*(reinterpret_cast<unsigned int *>( p)));
-    buf = reinterpret_cast<unsigned char *>( R_alloc(outlen, sizeof(unsigned char)));
-
-    if (type == 'Z') {
+    if (inlen < 5) {
+	warning("truncated data in %s", caller);
+	*err = TRUE;
+	return R_NilValue;
+    }
+    outlen = compressedDataLength(p);
+    type = p[4];
+    p += 5;
+    inlen -= 5;
+    ans = allocVector(RAWSXP, outlen);
+    if (type == 'Z' && allow_lzma) {
 	lzma_stream strm = LZMA_STREAM_INIT;
 	lzma_ret ret;
 	init_filters();
 	ret = lzma_raw_decoder(&strm, filters);
 	if (ret != LZMA_OK) {
-	    warning("internal error %d in R_decompress3", ret);
+	    warning("internal error %d in %s", ret, caller);
 	    *err = TRUE;
 	    return R_NilValue;
 	}
-	strm.next_in = p + 5;
-	strm.avail_in = inlen - 5;
-	strm.next_out = buf;
+	strm.next_in = p;
+	strm.avail_in = inlen;
+	strm.next_out = RAW(ans);
 	strm.avail_out = outlen;
 	ret = lzma_code(&strm, LZMA_RUN);
 	if (ret != LZMA_OK && (strm.avail_in > 0)) {
-	    warning("internal error %d in R_decompress3 %d",
-		    ret, strm.avail_in);
+	    warning("internal error %d in %s %d", ret, caller,
+		    strm.avail_in);
+	    lzma_end(&strm);
 	    *err = TRUE;
 	    return R_NilValue;
 	}
 	lzma_end(&strm);
     } else if (type == '2') {
-	int res;
-	res = BZ2_bzBuffToBuffDecompress(reinterpret_cast<char *>(buf), &outlen,
-					 reinterpret_cast<char *>((p + 5)), inlen - 5, 0, 0);
-	if(res != BZ_OK) {
-	    warning("internal error %d in R_decompress2", res);
+	unsigned int outl = outlen;
+	int res = BZ2_bzBuffToBuffDecompress(
+	    reinterpret_cast<char *>(RAW(ans)), &outl,
+	    const_cast<char *>(reinterpret_cast<const char *>(p)),
+	    static_cast<unsigned int>(inlen), 0, 0);
+	if(res != BZ_OK || outl != outlen) {
+	    warning("internal error %d in %s", res, caller);
 	    *err = TRUE;
 	    return R_NilValue;
 	}
     } else if (type == '1') {
-	uLong outl; int res;
-	res = uncompress(buf, &outl, static_cast<Bytef *>((p + 5)), inlen - 5);
-	if(res != Z_OK) {
-	    warning("internal error %d in R_decompress1");
+	uLong outl = outlen;
+	int res = uncompress(RAW(ans), &outl, p, uLong(inlen));
+	if(res != Z_OK || outl != outlen) {
+	    warning("internal error %d in %s", res, caller);
 	    *err = TRUE;
 	    return R_NilValue;
 	}
-    } else if (type == '0') {
-	buf = p + 5;
+    } else if (type == '0' && inlen >= outlen) {
+	memcpy(RAW(ans), p, outlen);
     } else {
-	warning("unknown type in R_decompress3");
+	warning("unknown type in %s", caller);
 	*err = TRUE;
 	return R_NilValue;
     }
-    ans = allocVector(RAWSXP, outlen);
-    memcpy(RAW(ans), buf, outlen);
-    vmaxset(vmax);
     return ans;
 }
 
+attribute_hidden
+SEXP R_decompress2(const unsigned char *p, size_t inlen, Rboolean *err)
+{
+    return decompressTyped(p, inlen, err, false, "R_decompress2");
+}
+
+attribute_hidden
+SEXP R_decompress3(const unsigned char *p, size_t inlen, Rboolean *err)
+{
+    return decompressTyped(p, inlen, err, true, "R_decompress3");
+}
+
 SEXP attribute_hidden
 do_memCompress(/*const*/ Expression* call, const BuiltInFunction* op, RObject* from_, RObject* type_)
 {
@@ -1941,6 +1941,8 @@ SEXP attribute_hidden do_unregNS(/*const*/ Expression* call, const BuiltInFuncti
     if (findVarInFrame(R_NamespaceRegistry, name) == R_UnboundValue)
 	errorcall(call, _("namespace not registered"));
     RemoveVariable(name, R_NamespaceRegistry);
+    /* Stop the S3 dispatch cache keeping the namespace alive. */
+    Environment::advanceSearchPathGeneration();
     return R_NilValue;
 }
 
@@ -55,6 +55,7 @@
 #include "rho/ExpressionVector.hpp"
 #include "rho/GCStackFrameBoundary.hpp"
 #include "rho/Frame.hpp"
+#include "rho/IntegerSequence.hpp"
 #include "rho/LoopBailout.hpp"
 #include "rho/LoopException.hpp"
 #include "rho/Promise.hpp"
@@ -62,6 +63,10 @@
 #include "rho/ReturnBailout.hpp"
 #include "rho/ReturnException.hpp"
 #include "rho/S3Launcher.hpp"
+#ifdef ENABLE_LLVM_JIT
+#include "rho/jit/CompilationQueue.hpp"
+#include "rho/jit/CompiledExpression.hpp"
+#endif
 
 using namespace std;
 using namespace rho;
@@ -887,10 +892,50 @@ SEXP attribute_hidden do_if(SEXP call, SEXP op, SEXP args, SEXP rho)
     }
 }
 
+static SEXP for_loop_impl(SEXP call, SEXP op, SEXP args, SEXP rho,
+			  SEXP sequence, const IntegerSequence* range = nullptr);
+
 SEXP attribute_hidden do_for_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
 {
     GCStackRoot<> argsrt(args), rhort(rho);
 
+    if ( !Rf_isSymbol(CAR(args)) )
+	Rf_errorcall(call, _("non-symbol loop variable"));
+
+    /* rho FIXME
+    if (R_jit_enabled > 2 && ! R_PendingPromises) {
+	R_compileAndExecute(call, rho);
+	return R_NilValue;
+    }
+    */
+
+    // Loops over from:to, seq_len(n) or seq_along(x) don't allocate
+    // the sequence.
+    IntegerSequence range;
+    GCStackRoot<> val;
+    if (IntegerSequence::evaluate(CADR(args), SEXP_downcast<Environment*>(rho),
+				  &range, &val))
+	return for_loop_impl(call, op, args, rho, nullptr, &range);
+    return for_loop_impl(call, op, args, rho, val);
+}
+
+/* Run a for() loop over a sequence that has already been evaluated.
+   The JIT compiler uses this when the sequence turns out not to be
+   one it has compiled the loop for. */
+SEXP R_forLoopOverSequence(SEXP call, SEXP op, SEXP args, SEXP rho,
+			   SEXP sequence)
+{
+    return GCStackFrameBoundary::withStackFrameBoundary(
+	[=]() { return for_loop_impl(call, op, args, rho, sequence); });
+}
+
+/* If range is non-null, the loop is over its elements, and sequence is
+   ignored. */
+static SEXP for_loop_impl(SEXP call, SEXP op, SEXP args, SEXP rho,
+			  SEXP sequence, const IntegerSequence* range)
+{
+    GCStackRoot<> argsrt(args), rhort(rho);
+
     /* Need to declare volatile variables whose values are relied on
        after for_next or for_break longjmps and might change between
        the setjmp and longjmp calls. Theoretically this does not
@@ -903,43 +948,41 @@ SEXP attribute_hidden do_for_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
     SEXP sym, body;
 
     sym = CAR(args);
-    val = CADR(args);
+    val = sequence;
     body = CADDR(args);
 
-    if ( !Rf_isSymbol(sym) ) Rf_errorcall(call, _("non-symbol loop variable"));
+    Rf_defineVar(sym, R_NilValue, rho);
 
-    /* rho FIXME
-    if (R_jit_enabled > 2 && ! R_PendingPromises) {
-	R_compileAndExecute(call, rho);
-	return R_NilValue;
-    }
-    */
+    if (range) {
+	n = range->size();
+	val_type = INTSXP;
+    } else {
+	/* deal with the case where we are iterating over a factor
+	   we need to coerce to character - then iterate */
 
-    val = Rf_eval(val, rho);
-    Rf_defineVar(sym, R_NilValue, rho);
+	if( Rf_inherits(val, "factor") ) {
+	    ans = Rf_asCharacterFactor(val);
+	    val = ans;
+	}
 
-    /* deal with the case where we are iterating over a factor
-       we need to coerce to character - then iterate */
+	if (Rf_isList(val) || Rf_isNull(val)) {
+	    n = length(val);
+	} else if (!Rf_isVector(val)) {
+	    Rf_errorcall(call, _("invalid for() loop sequence"));
+	} else {
+	    n = LENGTH(val);
+	}
 
-    if( Rf_inherits(val, "factor") ) {
-	ans = Rf_asCharacterFactor(val);
-	val = ans;
-    }
+	val_type = TYPEOF(val);
 
-    if (Rf_isList(val) || Rf_isNull(val)) {
-	n = length(val);
-    } else {
-	n = LENGTH(val);
+	/* bump up NAMED count of sequence to avoid modification by loop
+	   code */
+	if (NAMED(val) < 2) SET_NAMED(val, NAMED(val) + 1);
     }
 
-    val_type = TYPEOF(val);
-
     dbg = ENV_DEBUG(rho);
     bgn = BodyHasBraces(body);
 
-    /* bump up NAMED count of sequence to avoid modification by loop code */
-    if (NAMED(val) < 2) SET_NAMED(val, NAMED(val) + 1);
-
     Environment* env = SEXP_downcast<Environment*>(rho);
     Environment::LoopScope loopscope(env);
     for (i = 0; i < n; i++) {
@@ -978,7 +1021,7 @@ SEXP attribute_hidden do_for_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
                     break;
                 case INTSXP:
                     v = ALLOC_LOOP_VAR(v, val_type);
-                    INTEGER(v)[0] = INTEGER(val)[i];
+                    INTEGER(v)[0] = range ? (*range)[i] : INTEGER(val)[i];
                     break;
                 case REALSXP:
                     v = ALLOC_LOOP_VAR(v, val_type);
@@ -1038,6 +1081,43 @@ SEXP attribute_hidden do_for(SEXP call, SEXP op, SEXP args, SEXP rho)
 	[=]() { return do_for_impl(call, op, args, rho); });
 }
 
+/* On-stack replacement.  A closure's body is only compiled after it has
+   been called a number of times, so a long-running loop in a single call
+   would never run compiled code.  Instead, once a while() or repeat()
+   loop in a closure call has run for the number of iterations given by
+   the option rho.jit.loop_threshold in the interpreter, the rest of the
+   loop is run in compiled code.  That needs a frame with a layout, so a
+   call whose frame has none stays in the interpreter, and later calls of
+   the closure are given frames with a layout.
+
+   This is called at the start of each iteration, when the loop's state
+   is entirely in the environment.  It returns true if the rest of the
+   loop has been run. */
+#ifdef ENABLE_LLVM_JIT
+static bool continueLoopInCompiledCode(SEXP call, SEXP rho,
+				       unsigned int& back_edges)
+{
+    if (++back_edges != JIT::CompiledExpression::loopThreshold()
+	|| ENV_DEBUG(rho))
+	return false;
+    // The loop must be in the body of the innermost closure call, not in
+    // an environment created by local() or similar.
+    ClosureContext* context = ClosureContext::innermost();
+    if (!context || context->workingEnvironment() != rho)
+	return false;
+    const Closure* closure
+	= SEXP_downcast<const Closure*>(context->function());
+    return closure->continueLoopInCompiledCode(
+	SEXP_downcast<Expression*>(call), context->workingEnvironment());
+}
+#else
+static bool continueLoopInCompiledCode(SEXP call, SEXP rho,
+				       unsigned int& back_edges)
+{
+    return false;
+}
+#endif
+
 static SEXP do_while_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
 {
     Rboolean dbg;
@@ -1058,8 +1138,10 @@ static SEXP do_while_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
 
     Environment* env = SEXP_downcast<Environment*>(rho);
     Environment::LoopScope loopscope(env);
+    unsigned int back_edges = 0;
 
-    while (asLogicalNoNA(Rf_eval(CAR(args), rho), call)) {
+    while (!continueLoopInCompiledCode(call, rho, back_edges)
+	   && asLogicalNoNA(Rf_eval(CAR(args), rho), call)) {
 	Evaluator::maybeCheckForUserInterrupts();
 	RObject* ans;
 	DO_LOOP_RDEBUG(call, op, args, rho, bgn);
@@ -1120,7 +1202,8 @@ static SEXP do_repeat_impl(SEXP call, SEXP op, SEXP args, SEXP rho)
 
     Environment* env = SEXP_downcast<Environment*>(rho);
     Environment::LoopScope loopscope(env);
-    for (;;) {
+    unsigned int back_edges = 0;
+    while (!continueLoopInCompiledCode(call, rho, back_edges)) {
 	Evaluator::maybeCheckForUserInterrupts();
 	RObject* ans;
 	DO_LOOP_RDEBUG(call, op, args, rho, bgn);
@@ -2153,3 +2236,90 @@ SEXP attribute_hidden do_setmaxnumthreads(/*const*/ Expression* call, const Buil
     }
     return Rf_ScalarInteger(old);
 }
+
+/* Statistics from the JIT compiler's compilation queue, or NULL if the
+   JIT isn't enabled. */
+SEXP attribute_hidden do_jitstats(/*const*/ Expression* call, const BuiltInFunction* op, RObject* reset_)
+{
+#ifdef ENABLE_LLVM_JIT
+    JIT::CompilationQueue::Statistics stats
+	= JIT::CompilationQueue::statistics();
+    JIT::CompiledExpression::CallStatistics& calls
+	= JIT::CompiledExpression::callStatistics();
+    GCStackRoot<> ans(Rf_allocVector(VECSXP, 5));
+    GCStackRoot<> nms(Rf_allocVector(STRSXP, 5));
+
+    SEXP compiled = Rf_allocVector(REALSXP, 5);
+    SET_VECTOR_ELT(ans, 0, compiled);
+    REAL(compiled)[0] = double(stats.num_background);
+    REAL(compiled)[1] = double(stats.num_synchronous);
+    REAL(compiled)[2] = double(stats.num_optimized);
+    REAL(compiled)[3] = double(stats.num_cached);
+    REAL(compiled)[4] = double(stats.num_failed);
+
+    SEXP queue = Rf_allocVector(REALSXP, 3);
+    SET_VECTOR_ELT(ans, 1, queue);
+    REAL(queue)[0] = stats.queue_length;
+    REAL(queue)[1] = stats.max_queue_length;
+    REAL(queue)[2] = JIT::CompilationQueue::maxDepth();
+
+    SEXP times = Rf_allocVector(REALSXP, 4);
+    SET_VECTOR_ELT(ans, 2, times);
+    REAL(times)[0] = stats.total_latency;
+    REAL(times)[1] = stats.total_compile_time;
+    REAL(times)[2] = stats.max_latency;
+    REAL(times)[3] = stats.max_compile_time;
+
+    SEXP memory = Rf_allocVector(REALSXP, 3);
+    SET_VECTOR_ELT(ans, 3, memory);
+    REAL(memory)[0] = double(stats.total_code_size);
+    REAL(memory)[1] = double(stats.total_data_size);
+    REAL(memory)[2] = stats.num_engines;
+
+    SEXP call_counts = Rf_allocVector(REALSXP, 3);
+    SET_VECTOR_ELT(ans, 4, call_counts);
+    REAL(call_counts)[0] = double(calls.num_compiled);
+    REAL(call_counts)[1] = double(calls.num_frames_replaced);
+    REAL(call_counts)[2] = double(calls.num_interpreted);
+
+    const char* names[] = {"compiled", "queue", "times", "memory", "calls"};
+    for (int i = 0; i < 5; i++)
+	SET_STRING_ELT(nms, i, Rf_mkChar(names[i]));
+    Rf_setAttrib(ans, R_NamesSymbol, nms);
+
+    if (Rf_asLogical(reset_) == TRUE) {
+	JIT::CompilationQueue::resetStatistics();
+	calls = JIT::CompiledExpression::CallStatistics();
+    }
+    return ans;
+#else
+    return R_NilValue;
+#endif
+}
+
+SEXP attribute_hidden do_jitinfo(/*const*/ Expression* call, const BuiltInFunction* op, RObject* f_)
+{
+#ifdef ENABLE_LLVM_JIT
+    const Closure* closure = dynamic_cast<const Closure*>(f_);
+    const JIT::CompiledExpression* code
+	= closure ? closure->compiledBody() : nullptr;
+    if (!code)
+	return R_NilValue;
+    GCStackRoot<> ans(Rf_allocVector(VECSXP, 4));
+    GCStackRoot<> nms(Rf_allocVector(STRSXP, 4));
+
+    bool optimized = (code->tier() == JIT::CompilationTier::OPTIMIZED);
+    SET_VECTOR_ELT(ans, 0, Rf_mkString(optimized ? "optimized" : "baseline"));
+    SET_VECTOR_ELT(ans, 1, Rf_ScalarReal(double(code->codeSize())));
+    SET_VECTOR_ELT(ans, 2, Rf_ScalarReal(double(code->dataSize())));
+    SET_VECTOR_ELT(ans, 3, Rf_ScalarLogical(code->loadedFromCache()));
+
+    const char* names[] = {"tier", "code.size", "data.size", "cached"};
+    for (int i = 0; i < 4; i++)
+	SET_STRING_ELT(nms, i, Rf_mkChar(names[i]));
+    Rf_setAttrib(ans, R_NamesSymbol, nms);
+    return ans;
+#else
+    return R_NilValue;
+#endif
+}
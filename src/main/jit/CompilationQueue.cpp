@@ -0,0 +1,499 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#include "rho/jit/llvm.hpp"
+
+#define R_NO_REMAP
+#include "rho/jit/CompilationQueue.hpp"
+
+#include "rho/jit/MCJITMemoryManager.hpp"
+#include "rho/jit/ObjectCache.hpp"
+#include "rho/jit/Optimization.hpp"
+#include "rho/jit/Runtime.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <condition_variable>
+#include <deque>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <pthread.h>
+
+using std::chrono::steady_clock;
+
+namespace rho {
+namespace JIT {
+
+unsigned int CompilationQueue::s_max_depth = 8;
+
+namespace {
+
+// State shared by the interpreter and the compilation thread, all guarded
+// by 'mutex'.  It is never destroyed, so that it outlives the compilation
+// thread even if that can't be joined at exit.
+struct QueueState {
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::deque<std::shared_ptr<CompilationJob>> pending;
+    std::vector<std::shared_ptr<llvm::ExecutionEngine>> released_engines;
+    std::vector<std::shared_ptr<CompilationJob>> released_jobs;
+    // The compilation thread, or null if it hasn't been started.
+    std::thread* worker = nullptr;
+    // Tells the compilation thread to exit once its current job is done.
+    bool shutting_down = false;
+    std::string cache_directory;
+    CompilationQueue::Statistics stats = CompilationQueue::Statistics();
+};
+
+QueueState& queueState()
+{
+    static QueueState* state = new QueueState;
+    return *state;
+}
+
+double secondsSince(steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(steady_clock::now() - start).count();
+}
+
+// Requires state.mutex.
+void recordCompletion(QueueState& state, const CompilationJob& job,
+		      double compile_time, bool background)
+{
+    CompilationQueue::Statistics& stats = state.stats;
+    ++(background ? stats.num_background : stats.num_synchronous);
+    if (job.tier() == CompilationTier::OPTIMIZED)
+	++stats.num_optimized;
+    if (job.loadedFromCache())
+	++stats.num_cached;
+    stats.total_code_size += job.codeSize();
+    stats.total_data_size += job.dataSize();
+    if (!job.functionAddress())
+	++stats.num_failed;
+    double latency = secondsSince(job.submitTime());
+    stats.total_latency += latency;
+    stats.max_latency = std::max(stats.max_latency, latency);
+    stats.total_compile_time += compile_time;
+    stats.max_compile_time = std::max(stats.max_compile_time, compile_time);
+}
+
+void compilationThread()
+{
+    QueueState& state = queueState();
+    std::unique_lock<std::mutex> queue_lock(state.mutex);
+    while (true) {
+	state.work_available.wait(queue_lock, [&state] {
+		return !state.pending.empty() || state.shutting_down;
+	    });
+	if (state.shutting_down)
+	    return;
+	std::shared_ptr<CompilationJob> job = std::move(state.pending.front());
+	state.pending.pop_front();
+	queue_lock.unlock();
+
+	std::lock_guard<std::recursive_mutex> llvm_lock(
+	    CompilationQueue::llvmMutex());
+	steady_clock::time_point start = steady_clock::now();
+	job->run();
+	double compile_time = secondsSince(start);
+
+	queue_lock.lock();
+	recordCompletion(state, *job, compile_time, true);
+	--state.stats.queue_length;
+	// If the CompiledExpression has been garbage collected, this is the
+	// last reference to the job, and its LLVM objects must be destroyed
+	// while llvm_lock is still held.
+	job.reset();
+	queue_lock.unlock();
+	CompilationQueue::destroyReleased();
+	queue_lock.lock();
+    }
+}
+
+// A child process created by fork() inherits the queue but not the
+// compilation thread.  Make sure that neither mutex is held across the
+// fork, and have the child start a new thread when it next needs one.
+void prepareForFork()
+{
+    CompilationQueue::llvmMutex().lock();
+    queueState().mutex.lock();
+}
+
+void resumeAfterForkInParent()
+{
+    queueState().mutex.unlock();
+    CompilationQueue::llvmMutex().unlock();
+}
+
+void resumeAfterForkInChild()
+{
+    // The thread doesn't exist in the child, so the std::thread can be
+    // neither joined nor destroyed.  Leak it.
+    queueState().worker = nullptr;
+    resumeAfterForkInParent();
+}
+
+// Requires state.mutex.
+void startCompilationThread(QueueState& state)
+{
+    static bool registered_handlers = false;
+    if (!registered_handlers) {
+	pthread_atfork(prepareForFork, resumeAfterForkInParent,
+		       resumeAfterForkInChild);
+	// Stop the thread before static objects that jobs use, such as the
+	// LLVM context, are destroyed.
+	std::atexit(CompilationQueue::shutdown);
+	registered_handlers = true;
+    }
+    state.worker = new std::thread(compilationThread);
+}
+
+// Compiled functions share ExecutionEngines, as each engine has a large
+// fixed cost in memory.  But the memory for a function's code is only freed
+// when its engine is, once every function in the engine has been garbage
+// collected, so an engine only takes a limited number of modules before a
+// new one is started.
+const unsigned int max_modules_per_engine = 64;
+
+std::atomic<unsigned int> num_engines(0);
+
+// The engine that modules are currently being added to.  Guarded by
+// CompilationQueue::llvmMutex().
+struct SharedEngine {
+    std::shared_ptr<llvm::ExecutionEngine> engine;
+    MCJITMemoryManager* memory_manager = nullptr;  // Owned by the engine.
+    unsigned int num_modules = 0;
+    // The ObjectCache keys of the modules, which are used in their names.
+    std::unordered_set<std::string> module_keys;
+
+    // Starts a new engine for the modules that follow.  The old one lives
+    // on until all of its functions have been released, but its modules
+    // have all been finalized, so it no longer needs their globals.
+    void retire()
+    {
+	if (memory_manager)
+	    memory_manager->clearGlobals();
+	*this = SharedEngine();
+    }
+};
+
+// Code generation options depend on the tier, so each tier has its own
+// engines.
+SharedEngine& sharedEngine(CompilationTier tier)
+{
+    static SharedEngine* engines = new SharedEngine[2];
+    return engines[tier == CompilationTier::OPTIMIZED ? 1 : 0];
+}
+
+std::shared_ptr<llvm::ExecutionEngine> createEngine(
+    std::unique_ptr<llvm::Module> module,
+    std::unique_ptr<MCJITMemoryManager> memory_manager,
+    CompilationTier tier)
+{
+    bool optimize = (tier == CompilationTier::OPTIMIZED);
+    llvm::TargetOptions options;
+    options.EnableFastISel = !optimize;
+
+    llvm::ExecutionEngine* engine =
+#if (LLVM_VERSION < 306)
+	llvm::EngineBuilder(module.release())
+	.setMCJITMemoryManager(memory_manager.release())
+	.setUseMCJIT(true)
+#else
+	llvm::EngineBuilder(std::move(module))
+	.setMCJITMemoryManager(std::move(memory_manager))
+#endif
+	.setOptLevel(optimize ? llvm::CodeGenOpt::Default
+		     : llvm::CodeGenOpt::None)
+	.setTargetOptions(options)
+	.create();
+    if (!engine)
+	return nullptr;
+    ++num_engines;
+    return std::shared_ptr<llvm::ExecutionEngine>(
+	engine,
+	[](llvm::ExecutionEngine* engine) {
+	    delete engine;
+	    --num_engines;
+	});
+}
+
+}  // anonymous namespace
+
+CompilationJob::CompilationJob(
+    std::unique_ptr<llvm::Module> module,
+    std::unique_ptr<MCJITMemoryManager> memory_manager,
+    const std::string& function_name,
+    CompilationTier tier)
+    : m_module(std::move(module)),
+      m_memory_manager(std::move(memory_manager)),
+      m_function_name(function_name),
+      m_tier(tier),
+      m_function_address(0),
+      m_code_size(0),
+      m_data_size(0),
+      m_loaded_from_cache(false),
+      m_finished(false),
+      m_submit_time(steady_clock::now())
+{ }
+
+CompilationJob::~CompilationJob() { }
+
+void CompilationJob::run()
+{
+    bool optimize = (m_tier == CompilationTier::OPTIMIZED);
+    llvm::Module* module = m_module.get();
+    llvm::Function* function = module->getFunction(m_function_name);
+    llvm::verifyFunction(*function);
+
+    // If this code has been compiled before, MCJIT loads it from the cache
+    // instead of generating it, so the module doesn't need optimizing.
+    std::unique_ptr<ObjectCache> cache = ObjectCache::create(
+	module, m_tier, CompilationQueue::cacheDirectory());
+
+    // The function and the module's globals need names that are unique
+    // within the shared engine.  Cached code uses names derived from its
+    // key, so that they are the same in whichever process loads it.
+    SharedEngine& shared = sharedEngine(m_tier);
+    if (shared.num_modules == max_modules_per_engine)
+	shared.retire();
+    std::string suffix;
+    if (cache && shared.module_keys.insert(cache->key()).second) {
+	suffix = cache->key();
+    } else {
+	// Either there's no cache, or the engine already has a module with
+	// the same IR, whose names these would clash with.
+	cache.reset();
+	static uint64_t num_uncached_modules = 0;
+	suffix = std::to_string(++num_uncached_modules);
+    }
+    m_function_name += "." + suffix;
+    function->setName(m_function_name);
+    m_memory_manager->renameModuleGlobals(suffix);
+    m_loaded_from_cache = cache && cache->hasObject();
+
+    if (!m_loaded_from_cache) {
+	// Perform some basic intra-procedural optimization.
+	BasicFunctionPass().runOnFunction(*function);
+	llvm::verifyFunction(*function);
+	if (optimize)
+	    Runtime::linkInRuntimeModule(module);
+    }
+
+    // The IR is now complete.  Add it to the engine.
+    if (shared.engine) {
+#if (LLVM_VERSION < 306)
+	shared.engine->addModule(m_module.release());
+#else
+	shared.engine->addModule(std::move(m_module));
+#endif
+    } else {
+	std::unique_ptr<MCJITMemoryManager> memory_manager(
+	    new MCJITMemoryManager());
+	shared.memory_manager = memory_manager.get();
+	shared.engine = createEngine(std::move(m_module),
+				     std::move(memory_manager), m_tier);
+    }
+    m_engine = shared.engine;
+
+    if (m_engine) {
+	++shared.num_modules;
+	MCJITMemoryManager* memory_manager = shared.memory_manager;
+	memory_manager->addGlobalsFrom(*m_memory_manager);
+
+	// MCJIT doesn't generate code until it is finalized, so the module
+	// can still be optimized for the engine's target.
+	if (optimize && !m_loaded_from_cache)
+	    optimizeModule(module, m_engine->getTargetMachine());
+
+	// Compile to native code.  Earlier modules have already been
+	// finalized, so everything allocated now belongs to this one.
+	uint64_t code_size = memory_manager->codeSize();
+	uint64_t data_size = memory_manager->dataSize();
+	if (cache)
+	    m_engine->setObjectCache(cache.get());
+	m_engine->finalizeObject();
+	m_engine->setObjectCache(nullptr);
+	m_code_size = memory_manager->codeSize() - code_size;
+	m_data_size = memory_manager->dataSize() - data_size;
+	m_function_address = m_engine->getFunctionAddress(m_function_name);
+    } else {
+	shared = SharedEngine();
+    }
+    m_finished.store(true, std::memory_order_release);
+}
+
+void CompilationJob::abandon()
+{
+    m_finished.store(true, std::memory_order_release);
+}
+
+std::shared_ptr<llvm::ExecutionEngine> CompilationJob::takeEngine()
+{
+    return std::move(m_engine);
+}
+
+std::recursive_mutex& CompilationQueue::llvmMutex()
+{
+    static std::recursive_mutex* mutex = new std::recursive_mutex;
+    return *mutex;
+}
+
+void CompilationQueue::release(std::shared_ptr<llvm::ExecutionEngine> engine,
+			       std::shared_ptr<CompilationJob> job)
+{
+    if (!engine && !job)
+	return;
+    std::unique_lock<std::recursive_mutex> llvm_lock(llvmMutex(),
+						     std::try_to_lock);
+    if (llvm_lock) {
+	engine.reset();
+	job.reset();
+	return;
+    }
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> queue_lock(state.mutex);
+    if (engine)
+	state.released_engines.push_back(std::move(engine));
+    if (job)
+	state.released_jobs.push_back(std::move(job));
+}
+
+void CompilationQueue::destroyReleased()
+{
+    std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines;
+    std::vector<std::shared_ptr<CompilationJob>> jobs;
+    QueueState& state = queueState();
+    {
+	std::lock_guard<std::mutex> queue_lock(state.mutex);
+	engines.swap(state.released_engines);
+	jobs.swap(state.released_jobs);
+    }
+}
+
+void CompilationQueue::submit(const std::shared_ptr<CompilationJob>& job)
+{
+    QueueState& state = queueState();
+    {
+	std::lock_guard<std::mutex> queue_lock(state.mutex);
+	if (state.stats.queue_length < s_max_depth) {
+	    try {
+		if (!state.worker)
+		    startCompilationThread(state);
+		state.pending.push_back(job);
+		Statistics& stats = state.stats;
+		++stats.queue_length;
+		stats.max_queue_length = std::max(stats.max_queue_length,
+						  stats.queue_length);
+		state.work_available.notify_one();
+		return;
+	    } catch (const std::system_error&) {
+		// Couldn't start the thread.  Compile it here instead.
+	    }
+	}
+    }
+    runNow(job);
+}
+
+void CompilationQueue::shutdown()
+{
+    QueueState& state = queueState();
+    std::thread* worker;
+    {
+	std::lock_guard<std::mutex> queue_lock(state.mutex);
+	worker = state.worker;
+	if (!worker)
+	    return;
+	state.shutting_down = true;
+	state.work_available.notify_one();
+    }
+    worker->join();
+    delete worker;
+
+    // The jobs that didn't start are given up on.  Destroying them needs
+    // the LLVM mutex, which the compilation thread no longer holds.
+    std::deque<std::shared_ptr<CompilationJob>> abandoned;
+    {
+	std::lock_guard<std::mutex> queue_lock(state.mutex);
+	abandoned.swap(state.pending);
+	state.stats.queue_length -= abandoned.size();
+	state.worker = nullptr;
+	state.shutting_down = false;
+    }
+    std::lock_guard<std::recursive_mutex> llvm_lock(llvmMutex());
+    for (const std::shared_ptr<CompilationJob>& job : abandoned)
+	job->abandon();
+    abandoned.clear();
+    destroyReleased();
+}
+
+void CompilationQueue::runNow(const std::shared_ptr<CompilationJob>& job)
+{
+    steady_clock::time_point start = steady_clock::now();
+    job->run();
+    double compile_time = secondsSince(start);
+
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> queue_lock(state.mutex);
+    recordCompletion(state, *job, compile_time, false);
+}
+
+std::string CompilationQueue::cacheDirectory()
+{
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> queue_lock(state.mutex);
+    return state.cache_directory;
+}
+
+void CompilationQueue::setCacheDirectory(const std::string& directory)
+{
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> queue_lock(state.mutex);
+    state.cache_directory = directory;
+}
+
+CompilationQueue::Statistics CompilationQueue::statistics()
+{
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> queue_lock(state.mutex);
+    Statistics stats = state.stats;
+    stats.num_engines = num_engines;
+    return stats;
+}
+
+void CompilationQueue::resetStatistics()
+{
+    QueueState& state = queueState();
+    std::lock_guard<std::mutex> queue_lock(state.mutex);
+    Statistics& stats = state.stats;
+    unsigned int queue_length = stats.queue_length;
+    stats = Statistics();
+    stats.queue_length = queue_length;
+    stats.max_queue_length = queue_length;
+}
+
+} // namespace JIT
+} // namespace rho
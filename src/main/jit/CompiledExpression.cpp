@@ -25,16 +25,18 @@
 #define R_NO_REMAP
 #include "rho/jit/CompiledExpression.hpp"
 
+#include "rho/jit/CompilationQueue.hpp"
 #include "rho/jit/Compiler.hpp"
 #include "rho/jit/CompilerContext.hpp"
+#include "rho/jit/FunctionLookupCache.hpp"
 #include "rho/jit/Globals.hpp"
 #include "rho/jit/MCJITMemoryManager.hpp"
-#include "rho/jit/Optimization.hpp"
 #include "rho/jit/Runtime.hpp"
 #include "rho/jit/TypeBuilder.hpp"
 
 #include "rho/Closure.hpp"
 #include "rho/Environment.hpp"
+#include "rho/Expression.hpp"
 #include "rho/Frame.hpp"
 #include "rho/RObject.hpp"
 
@@ -44,20 +46,53 @@ using llvm::Value;
 namespace rho {
 namespace JIT {
 
+unsigned int CompiledExpression::s_compile_threshold = 100;
+unsigned int CompiledExpression::s_optimize_threshold = 1000;
+unsigned int CompiledExpression::s_optimize_back_edge_threshold = 100000;
+unsigned int CompiledExpression::s_loop_threshold = 10000;
+CompiledExpression::CallStatistics CompiledExpression::s_call_statistics
+    = CompiledExpression::CallStatistics();
+
 CompiledExpression*
-CompiledExpression::compileFunctionBody(const Closure* closure)
+CompiledExpression::compileFunctionBody(const Closure* closure,
+					CompilationTier tier,
+					const FrameDescriptor* frame_descriptor)
 {
-    return new CompiledExpression(closure);
+    std::unique_lock<std::recursive_mutex> lock(
+	CompilationQueue::llvmMutex(), std::try_to_lock);
+    if (!lock)
+	return nullptr;
+    CompilationQueue::destroyReleased();
+    return new CompiledExpression(closure, closure->body(), frame_descriptor,
+				  false, tier);
 }
 
-CompiledExpression::CompiledExpression(const Closure* closure)
+CompiledExpression*
+CompiledExpression::compileLoop(const Closure* closure,
+				const Expression* loop,
+				const FrameDescriptor* frame_descriptor)
+{
+    std::unique_lock<std::recursive_mutex> lock(
+	CompilationQueue::llvmMutex(), std::try_to_lock);
+    if (!lock)
+	return nullptr;
+    CompilationQueue::destroyReleased();
+    return new CompiledExpression(closure, loop, frame_descriptor, true,
+				  CompilationTier::BASELINE);
+}
+
+CompiledExpression::CompiledExpression(const Closure* closure,
+				       const RObject* code,
+				       const FrameDescriptor* frame_descriptor,
+				       bool is_loop_entry,
+				       CompilationTier tier)
+    : m_tier(tier), m_function(nullptr), m_code_size(0), m_data_size(0),
+      m_loaded_from_cache(false)
 {
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     EnsureGlobalsInitialized();
 
-    const RObject* body = closure->body();
-
     // Create a module to compile the code in.  MCJIT requires that each
     // separate invocation of the JIT compiler uses its own module.
     llvm::LLVMContext& context = llvm::getGlobalContext();
@@ -77,13 +112,14 @@ CompiledExpression::CompiledExpression(const Closure* closure)
     std::unique_ptr<MCJITMemoryManager> memory_manager(
         new MCJITMemoryManager(module.get()));
     CompilerContext compiler_context(closure, environment, function,
-				     memory_manager.get());
+				     memory_manager.get(), frame_descriptor,
+				     is_loop_entry, tier);
     Compiler compiler(&compiler_context);
 #if (LLVM_VERSION > 306)
     function->setPersonalityFn(
         Runtime::getExceptionPersonalityFunction(&compiler));
 #endif
-    Value* return_value = compiler.emitEval(body);
+    Value* return_value = compiler.emitEval(code);
 
     if (!llvm::isa<llvm::UndefValue>(return_value)) {
 	if (!return_value->hasName())
@@ -100,52 +136,61 @@ CompiledExpression::CompiledExpression(const Closure* closure)
     }
 
     // function->dump(); // So we can see what's going on while developing.
-    llvm::verifyFunction(*function);
-
-    // Perform some basic intra-procedural optimization.
-    BasicFunctionPass().runOnFunction(*function);
-    llvm::verifyFunction(*function);
-
-    // The IR is now complete.  Compile to native code.
-    llvm::TargetOptions options;
-    // TODO(kmillar): set options dynamically.
-    options.EnableFastISel = true;
-
-    m_engine.reset(
-#if (LLVM_VERSION < 306)
-                   llvm::EngineBuilder(module.release())
-		   .setMCJITMemoryManager(memory_manager.release())
-		   .setUseMCJIT(true)
-#else
-                   llvm::EngineBuilder(std::move(module))
-		   .setMCJITMemoryManager(std::move(memory_manager))
-#endif
-		   .setOptLevel(llvm::CodeGenOpt::None)
-                   .setTargetOptions(options)
-		   .create());
-    assert(m_engine);
+    m_frame_descriptor = compiler_context.m_frame_descriptor;
+    m_function_lookup_caches
+	= std::move(compiler_context.m_function_lookup_caches);
+
+    // The IR is complete, and nothing from here on looks at the
+    // interpreter's data structures.  Generate the machine code, in the
+    // background for function bodies.  Loops are only compiled when the
+    // interpreter wants to run them straight away.
+    m_job = std::make_shared<CompilationJob>(std::move(module),
+					     std::move(memory_manager),
+					     function->getName().str(), tier);
+    if (is_loop_entry)
+	CompilationQueue::runNow(m_job);
+    else
+	CompilationQueue::submit(m_job);
+    installCompiledCode();
+}
 
-    m_engine->finalizeObject();
-    auto ptr = m_engine->getFunctionAddress(function->getName());
-    assert(ptr && "JIT compilation failed");
+bool CompiledExpression::installCompiledCode() const
+{
+    if (!m_job || !m_job->isFinished())
+	return false;
+    m_engine = m_job->takeEngine();
+    m_code_size = m_job->codeSize();
+    m_data_size = m_job->dataSize();
+    m_loaded_from_cache = m_job->loadedFromCache();
+    m_function = reinterpret_cast<CompiledExpressionPointer>(
+	m_job->functionAddress());
+    // A finished job owns no LLVM objects, so this doesn't need the lock.
+    m_job.reset();
+    return m_function;
+}
 
-    m_function = reinterpret_cast<CompiledExpressionPointer>(ptr);
-    m_frame_descriptor = compiler_context.m_frame_descriptor;
+bool CompiledExpression::failed() const
+{
+    return !isReady() && !m_job;
 }
 
 CompiledExpression::~CompiledExpression()
 {
-    // m_engine->freeMachineCodeForFunction(m_function);
+    CompilationQueue::release(std::move(m_engine), std::move(m_job));
 }
 
 void CompiledExpression::detachReferents() {
     m_frame_descriptor = nullptr;
+    for (const auto& cache : m_function_lookup_caches)
+	cache->detachReferents();
     GCNode::detachReferents();
 }
 
 void CompiledExpression::visitReferents(const_visitor* v) const {
     if (m_frame_descriptor)
 	(*v)(m_frame_descriptor);
+    for (const auto& cache : m_function_lookup_caches)
+	cache->visitReferents(v);
     GCNode::visitReferents(v);
 }
 
@@ -26,6 +26,7 @@
 #include "rho/jit/Compiler.hpp"
 
 #include "rho/jit/CompilationException.hpp"
+#include "rho/jit/FunctionLookupCache.hpp"
 #include "rho/jit/MCJITMemoryManager.hpp"
 #include "rho/jit/Runtime.hpp"
 #include "rho/jit/TypeBuilder.hpp"
@@ -41,6 +42,10 @@
 #include "rho/SEXP_downcast.hpp"
 #include "rho/StringVector.hpp"
 #include "rho/Symbol.hpp"
+#include "rho/TypeFeedback.hpp"
+#include "Defn.h"
+
+#include <set>
 
 using llvm::BasicBlock;
 using llvm::PHINode;
@@ -74,10 +79,22 @@ Compiler::Compiler(CompilerContext* context)
 llvm::Constant* Compiler::emitConstantPointer(const void* value,
 					      llvm::Type* type)
 {
-    llvm::Constant* pointer_as_integer = llvm::ConstantInt::get(
-	getType<intptr_t>(),
-	reinterpret_cast<intptr_t>(value));
-    return llvm::ConstantExpr::getIntToPtr(pointer_as_integer, type);
+    if (!value) {
+	return llvm::ConstantPointerNull::get(
+	    llvm::cast<llvm::PointerType>(type));
+    }
+    // The address is resolved when the code is loaded, rather than being
+    // embedded in it, so that the code can be cached.
+    llvm::Constant* global = m_context->getMemoryManager()->getConstant(value);
+    return llvm::ConstantExpr::getBitCast(global, type);
+}
+
+Value* Compiler::emitEntryBlockAlloca(llvm::Type* type, const char* name)
+{
+    // Allocas in the entry block are promoted to registers by mem2reg.
+    BasicBlock& entry_block = m_context->getFunction()->getEntryBlock();
+    IRBuilder<> builder(&entry_block, entry_block.begin());
+    return builder.CreateAlloca(type, nullptr, name);
 }
 
 llvm::Constant* Compiler::emitSymbol(const Symbol* symbol)
@@ -204,6 +221,9 @@ Value* Compiler::emitEvalInternal(const RObject* object)
 Value* Compiler::emitSymbolEval(const Symbol* symbol)
 {
     assert(m_context->m_frame_descriptor != nullptr);
+    if (const UnboxedVariable* variable = findUnboxedVariable(symbol)) {
+	return Runtime::emitBoxInteger(variable->value, this);
+    }
     // Optimize the lookup in the likely case that this is a regular symbol
     // found in the local environment.
     int location = m_context->m_frame_descriptor->getLocation(symbol);
@@ -245,6 +265,7 @@ Value* Compiler::emitExpressionEval(const Expression* expression)
     } else {
 	// The first element is a (function-valued) expression.  Fallback
 	// to the interpreter for now.
+	emitSpillUnboxedVariables();
 	return Runtime::emitEvaluate(emitConstantPointer(expression),
 				     m_context->getEnvironment(), this);
     }
@@ -258,6 +279,7 @@ Value* Compiler::emitExpressionEval(const Expression* expression)
     }
 
     // The function wasn't inlined, so emit a call to the interpreter.
+    emitSpillUnboxedVariables();
     return Runtime::emitCallFunction(
 	resolved_function, emitConstantPointer(expression->tail()),
 	emitConstantPointer(expression), m_context->getEnvironment(), this);
@@ -266,6 +288,7 @@ Value* Compiler::emitExpressionEval(const Expression* expression)
 Value* Compiler::emitDotsEval(const DottedArgs* expression)
 {
     // Call the interpreter.
+    emitSpillUnboxedVariables();
     return Runtime::emitEvaluate(emitConstantPointer(expression),
 				 m_context->getEnvironment(), this);
 }
@@ -282,9 +305,18 @@ Value* Compiler::emitFunctionLookup(const Symbol* symbol,
     *expected_result = findFunction(symbol,
 				    m_context->getClosure()->environment());
     llvm::Value* fn = emitSymbol(symbol);
-    // TODO(kmillar): emit optimized code for this.
-    return Runtime::emitLookupFunction(fn, m_context->getEnvironment(),
-				       this);
+    if (m_context->m_frame_descriptor->getLocation(symbol) != -1) {
+	// The symbol is often bound locally, which the cache can't help with.
+	return Runtime::emitLookupFunction(fn, m_context->getEnvironment(),
+					   this);
+    }
+    // Give the call site an inline cache.
+    m_context->m_function_lookup_caches.emplace_back(
+	new FunctionLookupCache());
+    llvm::Value* cache = emitConstantPointer(
+	m_context->m_function_lookup_caches.back().get(), getInt8PtrTy());
+    return Runtime::emitLookupFunctionCached(fn, m_context->getEnvironment(),
+					     cache, this);
 }
 
 BasicBlock* Compiler::createBasicBlock(const char* name,
@@ -315,12 +347,25 @@ BasicBlock* Compiler::createBranch(const char* name,
 Value* Compiler::createBackEdge(llvm::BasicBlock* destination)
 {
     Runtime::emitMaybeCheckForUserInterrupt(this);
+    if (m_context->getTier() == CompilationTier::BASELINE)
+	emitCountBackEdge();
     return CreateBr(destination);
 }
 
+void Compiler::emitCountBackEdge()
+{
+    // The closure uses the count to decide when to recompile itself at
+    // CompilationTier::OPTIMIZED.
+    Value* counter = emitConstantPointer(
+	m_context->getClosure()->backEdgeCounter(),
+	getInt32Ty()->getPointerTo());
+    CreateStore(CreateAdd(CreateLoad(counter), getInt32(1)), counter);
+}
+
 /*
  * The rest of this file contains the code to emit inlined versions of special
- * functions, primarily those that implement flow control.
+ * functions, primarily those that implement flow control, and of the
+ * arithmetic and comparison operators.
  */
 const std::vector<std::pair<FunctionBase*, Compiler::EmitBuiltinFn>>&
 Compiler::getInlineableBuiltins()
@@ -337,8 +382,8 @@ Compiler::getInlineableBuiltins()
 		       &Compiler::emitInlinedReturn),
 	std::make_pair(BuiltInFunction::obtainPrimitive("if"),
 		       &Compiler::emitInlinedIf),
-	// std::make_pair(BuiltInFunction::obtainPrimitive("for"),
-	// 	       &Compiler::emitInlinedFor),
+	std::make_pair(BuiltInFunction::obtainPrimitive("for"),
+		       &Compiler::emitInlinedFor),
 	std::make_pair(BuiltInFunction::obtainPrimitive("while"),
 		       &Compiler::emitInlinedWhile),
 	std::make_pair(BuiltInFunction::obtainPrimitive("repeat"),
@@ -346,7 +391,27 @@ Compiler::getInlineableBuiltins()
 	std::make_pair(BuiltInFunction::obtainPrimitive("break"),
 		       &Compiler::emitInlinedBreak),
 	std::make_pair(BuiltInFunction::obtainPrimitive("next"),
-		       &Compiler::emitInlinedNext)
+		       &Compiler::emitInlinedNext),
+	std::make_pair(BuiltInFunction::obtainPrimitive("+"),
+		       &Compiler::emitInlinedArithmetic<PLUSOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive("-"),
+		       &Compiler::emitInlinedArithmetic<MINUSOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive("*"),
+		       &Compiler::emitInlinedArithmetic<TIMESOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive("/"),
+		       &Compiler::emitInlinedArithmetic<DIVOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive("=="),
+		       &Compiler::emitInlinedComparison<EQOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive("!="),
+		       &Compiler::emitInlinedComparison<NEOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive("<"),
+		       &Compiler::emitInlinedComparison<LTOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive("<="),
+		       &Compiler::emitInlinedComparison<LEOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive(">="),
+		       &Compiler::emitInlinedComparison<GEOP>),
+	std::make_pair(BuiltInFunction::obtainPrimitive(">"),
+		       &Compiler::emitInlinedComparison<GTOP>)
     };
     return inlineable_builtins;
 }
@@ -432,6 +497,7 @@ Value* Compiler::emitInlineableBuiltinCall(const Expression* expression,
     // TODO(kmillar): allow this check to be skipped at some optimization
     //   levels.
     SetInsertPoint(fallback_block);
+    emitSpillUnboxedVariables();
     Value* fallback_value
 	=  Runtime::emitCallFunction(resolved_function,
 				     emitConstantPointer(expression->tail()),
@@ -467,6 +533,7 @@ Value* Compiler::emitInlinedAssign(const Expression* expression)
 	} else if (dynamic_cast<const Expression*>(lhs_expr)) {
           // Complex assignment.
           emitSetVisibility(false);
+          emitSpillUnboxedVariables();
           auto applydefine =
               Runtime::getDeclaration("rho_runtime_applydefine", this);
           assert(applydefine != nullptr);
@@ -538,6 +605,11 @@ Value* Compiler::emitInlinedBegin(const Expression* expression)
 
 Value* Compiler::emitInlinedReturn(const Expression* expression)
 {
+    if (m_context->isLoopEntry()) {
+	// The interpreter's 'return' unwinds to the closure call.
+	return nullptr;
+    }
+
     // Both return() and return(expr) are legal.
     Value* return_value;
 
@@ -550,6 +622,8 @@ Value* Compiler::emitInlinedReturn(const Expression* expression)
 	// This is probably a syntax error.  Let the interpreter handle it.
 	return nullptr;
     }
+    // The environment may outlive the call.
+    emitSpillUnboxedVariables();
     return CreateRet(return_value);
 
     // Note: 'return' isn't valid at top-level, but since only functions get
@@ -701,6 +775,531 @@ Value* Compiler::emitInlinedNext(const Expression* expression) {
     }
 }
 
+/*
+ * for() loops are compiled as a counted loop over the sequence.  When the
+ * sequence is an integer vector produced by ':', seq_len() or seq_along(),
+ * and the loop body can't observe the loop variable through the
+ * environment, the variable is kept unboxed in a register and only stored
+ * to the frame when control leaves compiled code (see
+ * emitSpillUnboxedVariables()) and after the loop.
+ */
+Value* Compiler::emitInlinedFor(const Expression* expression)
+{
+    if (listLength(expression) != 4) {
+	// This is probably a syntax error.  Let the interpreter handle it.
+	return nullptr;
+    }
+    const PairList* args = expression->tail();
+    const Symbol* symbol = dynamic_cast<const Symbol*>(args->car());
+    if (!symbol || symbol == DotsSymbol || symbol->isDotDotSymbol()
+	|| symbol == Symbol::missingArgument()) {
+	// Let the interpreter report the error.
+	return nullptr;
+    }
+    int location = m_context->m_frame_descriptor->getLocation(symbol);
+    if (location == -1) {
+	return nullptr;
+    }
+    const RObject* sequence_expr = args->tail()->car();
+    const RObject* body = args->tail()->tail()->car();
+
+    Value* sequence = Runtime::emitForLoopSequence(emitEval(sequence_expr),
+						   expression, this);
+    // The loop body may collect garbage, and the sequence is only held in
+    // a register.
+    Value* protect_size = Runtime::emitProtect(sequence, this);
+    Value* length = Runtime::emitForLoopLength(sequence, this);
+
+    // As in the interpreter, the variable is NULL if the loop doesn't run.
+    Runtime::emitAssignSymbolInCompiledFrame(emitSymbol(symbol),
+					     m_context->getEnvironment(),
+					     location, emitNullValue(), this);
+
+    if (isIntegerSequenceExpression(sequence_expr)
+	&& keepsLoopVariableLocal(body, symbol)) {
+	emitUnboxedForLoop(expression, symbol, location, sequence, length,
+			   body);
+    } else {
+	emitBoxedForLoop(symbol, location, sequence, length, body);
+    }
+    Runtime::emitRestoreProtectStack(protect_size, this);
+    return emitInvisibleNullValue();
+}
+
+void Compiler::emitBoxedForLoop(const Symbol* symbol, int location,
+				Value* sequence, Value* length,
+				const RObject* body)
+{
+    BasicBlock* continue_block = createBasicBlock("continue");
+    emitIndexedLoop(
+	length, body, continue_block,
+	[&](Value* index) {
+	    Value* element = Runtime::emitForLoopElement(sequence, index,
+							 this);
+	    Runtime::emitAssignSymbolInCompiledFrame(
+		emitSymbol(symbol), m_context->getEnvironment(), location,
+		element, this);
+	});
+}
+
+void Compiler::emitUnboxedForLoop(const Expression* expression,
+				  const Symbol* symbol, int location,
+				  Value* sequence, Value* length,
+				  const RObject* body)
+{
+    BasicBlock* integer_loop = createBasicBlock("for_integer");
+    BasicBlock* interpreted_loop = createBasicBlock("for_interpreted");
+    BasicBlock* loop_exit = createBasicBlock("for_exit");
+    BasicBlock* store_variable = createBasicBlock("for_store");
+    BasicBlock* continue_block = createBasicBlock("continue");
+
+    // ':' gives a real vector when the start isn't a whole number, and
+    // the sequence functions may have been redefined.  Leave those cases
+    // to the interpreter.
+    CreateCondBr(Runtime::emitIsIntegerVector(sequence, this),
+		 integer_loop, interpreted_loop,
+		 CreateBranchWeightsLikelyTaken(m_context->getLLVMContext()));
+
+    SetInsertPoint(interpreted_loop);
+    emitSpillUnboxedVariables();
+    Runtime::emitForLoopOverSequence(expression, sequence,
+				     m_context->getEnvironment(), this);
+    CreateBr(continue_block);
+
+    SetInsertPoint(integer_loop);
+    // Holds the variable's value when the loop exits, which may be via
+    // 'break'.
+    Value* last_value = emitEntryBlockAlloca(getInt32Ty(),
+					     symbol->name()->c_str());
+    emitIndexedLoop(
+	length, body, loop_exit,
+	[&](Value* index) {
+	    Value* value = Runtime::emitIntegerElement(sequence, index, this);
+	    CreateStore(value, last_value);
+	    m_unboxed_variables.push_back({ symbol, location, value });
+	});
+    m_unboxed_variables.pop_back();
+
+    // Store the final value of the variable in the frame.
+    CreateCondBr(CreateICmpSGT(length, getInt32(0)),
+		 store_variable, continue_block);
+
+    SetInsertPoint(store_variable);
+    Value* boxed_value = Runtime::emitBoxInteger(CreateLoad(last_value),
+						 this);
+    Runtime::emitAssignSymbolInCompiledFrame(emitSymbol(symbol),
+					     m_context->getEnvironment(),
+					     location, boxed_value, this);
+    CreateBr(continue_block);
+
+    SetInsertPoint(continue_block);
+}
+
+void Compiler::emitIndexedLoop(Value* length, const RObject* body,
+			       BasicBlock* continue_block,
+			       const std::function<void(Value*)>& bind_variable)
+{
+    BasicBlock* preheader = GetInsertBlock();
+    BasicBlock* loop_header = createBasicBlock("for_header", continue_block);
+    BasicBlock* loop_body = createBasicBlock("for_body", continue_block);
+    BasicBlock* loop_latch = createBasicBlock("for_latch", continue_block);
+
+    CreateBr(loop_header);
+
+    SetInsertPoint(loop_header);
+    PHINode* index = CreatePHI(getInt32Ty(), 2, "index");
+    index->addIncoming(getInt32(0), preheader);
+    CreateCondBr(CreateICmpSLT(index, length), loop_body, continue_block);
+
+    SetInsertPoint(loop_body);
+    bind_variable(index);
+    {
+	// 'next' goes to the latch, so that the index is incremented.
+	LoopScope loop(m_context,
+		       continue_block, loop_latch,
+		       this);
+	emitEval(body);
+    }
+    createBackEdge(loop_latch);
+
+    SetInsertPoint(loop_latch);
+    index->addIncoming(CreateAdd(index, getInt32(1)), loop_latch);
+    CreateBr(loop_header);
+
+    SetInsertPoint(continue_block);
+}
+
+bool Compiler::isIntegerSequenceExpression(const RObject* expression)
+{
+    static const Symbol* colon = Symbol::obtain(":");
+    static const Symbol* seq_len = Symbol::obtain("seq_len");
+    static const Symbol* seq_along = Symbol::obtain("seq_along");
+
+    const Expression* call = dynamic_cast<const Expression*>(expression);
+    if (!call) {
+	return false;
+    }
+    const RObject* function = call->car();
+    int length = listLength(call);
+    return (function == colon && length == 3)
+	|| ((function == seq_len || function == seq_along) && length == 2);
+}
+
+// Returns true if evaluating 'code' can't read or modify 'variable' other
+// than by evaluating it directly.  Only calls to functions that neither
+// capture nor modify their caller's environment are allowed.
+bool Compiler::keepsLoopVariableLocal(const RObject* code,
+				      const Symbol* variable)
+{
+    static const std::set<const Symbol*> local_functions = [] {
+	std::set<const Symbol*> symbols;
+	for (const char* name : {
+		"{", "(", "if", "while", "repeat", "break", "next", "return",
+		"for", "<-", "=", "+", "-", "*", "/", "^", "%%", "%/%",
+		"==", "!=", "<", "<=", ">=", ">", "!", "&", "|", "&&", "||",
+		"[", "[[", ":", "seq_len", "seq_along", "length", "abs",
+		"sqrt", "exp", "log", "floor", "ceiling", "is.na" }) {
+	    symbols.insert(Symbol::obtain(name));
+	}
+	return symbols;
+    }();
+    static const Symbol* assign = Symbol::obtain("<-");
+    static const Symbol* assign2 = Symbol::obtain("=");
+    static const Symbol* for_symbol = Symbol::obtain("for");
+
+    const Expression* call = dynamic_cast<const Expression*>(code);
+    if (!call) {
+	// Constants and symbols.  '...' may hold a promise for the variable.
+	return code != DotsSymbol
+	    && !dynamic_cast<const DottedArgs*>(code);
+    }
+    const Symbol* function = dynamic_cast<const Symbol*>(call->car());
+    if (!function || function == variable
+	|| local_functions.count(function) == 0) {
+	return false;
+    }
+    const PairList* args = call->tail();
+    if ((function == assign || function == assign2)
+	&& (!args || !dynamic_cast<const Symbol*>(args->car())
+	    || args->car() == variable)) {
+	return false;
+    }
+    if (!args) {
+	return true;
+    }
+    if (function == for_symbol && args->car() == variable) {
+	return false;
+    }
+    for (const ConsCell& argument : *args) {
+	if (!keepsLoopVariableLocal(argument.car(), variable)) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+const Compiler::UnboxedVariable* Compiler::findUnboxedVariable(
+    const RObject* expression) const
+{
+    for (auto it = m_unboxed_variables.rbegin();
+	 it != m_unboxed_variables.rend(); ++it) {
+	if (it->symbol == expression) {
+	    return &*it;
+	}
+    }
+    return nullptr;
+}
+
+void Compiler::emitSpillUnboxedVariables()
+{
+    for (const UnboxedVariable& variable : m_unboxed_variables) {
+	Value* boxed_value = Runtime::emitBoxInteger(variable.value, this);
+	Runtime::emitAssignSymbolInCompiledFrame(
+	    emitSymbol(variable.symbol), m_context->getEnvironment(),
+	    variable.location, boxed_value, this);
+    }
+}
+
+/*
+ * Arithmetic and comparison operators are only inlined when the interpreter
+ * has recorded the operand types at the call site, and has seen nothing but
+ * attribute-free integer or real scalars there.  The generated code checks
+ * that the operands still have the recorded types and computes the result
+ * without calling the builtin.  If a check fails, or the result is one that
+ * the builtin would warn about or return NA for, it deoptimizes by calling
+ * the builtin on the operands that have already been evaluated.
+ */
+namespace {
+const char* arithmeticOperatorName(unsigned opcode)
+{
+    switch (opcode) {
+    case PLUSOP: return "+";
+    case MINUSOP: return "-";
+    case TIMESOP: return "*";
+    case DIVOP: return "/";
+    }
+    return nullptr;
+}
+
+const char* comparisonOperatorName(unsigned opcode)
+{
+    switch (opcode) {
+    case EQOP: return "==";
+    case NEOP: return "!=";
+    case LTOP: return "<";
+    case LEOP: return "<=";
+    case GEOP: return ">=";
+    case GTOP: return ">";
+    }
+    return nullptr;
+}
+
+bool isNumericScalarKind(unsigned kinds)
+{
+    return kinds == TypeFeedback::SCALAR_INTEGER
+	|| kinds == TypeFeedback::SCALAR_REAL;
+}
+}  // namespace
+
+template<unsigned opcode>
+Value* Compiler::emitInlinedArithmetic(const Expression* expression)
+{
+    return emitSpecializedBinaryOp(expression, false, opcode);
+}
+
+template<unsigned opcode>
+Value* Compiler::emitInlinedComparison(const Expression* expression)
+{
+    return emitSpecializedBinaryOp(expression, true, opcode);
+}
+
+Value* Compiler::emitSpecializedBinaryOp(const Expression* expression,
+					 bool is_comparison, unsigned opcode)
+{
+    if (listLength(expression) != 3) {
+	// Unary operators and syntax errors are left to the interpreter.
+	return nullptr;
+    }
+    const PairList* args = expression->tail();
+    const RObject* lhs_expr = args->car();
+    const RObject* rhs_expr = args->tail()->car();
+    if (args->tag() || args->tail()->tag()
+	|| lhs_expr == DotsSymbol || rhs_expr == DotsSymbol
+	|| lhs_expr == Symbol::missingArgument()
+	|| rhs_expr == Symbol::missingArgument()) {
+	return nullptr;
+    }
+
+    // Only speculate when every call so far has had scalar operands of
+    // the same types.  Unboxed loop variables are known to be integers.
+    const UnboxedVariable* lhs_variable = findUnboxedVariable(lhs_expr);
+    const UnboxedVariable* rhs_variable = findUnboxedVariable(rhs_expr);
+    const TypeFeedback* feedback = expression->typeFeedback();
+    if (feedback && feedback->numSamples() == 0) {
+	feedback = nullptr;
+    }
+    unsigned lhs_kind = lhs_variable ? TypeFeedback::SCALAR_INTEGER
+	: feedback ? feedback->lhsKinds() : TypeFeedback::NONE;
+    unsigned rhs_kind = rhs_variable ? TypeFeedback::SCALAR_INTEGER
+	: feedback ? feedback->rhsKinds() : TypeFeedback::NONE;
+    if (!isNumericScalarKind(lhs_kind) || !isNumericScalarKind(rhs_kind)) {
+	return nullptr;
+    }
+    // Integer division returns a real, so only +, - and * are done in
+    // integer arithmetic.
+    bool integer_operation = lhs_kind == TypeFeedback::SCALAR_INTEGER
+	&& rhs_kind == TypeFeedback::SCALAR_INTEGER
+	&& (is_comparison || opcode != DIVOP);
+
+    BuiltInFunction* builtin = BuiltInFunction::obtainPrimitive(
+	is_comparison ? comparisonOperatorName(opcode)
+	: arithmeticOperatorName(opcode));
+
+    // Unboxed loop variables are used directly, and need no type check.
+    Value* lhs = lhs_variable ? nullptr : emitEval(lhs_expr);
+    Value* rhs = nullptr;
+    if (!rhs_variable) {
+	// Evaluating rhs may collect garbage, and lhs is only held in a
+	// register.
+	Value* protect_size = lhs ? Runtime::emitProtect(lhs, this) : nullptr;
+	rhs = emitEval(rhs_expr);
+	if (protect_size) {
+	    Runtime::emitRestoreProtectStack(protect_size, this);
+	}
+    }
+
+    BasicBlock* fast_path = createBasicBlock("specialized");
+    BasicBlock* deoptimize = createBasicBlock("deoptimize");
+    BasicBlock* merge_block = createBasicBlock("continue");
+
+    // Check that the operands have the expected types.
+    Value* operands_match = getTrue();
+    if (lhs) {
+	operands_match = CreateAnd(
+	    operands_match,
+	    CreateICmpEQ(Runtime::emitScalarKind(lhs, this),
+			 getInt32(lhs_kind)));
+    }
+    if (rhs) {
+	operands_match = CreateAnd(
+	    operands_match,
+	    CreateICmpEQ(Runtime::emitScalarKind(rhs, this),
+			 getInt32(rhs_kind)));
+    }
+    CreateCondBr(operands_match, fast_path, deoptimize,
+		 CreateBranchWeightsLikelyTaken(m_context->getLLVMContext()));
+
+    SetInsertPoint(fast_path);
+    Value* lhs_value = emitUnboxOperand(lhs, lhs_variable, lhs_kind);
+    Value* rhs_value = emitUnboxOperand(rhs, rhs_variable, rhs_kind);
+    Value* fast_value;
+    if (integer_operation) {
+	fast_value = emitIntegerBinaryOp(is_comparison, opcode,
+					 lhs_value, rhs_value, deoptimize);
+    } else {
+	if (lhs_kind == TypeFeedback::SCALAR_INTEGER) {
+	    lhs_value = emitIntegerToReal(lhs_value, deoptimize);
+	}
+	if (rhs_kind == TypeFeedback::SCALAR_INTEGER) {
+	    rhs_value = emitIntegerToReal(rhs_value, deoptimize);
+	}
+	fast_value = emitRealBinaryOp(is_comparison, opcode,
+				      lhs_value, rhs_value, deoptimize);
+    }
+    BasicBlock* fast_path_end = GetInsertBlock();
+    CreateBr(merge_block);
+
+    // The builtin records the operand types that caused the guard to fail,
+    // so that a later compilation can take them into account.
+    SetInsertPoint(deoptimize);
+    emitSpillUnboxedVariables();
+    if (lhs_variable) {
+	lhs = Runtime::emitBoxInteger(lhs_variable->value, this);
+    }
+    if (rhs_variable) {
+	rhs = Runtime::emitBoxInteger(rhs_variable->value, this);
+    }
+    Value* fallback_value = Runtime::emitApplyBinaryBuiltIn(
+	builtin, lhs, rhs, expression, m_context->getEnvironment(), this);
+    BasicBlock* deoptimize_end = GetInsertBlock();
+    CreateBr(merge_block);
+
+    SetInsertPoint(merge_block);
+    PHINode* result = CreatePHI(getType<RObject*>(), 2);
+    result->addIncoming(fast_value, fast_path_end);
+    result->addIncoming(fallback_value, deoptimize_end);
+    return result;
+}
+
+Value* Compiler::emitRealBinaryOp(bool is_comparison, unsigned opcode,
+				  Value* lhs, Value* rhs,
+				  BasicBlock* deoptimize)
+{
+    if (is_comparison) {
+	// Comparisons involving NA or NaN give NA.
+	emitDeoptimizeIf(CreateFCmpUNO(lhs, rhs), deoptimize);
+	Value* comparison;
+	switch (opcode) {
+	case EQOP: comparison = CreateFCmpOEQ(lhs, rhs); break;
+	case NEOP: comparison = CreateFCmpONE(lhs, rhs); break;
+	case LTOP: comparison = CreateFCmpOLT(lhs, rhs); break;
+	case LEOP: comparison = CreateFCmpOLE(lhs, rhs); break;
+	case GEOP: comparison = CreateFCmpOGE(lhs, rhs); break;
+	case GTOP: comparison = CreateFCmpOGT(lhs, rhs); break;
+	default:
+	    assert(0 && "Unexpected comparison operator.");
+	    return nullptr;
+	}
+	return Runtime::emitBoxLogical(comparison, this);
+    }
+
+    // As in the interpreter, NA and NaN propagate through IEEE arithmetic.
+    Value* value;
+    switch (opcode) {
+    case PLUSOP: value = CreateFAdd(lhs, rhs); break;
+    case MINUSOP: value = CreateFSub(lhs, rhs); break;
+    case TIMESOP: value = CreateFMul(lhs, rhs); break;
+    case DIVOP: value = CreateFDiv(lhs, rhs); break;
+    default:
+	assert(0 && "Unexpected arithmetic operator.");
+	return nullptr;
+    }
+    return Runtime::emitBoxReal(value, this);
+}
+
+Value* Compiler::emitIntegerBinaryOp(bool is_comparison, unsigned opcode,
+				     Value* lhs, Value* rhs,
+				     BasicBlock* deoptimize)
+{
+    Value* na = getInt32(NA_INTEGER);
+    emitDeoptimizeIf(CreateOr(CreateICmpEQ(lhs, na), CreateICmpEQ(rhs, na)),
+		     deoptimize);
+
+    if (is_comparison) {
+	Value* comparison;
+	switch (opcode) {
+	case EQOP: comparison = CreateICmpEQ(lhs, rhs); break;
+	case NEOP: comparison = CreateICmpNE(lhs, rhs); break;
+	case LTOP: comparison = CreateICmpSLT(lhs, rhs); break;
+	case LEOP: comparison = CreateICmpSLE(lhs, rhs); break;
+	case GEOP: comparison = CreateICmpSGE(lhs, rhs); break;
+	case GTOP: comparison = CreateICmpSGT(lhs, rhs); break;
+	default:
+	    assert(0 && "Unexpected comparison operator.");
+	    return nullptr;
+	}
+	return Runtime::emitBoxLogical(comparison, this);
+    }
+
+    llvm::Intrinsic::ID intrinsic;
+    switch (opcode) {
+    case PLUSOP: intrinsic = llvm::Intrinsic::sadd_with_overflow; break;
+    case MINUSOP: intrinsic = llvm::Intrinsic::ssub_with_overflow; break;
+    case TIMESOP: intrinsic = llvm::Intrinsic::smul_with_overflow; break;
+    default:
+	assert(0 && "Unexpected arithmetic operator.");
+	return nullptr;
+    }
+    llvm::Function* operation = llvm::Intrinsic::getDeclaration(
+	m_context->getModule(), intrinsic, getInt32Ty());
+    Value* value_and_overflow = CreateCall(operation, { lhs, rhs });
+    Value* value = CreateExtractValue(value_and_overflow, 0);
+    Value* overflow = CreateExtractValue(value_and_overflow, 1);
+
+    // The builtin gives NA with a warning on overflow, and for results that
+    // would be indistinguishable from NA.
+    emitDeoptimizeIf(CreateOr(overflow, CreateICmpEQ(value, na)), deoptimize);
+    return Runtime::emitBoxInteger(value, this);
+}
+
+Value* Compiler::emitUnboxOperand(Value* value,
+				  const UnboxedVariable* variable,
+				  unsigned kind)
+{
+    if (variable) {
+	return variable->value;
+    }
+    if (kind == TypeFeedback::SCALAR_REAL) {
+	return Runtime::emitScalarRealValue(value, this);
+    }
+    assert(kind == TypeFeedback::SCALAR_INTEGER);
+    return Runtime::emitScalarIntegerValue(value, this);
+}
+
+Value* Compiler::emitIntegerToReal(Value* value, BasicBlock* deoptimize)
+{
+    emitDeoptimizeIf(CreateICmpEQ(value, getInt32(NA_INTEGER)), deoptimize);
+    return CreateSIToFP(value, getDoubleTy());
+}
+
+void Compiler::emitDeoptimizeIf(Value* condition, BasicBlock* deoptimize)
+{
+    BasicBlock* continue_block = createBasicBlock("continue");
+    CreateCondBr(condition, deoptimize, continue_block,
+		 CreateBranchWeightsUnlikelyTaken(m_context->getLLVMContext()));
+    SetInsertPoint(continue_block);
+}
+
 BasicBlock* Compiler::emitLandingPad(PHINode* dispatch) {
     InsertPointGuard preserve_insert_point(*this);
 
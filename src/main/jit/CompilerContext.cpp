@@ -49,13 +49,19 @@ namespace JIT {
 CompilerContext::CompilerContext(const Closure* closure,
 				 llvm::Value* environment,
 				 llvm::Function* function,
-				 MCJITMemoryManager* memory_manager)
+				 MCJITMemoryManager* memory_manager,
+				 const FrameDescriptor* frame_descriptor,
+				 bool is_loop_entry,
+				 CompilationTier tier)
 {
     m_closure = closure;
     m_environment = environment;
     m_function = function;
     m_memory_manager = memory_manager;
-    m_frame_descriptor = new FrameDescriptor(closure);
+    m_is_loop_entry = is_loop_entry;
+    m_tier = tier;
+    m_frame_descriptor = frame_descriptor ? frame_descriptor
+	: new FrameDescriptor(closure);
 }
 
 CompilerContext::~CompilerContext() {
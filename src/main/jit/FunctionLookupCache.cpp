@@ -0,0 +1,85 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#define R_NO_REMAP
+#include "rho/jit/FunctionLookupCache.hpp"
+
+namespace rho {
+namespace JIT {
+
+FunctionBase* FunctionLookupCache::update(const Symbol* symbol,
+					  Environment* env)
+{
+    clear();
+    FunctionBase* function = findFunction(symbol, env);
+    if (!function || env->frame()->binding(symbol))
+	return function;
+
+    // Find the binding again, checking that nothing except a change that
+    // updates the generation count could give a different result.
+    for (Environment* enclosing = env->enclosingEnvironment(); enclosing;
+	 enclosing = enclosing->enclosingEnvironment()) {
+	const Frame* frame = enclosing->frame();
+	if (!frame->isLocked() && !frame->isOnSearchPath())
+	    return function;
+	const Frame::Binding* binding = frame->binding(symbol);
+	if (!binding)
+	    continue;
+	m_binding = binding;
+	if (cachedFunction() == function) {
+	    m_enclosing = env->enclosingEnvironment();
+	    m_frame = frame;
+	    m_generation = Environment::searchPathGeneration();
+	} else {
+	    // findFunction() skipped over this binding because it isn't a
+	    // function, but it could become one without a change to the
+	    // generation count.
+	    m_binding = nullptr;
+	}
+	return function;
+    }
+    return function;
+}
+
+void FunctionLookupCache::clear()
+{
+    m_enclosing = nullptr;
+    m_frame = nullptr;
+    m_binding = nullptr;
+}
+
+void FunctionLookupCache::detachReferents()
+{
+    clear();
+}
+
+void FunctionLookupCache::visitReferents(GCNode::const_visitor* v) const
+{
+    if (m_enclosing)
+	(*v)(m_enclosing);
+    if (m_frame)
+	(*v)(m_frame);
+}
+
+} // namespace JIT
+} // namespace rho
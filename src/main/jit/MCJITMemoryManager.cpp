@@ -42,12 +42,72 @@ static inline bool startsWith(const std::string& text,
 static const std::string symbol_prefix = "rho.symbol.";
 static const std::string primitive_prefix = "rho.primitive.";
 static const std::string internal_prefix = "rho.internal.";
+static const std::string constant_prefix = "rho.constant";
+static const std::string global_prefix = "rho.global";
 
 MCJITMemoryManager::MCJITMemoryManager(Module* module)
-    : m_module(module) { }
+    : m_module(module), m_num_names(0), m_code_size(0), m_data_size(0) { }
+
+uint8_t* MCJITMemoryManager::allocateCodeSection(uintptr_t size,
+						 unsigned alignment,
+						 unsigned section_id,
+						 StringRef section_name)
+{
+    m_code_size += size;
+    return SectionMemoryManager::allocateCodeSection(size, alignment,
+						     section_id, section_name);
+}
+
+uint8_t* MCJITMemoryManager::allocateDataSection(uintptr_t size,
+						 unsigned alignment,
+						 unsigned section_id,
+						 StringRef section_name,
+						 bool is_read_only)
+{
+    m_data_size += size;
+    return SectionMemoryManager::allocateDataSection(size, alignment,
+						     section_id, section_name,
+						     is_read_only);
+}
+
+void MCJITMemoryManager::renameModuleGlobals(const std::string& suffix)
+{
+    // Symbols, builtins and named globals have the same address in every
+    // module, so only the numbered globals need renaming.
+    decltype(m_mappings) mappings;
+    for (auto& mapping : m_mappings) {
+	std::string name = mapping.first;
+	if (startsWith(name, constant_prefix + ".")
+	    || startsWith(name, global_prefix + ".")) {
+	    name += "." + suffix;
+	    mapping.second.second->setName(name);
+	}
+	mappings[name] = mapping.second;
+    }
+    m_mappings.swap(mappings);
+}
+
+void MCJITMemoryManager::addGlobalsFrom(const MCJITMemoryManager& other)
+{
+    m_mappings.insert(other.m_mappings.begin(), other.m_mappings.end());
+}
+
+void MCJITMemoryManager::clearGlobals()
+{
+    decltype(m_mappings)().swap(m_mappings);
+}
 
 uint64_t MCJITMemoryManager::getSymbolAddress(const std::string& name)
 {
+    // This is called while generating machine code, which may be on the
+    // compilation thread, so it doesn't look anything up in the interpreter
+    // if it can avoid it.  getSymbol() and getBuiltIn() record the
+    // addresses of the objects they refer to.
+    auto mapping = m_mappings.find(name);
+    if (mapping != m_mappings.end()) {
+	return reinterpret_cast<uint64_t>(mapping->second.first);
+    }
+
     if (startsWith(name, symbol_prefix)) {
 	std::string symbol_name = name.substr(symbol_prefix.length());
 	return reinterpret_cast<uint64_t>(Symbol::obtain(symbol_name));
@@ -66,11 +126,6 @@ uint64_t MCJITMemoryManager::getSymbolAddress(const std::string& name)
 	    BuiltInFunction::obtainInternal(builtin_name));
     }
 
-    auto mapping = m_mappings.find(name);
-    if (mapping != m_mappings.end()) {
-	return reinterpret_cast<uint64_t>(mapping->second.first);
-    }
-
     return RTDyldMemoryManager::getSymbolAddress(name);
 }
 
@@ -83,9 +138,11 @@ GlobalVariable* MCJITMemoryManager::getSymbol(const Symbol* symbol)
     if (result) {
 	return result;
     }
-    return new GlobalVariable(*m_module, type, true,
-			      GlobalValue::ExternalLinkage, nullptr,
-			      name);
+    result = new GlobalVariable(*m_module, type, true,
+				GlobalValue::ExternalLinkage, nullptr,
+				name);
+    m_mappings[name] = std::make_pair(const_cast<Symbol*>(symbol), result);
+    return result;
 }
 
 GlobalVariable* MCJITMemoryManager::getBuiltIn(const BuiltInFunction* function)
@@ -100,15 +157,40 @@ GlobalVariable* MCJITMemoryManager::getBuiltIn(const BuiltInFunction* function)
     if (result) {
 	return result;
     }
-    return new GlobalVariable(*m_module, type, true,
-     			      GlobalValue::ExternalLinkage, nullptr,
-			      name);
+    result = new GlobalVariable(*m_module, type, true,
+				GlobalValue::ExternalLinkage, nullptr,
+				name);
+    m_mappings[name] = std::make_pair(
+	const_cast<BuiltInFunction*>(function), result);
+    return result;
+}
+
+GlobalVariable* MCJITMemoryManager::getConstant(const void* address)
+{
+    GlobalVariable*& result = m_constants[address];
+    if (result) {
+	return result;
+    }
+    // The type is opaque so that the optimizer doesn't make any assumptions
+    // about the size of the object.
+    LLVMContext& context = m_module->getContext();
+    static const char* type_name = "rho.Opaque";
+    StructType* type = m_module->getTypeByName(type_name);
+    if (!type) {
+	type = StructType::create(context, type_name);
+    }
+    std::string name = addCounter(constant_prefix);
+    result = new GlobalVariable(*m_module, type, true,
+				GlobalValue::ExternalLinkage, nullptr,
+				name);
+    m_mappings[name] = std::make_pair(const_cast<void*>(address), result);
+    return result;
 }
 
-static std::string addCounter(const std::string& prefix) {
-	// Create our own, unique name.
-	static int counter = 0;
-	return prefix + "." + std::to_string(++counter);
+std::string MCJITMemoryManager::addCounter(const std::string& prefix) {
+    // Create our own, unique name.  The counter belongs to the module so
+    // that the names don't depend on what else has been compiled.
+    return prefix + "." + std::to_string(++m_num_names);
 }
 
 GlobalVariable* MCJITMemoryManager::addGlobal(Type* type, void* address,
@@ -117,7 +199,7 @@ GlobalVariable* MCJITMemoryManager::addGlobal(Type* type, void* address,
 {
     std::string name = prefix;
     if (prefix.empty()) {
-	prefix = "rho.global";
+	prefix = global_prefix;
 	name = addCounter(prefix);
     }
     // Find a unique name in the global table.
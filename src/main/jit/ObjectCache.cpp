@@ -0,0 +1,179 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+
+#include "rho/jit/llvm.hpp"
+
+#define R_NO_REMAP
+#include "rho/jit/ObjectCache.hpp"
+
+#include "rho/jit/Runtime.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+namespace rho {
+namespace JIT {
+
+// Changing how the code is generated in a way that the IR doesn't show
+// (for example, in the MCJITMemoryManager) requires a new version.
+static const char* cache_format_version = "rho-jit-cache-2";
+
+static std::string md5Hash(llvm::StringRef text)
+{
+    llvm::MD5 md5;
+    md5.update(text);
+    llvm::MD5::MD5Result digest;
+    md5.final(digest);
+    llvm::SmallString<32> result;
+    llvm::MD5::stringifyResult(digest, result);
+    return result.str();
+}
+
+// Identifies the build of rho.  The runtime module is rebuilt whenever
+// the layout of the interpreter's classes might change.
+static const std::string& runtimeModuleHash()
+{
+    static const std::string* hash = [] {
+	std::string* result = new std::string;
+	auto buffer = llvm::MemoryBuffer::getFile(
+	    Runtime::getRuntimeModuleFilename());
+	if (buffer)
+	    *result = md5Hash((*buffer)->getBuffer());
+	return result;
+    }();
+    return *hash;
+}
+
+std::string ObjectCache::key(const llvm::Module* module, CompilationTier tier,
+			     const std::string& runtime_hash)
+{
+    std::string ir;
+    llvm::raw_string_ostream ir_stream(ir);
+    module->print(ir_stream, nullptr);
+    ir_stream.flush();
+
+    std::string text;
+    auto add = [&text](llvm::StringRef line) {
+	text += line;
+	text += "\n";
+    };
+    add(cache_format_version);
+    add(std::to_string(LLVM_VERSION));
+    add(llvm::sys::getProcessTriple());
+    add(llvm::sys::getHostCPUName());
+    add(runtime_hash);
+    add(tier == CompilationTier::OPTIMIZED ? "optimized" : "baseline");
+    add(ir);
+    return md5Hash(text);
+}
+
+// Each file starts with a line that repeats its key and gives the size and
+// hash of the object code that follows, so that files which have been
+// truncated or damaged are recompiled rather than loaded.
+static std::string objectHeader(const std::string& key,
+				llvm::StringRef object)
+{
+    return std::string(cache_format_version) + " " + key + " "
+	+ std::to_string(object.size()) + " " + md5Hash(object) + "\n";
+}
+
+std::unique_ptr<ObjectCache> ObjectCache::create(const llvm::Module* module,
+						 CompilationTier tier,
+						 const std::string& directory)
+{
+    if (directory.empty() || runtimeModuleHash().empty())
+	return nullptr;
+    std::string key = ObjectCache::key(module, tier, runtimeModuleHash());
+    std::string filename = directory + "/" + key + ".o";
+
+    std::unique_ptr<llvm::MemoryBuffer> object;
+    auto buffer = llvm::MemoryBuffer::getFile(filename, -1, false);
+    if (buffer) {
+	llvm::StringRef contents = (*buffer)->getBuffer();
+	std::size_t header_end = contents.find('\n');
+	if (header_end != llvm::StringRef::npos) {
+	    llvm::StringRef code = contents.substr(header_end + 1);
+	    if (contents.substr(0, header_end + 1) == objectHeader(key, code))
+		object = std::unique_ptr<llvm::MemoryBuffer>(
+		    llvm::MemoryBuffer::getMemBufferCopy(code, filename));
+	}
+    }
+    return std::unique_ptr<ObjectCache>(
+	new ObjectCache(key, filename, std::move(object)));
+}
+
+ObjectCache::ObjectCache(const std::string& key, const std::string& filename,
+			 std::unique_ptr<llvm::MemoryBuffer> object)
+    : m_key(key), m_filename(filename), m_object(std::move(object))
+{ }
+
+void ObjectCache::writeObject(llvm::StringRef object)
+{
+    // Other processes may be using the same directory, so write to a
+    // private file and rename it into place, which is atomic.
+    std::string temporary = m_filename + "." + std::to_string(getpid())
+	+ ".tmp";
+    {
+	std::string header = objectHeader(m_key, object);
+	std::ofstream file(temporary, std::ios::binary);
+	file.write(header.data(), header.size());
+	file.write(object.data(), object.size());
+	if (!file) {
+	    file.close();
+	    std::remove(temporary.c_str());
+	    return;
+	}
+    }
+    if (std::rename(temporary.c_str(), m_filename.c_str()) != 0)
+	std::remove(temporary.c_str());
+}
+
+#if (LLVM_VERSION >= 306)
+void ObjectCache::notifyObjectCompiled(const llvm::Module* module,
+				       llvm::MemoryBufferRef object)
+{
+    writeObject(object.getBuffer());
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+ObjectCache::getObject(const llvm::Module* module)
+{
+    return std::move(m_object);
+}
+#else
+void ObjectCache::notifyObjectCompiled(const llvm::Module* module,
+				       const llvm::MemoryBuffer* object)
+{
+    writeObject(object->getBuffer());
+}
+
+llvm::MemoryBuffer* ObjectCache::getObject(const llvm::Module* module)
+{
+    return m_object.release();
+}
+#endif
+
+} // namespace JIT
+} // namespace rho
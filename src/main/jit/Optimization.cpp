@@ -79,5 +79,50 @@ bool RemoveRedundantCallsToSetVisibility::runOnBasicBlock(
 // LLVM uses the address of the following variable, the value is unimportant.
 char RemoveRedundantCallsToSetVisibility::pass_id = 0;
 
+//------------------------------------------------------------------------------
+// Implementation of optimizeModule.
+
+#if (LLVM_VERSION >= 307)
+typedef llvm::legacy::PassManager ModulePassManager;
+typedef llvm::legacy::FunctionPassManager FunctionPassManager;
+#else
+typedef llvm::PassManager ModulePassManager;
+typedef llvm::FunctionPassManager FunctionPassManager;
+#endif
+
+void optimizeModule(llvm::Module* module, llvm::TargetMachine* target) {
+  llvm::PassManagerBuilder builder;
+  builder.OptLevel = 2;
+  builder.SizeLevel = 0;
+  builder.Inliner = llvm::createFunctionInliningPass(builder.OptLevel,
+                                                     builder.SizeLevel);
+  builder.LoopVectorize = true;
+  builder.SLPVectorize = true;
+
+  FunctionPassManager function_passes(module);
+  ModulePassManager module_passes;
+  // The vectorizers need to know about the target to do anything useful.
+#if (LLVM_VERSION >= 307)
+  function_passes.add(llvm::createTargetTransformInfoWrapperPass(
+      target->getTargetIRAnalysis()));
+  module_passes.add(llvm::createTargetTransformInfoWrapperPass(
+      target->getTargetIRAnalysis()));
+#else
+  target->addAnalysisPasses(function_passes);
+  target->addAnalysisPasses(module_passes);
+#endif
+  builder.populateFunctionPassManager(function_passes);
+  builder.populateModulePassManager(module_passes);
+
+  function_passes.doInitialization();
+  for (llvm::Function& function : *module) {
+    if (!function.isDeclaration()) {
+      function_passes.run(function);
+    }
+  }
+  function_passes.doFinalization();
+  module_passes.run(*module);
+}
+
 }  // namespace JIT
 }  // namespace rho
@@ -34,6 +34,9 @@
 
 #include "RuntimeImpl.cpp"
 
+#include <set>
+#include <vector>
+
 using namespace llvm;
 
 namespace rho {
@@ -126,6 +129,15 @@ Value* emitLookupFunction(Value* value, Value* environment,
     return compiler->emitCallOrInvoke(lookup_function, { value, environment });
 }
 
+Value* emitLookupFunctionCached(Value* symbol, Value* environment,
+				Value* cache, Compiler* compiler)
+{
+    Function* lookup_function = getDeclaration(
+	"rho_runtime_lookupFunctionCached", compiler);
+    return compiler->emitCallOrInvoke(lookup_function,
+				      { symbol, environment, cache });
+}
+
 Value* emitCallFunction(llvm::Value* function_base, llvm::Value* pairlist_args,
 			llvm::Value* call, llvm::Value* environment,
 			Compiler* compiler)
@@ -136,6 +148,70 @@ Value* emitCallFunction(llvm::Value* function_base, llvm::Value* pairlist_args,
 	{ function_base, pairlist_args, call, environment });
 }
 
+Value* emitApplyBinaryBuiltIn(const BuiltInFunction* function,
+			     Value* lhs, Value* rhs,
+			     const Expression* call,
+			     Value* environment,
+			     Compiler* compiler)
+{
+    Function* apply_builtin = getDeclaration(
+	"rho_runtime_applyBinaryBuiltIn", compiler);
+    return compiler->emitCallOrInvoke(
+	apply_builtin,
+	{ compiler->emitConstantPointer(function), lhs, rhs,
+	  compiler->emitConstantPointer(call), environment });
+}
+
+Value* emitForLoopSequence(Value* sequence, const Expression* call,
+			   Compiler* compiler)
+{
+    Function* for_loop_sequence = getDeclaration(
+	"rho_runtime_forLoopSequence", compiler);
+    return compiler->emitCallOrInvoke(
+	for_loop_sequence, { sequence, compiler->emitConstantPointer(call) });
+}
+
+Value* emitForLoopLength(Value* sequence, Compiler* compiler)
+{
+    Function* for_loop_length = getDeclaration(
+	"rho_runtime_forLoopLength", compiler);
+    // Never throws.
+    return compiler->CreateCall(for_loop_length, sequence);
+}
+
+Value* emitForLoopElement(Value* sequence, Value* index, Compiler* compiler)
+{
+    Function* for_loop_element = getDeclaration(
+	"rho_runtime_forLoopElement", compiler);
+    return compiler->emitCallOrInvoke(for_loop_element, { sequence, index });
+}
+
+Value* emitIsIntegerVector(Value* sequence, Compiler* compiler)
+{
+    Function* is_integer_vector = getDeclaration(
+	"rho_runtime_isIntegerVector", compiler);
+    // Never throws.
+    return compiler->CreateCall(is_integer_vector, sequence);
+}
+
+Value* emitIntegerElement(Value* sequence, Value* index, Compiler* compiler)
+{
+    Function* integer_element = getDeclaration(
+	"rho_runtime_integerElement", compiler);
+    // Never throws.
+    return compiler->CreateCall(integer_element, { sequence, index });
+}
+
+Value* emitForLoopOverSequence(const Expression* call, Value* sequence,
+			       Value* environment, Compiler* compiler)
+{
+    Function* for_loop = getDeclaration(
+	"rho_runtime_forLoopOverSequence", compiler);
+    return compiler->emitCallOrInvoke(
+	for_loop,
+	{ compiler->emitConstantPointer(call), sequence, environment });
+}
+
 llvm::Value* emitBreak(llvm::Value* environment, Compiler* compiler) {
     Function* do_break = getDeclaration(DO_BREAK, compiler);
     compiler->emitCallOrInvoke(do_break, { environment });
@@ -169,6 +245,19 @@ void emitIncrementNamed(llvm::Value* value, Compiler* compiler)
     compiler->CreateCall(incrementNamed, value);
 }
 
+Value* emitProtect(llvm::Value* value, Compiler* compiler)
+{
+    Function* protect = getDeclaration("rho_runtime_protect", compiler);
+    return compiler->emitCallOrInvoke(protect, value);
+}
+
+void emitRestoreProtectStack(llvm::Value* size, Compiler* compiler)
+{
+    Function* restore
+	= getDeclaration("rho_runtime_restoreProtectStack", compiler);
+    compiler->emitCallOrInvoke(restore, size);
+}
+
 void emitMaybeCheckForUserInterrupt(Compiler* compiler)
 {
     Function* maybe_check_for_interrupt
@@ -242,6 +331,47 @@ Value* emitIsAFunction(llvm::Value* object, Compiler* compiler)
      return compiler->emitCallOrInvoke(is_a_function, object);
 }
 
+Value* emitScalarKind(llvm::Value* object, Compiler* compiler)
+{
+    Function* scalar_kind = getDeclaration("rho_runtime_scalarKind", compiler);
+    // Never throws.
+    return compiler->CreateCall(scalar_kind, object);
+}
+
+Value* emitScalarRealValue(llvm::Value* object, Compiler* compiler)
+{
+    Function* real_value = getDeclaration("rho_runtime_scalarRealValue",
+					  compiler);
+    // Never throws.
+    return compiler->CreateCall(real_value, object);
+}
+
+Value* emitScalarIntegerValue(llvm::Value* object, Compiler* compiler)
+{
+    Function* integer_value = getDeclaration("rho_runtime_scalarIntegerValue",
+					     compiler);
+    // Never throws.
+    return compiler->CreateCall(integer_value, object);
+}
+
+Value* emitBoxReal(llvm::Value* value, Compiler* compiler)
+{
+    Function* box_real = getDeclaration("rho_runtime_boxReal", compiler);
+    return compiler->emitCallOrInvoke(box_real, value);
+}
+
+Value* emitBoxInteger(llvm::Value* value, Compiler* compiler)
+{
+    Function* box_integer = getDeclaration("rho_runtime_boxInteger", compiler);
+    return compiler->emitCallOrInvoke(box_integer, value);
+}
+
+Value* emitBoxLogical(llvm::Value* value, Compiler* compiler)
+{
+    Function* box_logical = getDeclaration("rho_runtime_boxLogical", compiler);
+    return compiler->emitCallOrInvoke(box_logical, value);
+}
+
 void emitError(const char* error_msg, llvm::ArrayRef<llvm::Value*> extra_args,
 	       Compiler* compiler)
 {
@@ -280,18 +410,27 @@ static void cleanupRuntimeModule(Module* module)
     }
 }
 
-static std::unique_ptr<Module> createRuntimeModule(LLVMContext& context)
+std::string getRuntimeModuleFilename()
 {
-    std::string module_filename = std::string(R_Home) + "/jit/RuntimeImpl.bc";
+    return std::string(R_Home) + "/jit/RuntimeImpl.bc";
+}
 
+static std::unique_ptr<Module> parseRuntimeModule(LLVMContext& context)
+{
     llvm::SMDiagnostic err;
     std::unique_ptr<Module> runtime_module
-        = llvm::parseIRFile(module_filename, err, context);
+        = llvm::parseIRFile(getRuntimeModuleFilename(), err, context);
     if (!runtime_module) {
 	// TODO(kmillar): better error handling
 	printf("parse failed\n");
 	exit(1);
     }
+    return runtime_module;
+}
+
+static std::unique_ptr<Module> createRuntimeModule(LLVMContext& context)
+{
+    std::unique_ptr<Module> runtime_module = parseRuntimeModule(context);
     cleanupRuntimeModule(runtime_module.get());
 
     return runtime_module;
@@ -304,14 +443,122 @@ static Module* getRuntimeModule(LLVMContext& context)
     return runtime_module;
 }
 
+// A copy of the runtime module that keeps the bodies of its functions, for
+// linkInRuntimeModule().  It is only loaded if something is optimized.
+static Module* getRuntimeModuleWithBodies(LLVMContext& context)
+{
+    static Module* runtime_module = parseRuntimeModule(context).release();
+    return runtime_module;
+}
+
 std::unique_ptr<llvm::Module> createModule(llvm::LLVMContext& context)
 {
     return std::unique_ptr<Module>(new Module("anonymous_module", context));
 }
 
+static void collectReferencedGlobals(const User* user,
+				     std::set<const GlobalValue*>* globals)
+{
+    for (const Value* operand : user->operands()) {
+	if (const GlobalValue* global = dyn_cast<GlobalValue>(operand)) {
+	    globals->insert(global);
+	} else if (const Constant* constant = dyn_cast<Constant>(operand)) {
+	    collectReferencedGlobals(constant, globals);
+	}
+    }
+}
+
+// A copy of a runtime function's body can only be used in another module
+// if everything that it refers to is already in the running process,
+// because nothing else is copied with it.
+static bool canCopyBody(const Function* function,
+			std::set<const GlobalValue*>* referenced)
+{
+    if (function->isDeclaration())
+	return false;
+    for (const BasicBlock& block : *function) {
+	for (const Instruction& instruction : block)
+	    collectReferencedGlobals(&instruction, referenced);
+    }
+#if (LLVM_VERSION > 306)
+    if (function->hasPersonalityFn())
+	collectReferencedGlobals(function, referenced);
+#endif
+    for (const GlobalValue* global : *referenced) {
+	const Function* callee = dyn_cast<Function>(global);
+	if (callee && callee->isIntrinsic())
+	    continue;
+	if (isa<GlobalAlias>(global) || global->hasLocalLinkage()
+	    || !llvm::sys::DynamicLibrary::SearchForAddressOfSymbol(
+		global->getName()))
+	    return false;
+    }
+    return true;
+}
+
+static GlobalValue* getOrInsertDeclaration(const GlobalValue* global,
+					   Module* module)
+{
+    GlobalValue* result = module->getNamedValue(global->getName());
+    if (result)
+	return result;
+    if (const Function* function = dyn_cast<Function>(global)) {
+	Function* declaration = Function::Create(function->getFunctionType(),
+						 Function::ExternalLinkage,
+						 function->getName(),
+						 module);
+	declaration->setAttributes(function->getAttributes());
+	return declaration;
+    }
+    const GlobalVariable* variable = cast<GlobalVariable>(global);
+    return new GlobalVariable(*module,
+			      variable->getType()->getElementType(),
+			      variable->isConstant(),
+			      GlobalValue::ExternalLinkage, nullptr,
+			      variable->getName());
+}
+
 void linkInRuntimeModule(llvm::Module* module)
 {
-    // Nothing needed.
+    // getDeclaration() only copies the declarations of runtime functions
+    // into the module, so the optimizer can't inline them.  Give them their
+    // bodies.  Functions that the copied bodies call are left as
+    // declarations.
+    Module* runtime_module = getRuntimeModuleWithBodies(module->getContext());
+    std::vector<Function*> declarations;
+    for (Function& function : *module) {
+	if (function.isDeclaration() && !function.isIntrinsic())
+	    declarations.push_back(&function);
+    }
+
+    for (Function* declaration : declarations) {
+	const Function* definition
+	    = runtime_module->getFunction(declaration->getName());
+	std::set<const GlobalValue*> referenced;
+	if (!definition || !canCopyBody(definition, &referenced))
+	    continue;
+
+	llvm::ValueToValueMapTy value_map;
+	for (const GlobalValue* global : referenced)
+	    value_map[global] = getOrInsertDeclaration(global, module);
+	auto argument = declaration->arg_begin();
+	for (auto runtime_argument = definition->arg_begin();
+	     runtime_argument != definition->arg_end();
+	     ++runtime_argument, ++argument) {
+	    value_map[&*runtime_argument] = &*argument;
+	}
+	llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+	llvm::CloneFunctionInto(declaration, definition, value_map,
+				true, returns);
+
+	// The running process already has this function, so there's no
+	// need to generate code for it if some calls aren't inlined.
+	declaration->setLinkage(GlobalValue::AvailableExternallyLinkage);
+    }
+
+    // The copied bodies may refer to the runtime module's debug
+    // information.
+    llvm::StripDebugInfo(*module);
 }
 
 StructType* getRhoType(const std::string& name, LLVMContext& context)
@@ -377,6 +624,7 @@ namespace ForceCodeEmission {
     FORCE_EMISSION(rho_runtime_lookupSymbol);
     FORCE_EMISSION(rho_runtime_lookupSymbolInCompiledFrame);
     FORCE_EMISSION(rho_runtime_lookupFunction);
+    FORCE_EMISSION(rho_runtime_lookupFunctionCached);
     FORCE_EMISSION(rho_runtime_callFunction);
     FORCE_EMISSION(rho_runtime_do_break);
     FORCE_EMISSION(rho_runtime_do_next);
@@ -384,6 +632,19 @@ namespace ForceCodeEmission {
     FORCE_EMISSION(rho_runtime_coerceToTrueOrFalse);
     FORCE_EMISSION(rho_runtime_is_function);
     FORCE_EMISSION(rho_runtime_setVisibility);
+    FORCE_EMISSION(rho_runtime_applyBinaryBuiltIn);
+    FORCE_EMISSION(rho_runtime_scalarKind);
+    FORCE_EMISSION(rho_runtime_scalarRealValue);
+    FORCE_EMISSION(rho_runtime_scalarIntegerValue);
+    FORCE_EMISSION(rho_runtime_boxReal);
+    FORCE_EMISSION(rho_runtime_boxInteger);
+    FORCE_EMISSION(rho_runtime_boxLogical);
+    FORCE_EMISSION(rho_runtime_forLoopSequence);
+    FORCE_EMISSION(rho_runtime_forLoopLength);
+    FORCE_EMISSION(rho_runtime_forLoopElement);
+    FORCE_EMISSION(rho_runtime_isIntegerVector);
+    FORCE_EMISSION(rho_runtime_integerElement);
+    FORCE_EMISSION(rho_runtime_forLoopOverSequence);
 }
 
 } // namespace Runtime
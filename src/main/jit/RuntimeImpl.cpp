@@ -24,17 +24,25 @@
 #define R_NO_REMAP
 
 #include "rho/ArgList.hpp"
+#include "rho/BuiltInFunction.hpp"
 #include "rho/Environment.hpp"
 #include "rho/Evaluator.hpp"
 #include "rho/Expression.hpp"
 #include "rho/Frame.hpp"
 #include "rho/FunctionBase.hpp"
+#include "rho/IntVector.hpp"
+#include "rho/LogicalVector.hpp"
 #include "rho/LoopBailout.hpp"
 #include "rho/LoopException.hpp"
 #include "rho/PairList.hpp"
+#include "rho/PlainContext.hpp"
+#include "rho/ProtectStack.hpp"
+#include "rho/RealVector.hpp"
 #include "rho/RObject.hpp"
 #include "rho/StackChecker.hpp"
 #include "rho/Symbol.hpp"
+#include "rho/TypeFeedback.hpp"
+#include "rho/jit/FunctionLookupCache.hpp"
 #include "Defn.h"
 
 /*
@@ -132,6 +140,13 @@ FunctionBase* rho_runtime_lookupFunction(const Symbol* symbol,
     return findFunction(symbol, environment, true);
 }
 
+FunctionBase* rho_runtime_lookupFunctionCached(const Symbol* symbol,
+						Environment* environment,
+						JIT::FunctionLookupCache* cache)
+{
+    return cache->lookup(symbol, environment);
+}
+
 RObject* rho_runtime_callFunction(const FunctionBase* function,
 				   const PairList* args, const Expression* call,
 				   Environment* environment)
@@ -142,6 +157,150 @@ RObject* rho_runtime_callFunction(const FunctionBase* function,
     return call->evaluateFunctionCall(function, environment, arglist);
 }
 
+/*
+ * Apply a binary builtin to operands that have already been evaluated.
+ * This is the fallback taken when a type guard in specialized code fails.
+ * As the builtin records the operand types at the call site, the next
+ * compilation of the function will see the types that defeated the guard.
+ */
+RObject* rho_runtime_applyBinaryBuiltIn(const BuiltInFunction* function,
+					 RObject* lhs, RObject* rhs,
+					 const Expression* call,
+					 Environment* environment)
+{
+    ArgList arglist({ lhs, rhs }, ArgList::EVALUATED);
+    return call->evaluateFunctionCall(function, environment, arglist);
+}
+
+int rho_runtime_scalarKind(const RObject* value) {
+    return TypeFeedback::classify(value);
+}
+
+// These may only be used on values that rho_runtime_scalarKind() has
+// classified as scalars of the corresponding type.
+double rho_runtime_scalarRealValue(const RObject* value) {
+    return *static_cast<const RealVector*>(value)->begin();
+}
+
+int rho_runtime_scalarIntegerValue(const RObject* value) {
+    return *static_cast<const IntVector*>(value)->begin();
+}
+
+RObject* rho_runtime_boxReal(double value) {
+    return RealVector::createScalar(value);
+}
+
+RObject* rho_runtime_boxInteger(int value) {
+    return IntVector::createScalar(value);
+}
+
+RObject* rho_runtime_boxLogical(bool value) {
+    return LogicalVector::createScalar(value);
+}
+
+/*
+ * Support for compiled for() loops.
+ * rho_runtime_forLoopSequence prepares the evaluated sequence in the same way
+ * as do_for(): factors are iterated over as character vectors, and the
+ * sequence is marked as shared so that the loop body can't modify it.
+ * Pairlists are converted to lists so that their elements can be indexed.
+ */
+RObject* rho_runtime_forLoopSequence(RObject* sequence, const Expression* call)
+{
+    if (Rf_inherits(sequence, "factor")) {
+	sequence = Rf_asCharacterFactor(sequence);
+    } else if (sequence && sequence->sexptype() == LISTSXP) {
+	sequence = Rf_coerceVector(sequence, VECSXP);
+    }
+    if (Rf_length(sequence) > 0) {
+	switch (sequence->sexptype()) {
+	case LGLSXP: case INTSXP: case REALSXP: case CPLXSXP:
+	case STRSXP: case RAWSXP: case VECSXP: case EXPRSXP:
+	    break;
+	default:
+	    Rf_errorcall(const_cast<Expression*>(call),
+			 _("invalid for() loop sequence"));
+	}
+    }
+    if (NAMED(sequence) < 2)
+	SET_NAMED(sequence, NAMED(sequence) + 1);
+    return sequence;
+}
+
+int rho_runtime_forLoopLength(RObject* sequence) {
+    return Rf_length(sequence);
+}
+
+// Returns the value to bind to the loop variable in the index'th iteration.
+RObject* rho_runtime_forLoopElement(RObject* sequence, int index)
+{
+    RObject* value;
+    switch (sequence->sexptype()) {
+    case EXPRSXP:
+	value = XVECTOR_ELT(sequence, index);
+	break;
+    case VECSXP:
+	value = VECTOR_ELT(sequence, index);
+	break;
+    case LGLSXP:
+	value = Rf_allocVector(LGLSXP, 1);
+	LOGICAL(value)[0] = LOGICAL(sequence)[index];
+	return value;
+    case INTSXP:
+	value = Rf_allocVector(INTSXP, 1);
+	INTEGER(value)[0] = INTEGER(sequence)[index];
+	return value;
+    case REALSXP:
+	value = Rf_allocVector(REALSXP, 1);
+	REAL(value)[0] = REAL(sequence)[index];
+	return value;
+    case CPLXSXP:
+	value = Rf_allocVector(CPLXSXP, 1);
+	COMPLEX(value)[0] = COMPLEX(sequence)[index];
+	return value;
+    case STRSXP:
+	value = Rf_allocVector(STRSXP, 1);
+	SET_STRING_ELT(value, 0, STRING_ELT(sequence, index));
+	return value;
+    case RAWSXP:
+	value = Rf_allocVector(RAWSXP, 1);
+	RAW(value)[0] = RAW(sequence)[index];
+	return value;
+    default:
+	// rho_runtime_forLoopSequence has already checked the type.
+	assert(0 && "Unexpected for() loop sequence type.");
+	return nullptr;
+    }
+    // Make sure the loop variable is not modified via other variables.
+    if (value)
+	SET_NAMED(value, 2);
+    return value;
+}
+
+bool rho_runtime_isIntegerVector(RObject* sequence) {
+    return sequence && sequence->sexptype() == INTSXP;
+}
+
+int rho_runtime_integerElement(RObject* sequence, int index) {
+    return INTEGER(sequence)[index];
+}
+
+// In src/main/eval.cpp
+extern "C++"
+SEXP R_forLoopOverSequence(SEXP call, SEXP op, SEXP args, SEXP rho,
+			   SEXP sequence);
+
+RObject* rho_runtime_forLoopOverSequence(const Expression* call,
+					  RObject* sequence,
+					  Environment* environment)
+{
+    static BuiltInFunction* op = BuiltInFunction::obtainPrimitive("for");
+    PlainContext context;
+    return R_forLoopOverSequence(const_cast<Expression*>(call), op,
+				 const_cast<PairList*>(call->tail()),
+				 environment, sequence);
+}
+
 void rho_runtime_do_break(Environment* environment) {
     if (!environment->loopActive())
 	Rf_error(_("no loop to break from"));
@@ -184,6 +343,17 @@ void rho_runtime_incrementNamed(RObject* object) {
     }
 }
 
+// Keeps a value that compiled code holds only in registers alive across
+// calls that may collect garbage.  Returns the size to restore the
+// protection stack to once the value is no longer needed.
+size_t rho_runtime_protect(RObject* object) {
+    return ProtectStack::protect(object);
+}
+
+void rho_runtime_restoreProtectStack(size_t size) {
+    ProtectStack::restoreSize(size);
+}
+
 void rho_runtime_maybeCheckForUserInterrupts() {
     Evaluator::maybeCheckForUserInterrupts();
 }
@@ -192,10 +362,6 @@ void rho_runtime_maybeCheckForUserInterrupts() {
 void Rf_error(const char*, ...) __attribute__((noreturn));
 void Rf_warning(const char*, ...);
 
-// To force the symbol to be emitted.
-// TODO(kmillar): remove this once BuiltInFunction is used in this file.
-void force_symbol_emission_built_in_function(BuiltInFunction*) { }
-
 RObject* rho_runtime_applydefine(RObject* call, RObject* op, RObject* args,
                                   RObject* rho) {
   return applydefine(call, op, args, rho);
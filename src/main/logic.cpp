@@ -46,6 +46,18 @@ namespace {
     LogicalVector* binaryLogic(int opcode, const LogicalVector* l,
 			       const LogicalVector* r)
     {
+	Kernels::LogicalOp op = (opcode == 1 ? Kernels::AND : Kernels::OR);
+	LogicalVector* ans = applyBinaryKernel<LogicalVector>(
+	    [=](Kernels::Operands operands, Logical* out,
+		const Logical* lhs, const Logical* rhs, size_t n) {
+		Kernels::logical(op, operands, reinterpret_cast<int*>(out),
+				 reinterpret_cast<const int*>(lhs),
+				 reinterpret_cast<const int*>(rhs), n);
+	    },
+	    GeneralBinaryAttributeCopier(), l, r);
+	if (ans)
+	    return ans;
+
 	switch (opcode) {
 	case 1:
 	    {
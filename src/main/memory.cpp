@@ -42,6 +42,7 @@
 #include "rho/ExpressionVector.hpp"
 #include "rho/FunctionContext.hpp"
 #include "rho/GCManager.hpp"
+#include "rho/GCNodeAllocator.hpp"
 #include "rho/IntVector.hpp"
 #include "rho/Frame.hpp"
 #include "rho/LogicalVector.hpp"
@@ -205,6 +206,76 @@ SEXP attribute_hidden do_gc(/*const*/ Expression* call, const BuiltInFunction* o
     return value;
 }
 
+/* Raw material for gc.stats(), which labels and tabulates it. */
+SEXP attribute_hidden do_gcstats(/*const*/ Expression* call, const BuiltInFunction* op, RObject* reset_)
+{
+    const int nkinds = GCManager::NUM_COLLECTION_KINDS;
+    const int nbuckets = GCManager::PauseStatistics::s_num_buckets;
+    GCStackRoot<> ans(allocVector(VECSXP, 7));
+    GCStackRoot<> nms(allocVector(STRSXP, 7));
+
+    SEXP pauses = allocVector(REALSXP, nkinds * 3);
+    SET_VECTOR_ELT(ans, 0, pauses);
+    SEXP histogram = allocVector(REALSXP, nkinds * nbuckets);
+    SET_VECTOR_ELT(ans, 1, histogram);
+    for (int k = 0; k < nkinds; k++) {
+	const GCManager::PauseStatistics& stats
+	    = GCManager::pauseStatistics(GCManager::CollectionKind(k));
+	REAL(pauses)[k] = double(stats.count);
+	REAL(pauses)[k + nkinds] = stats.total_seconds;
+	REAL(pauses)[k + 2 * nkinds] = stats.max_seconds;
+	for (int b = 0; b < nbuckets; b++)
+	    REAL(histogram)[k + b * nkinds] = double(stats.histogram[b]);
+    }
+
+    SEXP limits = allocVector(REALSXP, nbuckets);
+    SET_VECTOR_ELT(ans, 2, limits);
+    for (int b = 0; b < nbuckets - 1; b++)
+	REAL(limits)[b] = GCManager::PauseStatistics::bucketLimit(b);
+    REAL(limits)[nbuckets - 1] = R_PosInf;
+
+    SEXP nodes = allocVector(REALSXP, 4);
+    SET_VECTOR_ELT(ans, 3, nodes);
+    size_t collected = GCNode::numNodesCreated() - GCNode::numNodes();
+    REAL(nodes)[0] = double(GCNode::numNodes());
+    REAL(nodes)[1] = double(GCNode::numNodesCreated());
+    REAL(nodes)[2] = double(collected - GCNode::numNodesCollectedAsCycles());
+    REAL(nodes)[3] = double(GCNode::numNodesCollectedAsCycles());
+
+    std::vector<GCNodeAllocator::SizeClassStatistics> classes
+	= GCNodeAllocator::sizeClassStatistics();
+    int nclasses = int(classes.size());
+    SEXP sizes = allocVector(REALSXP, nclasses * 4);
+    SET_VECTOR_ELT(ans, 4, sizes);
+    for (int i = 0; i < nclasses; i++) {
+	REAL(sizes)[i] = double(classes[i].block_size);
+	REAL(sizes)[i + nclasses] = double(classes[i].superblocks);
+	REAL(sizes)[i + 2 * nclasses] = double(classes[i].blocks);
+	REAL(sizes)[i + 3 * nclasses] = double(classes[i].allocated_blocks);
+    }
+
+    unsigned int num_buckets, used_buckets;
+    GCNodeAllocator::allocationTableUsage(&num_buckets, &used_buckets);
+    SEXP table = allocVector(REALSXP, 2);
+    SET_VECTOR_ELT(ans, 5, table);
+    REAL(table)[0] = num_buckets;
+    REAL(table)[1] = used_buckets;
+
+    SEXP released = allocVector(REALSXP, 2);
+    SET_VECTOR_ELT(ans, 6, released);
+    REAL(released)[0] = double(GCNodeAllocator::bytesReleased());
+    REAL(released)[1] = GCNodeAllocator::numReleasedSuperblocks();
+
+    const char* names[] = {"pauses", "histogram", "limits", "nodes",
+			   "sizes", "table", "released"};
+    for (int i = 0; i < 7; i++)
+	SET_STRING_ELT(nms, i, mkChar(names[i]));
+    setAttrib(ans, R_NamesSymbol, nms);
+
+    if (asLogical(reset_) == TRUE)
+	GCManager::resetStatistics();
+    return ans;
+}
 
 static double gctimes[5], gcstarttimes[5];
 static Rboolean gctime_enabled = FALSE;
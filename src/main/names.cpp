@@ -552,7 +552,7 @@ new BuiltInFunction("save",	do_save,	0,	111,	6,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("saveToConn",	do_saveToConn,	0,	111,	6,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("load",	do_load,	0,	111,	2,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("loadFromConn2",do_loadFromConn2,0,	111,	3,	{PP_FUNCALL, PREC_FN,	0}),
-new BuiltInFunction("serializeToConn",	do_serializeToConn,	0,	111,	5,	{PP_FUNCALL, PREC_FN,	0}),
+new BuiltInFunction("serializeToConn",	do_serializeToConn,	0,	111,	6,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("unserializeFromConn",	do_unserializeFromConn,	0,	11,	2,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("deparse",	do_deparse,	0,	11,	5,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("dput",	do_dput,	0,	111,	3,	{PP_FUNCALL, PREC_FN,	0}),
@@ -564,6 +564,7 @@ new BuiltInFunction("print.function",do_printfunction,0,	111,	-1,	{PP_FUNCALL, P
 new BuiltInFunction("prmatrix",	do_prmatrix,	0,	111,	6,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("gc",		do_gc,		0,	11,	2,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("gcinfo",	do_gcinfo,	0,	11,	1,	{PP_FUNCALL, PREC_FN,	0}),
+new BuiltInFunction("gc.stats",	do_gcstats,	0,	11,	1,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("gctorture",	do_gctorture,	0,	111,	1,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("gctorture2",	do_gctorture2,	0,	11,	3,	{PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("memory.profile",do_memoryprofile, 0,	11,	0,	{PP_FUNCALL, PREC_FN,	0}),
@@ -710,6 +711,8 @@ new BuiltInFunction("POSIXlt2Date",do_POSIXlt2D,	0,	11,	1,	{PP_FUNCALL, PREC_FN,
 
 new BuiltInFunction("setNumMathThreads", do_setnumthreads,      0,      11,     1,      {PP_FUNCALL, PREC_FN, 0}),
 new BuiltInFunction("setMaxNumMathThreads", do_setmaxnumthreads,      0,      11,     1,      {PP_FUNCALL, PREC_FN, 0}),
+new BuiltInFunction("jit.info",  do_jitinfo,       0,      11,     1,      {PP_FUNCALL, PREC_FN, 0}),
+new BuiltInFunction("jit.stats", do_jitstats,      0,      11,     1,      {PP_FUNCALL, PREC_FN, 0}),
 
 /* Connections */
 new BuiltInFunction("stdin",	do_stdin,	0,      11,     0,      {PP_FUNCALL, PREC_FN,	0}),
@@ -735,6 +738,7 @@ new BuiltInFunction("fifo",	do_fifo,	0,      11,     4,      {PP_FUNCALL, PREC_F
 new BuiltInFunction("gzfile",	do_gzfile,	0,      11,     4,      {PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("bzfile",	do_gzfile,	1,      11,     4,      {PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("xzfile",	do_gzfile,	2,      11,     4,      {PP_FUNCALL, PREC_FN,	0}),
+new BuiltInFunction("chunkedfile",do_gzfile,	3,      11,     4,      {PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("unz",         do_unz,		0,      11,     3,      {PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("seek",	do_seek,	0,      11,     4,      {PP_FUNCALL, PREC_FN,	0}),
 new BuiltInFunction("truncate",	do_truncate,	0,      11,     1,      {PP_FUNCALL, PREC_FN,	0}),
@@ -1611,6 +1611,9 @@ S3Launcher::create(const RObject* object, std::string generic, std::string group
 	ans(new S3Launcher(generic, group, call_env, table_env));
     ans->m_classes = static_cast<StringVector*>(R_data_class2(
         const_cast<RObject*>(object)));
+    if (ans->findCachedMethod(allow_default))
+	return ans;
+    std::vector<Symbol*> symbols;
 
     // Look for pukka method.  Need to interleave looking for generic
     // and group methods, e.g. if class(x) is c("foo", "bar") then
@@ -1620,6 +1623,7 @@ S3Launcher::create(const RObject* object, std::string generic, std::string group
 	for (ans->m_index = 0; ans->m_index < len; ++ans->m_index) {
 	    const char *ss = Rf_translateChar((*ans->m_classes)[ans->m_index]);
 	    ans->m_symbol = Symbol::obtain(generic + "." + ss);
+	    symbols.push_back(ans->m_symbol);
 	    ans->m_function
 		= findMethod(ans->m_symbol, call_env, table_env).first;
 	    if (ans->m_function) {
@@ -1638,6 +1642,7 @@ S3Launcher::create(const RObject* object, std::string generic, std::string group
 	    if (!group.empty()) {
 		// Try for group method:
 		ans->m_symbol = Symbol::obtain(group + "." + ss);
+		symbols.push_back(ans->m_symbol);
 		ans->m_function
 		    = findMethod(ans->m_symbol, call_env, table_env).first;
 		if (ans->m_function) {
@@ -1650,9 +1655,11 @@ S3Launcher::create(const RObject* object, std::string generic, std::string group
     if (!ans->m_function && allow_default) {
 	// Look for default method:
 	ans->m_symbol = Symbol::obtain(generic + ".default");
+	symbols.push_back(ans->m_symbol);
 	ans->m_function = findMethod(ans->m_symbol, call_env, table_env).first;
     }
     if (!ans->m_function)
 	return nullptr;
+    ans->cacheMethod(symbols, allow_default);
     return ans;
 }
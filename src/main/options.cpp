@@ -34,8 +34,16 @@
 #include <Rinternals.h>
 
 #include "rho/ArgMatcher.hpp"
+#include "rho/ArithmeticFusion.hpp"
+#include "rho/ChunkedFile.hpp"
 #include "rho/Evaluator.hpp"
+#include "rho/GCManager.hpp"
+#include "rho/ParallelFor.hpp"
 #include "rho/StackChecker.hpp"
+#ifdef ENABLE_LLVM_JIT
+#include "rho/jit/CompilationQueue.hpp"
+#include "rho/jit/CompiledExpression.hpp"
+#endif
 
 using namespace rho;
 
@@ -250,11 +258,14 @@ void attribute_hidden InitOptions(void)
     SEXP val, v;
     char *p;
 
+    int num_options = 24;
 #ifdef HAVE_RL_COMPLETION_MATCHES
-    PROTECT(v = val = allocList(17));
-#else
-    PROTECT(v = val = allocList(16));
+    num_options++;
+#endif
+#ifdef ENABLE_LLVM_JIT
+    num_options += 6;
 #endif
+    PROTECT(v = val = allocList(num_options));
 
     SET_TAG(v, install("prompt"));
     SETCAR(v, mkString("> "));
@@ -326,6 +337,121 @@ void attribute_hidden InitOptions(void)
     SETCAR(v, ScalarLogical(R_CBoundsCheck));
     v = CDR(v);
 
+    p = getenv("R_GC_NUM_THREADS");
+    if (p && atoi(p) > 0)
+	GCManager::setMarkSweepThreads(atoi(p));
+
+    SET_TAG(v, install("rho.gc.threads"));
+    SETCAR(v, ScalarInteger(GCManager::markSweepThreads()));
+    v = CDR(v);
+
+    /* Setting either of these selects the adaptive threshold policy */
+    p = getenv("R_GC_TARGET_PAUSE_MS");
+    if (p && atof(p) > 0) {
+	GCManager::setTargetPause(atof(p)/1000);
+	GCManager::setThresholdPolicy(new GCManager::AdaptivePolicy);
+    }
+    p = getenv("R_GC_HEAP_OVERHEAD");
+    if (p && atof(p) > 0) {
+	GCManager::setHeapOverhead(atof(p));
+	GCManager::setThresholdPolicy(new GCManager::AdaptivePolicy);
+    }
+
+    SET_TAG(v, install("rho.gc.target_pause_ms"));
+    SETCAR(v, ScalarReal(1000*GCManager::targetPause()));
+    v = CDR(v);
+
+    SET_TAG(v, install("rho.gc.heap_overhead"));
+    SETCAR(v, ScalarReal(GCManager::heapOverhead()));
+    v = CDR(v);
+
+    p = getenv("R_GC_RELEASE_DELAY");
+    if (p && *p)
+	GCManager::setMemoryReleaseDelay(atof(p));
+
+    SET_TAG(v, install("rho.gc.release_delay"));
+    SETCAR(v, ScalarReal(GCManager::memoryReleaseDelay()));
+    v = CDR(v);
+
+    p = getenv("R_COMPRESS_THREADS");
+    if (p && *p && atoi(p) >= 0)
+	ChunkedFile::setNumThreads(atoi(p));
+
+    SET_TAG(v, install("rho.compress.threads"));
+    SETCAR(v, ScalarInteger(ChunkedFile::numThreads()));
+    v = CDR(v);
+
+    p = getenv("R_MATH_THREADS");
+    if (p && atoi(p) > 0)
+	ParallelFor::setNumThreads(atoi(p));
+
+    SET_TAG(v, install("rho.math.threads"));
+    SETCAR(v, ScalarInteger(ParallelFor::numThreads()));
+    v = CDR(v);
+
+    p = getenv("R_MATH_PARALLEL_THRESHOLD");
+    if (p && *p && atof(p) >= 0 && atof(p) <= R_XLEN_T_MAX)
+	ParallelFor::setThreshold(atof(p));
+
+    SET_TAG(v, install("rho.math.parallel_threshold"));
+    SETCAR(v, ScalarReal(ParallelFor::threshold()));
+    v = CDR(v);
+
+    p = getenv("R_MATH_FUSE");
+    ArithmeticFusion::setEnabled(p && strcmp(p, "yes") == 0);
+
+    SET_TAG(v, install("rho.math.fuse"));
+    SETCAR(v, ScalarLogical(ArithmeticFusion::isEnabled()));
+    v = CDR(v);
+
+#ifdef ENABLE_LLVM_JIT
+    p = getenv("R_JIT_QUEUE_DEPTH");
+    if (p && *p && atoi(p) >= 0)
+	JIT::CompilationQueue::setMaxDepth(atoi(p));
+
+    SET_TAG(v, install("rho.jit.queue_depth"));
+    SETCAR(v, ScalarInteger(JIT::CompilationQueue::maxDepth()));
+    v = CDR(v);
+
+    p = getenv("R_JIT_COMPILE_THRESHOLD");
+    if (p && *p && atoi(p) >= 0)
+	JIT::CompiledExpression::setCompileThreshold(atoi(p));
+    p = getenv("R_JIT_OPTIMIZE_THRESHOLD");
+    if (p && *p && atoi(p) >= 0)
+	JIT::CompiledExpression::setOptimizeThreshold(atoi(p));
+    p = getenv("R_JIT_OPTIMIZE_BACK_EDGES");
+    if (p && *p && atoi(p) >= 0)
+	JIT::CompiledExpression::setOptimizeBackEdgeThreshold(atoi(p));
+    p = getenv("R_JIT_LOOP_THRESHOLD");
+    if (p && *p && atoi(p) >= 0)
+	JIT::CompiledExpression::setLoopThreshold(atoi(p));
+
+    SET_TAG(v, install("rho.jit.compile_threshold"));
+    SETCAR(v, ScalarInteger(JIT::CompiledExpression::compileThreshold()));
+    v = CDR(v);
+
+    SET_TAG(v, install("rho.jit.optimize_threshold"));
+    SETCAR(v, ScalarInteger(JIT::CompiledExpression::optimizeThreshold()));
+    v = CDR(v);
+
+    SET_TAG(v, install("rho.jit.optimize_back_edges"));
+    SETCAR(v, ScalarInteger(
+	       JIT::CompiledExpression::optimizeBackEdgeThreshold()));
+    v = CDR(v);
+
+    SET_TAG(v, install("rho.jit.loop_threshold"));
+    SETCAR(v, ScalarInteger(JIT::CompiledExpression::loopThreshold()));
+    v = CDR(v);
+
+    p = getenv("R_JIT_CACHE_DIR");
+    if (p && *p)
+	JIT::CompilationQueue::setCacheDirectory(R_ExpandFileName(p));
+
+    SET_TAG(v, install("rho.jit.cache_dir"));
+    SETCAR(v, mkString(JIT::CompilationQueue::cacheDirectory().c_str()));
+    v = CDR(v);
+#endif
+
 #ifdef HAVE_RL_COMPLETION_MATCHES
     /* value from Rf_initialize_R */
     SET_TAG(v, install("rl_word_breaks"));
@@ -651,6 +777,101 @@ SEXP attribute_hidden do_options(SEXP call, SEXP op, SEXP args, SEXP rho)
 		R_CBoundsCheck = RHOCONSTRUCT(Rboolean, k);
 		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarLogical(k)));
 	    }
+	    else if (streql(CHAR(namei), "rho.gc.threads")) {
+		int k = asInteger(argi);
+		if (k == NA_INTEGER || k < 1)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		GCManager::setMarkSweepThreads(k);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarInteger(k)));
+	    }
+	    else if (streql(CHAR(namei), "rho.gc.target_pause_ms")) {
+		double ms = asReal(argi);
+		if (ISNAN(ms) || ms < 0)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		GCManager::setTargetPause(ms/1000);
+		GCManager::setThresholdPolicy(new GCManager::AdaptivePolicy);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarReal(ms)));
+	    }
+	    else if (streql(CHAR(namei), "rho.gc.heap_overhead")) {
+		double ratio = asReal(argi);
+		if (!R_FINITE(ratio) || ratio <= 0)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		GCManager::setHeapOverhead(ratio);
+		GCManager::setThresholdPolicy(new GCManager::AdaptivePolicy);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarReal(ratio)));
+	    }
+	    else if (streql(CHAR(namei), "rho.gc.release_delay")) {
+		double delay = asReal(argi);
+		if (ISNAN(delay))
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		GCManager::setMemoryReleaseDelay(delay);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarReal(delay)));
+	    }
+	    else if (streql(CHAR(namei), "rho.compress.threads")) {
+		int k = asInteger(argi);
+		if (k == NA_INTEGER || k < 0)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		ChunkedFile::setNumThreads(k);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarInteger(k)));
+	    }
+	    else if (streql(CHAR(namei), "rho.math.threads")) {
+		int k = asInteger(argi);
+		if (k == NA_INTEGER || k < 1)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		ParallelFor::setNumThreads(k);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarInteger(k)));
+	    }
+	    else if (streql(CHAR(namei), "rho.math.parallel_threshold")) {
+		double size = asReal(argi);
+		if (ISNAN(size) || size < 0 || size > R_XLEN_T_MAX)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		ParallelFor::setThreshold(size);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarReal(size)));
+	    }
+	    else if (streql(CHAR(namei), "rho.math.fuse")) {
+		if (TYPEOF(argi) != LGLSXP || LENGTH(argi) != 1)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		int k = asLogical(argi);
+		if (k == NA_LOGICAL)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		ArithmeticFusion::setEnabled(k);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarLogical(k)));
+	    }
+#ifdef ENABLE_LLVM_JIT
+	    else if (streql(CHAR(namei), "rho.jit.queue_depth")) {
+		int k = asInteger(argi);
+		if (k == NA_INTEGER || k < 0)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		JIT::CompilationQueue::setMaxDepth(k);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarInteger(k)));
+	    }
+	    else if (streql(CHAR(namei), "rho.jit.compile_threshold")
+		     || streql(CHAR(namei), "rho.jit.optimize_threshold")
+		     || streql(CHAR(namei), "rho.jit.optimize_back_edges")
+		     || streql(CHAR(namei), "rho.jit.loop_threshold")) {
+		int k = asInteger(argi);
+		if (k == NA_INTEGER || k < 0)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		if (streql(CHAR(namei), "rho.jit.compile_threshold"))
+		    JIT::CompiledExpression::setCompileThreshold(k);
+		else if (streql(CHAR(namei), "rho.jit.optimize_threshold"))
+		    JIT::CompiledExpression::setOptimizeThreshold(k);
+		else if (streql(CHAR(namei), "rho.jit.optimize_back_edges"))
+		    JIT::CompiledExpression::setOptimizeBackEdgeThreshold(k);
+		else
+		    JIT::CompiledExpression::setLoopThreshold(k);
+		SET_VECTOR_ELT(value, i, SetOption(tag, ScalarInteger(k)));
+	    }
+	    else if (streql(CHAR(namei), "rho.jit.cache_dir")) {
+		if (TYPEOF(argi) != STRSXP || LENGTH(argi) != 1
+		    || STRING_ELT(argi, 0) == NA_STRING)
+		    error(_("invalid value for '%s'"), CHAR(namei));
+		const char* directory = translateChar(STRING_ELT(argi, 0));
+		JIT::CompilationQueue::setCacheDirectory(
+		    *directory ? R_ExpandFileName(directory) : "");
+		SET_VECTOR_ELT(value, i, SetOption(tag, duplicate(argi)));
+	    }
+#endif
 	    else {
 		SET_VECTOR_ELT(value, i, SetOption(tag, duplicate(argi)));
 	    }
@@ -87,11 +87,69 @@ namespace {
 	    lhs, rhs);
     }
 
+    Kernels::ComparisonOp comparison_kernel_op(RELOP_TYPE code)
+    {
+	switch (code) {
+	case EQOP:
+	    return Kernels::EQ;
+	case NEOP:
+	    return Kernels::NE;
+	case LTOP:
+	    return Kernels::LT;
+	case GTOP:
+	    return Kernels::GT;
+	case LEOP:
+	    return Kernels::LE;
+	case GEOP:
+	    return Kernels::GE;
+	}
+	return Kernels::EQ;  // -Wall
+    }
+
+    // Use a vectorized kernel where there is one, returning a null
+    // pointer if none applies.
+    template <class V>
+    LogicalVector* relop_kernel(const V*, const V*, RELOP_TYPE)
+    {
+	return nullptr;
+    }
+
+    LogicalVector* relop_kernel(const IntVector* vl, const IntVector* vr,
+				RELOP_TYPE code)
+    {
+	Kernels::ComparisonOp op = comparison_kernel_op(code);
+	return applyBinaryKernel<LogicalVector>(
+	    [=](Kernels::Operands operands, Logical* out,
+		const int* l, const int* r, size_t n) {
+		Kernels::integerComparison(op, operands,
+					   reinterpret_cast<int*>(out),
+					   l, r, n);
+	    },
+	    GeneralBinaryAttributeCopier(), vl, vr);
+    }
+
+    LogicalVector* relop_kernel(const RealVector* vl, const RealVector* vr,
+				RELOP_TYPE code)
+    {
+	Kernels::ComparisonOp op = comparison_kernel_op(code);
+	return applyBinaryKernel<LogicalVector>(
+	    [=](Kernels::Operands operands, Logical* out,
+		const double* l, const double* r, size_t n) {
+		Kernels::realComparison(op, operands,
+					reinterpret_cast<int*>(out),
+					l, r, n);
+	    },
+	    GeneralBinaryAttributeCopier(), vl, vr);
+    }
+
     template <class V>
     LogicalVector* relop(const V* vl, const V* vr, RELOP_TYPE code)
     {
 	typedef typename V::value_type Value;
 
+	if (LogicalVector* ans = relop_kernel(vl, vr, code))
+	    return ans;
+
 	switch (code) {
 	case EQOP:
 	    return relop_aux(vl, vr,
@@ -139,6 +197,9 @@ SEXP do_relop(/*const*/ Expression* call,
 			  RObject* xarg, RObject* yarg)
 {
     GCStackRoot<> x(xarg), y(yarg);
+#ifdef ENABLE_LLVM_JIT
+    call->recordOperandTypes(x, y);
+#endif
 
     /* That symbols and calls were allowed was undocumented prior to
        R 2.5.0.  We deparse them as deparse() would, minus attributes */
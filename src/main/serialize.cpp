@@ -41,7 +41,16 @@
 #include <errno.h>
 
 #include <cstdarg>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
+#ifndef Win32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "rho/Closure.hpp"
 #include "rho/DottedArgs.hpp"
 #include "rho/ExpressionVector.hpp"
@@ -830,47 +839,105 @@ static void OutStringVec(R_outpstream_t stream, SEXP s, HashTable* ref_table)
 	WriteItem(STRING_ELT(s, i), ref_table, stream);
 }
 
-#include <rpc/types.h>
-// rpc/types.h #defines FALSE to 0.  rho needs to stop that:
-#undef FALSE
-
-#include <rpc/xdr.h>
+/* Vectors of integers, reals and complex numbers are written and read
+   as blocks of bytes.  In binary format, and in XDR format on
+   big-endian hosts, the bytes are those of the vector's storage; XDR
+   format on little-endian hosts needs their byte order reversed.  Blocks
+   are limited by the int length taken by OutBytes and InBytes. */
 
-#define CHUNK_SIZE 8096
+#define MAX_BLOCK_BYTES (1 << 30)
+#define SWAP_BUFFER_BYTES (1 << 16)
 
 #define min2(a, b) ((a) < (b)) ? (a) : (b)
 
+static R_INLINE bool needsByteSwap(R_pstream_format_t type)
+{
+#ifdef WORDS_BIGENDIAN
+    return false;
+#else
+    return type == R_pstream_xdr_format;
+#endif
+}
+
+static R_INLINE uint32_t swapBytes(uint32_t x)
+{
+    return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+static R_INLINE uint64_t swapBytes(uint64_t x)
+{
+    return (uint64_t(swapBytes(uint32_t(x))) << 32)
+	| swapBytes(uint32_t(x >> 32));
+}
+
+static void OutBlocks(R_outpstream_t stream, const void *data, R_xlen_t nbytes)
+{
+    char *p = static_cast<char *>(const_cast<void *>(data));
+    R_xlen_t done, thiss;
+    for (done = 0; done < nbytes; done += thiss) {
+	thiss = min2(MAX_BLOCK_BYTES, nbytes - done);
+	stream->OutBytes(stream, p + done, int(thiss));
+    }
+}
+
+static void InBlocks(R_inpstream_t stream, void *data, R_xlen_t nbytes)
+{
+    char *p = static_cast<char *>(data);
+    R_xlen_t done, thiss;
+    for (done = 0; done < nbytes; done += thiss) {
+	thiss = min2(MAX_BLOCK_BYTES, nbytes - done);
+	stream->InBytes(stream, p + done, int(thiss));
+    }
+}
+
+/* Write 'length' items of the same size as T, T being uint32_t or
+   uint64_t, in the byte order required by the stream. */
+template <typename T>
+static void OutItems(R_outpstream_t stream, const void *data, R_xlen_t length)
+{
+    if (!needsByteSwap(stream->type)) {
+	OutBlocks(stream, data, length * R_xlen_t(sizeof(T)));
+	return;
+    }
+    static T buf[SWAP_BUFFER_BYTES / sizeof(T)];
+    const char *p = static_cast<const char *>(data);
+    R_xlen_t done, thiss;
+    for (done = 0; done < length; done += thiss) {
+	thiss = min2(R_xlen_t(SWAP_BUFFER_BYTES / sizeof(T)), length - done);
+	for (R_xlen_t cnt = 0; cnt < thiss; cnt++) {
+	    T x;
+	    memcpy(&x, p + (done + cnt) * sizeof(T), sizeof(T));
+	    buf[cnt] = swapBytes(x);
+	}
+	stream->OutBytes(stream, buf, int(thiss * sizeof(T)));
+    }
+}
+
+/* Read 'length' items straight into 'data', then put them in native
+   byte order if necessary. */
+template <typename T>
+static void InItems(R_inpstream_t stream, void *data, R_xlen_t length)
+{
+    InBlocks(stream, data, length * R_xlen_t(sizeof(T)));
+    if (!needsByteSwap(stream->type))
+	return;
+    char *p = static_cast<char *>(data);
+    for (R_xlen_t cnt = 0; cnt < length; cnt++, p += sizeof(T)) {
+	T x;
+	memcpy(&x, p, sizeof(T));
+	x = swapBytes(x);
+	memcpy(p, &x, sizeof(T));
+    }
+}
+
 static R_INLINE void
 OutIntegerVec(R_outpstream_t stream, SEXP s, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-	static char buf[CHUNK_SIZE * sizeof(int)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-	for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(int)), XDR_ENCODE);
-	    for(int cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_int(&xdrs, INTEGER(s) + done + cnt))
-		    Rf_error(_("XDR write failed"));
-	    xdr_destroy(&xdrs);
-	    stream->OutBytes(stream, buf, int(sizeof(int) * thiss));
-	}
-	break;
-    }
     case R_pstream_binary_format:
-    {
-	/* write in chunks to avoid overflowing ints */
-	R_xlen_t done, thiss;
-	for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->OutBytes(stream, INTEGER(s) + done,
-			     int(sizeof(int) * thiss));
-	}
+	OutItems<uint32_t>(stream, INTEGER(s), length);
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    OutInteger(stream, INTEGER(s)[cnt]);
@@ -882,31 +949,9 @@ OutRealVec(R_outpstream_t stream, SEXP s, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-	static char buf[CHUNK_SIZE * sizeof(double)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(double)), XDR_ENCODE);
-	    for(int cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_double(&xdrs, REAL(s) + done + cnt))
-		    Rf_error(_("XDR write failed"));
-	    xdr_destroy(&xdrs);
-	    stream->OutBytes(stream, buf, int(sizeof(double) * thiss));
-	}
-	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->OutBytes(stream, REAL(s) + done,
-			     int(sizeof(double) * thiss));
-	}
+	OutItems<uint64_t>(stream, REAL(s), length);
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    OutReal(stream, REAL(s)[cnt]);
@@ -918,34 +963,10 @@ OutComplexVec(R_outpstream_t stream, SEXP s, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-	static char buf[CHUNK_SIZE * sizeof(Rcomplex)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-	Rcomplex *c = COMPLEX(s);
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(Rcomplex)), XDR_ENCODE);
-	    for(int cnt = 0; cnt < thiss; cnt++) {
-		if(!xdr_double(&xdrs, &(c[done+cnt].r)) ||
-		   !xdr_double(&xdrs, &(c[done+cnt].i)))
-		    Rf_error(_("XDR write failed"));
-	    }
-	    stream->OutBytes(stream, buf, int(sizeof(Rcomplex) * thiss));
-	    xdr_destroy(&xdrs);
-	}
-	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->OutBytes(stream, COMPLEX(s) + done,
-			     int(sizeof(Rcomplex) * thiss));
-	}
+	/* the real and imaginary parts are converted separately */
+	OutItems<uint64_t>(stream, COMPLEX(s), 2 * length);
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    OutComplex(stream, COMPLEX(s)[cnt]);
@@ -1131,14 +1152,8 @@ static void WriteItem (SEXP s, HashTable* ref_table, R_outpstream_t stream)
 	    switch (stream->type) {
 	    case R_pstream_xdr_format:
 	    case R_pstream_binary_format:
-	    {
-		R_xlen_t done, thiss;
-		for (done = 0; done < len; done += thiss) {
-		    thiss = min2(CHUNK_SIZE, len - done);
-		    stream->OutBytes(stream, RAW(s) + done, int( thiss));
-		}
+		OutBlocks(stream, RAW(s), len);
 		break;
-	    }
 	    default:
 		for (R_xlen_t ix = 0; ix < len; ix++)
 		    OutByte(stream, RAW(s)[ix]);
@@ -1237,37 +1252,14 @@ static SEXP InStringVec(R_inpstream_t stream, SEXP ref_table)
     return s;
 }
 
-/* use static buffer to reuse storage */
 static R_INLINE void
 InIntegerVec(R_inpstream_t stream, SEXP obj, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-	static char buf[CHUNK_SIZE * sizeof(int)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, buf, int(sizeof(int) * thiss));
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(int)), XDR_DECODE);
-	    for(int cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_int(&xdrs, INTEGER(obj) + done + cnt))
-		    Rf_error(_("XDR read failed"));
-	    xdr_destroy(&xdrs);
-	}
-	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, INTEGER(obj) + done,
-			    int(sizeof(int) * thiss));
-	}
+	InItems<uint32_t>(stream, INTEGER(obj), length);
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    INTEGER(obj)[cnt] = InInteger(stream);
@@ -1279,31 +1271,9 @@ InRealVec(R_inpstream_t stream, SEXP obj, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-	static char buf[CHUNK_SIZE * sizeof(double)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, buf, int(sizeof(double) * thiss));
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(double)), XDR_DECODE);
-	    for(R_xlen_t cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_double(&xdrs, REAL(obj) + done + cnt))
-		    Rf_error(_("XDR read failed"));
-	    xdr_destroy(&xdrs);
-	}
-	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, REAL(obj) + done,
-			    int(sizeof(double) * thiss));
-	}
+	InItems<uint64_t>(stream, REAL(obj), length);
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    REAL(obj)[cnt] = InReal(stream);
@@ -1315,40 +1285,16 @@ InComplexVec(R_inpstream_t stream, SEXP obj, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-	static char buf[CHUNK_SIZE * sizeof(Rcomplex)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-	Rcomplex *output = COMPLEX(obj);
-	for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, buf, int(sizeof(Rcomplex) * thiss));
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(Rcomplex)), XDR_DECODE);
-	    for(R_xlen_t cnt = 0; cnt < thiss; cnt++) {
-		if(!xdr_double(&xdrs, &(output[done+cnt].r)) ||
-		   !xdr_double(&xdrs, &(output[done+cnt].i)))
-		    Rf_error(_("XDR read failed"));
-	    }
-	    xdr_destroy(&xdrs);
-	}
-	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, COMPLEX(obj) + done,
-			    int(sizeof(Rcomplex) * thiss));
-	}
+	InItems<uint64_t>(stream, COMPLEX(obj), 2 * length);
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    COMPLEX(obj)[cnt] = InComplex(stream);
     }
 }
 
+
 static R_xlen_t ReadLENGTH (R_inpstream_t stream)
 {
     int len = InInteger(stream);
@@ -1676,13 +1622,7 @@ static SEXP ReadItem (SEXP ref_table, R_inpstream_t stream)
 	case RAWSXP:
 	    len = ReadLENGTH(stream);
 	    PROTECT(s = Rf_allocVector(RAWSXP, len));
-	    {
-	        R_xlen_t done, thiss;
-		for (done = 0; done < len; done += thiss) {
-		    thiss = min2(CHUNK_SIZE, len - done);
-		    stream->InBytes(stream, RAW(s) + done, int( thiss));
-		}
-	    }
+	    InBlocks(stream, RAW(s), len);
 	    break;
 	case S4SXP:
 	    PROTECT(s = Rf_allocS4Object());
@@ -2072,9 +2012,9 @@ static SEXP CallHook(SEXP x, SEXP fun)
    This became public in R 2.13.0, and that version added support for
    connections internally */
 SEXP attribute_hidden
-do_serializeToConn(/*const*/ Expression* call, const BuiltInFunction* op, RObject* object_, RObject* con_, RObject* ascii_, RObject* version_, RObject* refhook_)
+do_serializeToConn(/*const*/ Expression* call, const BuiltInFunction* op, RObject* object_, RObject* con_, RObject* ascii_, RObject* xdr_, RObject* version_, RObject* refhook_)
 {
-    /* serializeToConn(object, conn, ascii, version, hook) */
+    /* serializeToConn(object, conn, ascii, xdr, version, hook) */
 
     SEXP object, fun;
     Rboolean ascii, wasopen;
@@ -2092,6 +2032,7 @@ do_serializeToConn(/*const*/ Expression* call, const BuiltInFunction* op, RObjec
     ascii = RHOCONSTRUCT(Rboolean, INTEGER(ascii_)[0]);
     if (ascii == NA_LOGICAL) type = R_pstream_asciihex_format;
     else if (ascii) type = R_pstream_ascii_format;
+    else if (Rf_asLogical(xdr_) == FALSE) type = R_pstream_binary_format;
     else type = R_pstream_xdr_format;
 
     if (version_ == R_NilValue)
@@ -2443,6 +2384,18 @@ R_serialize(SEXP object, SEXP icon, SEXP ascii, SEXP Sversion, SEXP fun)
 }
 
 
+static SEXP unserializeFromMemory(const void *data, R_size_t length,
+				  SEXP fun)
+{
+    struct R_inpstream_st in;
+    struct membuf_st mbs;
+    SEXP (*hook)(SEXP, SEXP) = fun != R_NilValue ? CallHook : nullptr;
+
+    /* The stream only reads from the buffer. */
+    InitMemInPStream(&in, &mbs, const_cast<void *>(data), length, hook, fun);
+    return R_Unserialize(&in);
+}
+
 SEXP attribute_hidden R_unserialize(SEXP icon, SEXP fun)
 {
     struct R_inpstream_st in;
@@ -2456,11 +2409,7 @@ SEXP attribute_hidden R_unserialize(SEXP icon, SEXP fun)
 	return R_NilValue; /* -Wall */
     } else if (TYPEOF(icon) == RAWSXP) {
 	/* We might want to read from a long raw vector */
-	struct membuf_st mbs;
-	void *data = RAW(icon);
-	R_size_t length = XLENGTH(icon);
-	InitMemInPStream(&in, &mbs, data,  length, hook, fun);
-	return R_Unserialize(&in);
+	return unserializeFromMemory(RAW(icon), XLENGTH(icon), fun);
     } else {
 	Rconnection con = getConnection(Rf_asInteger(icon));
 	R_InitConnInPStream(&in, con, R_pstream_any_format, hook, fun);
@@ -2519,123 +2468,164 @@ static SEXP appendRawToFile(SEXP file, SEXP bytes)
     return val;
 }
 
-/* Interface to cache the pkg.rdb files */
+/* Interface to cache the pkg.rdb files.  Where possible the files are
+   mapped into memory, so that processes loading the same packages share
+   the pages, and values are decompressed and unserialized straight from
+   the mapping.  A database stays open until it is flushed.
+
+   Touching a mapped page beyond the end of a file that has since been
+   truncated raises SIGBUS, so before each fetch the file is checked
+   against the one that was mapped.  If it has been truncated, replaced
+   or rewritten (as when a package is reinstalled), it is mapped afresh,
+   and offsets beyond its end then raise an R error. */
+
+namespace {
+    class LazyLoadDB {
+    public:
+	explicit LazyLoadDB(const char *path);
+	~LazyLoadDB();
+
+	/* The bytes in the range specified by a position/length
+	   vector. */
+	const unsigned char *bytes(SEXP key, const char *path) const;
+
+	/* Is the file at path still the one that was opened? */
+	bool isCurrent(const char *path) const;
+    private:
+	unsigned char *m_data;
+	size_t m_size;
+#ifndef Win32
+	dev_t m_device;
+	ino_t m_inode;
+	time_t m_mtime;
+#endif
 
-#define NC 100
-static int used = 0;
-static char names[NC][PATH_MAX];
-static char *ptr[NC];
+	LazyLoadDB(const LazyLoadDB&) = delete;
+	LazyLoadDB& operator=(const LazyLoadDB&) = delete;
+    };
 
-SEXP attribute_hidden
-do_lazyLoadDBflush(/*const*/ Expression* call, const BuiltInFunction* op, RObject* file_)
-{
-    int i;
-    const char *cfile = CHAR(STRING_ELT(file_, 0));
+    typedef std::unordered_map<std::string,
+			       std::shared_ptr<const LazyLoadDB>>
+	LazyLoadDBCache;
 
-    /* fprintf(stderr, "flushing file %s", cfile); */
-    for (i = 0; i < used; i++)
-	if(strcmp(cfile, names[i]) == 0) {
-	    strcpy(names[i], "");
-	    free(ptr[i]);
-	    /* fprintf(stderr, " found at pos %d in cache", i); */
-	    break;
+    LazyLoadDBCache* lazyLoadDBCache()
+    {
+	static LazyLoadDBCache* cache = new LazyLoadDBCache();
+	return cache;
+    }
+}
+
+LazyLoadDB::LazyLoadDB(const char *path)
+    : m_data(nullptr), m_size(0)
+{
+#ifndef Win32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+	Rf_error(_("cannot open file '%s': %s"), path, strerror(errno));
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+	close(fd);
+	Rf_error(_("cannot open file '%s': %s"), path, strerror(errno));
+    }
+    m_size = size_t(sb.st_size);
+    m_device = sb.st_dev;
+    m_inode = sb.st_ino;
+    m_mtime = sb.st_mtime;
+    if (m_size > 0) {
+	void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+	    close(fd);
+	    Rf_error(_("cannot map file '%s': %s"), path, strerror(errno));
 	}
-    /* fprintf(stderr, "\n"); */
-    return R_NilValue;
+	m_data = static_cast<unsigned char *>(data);
+    }
+    close(fd);
+#else
+    FILE *fp = R_fopen(path, "rb");
+    if (!fp)
+	Rf_error(_("cannot open file '%s': %s"), path, strerror(errno));
+    if (fseek(fp, 0, SEEK_END) != 0) {
+	fclose(fp);
+	Rf_error(_("seek failed on %s"), path);
+    }
+    m_size = size_t(ftell(fp));
+    m_data = static_cast<unsigned char *>(malloc(m_size ? m_size : 1));
+    if (!m_data) {
+	fclose(fp);
+	Rf_error(_("cannot allocate buffer for '%s'"), path);
+    }
+    if (fseek(fp, 0, SEEK_SET) != 0
+	|| fread(m_data, 1, m_size, fp) != m_size) {
+	fclose(fp);
+	free(m_data);
+	Rf_error(_("read failed on %s"), path);
+    }
+    fclose(fp);
+#endif
 }
 
+LazyLoadDB::~LazyLoadDB()
+{
+#ifndef Win32
+    if (m_data)
+	munmap(m_data, m_size);
+#else
+    free(m_data);
+#endif
+}
 
-/* Reads, in binary mode, the bytes in the range specified by a
-   position/length vector and returns them as raw vector. */
-
-/* There are some large lazy-data examples, e.g. 80Mb for SNPMaP.cdm */
-#define LEN_LIMIT 10*1048576
-static SEXP readRawFromFile(SEXP file, SEXP key)
+bool LazyLoadDB::isCurrent(const char *path) const
 {
-    FILE *fp;
-    int offset, len, in, i, icache = -1;
-    long filelen;
-    SEXP val;
-    const char *cfile = CHAR(STRING_ELT(file, 0));
+#ifndef Win32
+    struct stat sb;
+    return stat(path, &sb) == 0 && size_t(sb.st_size) == m_size
+	&& sb.st_dev == m_device && sb.st_ino == m_inode
+	&& sb.st_mtime == m_mtime;
+#else
+    /* The file was read into memory. */
+    return true;
+#endif
+}
 
-    if (! IS_PROPER_STRING(file))
-	Rf_error(_("not a proper file name"));
+const unsigned char *LazyLoadDB::bytes(SEXP key, const char *path) const
+{
     if (TYPEOF(key) != INTSXP || LENGTH(key) != 2)
 	Rf_error(_("bad offset/length argument"));
+    int offset = INTEGER(key)[0];
+    int len = INTEGER(key)[1];
+    if (offset < 0 || len < 0 || size_t(offset) + size_t(len) > m_size)
+	Rf_error(_("lazy-load database '%s' is corrupt"), path);
+    return m_data + offset;
+}
 
-    offset = INTEGER(key)[0];
-    len = INTEGER(key)[1];
-
-    val = Rf_allocVector(RAWSXP, len);
-    /* Do we have this database cached? */
-    for (i = 0; i < used; i++)
-	if(strcmp(cfile, names[i]) == 0) {icache = i; break;}
-    if (icache >= 0) {
-	memcpy(RAW(val), ptr[icache]+offset, len);
-	return val;
-    }
-
-    /* find a vacant slot? */
-    for (i = 0; i < used; i++)
-	if(strcmp("", names[i]) == 0) {icache = i; break;}
-    if(icache < 0 && used < NC) icache = used++;
-
-    if(icache >= 0) {
-	if ((fp = R_fopen(cfile, "rb")) == nullptr)
-	    Rf_error(_("cannot open file '%s': %s"), cfile, strerror(errno));
-	if (fseek(fp, 0, SEEK_END) != 0) {
-	    fclose(fp);
-	    Rf_error(_("seek failed on %s"), cfile);
-	}
-	filelen = ftell(fp);
-	if (filelen < LEN_LIMIT) {
-	    char *p;
-	    /* fprintf(stderr, "adding file '%s' at pos %d in cache, length %d\n",
-	       cfile, icache, filelen); */
-	    p = static_cast<char *>( malloc(filelen));
-	    if (p) {
-		strcpy(names[icache], cfile);
-		ptr[icache] = p;
-		if (fseek(fp, 0, SEEK_SET) != 0) {
-		    fclose(fp);
-		    Rf_error(_("seek failed on %s"), cfile);
-		}
-		in = int( fread(p, 1, filelen, fp));
-		fclose(fp);
-		if (filelen != in) Rf_error(_("read failed on %s"), cfile);
-		memcpy(RAW(val), p+offset, len);
-	    } else {
-		if (fseek(fp, offset, SEEK_SET) != 0) {
-		    fclose(fp);
-		    Rf_error(_("seek failed on %s"), cfile);
-		}
-		in = int( fread(RAW(val), 1, len, fp));
-		fclose(fp);
-		if (len != in) Rf_error(_("read failed on %s"), cfile);
-	    }
-	    return val;
-	} else {
-	    if (fseek(fp, offset, SEEK_SET) != 0) {
-		fclose(fp);
-		Rf_error(_("seek failed on %s"), cfile);
-	    }
-	    in = int( fread(RAW(val), 1, len, fp));
-	    fclose(fp);
-	    if (len != in) Rf_error(_("read failed on %s"), cfile);
-	    return val;
+/* Returns the cached database held in a file, opening it if need be. */
+static std::shared_ptr<const LazyLoadDB> lazyLoadDB(SEXP file)
+{
+    if (! IS_PROPER_STRING(file))
+	Rf_error(_("not a proper file name"));
+    const char *cfile = CHAR(STRING_ELT(file, 0));
+    std::shared_ptr<const LazyLoadDB>& db = (*lazyLoadDBCache())[cfile];
+    if (db && !db->isCurrent(cfile))
+	db.reset();
+    if (!db) {
+	try {
+	    db = std::make_shared<const LazyLoadDB>(cfile);
+	} catch (...) {
+	    lazyLoadDBCache()->erase(cfile);
+	    throw;
 	}
     }
+    return db;
+}
 
-    if ((fp = R_fopen(cfile, "rb")) == nullptr)
-	Rf_error(_("cannot open file '%s': %s"), cfile, strerror(errno));
-    if (fseek(fp, offset, SEEK_SET) != 0) {
-	fclose(fp);
-	Rf_error(_("seek failed on %s"), cfile);
-    }
-    in = int( fread(RAW(val), 1, len, fp));
-    fclose(fp);
-    if (len != in) Rf_error(_("read failed on %s"), cfile);
-    return val;
+SEXP attribute_hidden
+do_lazyLoadDBflush(/*const*/ Expression* call, const BuiltInFunction* op, RObject* file_)
+{
+    const char *cfile = CHAR(STRING_ELT(file_, 0));
+
+    /* A fetch in progress keeps its own reference to the database. */
+    lazyLoadDBCache()->erase(cfile);
+    return R_NilValue;
 }
 
 /* Gets the binding values of variables from a frame and returns them
@@ -2685,11 +2675,11 @@ static SEXP R_getVarsFromFrame(SEXP vars, SEXP env, SEXP forcesxp)
 
 /* from connections.c */
 SEXP R_compress1(SEXP in);
-SEXP R_decompress1(SEXP in, Rboolean *err);
+SEXP R_decompress1(const unsigned char *in, size_t inlen, Rboolean *err);
 SEXP R_compress2(SEXP in);
-SEXP R_decompress2(SEXP in, Rboolean *err);
+SEXP R_decompress2(const unsigned char *in, size_t inlen, Rboolean *err);
 SEXP R_compress3(SEXP in);
-SEXP R_decompress3(SEXP in, Rboolean *err);
+SEXP R_decompress3(const unsigned char *in, size_t inlen, Rboolean *err);
 
 /* Serializes and, optionally, compresses a value and appends the
    result to a file.  Returns the key position/length key for
@@ -2724,7 +2714,6 @@ SEXP attribute_hidden
 do_lazyLoadDBfetch(/*const*/ Expression* call, const BuiltInFunction* op, RObject* key_, RObject* file_, RObject* compressed_, RObject* hook_)
 {
     SEXP key, file, compsxp, hook;
-    PROTECT_INDEX vpi;
     int compressed;
     Rboolean err = FALSE;
     SEXP val;
@@ -2735,18 +2724,25 @@ do_lazyLoadDBfetch(/*const*/ Expression* call, const BuiltInFunction* op, RObjec
     hook = hook_;
     compressed = Rf_asInteger(compsxp);
 
-    PROTECT_WITH_INDEX(val = readRawFromFile(file, key), &vpi);
-    if (compressed == 3)
-	REPROTECT(val = R_decompress3(val, &err), vpi);
-    else if (compressed == 2)
-	REPROTECT(val = R_decompress2(val, &err), vpi);
-    else if (compressed)
-	REPROTECT(val = R_decompress1(val, &err), vpi);
-    if (err) Rf_error("lazy-load database '%s' is corrupt",
-		      CHAR(STRING_ELT(file, 0)));
-    val = R_unserialize(val, hook);
+    std::shared_ptr<const LazyLoadDB> db = lazyLoadDB(file);
+    const unsigned char *bytes = db->bytes(key, CHAR(STRING_ELT(file, 0)));
+    size_t len = size_t(INTEGER(key)[1]);
+    if (compressed) {
+	if (compressed == 3)
+	    val = R_decompress3(bytes, len, &err);
+	else if (compressed == 2)
+	    val = R_decompress2(bytes, len, &err);
+	else
+	    val = R_decompress1(bytes, len, &err);
+	if (err) Rf_error("lazy-load database '%s' is corrupt",
+			  CHAR(STRING_ELT(file, 0)));
+	PROTECT(val);
+	val = R_unserialize(val, hook);
+	UNPROTECT(1);
+    } else
+	val = unserializeFromMemory(bytes, len, hook);
+    PROTECT(val);
     if (TYPEOF(val) == PROMSXP) {
-	REPROTECT(val, vpi);
 	val = Rf_eval(val, R_GlobalEnv);
 	SET_NAMED(val, 2);
     }
@@ -104,12 +104,15 @@ using namespace rho;
 
 /* EnlargeVector() takes a vector "x" and changes its length to "newlen".
    This allows to assign values "past the end" of the vector or list.
-   Note that, unlike S, we only extend as much as is necessary.
+   Note that, unlike S, we only extend as much as is necessary.  But
+   "x", which must not be shared, is given spare capacity when it has
+   to be reallocated, so that it can then be extended in place:
+   appending to a vector an element at a time is therefore not
+   quadratic.
 */
 static SEXP EnlargeVector(SEXP x, R_xlen_t newlen)
 {
-    R_xlen_t i, len;
-    SEXP newx, names, newnames;
+    R_xlen_t len;
 
     /* Sanity Checks */
     if (!isVector(x))
@@ -120,74 +123,28 @@ static SEXP EnlargeVector(SEXP x, R_xlen_t newlen)
     if (LOGICAL(GetOption1(install("check.bounds")))[0])
 	warning(_("assignment outside vector/list limits (extending from %d to %d)"),
 		len, newlen);
-    PROTECT(x);
-    PROTECT(newx = allocVector(TYPEOF(x), newlen));
 
-    /* Copy the elements into place. */
     switch(TYPEOF(x)) {
     case LGLSXP:
+	return VectorBase::enlarge(static_cast<LogicalVector*>(x), newlen);
     case INTSXP:
-	for (i = 0; i < len; i++)
-	    INTEGER(newx)[i] = INTEGER(x)[i];
-	for (i = len; i < newlen; i++)
-	    INTEGER(newx)[i] = NA_INTEGER;
-	break;
+	return VectorBase::enlarge(static_cast<IntVector*>(x), newlen);
     case REALSXP:
-	for (i = 0; i < len; i++)
-	    REAL(newx)[i] = REAL(x)[i];
-	for (i = len; i < newlen; i++)
-	    REAL(newx)[i] = NA_REAL;
-	break;
+	return VectorBase::enlarge(static_cast<RealVector*>(x), newlen);
     case CPLXSXP:
-	for (i = 0; i < len; i++)
-	    COMPLEX(newx)[i] = COMPLEX(x)[i];
-	for (i = len; i < newlen; i++) {
-	    COMPLEX(newx)[i].r = NA_REAL;
-	    COMPLEX(newx)[i].i = NA_REAL;
-	}
-	break;
+	return VectorBase::enlarge(static_cast<ComplexVector*>(x), newlen);
     case STRSXP:
-	for (i = 0; i < len; i++)
-	    SET_STRING_ELT(newx, i, STRING_ELT(x, i));
-	for (i = len; i < newlen; i++)
-	    SET_STRING_ELT(newx, i, NA_STRING); /* was R_BlankString  < 1.6.0 */
-	break;
+	return VectorBase::enlarge(static_cast<StringVector*>(x), newlen);
     case EXPRSXP:
-	for (i = 0; i < len; i++)
-	    SET_XVECTOR_ELT(newx, i, XVECTOR_ELT(x, i));
-	for (i = len; i < newlen; i++)
-	    SET_XVECTOR_ELT(newx, i, R_NilValue);
-	break;
+	return VectorBase::enlarge(static_cast<ExpressionVector*>(x), newlen);
     case VECSXP:
-	for (i = 0; i < len; i++)
-	    SET_VECTOR_ELT(newx, i, VECTOR_ELT(x, i));
-	for (i = len; i < newlen; i++)
-	    SET_VECTOR_ELT(newx, i, R_NilValue);
-	break;
+	return VectorBase::enlarge(static_cast<ListVector*>(x), newlen);
     case RAWSXP:
-	for (i = 0; i < len; i++)
-	    RAW(newx)[i] = RAW(x)[i];
-	for (i = len; i < newlen; i++)
-	    RAW(newx)[i] = Rbyte( 0);
-	break;
+	return VectorBase::enlarge(static_cast<RawVector*>(x), newlen);
     default:
 	UNIMPLEMENTED_TYPE("EnlargeVector", x);
     }
-
-    /* Adjust the attribute list. */
-    names = getAttrib(x, R_NamesSymbol);
-    if (!isNull(names)) {
-	PROTECT(newnames = allocVector(STRSXP, newlen));
-	for (i = 0; i < len; i++)
-	    SET_STRING_ELT(newnames, i, STRING_ELT(names, i));
-	for (i = len; i < newlen; i++)
-	    SET_STRING_ELT(newnames, i, R_BlankString);
-	setAttrib(newx, R_NamesSymbol, newnames);
-	UNPROTECT(1);
-    }
-    copyMostAttrib(x, newx);
-    UNPROTECT(2);
-    return newx;
+    return nullptr;  // -Wall
 }
 
 /* used instead of coerceVector to embed a non-vector in a list for
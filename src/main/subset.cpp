@@ -49,7 +49,9 @@
 #include <Internal.h>
 #include "rho/ComplexVector.hpp"
 #include "rho/ExpressionVector.hpp"
+#include "rho/Frame.hpp"
 #include "rho/GCStackRoot.hpp"
+#include "rho/IntegerSequence.hpp"
 #include "rho/Promise.hpp"
 #include "rho/RawVector.hpp"
 #include "rho/Subscripting.hpp"
@@ -370,12 +372,87 @@ static int ExtractExactArg(SEXP args)
     return exact;
 }
 
+static SEXP VectorRange(SEXP x, const IntegerSequence& range)
+{
+    switch (TYPEOF(x)) {
+    case LGLSXP:
+	return Subscripting::vectorSubset(static_cast<LogicalVector*>(x), range);
+    case INTSXP:
+	return Subscripting::vectorSubset(static_cast<IntVector*>(x), range);
+    case REALSXP:
+	return Subscripting::vectorSubset(static_cast<RealVector*>(x), range);
+    case CPLXSXP:
+	return Subscripting::vectorSubset(static_cast<ComplexVector*>(x), range);
+    case RAWSXP:
+	return Subscripting::vectorSubset(static_cast<RawVector*>(x), range);
+    case STRSXP:
+	return Subscripting::vectorSubset(static_cast<StringVector*>(x), range);
+    case VECSXP:
+	return Subscripting::vectorSubset(static_cast<ListVector*>(x), range);
+    case EXPRSXP:
+	return Subscripting::vectorSubset(static_cast<ExpressionVector*>(x),
+					  range);
+    default:
+	return nullptr;  // -Wall
+    }
+}
+
+/* Handles x[from:to], x[seq_len(n)] and x[seq_along(y)], where x is a
+   variable whose value is a vector without a class or dimensions, by
+   copying the range of elements without allocating the index vector.
+   Returns false without evaluating anything other than x, which the
+   usual code can then look up again, if the call isn't of that form. */
+static bool RangeSubset(const Expression* call, const BuiltInFunction* op,
+			SEXP args, Environment* env, GCStackRoot<>* ans)
+{
+    if (!args || !CDR(args) || CDDR(args) || TAG(args) || TAG(CDR(args))
+	|| TYPEOF(CAR(args)) != SYMSXP || TYPEOF(CADR(args)) != LANGSXP)
+	return false;
+    Symbol* symbol = static_cast<Symbol*>(CAR(args));
+    if (symbol == DotsSymbol || symbol->isDotDotSymbol())
+	return false;
+    Frame::Binding* binding = env->findBinding(symbol);
+    if (!binding || binding->isActive())
+	return false;
+    GCStackRoot<> x(binding->forcedValue());
+    switch (TYPEOF(x)) {
+    case LGLSXP: case INTSXP: case REALSXP: case CPLXSXP: case RAWSXP:
+    case STRSXP: case VECSXP: case EXPRSXP:
+	break;
+    default:
+	return false;
+    }
+    VectorBase* v = static_cast<VectorBase*>(x.get());
+    if (v->hasClass() || v->dimensions())
+	return false;
+
+    IntegerSequence range;
+    GCStackRoot<> indices;
+    if (IntegerSequence::evaluate(CADR(args), env, &range, &indices)) {
+	std::size_t size = v->size();
+	if (range.size() == 0
+	    || (min(range.from(), range.to()) >= 1
+		&& std::size_t(max(range.from(), range.to())) <= size)) {
+	    *ans = VectorRange(x, range);
+	    return true;
+	}
+	indices = range.materialize();
+    }
+    *ans = BuiltInFunction::callBuiltInWithCApi(
+	do_subset_dflt, call, op, ArgList({x, indices}, ArgList::EVALUATED),
+	env);
+    return true;
+}
+
 /* The "[" subset operator. */
 SEXP attribute_hidden do_subset(SEXP call, SEXP op, SEXP args, SEXP rho)
 {
     const Expression* expression = SEXP_downcast<Expression*>(call);
     const BuiltInFunction* function = SEXP_downcast<BuiltInFunction*>(op);
     Environment* envx = SEXP_downcast<Environment*>(rho);
+    GCStackRoot<> ans;
+    if (RangeSubset(expression, function, args, envx, &ans))
+	return ans;
     ArgList arglist(SEXP_downcast<PairList*>(args), ArgList::RAW);
     auto dispatched = Rf_DispatchOrEval(expression, function, &arglist, envx,
                                        MissingArgHandling::Keep);
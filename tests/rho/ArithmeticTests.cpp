@@ -0,0 +1,116 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "EvaluationTests.hpp"
+
+class ArithmeticTest : public EvaluatorTest { };
+
+TEST_P(ArithmeticTest, Scalars)
+{
+    runEvaluatorTests({
+	{ "{ x <- 1.5; y <- 2; x + y }", "3.5" },
+	{ "{ x <- 1.5; y <- 2; x - y }", "-0.5" },
+	{ "{ x <- 1.5; y <- 2; x * y }", "3" },
+	{ "{ x <- 1L; y <- 2L; x / y }", "0.5" },
+	{ "{ x <- 1L; y <- 2; x + y }", "3" },
+	{ "{ x <- 3L; y <- 4L; x * y }", "12L" },
+	{ "{ x <- 1; y <- 2L; x < y }", "TRUE" },
+	{ "{ x <- 2L; y <- 2L; x >= y }", "TRUE" },
+	{ "{ x <- NA_real_; y <- 1; x + y }", "NA_real_" },
+	{ "{ x <- NaN; y <- 1; x == y }", "NA" },
+	});
+}
+
+// Calling a closure more than 100 times gets it compiled, with the
+// arithmetic specialized for the operand types seen so far.  These tests
+// then call it with operands that the specialized code can't handle.
+TEST_P(ArithmeticTest, ChangedOperandTypes)
+{
+    runEvaluatorTests({
+	{ "{ f <- function(x, y) x + y; for (i in 1:200) f(1, 2); f(1L, 2L) }",
+		"3L" },
+	{ "{ f <- function(x, y) x * y; for (i in 1:200) f(2, 3); f(1:2, 3) }",
+		"c(3, 6)" },
+	{ "{ f <- function(x, y) x - y; for (i in 1:200) f(2, 3);"
+	  "  f(c(a = 2), 3) }",
+		"c(a = -1)" },
+	{ "{ f <- function(x, y) x < y; for (i in 1:200) f(1, 2); f(NA, 2) }",
+		"NA" },
+	{ "{ f <- function(x, y) x / y; for (i in 1:200) f(1L, 2L); f(1L, 0L) }",
+		"Inf" },
+	{ "{ f <- function(x, y) x + y; for (i in 1:200) f(1L, 2L);"
+	  "  f(.Machine$integer.max, 1L) }",
+		"NA_integer_",
+		Warning("NAs produced by integer overflow") },
+	{ "{ f <- function(x, y) x + y; for (i in 1:200) f(1, 2); f('a', 2) }",
+		Error("non-numeric argument to binary operator") },
+	});
+}
+
+// With options(rho.math.fuse = TRUE), nested arithmetic on long vectors
+// is computed in one pass.  The results, and the order in which operands
+// are evaluated, must be the same as without fusion.
+TEST_P(ArithmeticTest, FusedExpressions)
+{
+    runEvaluatorTests({
+	{ "{ x <- seq(0, 1, length.out = 5000); y <- rev(x) + 1;"
+	  "  options(rho.math.fuse = FALSE); expected <- x * y + x^2 - 2 / y;"
+	  "  options(rho.math.fuse = TRUE); r <- x * y + x^2 - 2 / y;"
+	  "  options(rho.math.fuse = FALSE); identical(r, expected) }",
+		"TRUE" },
+	{ "{ x <- c(a = 1, b = 2, rep(3, 4998)); options(rho.math.fuse = TRUE);"
+	  "  r <- (x * 2 + 1) / 2; options(rho.math.fuse = FALSE);"
+	  "  list(names(r)[1:3], unname(r[1:3])) }",
+		"list(c('a', 'b', ''), c(1.5, 2.5, 3.5))" },
+	{ "{ x <- 1:5000; options(rho.math.fuse = TRUE); r <- x * 2L + 1L;"
+	  "  options(rho.math.fuse = FALSE); c(typeof(r), r[5000]) }",
+		"c('integer', '10001')" },
+	{ "{ `+` <- function(e1, e2) 'mine'; x <- as.numeric(1:5000);"
+	  "  options(rho.math.fuse = TRUE); r <- x * x + x;"
+	  "  options(rho.math.fuse = FALSE); r }",
+		"'mine'" },
+	{ "{ x <- as.numeric(1:5000); order <- character();"
+	  "  f <- function(name) { order <<- c(order, name); x };"
+	  "  options(rho.math.fuse = TRUE); r <- f('a') * f('b') + f('c');"
+	  "  options(rho.math.fuse = FALSE); c(paste(order, collapse = ''),"
+	  "  r[2] == 6) }",
+		"c('abc', 'TRUE')" },
+	{ "{ a <- as.numeric(1:5000); b <- a + 0; c <- a + 0;"
+	  "  options(rho.math.fuse = TRUE); r <- a * b + { a[1] <- 0; c };"
+	  "  options(rho.math.fuse = FALSE); r[1:2] }",
+		"c(2, 6)" },
+	{ "{ a <- as.numeric(1:5000); b <- a + 0; c <- a + 0;"
+	  "  options(rho.math.fuse = TRUE);"
+	  "  r <- a * b + c * { a[1] <- 0; c };"
+	  "  options(rho.math.fuse = FALSE); r[1:2] }",
+		"c(2, 8)" },
+	});
+}
+
+INSTANTIATE_TEST_CASE_P(InterpreterArithmeticTest,
+                        ArithmeticTest,
+			testing::Values(Executor::InterpreterExecutor()));
+
+INSTANTIATE_TEST_CASE_P(JITArithmeticTest,
+                        ArithmeticTest,
+			testing::Values(Executor::JITExecutor()));
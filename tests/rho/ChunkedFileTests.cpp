@@ -0,0 +1,169 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+#include "rho/ChunkedFile.hpp"
+
+#include <cstdio>
+#include <vector>
+
+using namespace rho;
+
+namespace {
+    // Bytes that compress, but not to nothing.
+    std::vector<unsigned char> testData(std::size_t size)
+    {
+	std::vector<unsigned char> data(size);
+	unsigned int state = 12345;
+	for (std::size_t i = 0; i < size; ++i) {
+	    state = state*1103515245 + 12345;
+	    data[i] = static_cast<unsigned char>((state >> 16) % 16);
+	}
+	return data;
+    }
+
+    // Write 'data' in pieces of 'piece_size' bytes to a chunked file with
+    // chunks of 'chunk_size' bytes, and rewind the file.
+    std::FILE* writeChunkedFile(const std::vector<unsigned char>& data,
+				std::size_t chunk_size, std::size_t piece_size)
+    {
+	std::FILE* fp = std::tmpfile();
+	ChunkedFile::Writer writer(fp, 6, chunk_size);
+	for (std::size_t i = 0; i < data.size(); i += piece_size) {
+	    std::size_t n = std::min(piece_size, data.size() - i);
+	    EXPECT_TRUE(writer.write(data.data() + i, n));
+	}
+	EXPECT_EQ(data.size(), writer.position());
+	EXPECT_TRUE(writer.finish());
+	std::rewind(fp);
+	return fp;
+    }
+
+    class ChunkedFileTest : public ::testing::TestWithParam<unsigned int> {
+    protected:
+	void SetUp() override
+	{
+	    m_saved_num_threads = ChunkedFile::numThreads();
+	    ChunkedFile::setNumThreads(GetParam());
+	}
+
+	void TearDown() override
+	{
+	    ChunkedFile::setNumThreads(m_saved_num_threads);
+	}
+    private:
+	unsigned int m_saved_num_threads;
+    };
+}
+
+TEST_P(ChunkedFileTest, ReadsBackWhatWasWritten)
+{
+    std::vector<unsigned char> data = testData(100000);
+    std::FILE* fp = writeChunkedFile(data, 4096, 1000);
+
+    unsigned char magic[ChunkedFile::magic_size];
+    ASSERT_EQ(sizeof(magic), std::fread(magic, 1, sizeof(magic), fp));
+    EXPECT_TRUE(ChunkedFile::hasMagic(magic, sizeof(magic)));
+
+    ChunkedFile::Reader reader(fp);
+    ASSERT_FALSE(reader.failed());
+    EXPECT_EQ(data.size(), reader.size());
+    std::vector<unsigned char> result(data.size());
+    // Read in pieces that straddle chunk boundaries.
+    std::size_t num_read = 0;
+    while (num_read < result.size()) {
+	std::size_t n = reader.read(result.data() + num_read, 3000);
+	ASSERT_NE(0u, n);
+	num_read += n;
+    }
+    EXPECT_EQ(data, result);
+    unsigned char extra;
+    EXPECT_EQ(0u, reader.read(&extra, 1));
+    EXPECT_FALSE(reader.failed());
+    std::fclose(fp);
+}
+
+TEST_P(ChunkedFileTest, SeeksToAnyPosition)
+{
+    std::vector<unsigned char> data = testData(50000);
+    std::FILE* fp = writeChunkedFile(data, 1000, 50000);
+    ChunkedFile::Reader reader(fp);
+    ASSERT_FALSE(reader.failed());
+
+    for (std::size_t position : {40500, 999, 1000, 0, 49990, 20000}) {
+	reader.seek(position);
+	unsigned char buffer[20];
+	std::size_t expected = std::min<std::size_t>(sizeof(buffer),
+						     data.size() - position);
+	ASSERT_EQ(expected, reader.read(buffer, sizeof(buffer)));
+	EXPECT_TRUE(std::equal(buffer, buffer + expected,
+			       data.begin() + position));
+	EXPECT_EQ(position + expected, reader.position());
+    }
+    reader.seek(data.size() + 10);
+    unsigned char extra;
+    EXPECT_EQ(0u, reader.read(&extra, 1));
+    std::fclose(fp);
+}
+
+TEST_P(ChunkedFileTest, HandlesEmptyStream)
+{
+    std::FILE* fp = writeChunkedFile(std::vector<unsigned char>(), 1000, 1);
+    ChunkedFile::Reader reader(fp);
+    ASSERT_FALSE(reader.failed());
+    EXPECT_EQ(0u, reader.size());
+    unsigned char extra;
+    EXPECT_EQ(0u, reader.read(&extra, 1));
+    std::fclose(fp);
+}
+
+TEST_P(ChunkedFileTest, RejectsDamagedFiles)
+{
+    std::vector<unsigned char> data = testData(10000);
+    std::FILE* fp = writeChunkedFile(data, 1000, 10000);
+    std::vector<unsigned char> contents;
+    int c;
+    while ((c = std::fgetc(fp)) != EOF)
+	contents.push_back(static_cast<unsigned char>(c));
+    std::fclose(fp);
+
+    // A truncated file has no trailer.
+    fp = std::tmpfile();
+    std::fwrite(contents.data(), 1, contents.size() - 1, fp);
+    EXPECT_TRUE(ChunkedFile::Reader(fp).failed());
+    std::fclose(fp);
+
+    // A corrupt chunk is detected when it is read.
+    contents[ChunkedFile::header_size + 2] ^= 0xff;
+    fp = std::tmpfile();
+    std::fwrite(contents.data(), 1, contents.size(), fp);
+    ChunkedFile::Reader reader(fp);
+    ASSERT_FALSE(reader.failed());
+    std::vector<unsigned char> result(data.size());
+    EXPECT_GT(data.size(), reader.read(result.data(), result.size()));
+    EXPECT_TRUE(reader.failed());
+    std::fclose(fp);
+}
+
+INSTANTIATE_TEST_CASE_P(NumThreads, ChunkedFileTest,
+			::testing::Values(0u, 1u, 4u));
@@ -0,0 +1,96 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "EvaluationTests.hpp"
+
+class ClosureCallTest : public EvaluatorTest { };
+
+// A closure is compiled on its 100th call, after the frame for that call
+// has been created without a layout.  The call then moves its bindings to
+// a frame laid out for the compiled code, which must be invisible to R
+// code.  Each test calls a closure 150 times so that calls before, during
+// and after the change are all checked.
+TEST_P(ClosureCallTest, PromiseArgumentsAfterFrameReplacement)
+{
+    runEvaluatorTests({
+	    // Each argument is forced once, when it is first used.
+	    { "{ n <- 0; f <- function(x) { n <<- n + 1; x + x };"
+	      "  r <- vapply(1:150, function(k) f({ n <<- n + 10; k }), 0);"
+	      "  c(sum(r), n) }", "c(22650, 1650)" },
+	    { "{ f <- function(x) 1;"
+	      "  sum(vapply(1:150, function(k) f(stop('forced')), 0)) }",
+		    "150" },
+	    { "{ f <- function(x) substitute(x);"
+	      "  all(vapply(1:150, function(k) identical(f(a + k),"
+	      "                                          quote(a + k)), TRUE)) }",
+		    "TRUE" },
+	});
+}
+
+TEST_P(ClosureCallTest, MissingArgumentsAfterFrameReplacement)
+{
+    runEvaluatorTests({
+	    { "{ f <- function(x, y) if (missing(y)) -x else x + y;"
+	      "  sum(vapply(1:150, function(k) f(k), 0)) + f(1, 2) }",
+		    "-11322" },
+	    { "{ f <- function(x, y = x * 2) y;"
+	      "  sum(vapply(1:150, function(k) f(k), 0)) + f(1, 5) }",
+		    "22655" },
+	    // Missingness passed on by another call.
+	    { "{ f <- function(x, y) if (missing(y)) x else -y;"
+	      "  g <- function(a, b) f(a, b);"
+	      "  c(sum(vapply(1:150, function(k) g(k), 0)), g(1, 5)) }",
+		    "c(11325, -5)" },
+	    { "{ f <- function(x) x;"
+	      "  for (k in 1:150) tryCatch(f(), error = function(e) NULL);"
+	      "  f() }",
+		    Error("argument \"x\" is missing, with no default") },
+	});
+}
+
+TEST_P(ClosureCallTest, FunctionAndEnvironmentAfterFrameReplacement)
+{
+    runEvaluatorTests({
+	    { "{ f <- function() identical(sys.function(), f);"
+	      "  all(vapply(1:150, function(k) f(), TRUE)) }", "TRUE" },
+	    { "{ f <- function() { e <- environment();"
+	      "    g <- function() parent.frame();"
+	      "    identical(g(), e) && identical(environment(g), e)"
+	      "      && identical(sys.frame(sys.nframe()), e) };"
+	      "  all(vapply(1:150, function(k) f(), TRUE)) }", "TRUE" },
+	    // Closures created by a call see the bindings made before and
+	    // after its frame was replaced.
+	    { "{ f <- function(x) { y <- x * 2; function() c(x, y) };"
+	      "  h <- lapply(1:150, f);"
+	      "  c(h[[1]](), h[[100]](), h[[150]]()) }",
+		    "c(1, 2, 100, 200, 150, 300)" },
+	});
+}
+
+INSTANTIATE_TEST_CASE_P(InterpreterClosureCallTest,
+                        ClosureCallTest,
+			testing::Values(Executor::InterpreterExecutor()));
+
+INSTANTIATE_TEST_CASE_P(JITClosureCallTest,
+                        ClosureCallTest,
+			testing::Values(Executor::JITExecutor()));
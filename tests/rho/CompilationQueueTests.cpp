@@ -0,0 +1,162 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/CompilationQueue.hpp"
+
+#include "rho/Closure.hpp"
+#include "rho/Environment.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "rho/IntVector.hpp"
+#include "rho/Symbol.hpp"
+#include "EvaluationTests.hpp"
+
+#include <chrono>
+#include <thread>
+
+using namespace rho;
+using namespace rho::JIT;
+
+class CompilationQueueTest : public ::testing::Test
+{
+protected:
+    CompilationQueueTest()
+	: m_depth(CompilationQueue::maxDepth()),
+	  m_env(Executor::newTestEnv())
+    {
+	CompilationQueue::setMaxDepth(8);
+    }
+
+    ~CompilationQueueTest()
+    {
+	CompilationQueue::setMaxDepth(m_depth);
+    }
+
+    // Defines a closure in the test environment that sums 1:n.  Each
+    // closure has a different body, so that none of them share code.
+    Closure* defineSum(const std::string& name)
+    {
+	std::string definition = name + " <- function(n) { s <- 0L;"
+	    " for (i in seq_len(n)) s <- s + i; s + 0L * nchar('"
+	    + name + "') }";
+	Executor::parseAndEvalWithInterpreter(definition, m_env);
+	return SEXP_downcast<Closure*>(
+	    m_env->frame()->binding(Symbol::obtain(name))->forcedValue());
+    }
+
+    static void compile(const Closure* closure)
+    {
+	std::lock_guard<std::recursive_mutex> lock(
+	    CompilationQueue::llvmMutex());
+	closure->compile();
+    }
+
+    // Waits for the compilation thread to finish all of its jobs.
+    static bool waitUntilIdle()
+    {
+	for (int i = 0; i < 6000; ++i) {
+	    if (CompilationQueue::statistics().queue_length == 0)
+		return true;
+	    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return false;
+    }
+
+    int callSum(const std::string& name, int n)
+    {
+	RObject* result = Executor::parseAndEvalWithInterpreter(
+	    name + "(" + std::to_string(n) + "L)", m_env);
+	return (*SEXP_downcast<IntVector*>(result))[0];
+    }
+
+    unsigned int m_depth;
+    GCStackRoot<Environment> m_env;
+};
+
+TEST_F(CompilationQueueTest, CompilesInTheBackground) {
+    CompilationQueue::Statistics before = CompilationQueue::statistics();
+    GCStackRoot<Closure> sum(defineSum("queue_test_background"));
+    compile(sum);
+    ASSERT_TRUE(waitUntilIdle());
+    ASSERT_TRUE(sum->compiledBody() != nullptr);
+
+    CompilationQueue::Statistics after = CompilationQueue::statistics();
+    EXPECT_EQ(before.num_background + 1, after.num_background);
+    EXPECT_EQ(before.num_synchronous, after.num_synchronous);
+    EXPECT_EQ(0u, after.queue_length);
+    EXPECT_EQ(5050, callSum("queue_test_background", 100));
+}
+
+TEST_F(CompilationQueueTest, CompilesSynchronouslyWithoutAQueue) {
+    CompilationQueue::setMaxDepth(0);
+    CompilationQueue::Statistics before = CompilationQueue::statistics();
+    GCStackRoot<Closure> sum(defineSum("queue_test_synchronous"));
+    compile(sum);
+    // The code is ready as soon as compile() returns.
+    ASSERT_TRUE(sum->compiledBody() != nullptr);
+
+    CompilationQueue::Statistics after = CompilationQueue::statistics();
+    EXPECT_EQ(before.num_synchronous + 1, after.num_synchronous);
+    EXPECT_EQ(before.num_background, after.num_background);
+    EXPECT_EQ(5050, callSum("queue_test_synchronous", 100));
+}
+
+TEST_F(CompilationQueueTest, ShutdownFinishesOrAbandonsEveryJob) {
+    GCStackRoot<Closure> sum1(defineSum("queue_test_shutdown1"));
+    GCStackRoot<Closure> sum2(defineSum("queue_test_shutdown2"));
+    GCStackRoot<Closure> sum3(defineSum("queue_test_shutdown3"));
+    {
+	// Keep the compilation thread waiting until all three are queued.
+	std::lock_guard<std::recursive_mutex> lock(
+	    CompilationQueue::llvmMutex());
+	sum1->compile();
+	sum2->compile();
+	sum3->compile();
+    }
+    CompilationQueue::shutdown();
+
+    // Nothing is left waiting for a thread that has gone.
+    EXPECT_EQ(0u, CompilationQueue::statistics().queue_length);
+
+    // The closures still work, compiled or not.
+    EXPECT_EQ(5050, callSum("queue_test_shutdown1", 100));
+    EXPECT_EQ(5050, callSum("queue_test_shutdown2", 100));
+    EXPECT_EQ(5050, callSum("queue_test_shutdown3", 100));
+}
+
+TEST_F(CompilationQueueTest, RestartsAfterShutdown) {
+    CompilationQueue::shutdown();
+    // Shutting down a queue without a thread does nothing.
+    CompilationQueue::shutdown();
+
+    CompilationQueue::Statistics before = CompilationQueue::statistics();
+    GCStackRoot<Closure> sum(defineSum("queue_test_restart"));
+    compile(sum);
+    ASSERT_TRUE(waitUntilIdle());
+    ASSERT_TRUE(sum->compiledBody() != nullptr);
+    EXPECT_EQ(before.num_background + 1,
+	      CompilationQueue::statistics().num_background);
+    EXPECT_EQ(5050, callSum("queue_test_restart", 100));
+}
@@ -192,7 +192,99 @@ TEST_P(ControlFlowTest, StopInsideLoop)
       });
 }
 
-// TODO(kmillar): Test break, next, for
+TEST_P(ControlFlowTest, For)
+{
+    runEvaluatorTests({
+	    { "for(i in 1:3) 1", "NULL" },
+	    { "{ x <- 0; for(i in 1:3) x <- x + i; x }", "6" },
+	    { "{ x <- 0; for(i in seq_len(4)) x <- x + i; x }", "10" },
+	    { "{ x <- 0; for(i in seq_along(c(5, 6))) x <- x * 10 + i; x }",
+		    "12" },
+	    { "{ x <- 0; for(i in 3:1) x <- x * 10 + i; x }", "321" },
+	    { "{ x <- 0; for(i in c(1.5, 2.5)) x <- x + i; x }", "4" },
+	    { "{ x <- 0; for(i in 1.5:3) x <- x + i; x }", "4" },
+	    { "{ x <- ''; for(s in c('a', 'b')) x <- paste0(x, s); x }",
+		    "'ab'" },
+	    { "{ x <- 0; for(e in list(1, 2L)) x <- x + e; x }", "3" },
+
+	    // The value of the loop variable afterwards.
+	    { "{ for(i in 1:3) 1; i }", "3L" },
+	    { "{ for(i in seq_len(0)) 1; i }", "NULL" },
+	    { "{ for(i in 1:10) if (i == 4L) break; i }", "4L" },
+	    { "{ for(i in c('a', 'b')) 1; i }", "'b'" },
+
+	    // break and next.
+	    { "{ x <- 0; for(i in 1:10) { if (i > 3) break; x <- x + i }; x }",
+		    "6" },
+	    { "{ x <- 0; for(i in 1:4) { if (i == 2) next; x <- x + i }; x }",
+		    "8" },
+
+	    // The loop variable is visible to called code.
+	    { "{ x <- 0; for(i in 1:3) x <- x + get('i'); x }", "6" },
+	    { "{ x <- 0; for(i in 1:3) x <- x + identity(i); x }", "6" },
+	    { "{ x <- 0; for(i in 1:3) for(j in 1:i) x <- x + j; x }", "10" },
+	    { "{ for(i in 1:3) i <- 10L; i }", "10L" },
+
+	    { "for(i in quote(x)) 1",
+		    Error("invalid for() loop sequence") },
+	});
+}
+
+// Loops over from:to, seq_len() and seq_along() don't allocate the
+// sequence, but must behave as if they did.
+TEST_P(ControlFlowTest, ForOverSequence)
+{
+    runEvaluatorTests({
+	    { "{ x <- 0; n <- 2.5; for(i in 1:n) x <- x + i; x }", "3" },
+	    { "{ for(i in 1:2) 1; typeof(i) }", "'integer'" },
+	    { "{ k <- 0; for(i in 2147483646:2147483647) k <- k + i; k }",
+		    "4294967293" },
+	    { "{ for(i in 1e10:(1e10 + 1)) 1; i }", "1e10 + 1" },
+	    { "{ for(i in seq_along(NULL)) 1; i }", "NULL" },
+	    { "{ x <- c(a = 1, b = 2); for(i in seq_along(x)) 1; i }", "2L" },
+	    { "{ `:` <- function(a, b) c(7, 8); x <- 0;"
+	      "  for(i in 1:2) x <- x + i; x }", "15" },
+	    { "{ n <- c(2, 3); x <- 0; for(i in 1:n) x <- x + i; x }", "3",
+		    Warning("numerical expression has 2 elements:"
+			    " only the first used") },
+	    { "for(i in seq_len(-1)) 1",
+		    Error("argument must be coercible to non-negative integer") },
+	    { "for(i in 1:NA) 1", Error("NA/NaN argument") },
+	    { "{ a <- 1:3; b <- 2; x <- 0; for(i in a*b + 1) x <- x + i; x }",
+		    "15" },
+	    { "{ x <- c(5, 6, 7); y <- 1; x[y + 1:2] }", "c(6, 7)" },
+	});
+}
+
+// Loops that run long enough in the interpreter to continue in compiled
+// code part way through.
+TEST_P(ControlFlowTest, LongRunningLoops)
+{
+    runEvaluatorTests({
+	    { "{ f <- function(n) { i <- 0L; s <- 0;"
+	      "    while (i < n) { i <- i + 1L; s <- s + i }; s };"
+	      "  f(20000L) }", "200010000" },
+	    { "{ f <- function(x) { i <- 0L; while (i < 15000L) i <- i + 1L;"
+	      "    c(i, x) };"
+	      "  f(5L) }", "c(15000L, 5L)" },
+	    { "{ f <- function() { i <- 0L;"
+	      "    repeat { i <- i + 1L; if (i >= 12000L) break }; i };"
+	      "  f() }", "12000L" },
+	    { "{ f <- function() { i <- 0L;"
+	      "    repeat { i <- i + 1L; if (i == 20000L) return(i) }; -1L };"
+	      "  f() }", "20000L" },
+	    { "{ f <- function() { i <- 0L; y <- 0L;"
+	      "    while (i < 30000L) { i <- i + 1L; if (i %% 2L == 0L) next;"
+	      "      y <- y + 1L };"
+	      "    y };"
+	      "  c(f(), f()) }", "c(15000L, 15000L)" },
+	    // The loop runs while applydefine() holds the binding of *tmp*.
+	    { "{ f <- function() { x <- c(0, 0);"
+	      "    x[{ i <- 0L; while (i < 20000L) i <- i + 1L; 2L }] <- 5;"
+	      "    c(x, i) };"
+	      "  c(f(), f()) }", "c(0, 5, 20000, 0, 5, 20000)" },
+	});
+}
 
 INSTANTIATE_TEST_CASE_P(InterpreterControlFlowTest,
                         ControlFlowTest,
@@ -30,6 +30,9 @@
 #include "rho/Expression.hpp"
 #include "rho/Frame.hpp"
 #include "rho/ListVector.hpp"
+#ifdef ENABLE_LLVM_JIT
+#include "rho/jit/CompilationQueue.hpp"
+#endif
 #include "Defn.h"
 #include "Parse.h"
 
@@ -194,10 +197,34 @@ public:
 #ifdef ENABLE_LLVM_JIT
 class JITExecutor : public CompilingExecutor {
 public:
+    RObject* parseAndEval(
+	const std::string& expression, Environment* env) override
+    {
+	// Generate machine code on this thread, so that closures that the
+	// tests call repeatedly use compiled code as soon as they are
+	// compiled.
+	SynchronousCompilation synchronous;
+	return CompilingExecutor::parseAndEval(expression, env);
+    }
+
     Closure* compile(Closure* closure) const override {
+	// Wait for any compilation that is running in the background.
+	std::lock_guard<std::recursive_mutex> lock(
+	    JIT::CompilationQueue::llvmMutex());
 	closure->compile();
 	return closure;
     }
+private:
+    struct SynchronousCompilation {
+	SynchronousCompilation()
+	    : m_depth(JIT::CompilationQueue::maxDepth()) {
+	    JIT::CompilationQueue::setMaxDepth(0);
+	}
+	~SynchronousCompilation() {
+	    JIT::CompilationQueue::setMaxDepth(m_depth);
+	}
+	unsigned int m_depth;
+    };
 };
 
 Executor* Executor::JITExecutor() {
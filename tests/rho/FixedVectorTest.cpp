@@ -83,3 +83,47 @@ TEST(IntegerVectorTest, ShortInitializerListConstructor) {
     object = IntVector::create({ });
     EXPECT_EQ(0, object->size());
 }
+
+TEST(IntegerVectorTest, EnlargeInPlace) {
+    IntVector* object = IntVector::createWithCapacity(2, 5);
+    (*object)[0] = 3;
+    (*object)[1] = 4;
+    ASSERT_EQ(2, object->size());
+    EXPECT_EQ(5, object->capacity());
+
+    EXPECT_EQ(object, VectorBase::enlarge(object, 4));
+    ASSERT_EQ(4, object->size());
+    EXPECT_EQ(3, (*object)[0]);
+    EXPECT_EQ(4, (*object)[1]);
+    EXPECT_EQ(NA_INTEGER, (*object)[2]);
+    EXPECT_EQ(NA_INTEGER, (*object)[3]);
+}
+
+TEST(IntegerVectorTest, EnlargeReservesCapacity) {
+    IntVector* object = IntVector::create({ 7, 14 });
+    EXPECT_EQ(2, object->capacity());
+
+    IntVector* enlarged = VectorBase::enlarge(object, 100);
+    EXPECT_NE(object, enlarged);
+    ASSERT_EQ(100, enlarged->size());
+    EXPECT_LT(100, enlarged->capacity());
+    EXPECT_EQ( 7, (*enlarged)[0]);
+    EXPECT_EQ(14, (*enlarged)[1]);
+    EXPECT_EQ(NA_INTEGER, (*enlarged)[99]);
+
+    // Copies don't inherit the spare capacity.
+    EXPECT_EQ(100, enlarged->clone()->capacity());
+}
+
+TEST(ListVectorTest, EnlargeInPlace) {
+    ListVector* vector = ListVector::createWithCapacity(1, 2);
+    (*vector)[0] = IntVector::createScalar(2);
+
+    EXPECT_EQ(vector, VectorBase::enlarge(vector, 2));
+    ASSERT_EQ(2, vector->size());
+    EXPECT_EQ(nullptr, (*vector)[1].get());
+
+    ReferentChecker checker(std::set<const GCNode*>({ (*vector)[0].get() }));
+    vector->visitReferents(&checker);
+    EXPECT_TRUE(checker.ok());
+}
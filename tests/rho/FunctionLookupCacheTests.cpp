@@ -0,0 +1,123 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/FunctionLookupCache.hpp"
+
+#include "rho/BuiltInFunction.hpp"
+#include "rho/Environment.hpp"
+#include "rho/Frame.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "rho/Symbol.hpp"
+
+using namespace rho;
+using namespace rho::JIT;
+
+class FunctionLookupCacheTest : public ::testing::Test
+{
+protected:
+    FunctionLookupCacheTest()
+	: m_symbol(Symbol::obtain("function_lookup_cache_test_fn")),
+	  m_function1(BuiltInFunction::obtainPrimitive("length")),
+	  m_function2(BuiltInFunction::obtainPrimitive("sum")) { }
+
+    ~FunctionLookupCacheTest()
+    {
+	Environment::global()->frame()->erase(m_symbol);
+    }
+
+    // Returns a new environment like the local environment of a closure
+    // defined in enclosing.
+    static Environment* localEnvironment(Environment* enclosing)
+    {
+	GCStackRoot<Frame> frame(Frame::normalFrame());
+	return new Environment(enclosing, frame);
+    }
+
+    Symbol* m_symbol;
+    GCRoot<FunctionBase> m_function1;
+    GCRoot<FunctionBase> m_function2;
+    FunctionLookupCache m_cache;
+};
+
+TEST_F(FunctionLookupCacheTest, FindsFunctionsOnSearchPath) {
+    Environment::global()->frame()->bind(m_symbol, m_function1);
+    GCStackRoot<Environment> env(localEnvironment(Environment::global()));
+
+    EXPECT_EQ(m_function1, m_cache.lookup(m_symbol, env));
+    EXPECT_EQ(m_function1, m_cache.lookup(m_symbol, env));
+
+    // Reassignment is seen through the cached binding.
+    Environment::global()->frame()->bind(m_symbol, m_function2);
+    EXPECT_EQ(m_function2, m_cache.lookup(m_symbol, env));
+}
+
+TEST_F(FunctionLookupCacheTest, SeesLocalBindings) {
+    Environment::global()->frame()->bind(m_symbol, m_function1);
+    GCStackRoot<Environment> env(localEnvironment(Environment::global()));
+    EXPECT_EQ(m_function1, m_cache.lookup(m_symbol, env));
+
+    env->frame()->bind(m_symbol, m_function2);
+    EXPECT_EQ(m_function2, m_cache.lookup(m_symbol, env));
+}
+
+TEST_F(FunctionLookupCacheTest, SeesNewBindingsInLockedChain) {
+    Environment::global()->frame()->bind(m_symbol, m_function1);
+    GCStackRoot<Environment> ns(localEnvironment(Environment::global()));
+    ns->frame()->lock(false);
+    GCStackRoot<Environment> env(localEnvironment(ns));
+    EXPECT_EQ(m_function1, m_cache.lookup(m_symbol, env));
+
+    // Removing the binding changes the search path generation.
+    Environment::global()->frame()->erase(m_symbol);
+    EXPECT_EQ(nullptr, m_cache.lookup(m_symbol, env));
+}
+
+TEST_F(FunctionLookupCacheTest, SeesNewBindingsInUnlockedFrames) {
+    Environment::global()->frame()->bind(m_symbol, m_function1);
+    GCStackRoot<Environment> enclosing(
+	localEnvironment(Environment::global()));
+    GCStackRoot<Environment> env(localEnvironment(enclosing));
+    EXPECT_EQ(m_function1, m_cache.lookup(m_symbol, env));
+
+    // A new binding here doesn't change the search path generation.
+    enclosing->frame()->bind(m_symbol, m_function2);
+    EXPECT_EQ(m_function2, m_cache.lookup(m_symbol, env));
+}
+
+TEST_F(FunctionLookupCacheTest, SeesNewEnclosingEnvironments) {
+    Environment::global()->frame()->bind(m_symbol, m_function1);
+    GCStackRoot<Environment> ns(localEnvironment(Environment::global()));
+    ns->frame()->lock(false);
+    GCStackRoot<Environment> env(localEnvironment(ns));
+    EXPECT_EQ(m_function1, m_cache.lookup(m_symbol, env));
+
+    GCStackRoot<Environment> other(localEnvironment(Environment::global()));
+    other->frame()->bind(m_symbol, m_function2);
+    other->frame()->lock(false);
+    ns->setEnclosingEnvironment(other);
+    EXPECT_EQ(m_function2, m_cache.lookup(m_symbol, env));
+}
@@ -0,0 +1,87 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#include "rho/GCManager.hpp"
+
+using namespace rho;
+
+namespace {
+    GCManager::CollectionOutcome outcome(size_t before, size_t after,
+					 double pause_seconds, bool full)
+    {
+	GCManager::CollectionOutcome result;
+	result.bytes_before = before;
+	result.bytes_after = after;
+	result.threshold = before;
+	result.min_threshold = 1000;
+	result.pause_seconds = pause_seconds;
+	result.full = full;
+	return result;
+    }
+}
+
+TEST(GCManagerTest, FixedGrowthPolicyFallsGradually) {
+    GCManager::FixedGrowthPolicy policy;
+    size_t threshold = policy(outcome(100000, 10000, 0.0, true));
+    EXPECT_EQ(80000u, threshold);
+}
+
+TEST(GCManagerTest, AdaptivePolicyFollowsShrinkingHeap) {
+    GCManager::setTargetPause(0);
+    GCManager::AdaptivePolicy policy;
+    size_t threshold = policy(outcome(100000, 10000, 0.0, true));
+    EXPECT_GT(20000u, threshold);
+    EXPECT_LT(10000u, threshold);
+}
+
+TEST(GCManagerTest, AdaptivePolicyGivesRoomToSurvivingHeap) {
+    GCManager::setTargetPause(0);
+    GCManager::AdaptivePolicy policy;
+    size_t mostly_garbage = policy(outcome(100000, 10000, 0.0, false));
+    size_t mostly_live = policy(outcome(11000, 10000, 0.0, false));
+    EXPECT_LT(mostly_garbage - 10000, mostly_live - 10000);
+}
+
+TEST(GCManagerTest, AdaptivePolicyMeetsTargetPause) {
+    GCManager::setTargetPause(0.001);
+    GCManager::AdaptivePolicy policy;
+    size_t slow = policy(outcome(100000, 10000, 0.01, false));
+    size_t slower = policy(outcome(100000, 10000, 0.01, false));
+    EXPECT_LT(slower, slow);
+    // Full collections don't affect the scaling.
+    EXPECT_EQ(slower, policy(outcome(100000, 10000, 0.01, true)));
+    GCManager::setTargetPause(0);
+}
+
+TEST(GCManagerTest, AdaptivePolicyScalingIsPerPolicy) {
+    GCManager::setTargetPause(0.001);
+    GCManager::AdaptivePolicy first;
+    size_t unscaled = first(outcome(100000, 10000, 0.001, false));
+    EXPECT_GT(unscaled, first(outcome(100000, 10000, 0.01, false)));
+    // A new policy doesn't inherit the scaling of the old one.
+    GCManager::AdaptivePolicy second;
+    EXPECT_EQ(unscaled, second(outcome(100000, 10000, 0.001, false)));
+    GCManager::setTargetPause(0);
+}
@@ -21,6 +21,10 @@
  *  http://www.r-project.org/Licenses/
  */
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "rho/GCNodeAllocator.hpp"
 #include "rho/AddressSanitizer.hpp"
@@ -34,16 +38,23 @@ void* pointer_offset(void* pointer, int offset) {
 
 TEST(GCNodeAllocatorTest, ExactLookupSmall) {
     // Test that looking up exact object pointer works for small objects.
+    std::vector<void*> allocs;
     for (int i = 4; i <= 256 / 8; ++i) {
         void* alloc = GCNodeAllocator::allocate(i * 8);
+        allocs.push_back(alloc);
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 TEST(GCNodeAllocatorTest, InternalLookupSmall) {
     // Test that looking up internal object pointers works for small objects.
+    std::vector<void*> allocs;
     for (int i = 4; i <= 256 / 8; ++i) {
         void* alloc = GCNodeAllocator::allocate(i * 8);
+        allocs.push_back(alloc);
         // One past start:
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(pointer_offset(alloc, 1)));
 
@@ -53,6 +64,9 @@ TEST(GCNodeAllocatorTest, InternalLookupSmall) {
         // Pointer to end:
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(pointer_offset(alloc, i * 8 - 1)));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 #ifndef HAVE_ADDRESS_SANITIZER
@@ -61,34 +75,51 @@ TEST(GCNodeAllocatorTest, InternalLookupSmall) {
 TEST(GCNodeAllocatorTest, OnePastEndLookupSmall) {
     // Test that looking up one past the end of a small 8-multiple allocation
     // does not find the same allocation.
+    std::vector<void*> allocs;
     for (int i = 4; i <= 256 / 8; ++i) {
         void* alloc = GCNodeAllocator::allocate(i * 8);
+        allocs.push_back(alloc);
         EXPECT_NE(alloc, pointer_offset(alloc, i * 8));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 TEST(GCNodeAllocatorTest, OneBeforeLookupSmall) {
     // Test that looking up a pointer before a small object allocation
     // does not find the same allocation.
+    std::vector<void*> allocs;
     for (int i = 4; i <= 256 / 8; ++i) {
         void* alloc = GCNodeAllocator::allocate(i * 8);
+        allocs.push_back(alloc);
         EXPECT_NE(alloc, pointer_offset(alloc, -1));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 #endif // HAVE_ADDRESS_SANITIZER
 
 TEST(GCNodeAllocatorTest, ExactLookupMedium) {
     // Test that looking up exact object pointer works for medium objects.
+    std::vector<void*> allocs;
     for (int i = 8; i < 18; ++i) {
         void* alloc = GCNodeAllocator::allocate(1 << i);
+        allocs.push_back(alloc);
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 TEST(GCNodeAllocatorTest, InternalLookupMedium) {
     // Test that looking up internal object pointers works for medium objects.
+    std::vector<void*> allocs;
     for (int i = 8; i < 18; ++i) {
         void* alloc = GCNodeAllocator::allocate(1 << i);
+        allocs.push_back(alloc);
         // One past start:
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(pointer_offset(alloc, 1)));
 
@@ -98,6 +129,9 @@ TEST(GCNodeAllocatorTest, InternalLookupMedium) {
         // Pointer to end:
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(pointer_offset(alloc, (1 << i) - 1)));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 TEST(GCNodeAllocatorTest, ExactLookupLarge) {
@@ -111,6 +145,9 @@ TEST(GCNodeAllocatorTest, ExactLookupLarge) {
     for (void* alloc : allocs) {
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 TEST(GCNodeAllocatorTest, InternalLookupLarge) {
@@ -131,6 +168,9 @@ TEST(GCNodeAllocatorTest, InternalLookupLarge) {
         // Pointer to end:
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(pointer_offset(alloc, size - 1)));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 #ifndef HAVE_ADDRESS_SANITIZER
@@ -146,6 +186,9 @@ TEST(GCNodeAllocatorTest, OnePastEndLookupLarge) {
     for (void* alloc : allocs) {
         EXPECT_NE(alloc, GCNodeAllocator::lookupPointer(pointer_offset(alloc, size + 1)));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 TEST(GCNodeAllocatorTest, OneBeforendLookupLarge) {
@@ -158,6 +201,9 @@ TEST(GCNodeAllocatorTest, OneBeforendLookupLarge) {
     for (void* alloc : allocs) {
         EXPECT_NE(alloc, GCNodeAllocator::lookupPointer(pointer_offset(alloc, -1)));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
 TEST(GCNodeAllocatorTest, FreeListSmall) {
@@ -230,9 +276,165 @@ TEST(GCNodeAllocatorTest, AllocManySmall) {
     // Make many allocations to make sure superblock lookup works when the
     // superblock becomes full.
     static constexpr int max_small_block_size = 256;
+    std::vector<void*> allocs;
     for (int i = 0; i < (1 << 19) / max_small_block_size; ++i) {
         void* alloc = GCNodeAllocator::allocate(256);
+        allocs.push_back(alloc);
         EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
     }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
 }
 
+
+TEST(GCNodeAllocatorTest, AllocFreeManyThreads) {
+    // Allocate and free small and medium objects from several threads at
+    // once, freeing some of each thread's objects on another thread.
+    static constexpr int num_threads = 4;
+    static constexpr int num_allocs = 20000;
+    std::vector<void*> allocs[num_threads];
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([t, &allocs]() {
+            for (int i = 0; i < num_allocs; ++i) {
+                void* alloc = GCNodeAllocator::allocate(32 + (i + t) % 300);
+                if (i % 2) {
+                    GCNodeAllocator::free(alloc);
+                } else {
+                    allocs[t].push_back(alloc);
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    for (int t = 0; t < num_threads; ++t) {
+        for (void* alloc : allocs[t]) {
+            EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
+        }
+    }
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([t, &allocs]() {
+            for (void* alloc : allocs[(t + 1) % num_threads]) {
+                GCNodeAllocator::free(alloc);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < num_threads; ++t) {
+        for (void* alloc : allocs[t]) {
+            EXPECT_EQ(nullptr, GCNodeAllocator::lookupPointer(alloc));
+        }
+    }
+}
+
+#ifndef HAVE_ADDRESS_SANITIZER
+// Freed blocks are not cached in address sanitizer builds.
+TEST(GCNodeAllocatorTest, FreeOnlyThreadReleasesCache) {
+    // A thread that only frees blocks must hand them back to the shared
+    // freelists when it exits, so that other threads can reuse them.
+    static constexpr int num_allocs = 10;
+    std::vector<void*> allocs;
+    for (int i = 0; i < num_allocs; ++i) {
+        allocs.push_back(GCNodeAllocator::allocate(56));
+    }
+    std::thread freer([&allocs]() {
+        for (void* alloc : allocs) {
+            GCNodeAllocator::free(alloc);
+        }
+    });
+    freer.join();
+
+    void* reused = nullptr;
+    std::thread allocator([&reused]() {
+        reused = GCNodeAllocator::allocate(56);
+        GCNodeAllocator::free(reused);
+    });
+    allocator.join();
+    EXPECT_NE(allocs.end(), std::find(allocs.begin(), allocs.end(), reused));
+}
+#endif // HAVE_ADDRESS_SANITIZER
+
+TEST(GCNodeAllocatorTest, SizeClassStatistics) {
+    // Check that allocations show up in the statistics for their size class.
+    static constexpr int num_allocs = 100;
+    static constexpr std::size_t large_size = std::size_t{1} << 22;
+    std::vector<void*> allocs;
+    for (int i = 0; i < num_allocs; ++i) {
+        allocs.push_back(GCNodeAllocator::allocate(48));
+    }
+    void* large = GCNodeAllocator::allocate(large_size);
+
+    bool found_small = false;
+    bool found_large = false;
+    for (const GCNodeAllocator::SizeClassStatistics& stats
+             : GCNodeAllocator::sizeClassStatistics()) {
+        EXPECT_LE(stats.allocated_blocks, stats.blocks);
+        if (stats.block_size == 48) {
+            found_small = true;
+            EXPECT_LE(1, stats.superblocks);
+            EXPECT_LE(num_allocs, stats.allocated_blocks);
+        } else if (stats.block_size == large_size) {
+            found_large = true;
+            EXPECT_EQ(0, stats.superblocks);
+            EXPECT_LE(1, stats.allocated_blocks);
+        }
+    }
+    EXPECT_TRUE(found_small);
+    EXPECT_TRUE(found_large);
+
+    unsigned num_buckets, used_buckets;
+    GCNodeAllocator::allocationTableUsage(&num_buckets, &used_buckets);
+    EXPECT_LE(1, used_buckets);
+    EXPECT_LE(used_buckets, num_buckets);
+
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
+    GCNodeAllocator::free(large);
+}
+
+#ifndef HAVE_ADDRESS_SANITIZER
+// Nothing is released in address sanitizer builds.
+TEST(GCNodeAllocatorTest, ReleaseEmptySuperblocks) {
+    // Fill several small and medium superblocks, free everything and check
+    // that the superblocks are released once they have stayed empty.
+    static constexpr int num_small = 40000;
+    static constexpr int num_medium = 2000;
+    std::vector<void*> allocs;
+    for (int i = 0; i < num_small; ++i) {
+        allocs.push_back(GCNodeAllocator::allocate(72));
+    }
+    for (int i = 0; i < num_medium; ++i) {
+        allocs.push_back(GCNodeAllocator::allocate(1000));
+    }
+    for (void* alloc : allocs) {
+        GCNodeAllocator::free(alloc);
+    }
+
+    std::size_t released_before = GCNodeAllocator::bytesReleased();
+    // The first call only notes which superblocks are empty.
+    EXPECT_EQ(0u, GCNodeAllocator::releaseEmptySuperblocks(3600));
+    std::size_t bytes = GCNodeAllocator::releaseEmptySuperblocks(0);
+    EXPECT_LT(0u, bytes);
+    EXPECT_EQ(released_before + bytes, GCNodeAllocator::bytesReleased());
+    EXPECT_LT(0u, GCNodeAllocator::numReleasedSuperblocks());
+    EXPECT_EQ(0u, GCNodeAllocator::releaseEmptySuperblocks(0));
+
+    // Released memory can be allocated again.
+    for (int i = 0; i < num_small; ++i) {
+        void* alloc = GCNodeAllocator::allocate(40);
+        EXPECT_EQ(alloc, GCNodeAllocator::lookupPointer(alloc));
+        allocs[i] = alloc;
+    }
+    for (int i = 0; i < num_small; ++i) {
+        GCNodeAllocator::free(allocs[i]);
+    }
+}
+#endif // HAVE_ADDRESS_SANITIZER
@@ -0,0 +1,118 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#include "TestHelpers.hpp"
+#include "rho/GCManager.hpp"
+#include "rho/GCNode.hpp"
+#include "rho/GCRoot.hpp"
+#include "rho/ListVector.hpp"
+
+using namespace rho;
+
+TEST(GCNodeTest, YoungCollectionPromotesSurvivors) {
+    GCRoot<ListVector> list(ListVector::create(1));
+    EXPECT_LT(0u, GCNode::numYoungNodes());
+
+    GCNode::gcYoung();
+    EXPECT_EQ(0u, GCNode::numYoungNodes());
+}
+
+TEST(GCNodeTest, YoungCollectionKeepsRootedCycles) {
+    GCRoot<ListVector> list(ListVector::create(1));
+    (*list)[0] = list.get();
+
+    GCNode::gcYoung();
+    EXPECT_EQ(list.get(), (*list)[0].get());
+    EXPECT_EQ(2, getRefCount(list));
+}
+
+TEST(GCNodeTest, YoungCollectionKeepsCyclesReferencedFromOldNodes) {
+    GCRoot<ListVector> old_list(ListVector::create(1));
+    GCNode::gcYoung();  // Promote old_list to the old generation.
+
+    {
+	GCRoot<ListVector> young_list(ListVector::create(1));
+	(*young_list)[0] = young_list.get();
+	(*old_list)[0] = young_list.get();
+    }
+
+    GCNode::gcYoung();
+    ListVector* survivor = SEXP_downcast<ListVector*>((*old_list)[0].get());
+    ASSERT_TRUE(survivor);
+    EXPECT_EQ(survivor, (*survivor)[0].get());
+}
+
+TEST(GCNodeTest, ParallelMarkSweepKeepsReachableNodes) {
+    unsigned int num_threads = GCManager::markSweepThreads();
+    GCManager::setMarkSweepThreads(4);
+
+    // A long chain, so that the marking threads have work to share.
+    GCRoot<ListVector> head(ListVector::create(1));
+    ListVector* tail = head;
+    for (int i = 0; i < 10000; ++i) {
+	ListVector* next = ListVector::create(1);
+	(*tail)[0] = next;
+	tail = next;
+    }
+    (*tail)[0] = head.get();
+
+    size_t num_nodes;
+    {
+	GCRoot<ListVector> garbage(ListVector::create(1));
+	(*garbage)[0] = garbage.get();
+	num_nodes = GCNode::numNodes();
+    }
+    GCNode::gc(true);
+    GCManager::setMarkSweepThreads(num_threads);
+
+    EXPECT_GE(num_nodes - 1, GCNode::numNodes());
+    int length = 0;
+    for (ListVector* node = SEXP_downcast<ListVector*>((*head)[0].get());
+	 node != head; node = SEXP_downcast<ListVector*>((*node)[0].get())) {
+	++length;
+    }
+    EXPECT_EQ(10000, length);
+}
+
+TEST(GCNodeTest, DeletingMoribundNodesKeepsMoribundListConsistent) {
+    {
+	GCRoot<ListVector> list(ListVector::create(1000));
+	for (int i = 0; i < 1000; ++i) {
+	    (*list)[i] = ListVector::create(1);
+	}
+    }
+    // Deleting the outer list deletes the (still moribund) elements.
+    GCNode::gc(false);
+    EXPECT_TRUE(GCNode::check());
+
+    // Fresh nodes may reuse the addresses of the deleted ones.
+    GCRoot<ListVector> list(ListVector::create(1000));
+    for (int i = 0; i < 1000; ++i) {
+	(*list)[i] = ListVector::create(1);
+    }
+    GCNode::gc(false);
+    EXPECT_TRUE(GCNode::check());
+    EXPECT_EQ(1, getRefCount((*list)[999]));
+}
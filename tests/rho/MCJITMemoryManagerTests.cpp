@@ -160,3 +160,77 @@ TEST_F(MCJITMemoryManagerTest, UndefinedGlobal) {
     uint64_t address = m_manager->getSymbolAddress("my_undefined_symbol");
     EXPECT_EQ(0, address);
 }
+
+TEST_F(MCJITMemoryManagerTest, GetConstant) {
+    Environment* test_object_1 = (Environment*)0x1;
+    Environment* test_object_2 = (Environment*)0x2;
+    GlobalVariable* global_1 = m_manager->getConstant(test_object_1);
+    GlobalVariable* global_2 = m_manager->getConstant(test_object_2);
+    EXPECT_NE(global_1, global_2);
+    EXPECT_EQ(global_1, m_manager->getConstant(test_object_1));
+
+    uint64_t address_1 = m_manager->getSymbolAddress(global_1->getName());
+    EXPECT_EQ(test_object_1, reinterpret_cast<Environment*>(address_1));
+    uint64_t address_2 = m_manager->getSymbolAddress(global_2->getName());
+    EXPECT_EQ(test_object_2, reinterpret_cast<Environment*>(address_2));
+}
+
+TEST_F(MCJITMemoryManagerTest, ConstantNamesAreDeterministic) {
+    Module other_module("mcjit_mm_test_2", m_context);
+    rho::JIT::MCJITMemoryManager other_manager(&other_module);
+
+    GlobalVariable* global_1 = m_manager->getConstant((Environment*)0x1);
+    GlobalVariable* global_2 = other_manager.getConstant((Environment*)0x2);
+    EXPECT_EQ(global_1->getName(), global_2->getName());
+}
+
+TEST_F(MCJITMemoryManagerTest, SharedManager) {
+    Module other_module("mcjit_mm_test_2", m_context);
+    rho::JIT::MCJITMemoryManager other_manager(&other_module);
+    rho::JIT::MCJITMemoryManager shared_manager;
+
+    Environment* test_object_1 = (Environment*)0x1;
+    Environment* test_object_2 = (Environment*)0x2;
+    GlobalVariable* global_1 = m_manager->getConstant(test_object_1);
+    GlobalVariable* global_2 = other_manager.getConstant(test_object_2);
+    Symbol* test_symbol = Symbol::obtain("mcjit_mm_test_symbol");
+    GlobalVariable* symbol_global = m_manager->getSymbol(test_symbol);
+    other_manager.getSymbol(test_symbol);
+
+    m_manager->renameModuleGlobals("a");
+    other_manager.renameModuleGlobals("b");
+    EXPECT_NE(global_1->getName(), global_2->getName());
+    EXPECT_EQ("rho.symbol.mcjit_mm_test_symbol", symbol_global->getName());
+
+    shared_manager.addGlobalsFrom(*m_manager);
+    shared_manager.addGlobalsFrom(other_manager);
+    uint64_t address_1 = shared_manager.getSymbolAddress(global_1->getName());
+    EXPECT_EQ(test_object_1, reinterpret_cast<Environment*>(address_1));
+    uint64_t address_2 = shared_manager.getSymbolAddress(global_2->getName());
+    EXPECT_EQ(test_object_2, reinterpret_cast<Environment*>(address_2));
+    uint64_t address = shared_manager.getSymbolAddress(
+	symbol_global->getName());
+    EXPECT_EQ(test_symbol, reinterpret_cast<Symbol*>(address));
+}
+
+TEST_F(MCJITMemoryManagerTest, ClearGlobals) {
+    rho::JIT::MCJITMemoryManager shared_manager;
+    Environment* test_object = (Environment*)0x1;
+    GlobalVariable* global = m_manager->getConstant(test_object);
+    Symbol* test_symbol = Symbol::obtain("mcjit_mm_test_symbol");
+    GlobalVariable* symbol_global = m_manager->getSymbol(test_symbol);
+    m_manager->renameModuleGlobals("a");
+
+    shared_manager.addGlobalsFrom(*m_manager);
+    uint64_t address = shared_manager.getSymbolAddress(global->getName());
+    EXPECT_EQ(test_object, reinterpret_cast<Environment*>(address));
+
+    shared_manager.clearGlobals();
+    EXPECT_EQ(0, shared_manager.getSymbolAddress(global->getName()));
+    address = shared_manager.getSymbolAddress(symbol_global->getName());
+    EXPECT_EQ(test_symbol, reinterpret_cast<Symbol*>(address));
+
+    // The module's own manager still knows its globals.
+    address = m_manager->getSymbolAddress(global->getName());
+    EXPECT_EQ(test_object, reinterpret_cast<Environment*>(address));
+}
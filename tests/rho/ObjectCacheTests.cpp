@@ -0,0 +1,234 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/ObjectCache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+using namespace rho::JIT;
+
+class ObjectCacheTest : public ::testing::Test
+{
+protected:
+    ObjectCacheTest()
+	: m_context(llvm::getGlobalContext()),
+	  m_module(new llvm::Module("object_cache_test", m_context))
+    {
+	char directory[] = "/tmp/rho-object-cache-XXXXXX";
+	if (mkdtemp(directory))
+	    m_directory = directory;
+	llvm::Function::Create(
+	    llvm::FunctionType::get(llvm::Type::getInt32Ty(m_context), false),
+	    llvm::GlobalValue::ExternalLinkage, "object_cache_test_function",
+	    m_module.get());
+    }
+
+    ~ObjectCacheTest()
+    {
+	for (const std::string& filename : m_files)
+	    std::remove(filename.c_str());
+	rmdir(m_directory.c_str());
+    }
+
+    std::unique_ptr<ObjectCache> create(CompilationTier tier
+					= CompilationTier::BASELINE)
+    {
+	std::unique_ptr<ObjectCache> cache
+	    = ObjectCache::create(m_module.get(), tier, m_directory);
+	if (cache)
+	    m_files.push_back(filename(cache->key()));
+	return cache;
+    }
+
+    std::string filename(const std::string& key) const
+    {
+	return m_directory + "/" + key + ".o";
+    }
+
+    // Passes 'object' to the cache as MCJIT does once it has generated
+    // the code.
+    static void store(ObjectCache* cache, const std::string& object)
+    {
+#if (LLVM_VERSION >= 306)
+	cache->notifyObjectCompiled(
+	    nullptr, llvm::MemoryBufferRef(object, "object"));
+#else
+	std::unique_ptr<llvm::MemoryBuffer> buffer(
+	    llvm::MemoryBuffer::getMemBuffer(object, "object", false));
+	cache->notifyObjectCompiled(nullptr, buffer.get());
+#endif
+    }
+
+    // Fetches the object code from the cache as MCJIT does.
+    static std::string load(ObjectCache* cache)
+    {
+	std::unique_ptr<llvm::MemoryBuffer> buffer(cache->getObject(nullptr));
+	return buffer ? buffer->getBuffer().str() : std::string();
+    }
+
+    static std::string readFile(const std::string& filename)
+    {
+	std::ifstream file(filename, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file),
+			   std::istreambuf_iterator<char>());
+    }
+
+    static void writeFile(const std::string& filename,
+			  const std::string& contents)
+    {
+	std::ofstream file(filename, std::ios::binary);
+	file.write(contents.data(), contents.size());
+    }
+
+    llvm::LLVMContext& m_context;
+    std::unique_ptr<llvm::Module> m_module;
+    std::string m_directory;
+    std::vector<std::string> m_files;
+};
+
+static const char test_object_code[] = "object code\n\0 for the test module";
+static const std::string test_object(test_object_code,
+				     sizeof(test_object_code) - 1);
+
+TEST_F(ObjectCacheTest, NoDirectory) {
+    EXPECT_TRUE(ObjectCache::create(m_module.get(), CompilationTier::BASELINE,
+				    "") == nullptr);
+}
+
+TEST_F(ObjectCacheTest, Miss) {
+    ASSERT_FALSE(m_directory.empty());
+    std::unique_ptr<ObjectCache> cache = create();
+    ASSERT_TRUE(cache != nullptr);
+    EXPECT_FALSE(cache->hasObject());
+    EXPECT_EQ("", load(cache.get()));
+}
+
+TEST_F(ObjectCacheTest, Hit) {
+    ASSERT_FALSE(m_directory.empty());
+    std::unique_ptr<ObjectCache> cache = create();
+    ASSERT_TRUE(cache != nullptr);
+    store(cache.get(), test_object);
+
+    std::unique_ptr<ObjectCache> later = create();
+    ASSERT_TRUE(later != nullptr);
+    EXPECT_EQ(cache->key(), later->key());
+    EXPECT_TRUE(later->hasObject());
+    EXPECT_EQ(test_object, load(later.get()));
+}
+
+TEST_F(ObjectCacheTest, KeyDependsOnTier) {
+    ASSERT_FALSE(m_directory.empty());
+    std::unique_ptr<ObjectCache> baseline = create(CompilationTier::BASELINE);
+    ASSERT_TRUE(baseline != nullptr);
+    store(baseline.get(), test_object);
+
+    std::unique_ptr<ObjectCache> optimized
+	= create(CompilationTier::OPTIMIZED);
+    ASSERT_TRUE(optimized != nullptr);
+    EXPECT_NE(baseline->key(), optimized->key());
+    EXPECT_FALSE(optimized->hasObject());
+}
+
+TEST_F(ObjectCacheTest, KeyDependsOnRuntimeModule) {
+    ASSERT_FALSE(m_directory.empty());
+    std::string key = ObjectCache::key(m_module.get(),
+				       CompilationTier::BASELINE, "runtime-1");
+    EXPECT_EQ(key, ObjectCache::key(m_module.get(), CompilationTier::BASELINE,
+				    "runtime-1"));
+    EXPECT_NE(key, ObjectCache::key(m_module.get(), CompilationTier::BASELINE,
+				    "runtime-2"));
+
+    // Code stored by another build of rho isn't found.
+    std::unique_ptr<ObjectCache> cache = create();
+    ASSERT_TRUE(cache != nullptr);
+    EXPECT_NE(key, cache->key());
+    store(cache.get(), test_object);
+    std::string other_filename = filename(key);
+    m_files.push_back(other_filename);
+    ASSERT_EQ(0, std::rename(filename(cache->key()).c_str(),
+			     other_filename.c_str()));
+    EXPECT_FALSE(create()->hasObject());
+}
+
+TEST_F(ObjectCacheTest, KeyDependsOnModule) {
+    ASSERT_FALSE(m_directory.empty());
+    std::unique_ptr<ObjectCache> cache = create();
+    ASSERT_TRUE(cache != nullptr);
+    store(cache.get(), test_object);
+
+    m_module->getFunction("object_cache_test_function")->setName(
+	"object_cache_test_function.1");
+    std::unique_ptr<ObjectCache> other = create();
+    ASSERT_TRUE(other != nullptr);
+    EXPECT_NE(cache->key(), other->key());
+    EXPECT_FALSE(other->hasObject());
+}
+
+TEST_F(ObjectCacheTest, TruncatedFile) {
+    ASSERT_FALSE(m_directory.empty());
+    std::unique_ptr<ObjectCache> cache = create();
+    ASSERT_TRUE(cache != nullptr);
+    store(cache.get(), test_object);
+
+    std::string contents = readFile(filename(cache->key()));
+    ASSERT_GT(contents.size(), test_object.size());
+    writeFile(filename(cache->key()), contents.substr(0, contents.size() - 1));
+    EXPECT_FALSE(create()->hasObject());
+    writeFile(filename(cache->key()),
+	      contents.substr(0, contents.size() - test_object.size()));
+    EXPECT_FALSE(create()->hasObject());
+    writeFile(filename(cache->key()), "");
+    EXPECT_FALSE(create()->hasObject());
+}
+
+TEST_F(ObjectCacheTest, CorruptFile) {
+    ASSERT_FALSE(m_directory.empty());
+    std::unique_ptr<ObjectCache> cache = create();
+    ASSERT_TRUE(cache != nullptr);
+    store(cache.get(), test_object);
+
+    std::string contents = readFile(filename(cache->key()));
+    std::string corrupt = contents;
+    corrupt[corrupt.size() - 1] ^= 1;
+    writeFile(filename(cache->key()), corrupt);
+    EXPECT_FALSE(create()->hasObject());
+
+    // A file with no header at all.
+    writeFile(filename(cache->key()), test_object);
+    EXPECT_FALSE(create()->hasObject());
+
+    // The code is stored again once it has been recompiled.
+    std::unique_ptr<ObjectCache> recompiled = create();
+    store(recompiled.get(), test_object);
+    EXPECT_EQ(contents, readFile(filename(cache->key())));
+    EXPECT_EQ(test_object, load(create().get()));
+}
@@ -0,0 +1,99 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+#include "rho/ParallelFor.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace rho;
+
+namespace {
+    class ParallelForTest : public ::testing::Test {
+    protected:
+	void SetUp() override
+	{
+	    m_saved_num_threads = ParallelFor::numThreads();
+	    m_saved_threshold = ParallelFor::threshold();
+	}
+
+	void TearDown() override
+	{
+	    ParallelFor::setNumThreads(m_saved_num_threads);
+	    ParallelFor::setThreshold(m_saved_threshold);
+	}
+    private:
+	unsigned int m_saved_num_threads;
+	std::size_t m_saved_threshold;
+    };
+}
+
+TEST_F(ParallelForTest, VisitsEachElementOnce)
+{
+    for (unsigned int num_ranges : {1, 2, 7, 64}) {
+	std::vector<int> visits(1000);
+	std::vector<int> range_calls(num_ranges);
+	ParallelFor::run(visits.size(), num_ranges,
+			 [&](unsigned int range, std::size_t begin,
+			     std::size_t end) {
+			     ++range_calls[range];
+			     for (std::size_t i = begin; i < end; ++i)
+				 ++visits[i];
+			 });
+	EXPECT_EQ(std::vector<int>(1000, 1), visits) << num_ranges;
+	EXPECT_EQ(std::vector<int>(num_ranges, 1), range_calls);
+    }
+}
+
+TEST_F(ParallelForTest, RangesAreBalanced)
+{
+    std::vector<std::size_t> lengths(3);
+    ParallelFor::run(10, 3,
+		     [&](unsigned int range, std::size_t begin,
+			 std::size_t end) {
+			 lengths[range] = end - begin;
+		     });
+    EXPECT_EQ(std::vector<std::size_t>({4, 3, 3}), lengths);
+}
+
+TEST_F(ParallelForTest, ShortLoopsAreNotSplit)
+{
+    ParallelFor::setNumThreads(4);
+    ParallelFor::setThreshold(1000);
+    EXPECT_EQ(1u, ParallelFor::numRanges(999));
+    EXPECT_GE(4u, ParallelFor::numRanges(1000));
+    EXPECT_LE(1u, ParallelFor::numRanges(1000));
+
+    ParallelFor::setThreshold(0);
+    EXPECT_GE(3u, ParallelFor::numRanges(3));
+
+    ParallelFor::setNumThreads(1);
+    EXPECT_EQ(1u, ParallelFor::numRanges(1000000));
+}
+
+TEST_F(ParallelForTest, ZeroThreadsMeansOne)
+{
+    ParallelFor::setNumThreads(0);
+    EXPECT_EQ(1u, ParallelFor::numThreads());
+}
@@ -0,0 +1,157 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+
+#define R_NO_REMAP
+#include "rho/jit/CompilationQueue.hpp"
+#include "rho/jit/CompiledExpression.hpp"
+
+#include "rho/Closure.hpp"
+#include "rho/CommandTerminated.hpp"
+#include "rho/Environment.hpp"
+#include "rho/GCStackRoot.hpp"
+#include "rho/Symbol.hpp"
+#include "EvaluationTests.hpp"
+
+using namespace rho;
+using namespace rho::JIT;
+
+// Closures are compiled on their second call and recompiled with
+// optimization on their fifth, all on the calling thread.
+class RecompilationTest : public ::testing::Test
+{
+protected:
+    RecompilationTest()
+	: m_depth(CompilationQueue::maxDepth()),
+	  m_compile_threshold(CompiledExpression::compileThreshold()),
+	  m_optimize_threshold(CompiledExpression::optimizeThreshold()),
+	  m_back_edge_threshold(
+	      CompiledExpression::optimizeBackEdgeThreshold()),
+	  m_env(Executor::newTestEnv())
+    {
+	CompilationQueue::setMaxDepth(0);
+	CompiledExpression::setCompileThreshold(2);
+	CompiledExpression::setOptimizeThreshold(5);
+	CompiledExpression::setOptimizeBackEdgeThreshold(0);
+    }
+
+    ~RecompilationTest()
+    {
+	CompilationQueue::setMaxDepth(m_depth);
+	CompiledExpression::setCompileThreshold(m_compile_threshold);
+	CompiledExpression::setOptimizeThreshold(m_optimize_threshold);
+	CompiledExpression::setOptimizeBackEdgeThreshold(
+	    m_back_edge_threshold);
+    }
+
+    Closure* define(const std::string& name, const std::string& function)
+    {
+	Executor::parseAndEvalWithInterpreter(name + " <- " + function, m_env);
+	return SEXP_downcast<Closure*>(
+	    m_env->frame()->binding(Symbol::obtain(name))->forcedValue());
+    }
+
+    // Evaluates expression with the interpreter, which calls the closures
+    // defined in the test environment, and compares the result with that
+    // of expected.
+    void expectResult(const std::string& expression,
+		      const std::string& expected)
+    {
+	GCStackRoot<> result(
+	    Executor::parseAndEvalWithInterpreter(expression, m_env));
+	GCStackRoot<> expected_result(
+	    Executor::parseAndEvalWithInterpreter(expected));
+	EXPECT_IDENTICAL(expected_result.get(), result.get()) << expression;
+    }
+
+    static CompilationTier tier(const Closure* closure)
+    {
+	const CompiledExpression* body = closure->compiledBody();
+	return body ? body->tier() : CompilationTier::BASELINE;
+    }
+
+    unsigned int m_depth;
+    unsigned int m_compile_threshold;
+    unsigned int m_optimize_threshold;
+    unsigned int m_back_edge_threshold;
+    GCStackRoot<Environment> m_env;
+};
+
+TEST_F(RecompilationTest, HotClosuresAreRecompiled) {
+    uint64_t num_optimized = CompilationQueue::statistics().num_optimized;
+    GCStackRoot<Closure> f(define(
+	"f", "function(n) { s <- 0; i <- 0L;"
+	"  while (i < n) { i <- i + 1L; s <- s + i * 2 }; s }"));
+
+    // Every call gets the same answer, whichever code runs it.
+    for (int i = 0; i < 10; ++i)
+	expectResult("f(10L)", "110");
+    ASSERT_TRUE(f->compiledBody() != nullptr);
+    EXPECT_EQ(CompilationTier::OPTIMIZED, tier(f));
+    EXPECT_EQ(num_optimized + 1,
+	      CompilationQueue::statistics().num_optimized);
+
+    expectResult("f(0L)", "0");
+    expectResult("f(100L)", "10100");
+    expectResult("f(2.5)", "12");
+}
+
+TEST_F(RecompilationTest, LoopsMakeClosuresHot) {
+    CompiledExpression::setOptimizeThreshold(0);
+    CompiledExpression::setOptimizeBackEdgeThreshold(1000);
+    GCStackRoot<Closure> f(define(
+	"f", "function(n) { s <- 0L; for (i in seq_len(n)) s <- s + i; s }"));
+
+    // Only the baseline code counts iterations.  It runs the third and
+    // fourth calls, after which the closure is hot, so the fifth call
+    // recompiles it and the sixth runs the optimized code.
+    for (int i = 0; i < 5; ++i)
+	expectResult("f(600L)", "180300L");
+    EXPECT_EQ(CompilationTier::BASELINE, tier(f));
+    expectResult("f(600L)", "180300L");
+    EXPECT_EQ(CompilationTier::OPTIMIZED, tier(f));
+}
+
+// The optimized code has the runtime functions linked in for inlining.
+// Check the paths through them that the baseline tests exercise least.
+TEST_F(RecompilationTest, OptimizedCodeKeepsRuntimeBehaviour) {
+    GCStackRoot<Closure> f(define(
+	"f", "function(x, y) { if (y < 0) stop('negative');"
+	"  x[[y]] + length(x) }"));
+
+    for (int i = 0; i < 10; ++i)
+	expectResult("f(c(5, 6, 7), 2L)", "9");
+    ASSERT_EQ(CompilationTier::OPTIMIZED, tier(f));
+
+    // Operands of other types than those seen so far.
+    expectResult("f(list(1L, 2L), 1)", "3L");
+    expectResult("f(c(a = 1.5), 'a')", "2.5");
+    // Errors raised by the runtime and by called functions.
+    EXPECT_THROW(Executor::parseAndEvalWithInterpreter("f(1, -1)", m_env),
+		 CommandTerminated);
+    EXPECT_THROW(Executor::parseAndEvalWithInterpreter("f(1, 5L)", m_env),
+		 CommandTerminated);
+    // Functions that the code looks up can be redefined.
+    expectResult("{ length <- function(x) 100; f(c(5, 6, 7), 2L) }", "106");
+}
@@ -37,5 +37,27 @@ TEST_P(SubassignTest_, ExtendVector)
       });
 }
 
+TEST_P(SubassignTest_, AppendInLoop)
+{
+  runEvaluatorTests({
+      { "{ x <- integer(); for (i in 1:100) x[i] <- i; identical(x, 1:100) }",
+            "TRUE" },
+      { "{ x <- list(); for (i in 1:100) x[[i]] <- i; identical(x, as.list(1:100)) }",
+            "TRUE" },
+      { "{ x <- c(a = 1); for (i in 2:50) x[length(x) + 1] <- i;"
+        " c(length(x), length(names(x)), sum(names(x) == '')) }",
+            "c(50L, 50L, 49L)" },
+      { "{ x <- 1; y <- x; x[3] <- 3; y }", "1" },
+      { "{ x <- 1; x[3] <- 3; y <- x; x[4] <- 4; y }", "c(1, NA, 3)" },
+      { "{ x <- c(a = 1); x[3] <- 3; n <- names(x); x[4] <- 4; n }",
+            "c('a', '', '')" },
+      { "{ x <- c(a = 1); x[3] <- 3; x[4] <- 4; y <- x * 2; x[5] <- 5;"
+        " c(length(y), length(names(y))) }",
+            "c(4L, 4L)" },
+      { "{ x <- c(a = 1); x[3] <- 3; y <- -x; x[['d']] <- 4; names(y) }",
+            "c('a', '', '')" },
+      });
+}
+
 INSTANTIATE_TEST_CASE_P(SubassignTest, SubassignTest_,
                         testing::Values(Executor::InterpreterExecutor()));
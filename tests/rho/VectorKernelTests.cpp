@@ -0,0 +1,204 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the Rho Project Authors.
+ *
+ *  Rho is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the Rho website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+#include "gtest/gtest.h"
+#include "rho/VectorKernels.hpp"
+
+#include <climits>
+#include <cmath>
+#include <vector>
+
+using namespace rho::VectorOps::Kernels;
+
+namespace {
+    const int na = INT_MIN;
+
+    // Pairs of operands that exercise NA handling and overflow, as a
+    // vector of left operands and a vector of right operands.
+    const std::vector<int> int_lhs = {
+	1, -1, na, 5, INT_MAX, -INT_MAX, INT_MAX, -INT_MAX, 46341, -46341,
+	65536, 0, 7, -3, na, 2
+    };
+    const std::vector<int> int_rhs = {
+	2, na, 3, -5, 1, -1, -1, 1, 46341, 46341,
+	-32768, 0, -7, 0, na, INT_MAX
+    };
+
+    // Expected values, computed the same way as integer_plus() and
+    // friends in arithmetic.cpp.
+    int expectedPlus(long long lhs, long long rhs)
+    {
+	if (lhs == na || rhs == na)
+	    return na;
+	long long sum = lhs + rhs;
+	return (sum > INT_MAX || sum < -INT_MAX) ? na : int(sum);
+    }
+
+    int expectedMinus(long long lhs, long long rhs)
+    {
+	if (lhs == na || rhs == na)
+	    return na;
+	long long difference = lhs - rhs;
+	return (difference > INT_MAX || difference < -INT_MAX)
+	    ? na : int(difference);
+    }
+
+    int expectedTimes(long long lhs, long long rhs)
+    {
+	if (lhs == na || rhs == na)
+	    return na;
+	long long product = lhs * rhs;
+	return (product > INT_MAX || product < -INT_MAX) ? na : int(product);
+    }
+
+    int expectedAnd(int lhs, int rhs)
+    {
+	if (lhs == 0 || rhs == 0)
+	    return 0;
+	return (lhs == na || rhs == na) ? na : 1;
+    }
+
+    int expectedOr(int lhs, int rhs)
+    {
+	if ((lhs != 0 && lhs != na) || (rhs != 0 && rhs != na))
+	    return 1;
+	return (lhs == na || rhs == na) ? na : 0;
+    }
+}
+
+TEST(VectorKernelTest, IntegerArithmetic)
+{
+    std::size_t n = int_lhs.size();
+    std::vector<int> out(n);
+
+    EXPECT_TRUE(integerArithmetic(PLUS, VECTOR_VECTOR, out.data(),
+				  int_lhs.data(), int_rhs.data(), n));
+    for (std::size_t i = 0; i < n; ++i)
+	EXPECT_EQ(expectedPlus(int_lhs[i], int_rhs[i]), out[i]) << i;
+
+    EXPECT_TRUE(integerArithmetic(MINUS, VECTOR_VECTOR, out.data(),
+				  int_lhs.data(), int_rhs.data(), n));
+    for (std::size_t i = 0; i < n; ++i)
+	EXPECT_EQ(expectedMinus(int_lhs[i], int_rhs[i]), out[i]) << i;
+
+    EXPECT_TRUE(integerArithmetic(TIMES, VECTOR_VECTOR, out.data(),
+				  int_lhs.data(), int_rhs.data(), n));
+    for (std::size_t i = 0; i < n; ++i)
+	EXPECT_EQ(expectedTimes(int_lhs[i], int_rhs[i]), out[i]) << i;
+}
+
+TEST(VectorKernelTest, IntegerOverflowIsNotReportedForNA)
+{
+    std::vector<int> lhs = {1, na, INT_MAX};
+    std::vector<int> out(3);
+    int rhs = na;
+    EXPECT_FALSE(integerArithmetic(PLUS, VECTOR_SCALAR, out.data(),
+				   lhs.data(), &rhs, 3));
+    EXPECT_EQ(std::vector<int>({na, na, na}), out);
+
+    rhs = 1;
+    EXPECT_TRUE(integerArithmetic(PLUS, VECTOR_SCALAR, out.data(),
+				  lhs.data(), &rhs, 3));
+    EXPECT_EQ(std::vector<int>({2, na, na}), out);
+
+    EXPECT_FALSE(integerArithmetic(MINUS, SCALAR_VECTOR, out.data(),
+				   &rhs, lhs.data(), 3));
+    EXPECT_EQ(std::vector<int>({0, na, 1 - INT_MAX}), out);
+}
+
+TEST(VectorKernelTest, RealArithmetic)
+{
+    std::vector<double> lhs = {1.5, -2, 0, NAN, INFINITY, 1e308};
+    std::vector<double> out(lhs.size());
+    double rhs = 2;
+
+    realArithmetic(PLUS, VECTOR_SCALAR, out.data(), lhs.data(), &rhs,
+		   lhs.size());
+    EXPECT_EQ(3.5, out[0]);
+    EXPECT_TRUE(std::isnan(out[3]));
+    EXPECT_EQ(INFINITY, out[4]);
+
+    realArithmetic(DIVIDE, SCALAR_VECTOR, out.data(), &rhs, lhs.data(),
+		   lhs.size());
+    EXPECT_EQ(-1, out[1]);
+    EXPECT_EQ(INFINITY, out[2]);
+    EXPECT_EQ(0, out[4]);
+
+    realArithmetic(SQUARE, VECTOR_VECTOR, out.data(), lhs.data(), nullptr,
+		   lhs.size());
+    EXPECT_EQ(2.25, out[0]);
+    EXPECT_EQ(4, out[1]);
+    EXPECT_TRUE(std::isnan(out[3]));
+    EXPECT_EQ(INFINITY, out[5]);
+}
+
+TEST(VectorKernelTest, Comparisons)
+{
+    std::vector<double> lhs = {1, 2, 3, NAN, 1};
+    std::vector<double> rhs = {2, 2, 2, 1, NAN};
+    std::vector<int> out(lhs.size());
+
+    realComparison(LT, VECTOR_VECTOR, out.data(), lhs.data(), rhs.data(),
+		   lhs.size());
+    EXPECT_EQ(std::vector<int>({1, 0, 0, na, na}), out);
+    realComparison(GE, VECTOR_VECTOR, out.data(), lhs.data(), rhs.data(),
+		   lhs.size());
+    EXPECT_EQ(std::vector<int>({0, 1, 1, na, na}), out);
+
+    std::vector<int> ilhs = {1, 2, 3, na, 1};
+    int irhs = 2;
+    integerComparison(EQ, VECTOR_SCALAR, out.data(), ilhs.data(), &irhs,
+		      ilhs.size());
+    EXPECT_EQ(std::vector<int>({0, 1, 0, na, 0}), out);
+    integerComparison(GT, SCALAR_VECTOR, out.data(), &irhs, ilhs.data(),
+		      ilhs.size());
+    EXPECT_EQ(std::vector<int>({1, 0, 0, na, 1}), out);
+    irhs = na;
+    integerComparison(NE, VECTOR_SCALAR, out.data(), ilhs.data(), &irhs,
+		      ilhs.size());
+    EXPECT_EQ(std::vector<int>(5, na), out);
+}
+
+TEST(VectorKernelTest, Logical)
+{
+    // Every combination of FALSE, TRUE, NA and a nonstandard TRUE.
+    std::vector<int> values = {0, 1, na, 2};
+    std::vector<int> lhs, rhs;
+    for (int l : values) {
+	for (int r : values) {
+	    lhs.push_back(l);
+	    rhs.push_back(r);
+	}
+    }
+    std::vector<int> out(lhs.size());
+
+    logical(AND, VECTOR_VECTOR, out.data(), lhs.data(), rhs.data(),
+	    lhs.size());
+    for (std::size_t i = 0; i < lhs.size(); ++i)
+	EXPECT_EQ(expectedAnd(lhs[i], rhs[i]), out[i]) << i;
+
+    logical(OR, VECTOR_VECTOR, out.data(), lhs.data(), rhs.data(),
+	    lhs.size());
+    for (std::size_t i = 0; i < lhs.size(); ++i)
+	EXPECT_EQ(expectedOr(lhs[i], rhs[i]), out[i]) << i;
+}